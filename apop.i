@@ -169,8 +169,12 @@ def apop_pylist_to_data(inlist):
 
 /* Variadics: */
 int apop_db_close(char vacuum='q');
-void apop_db_merge(char *db_file, char inout='i');
-void apop_db_merge_table(char *db_file, char *tabname, char inout='i');
+long apop_db_merge(char *db_file, char inout='i', char indices='n');
+long apop_db_merge_table(char *db_file, char *tabname, char inout='i', char indices='n');
+apop_data * apop_query_cursor_percentiles(apop_query_cursor *cursor, char rounding='d', int k=200);
+apop_sketch * apop_sketch_alloc(int k=200);
+double * apop_sketch_percentiles(apop_sketch const *s, char rounding='d');
+double apop_sketch_percentile(apop_sketch const *s, double p, char rounding='d');
 apop_data * apop_text_to_data(char *text_file="-", int has_row_names=0, int has_col_names=1);
 int apop_text_to_db(char *text_file="-", char *tabname="t", int has_row_names =0, int has_col_names=1, char **field_names=NULL,
         int *field_ends=NULL, apop_data *field_params=NULL, char* table_params=NULL, char *delimiters = "|,\t");
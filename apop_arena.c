@@ -0,0 +1,208 @@
+/** \file apop_arena.c  Bulk storage for the strings in names and text grids. */
+/* Copyright (c) 2026 by Ben Klemens.  Licensed under the modified GNU GPL v2; see COPYING and COPYING2.
+
+   Normally, every row name and every cell of a text grid is its own malloced string, so
+   a data set with a few million rows of text is tens of millions of tiny heap blocks,
+   and freeing or copying it means tens of millions of calls to free or malloc. An arena
+   packs the strings back to back into a few big blocks, each twice the size of the last,
+   so freeing the data set frees a few dozen blocks.
+
+   --Nothing in an arena is freed on its own. A string that gets replaced is dead space
+     until the whole arena goes.
+   --A set with an arena can still hold heap-allocated strings, e.g., because the user
+     asprintfed into a text cell, so apop_arena_free checks whether the arena owns the
+     pointer, and calls free if not. To free a whole name list or text grid, use
+     apop_arena_free_list or apop_arena_free_grid, which take the lock once, not once
+     per string.
+   --An apop_data set and its apop_name both point to the arena; it is freed when the
+     last of them lets go.
+   --With a NULL arena, all of these are the usual malloc, strdup, realloc, and free.
+   --apop_arena_adopt makes an arena whose first block is somebody else's memory, like
+     an mmapped file (see apop_binary.c). The strings in it are owned by the arena like
+     any other, and the block's release function is called when the arena goes.
+*/
+#include "apop_internal.h"
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+
+typedef struct arena_block {
+    struct arena_block *prev;
+    size_t size, used;
+    char *data;
+    void (*release)(void *data, size_t size); //for adopted blocks; NULL for ours.
+} arena_block;
+
+struct apop_arena {
+    pthread_mutex_t lock;
+    int refs;
+    arena_block *top;
+};
+
+#define First_block 4096
+#define Max_growth ((size_t)1<<26)
+
+struct apop_arena *apop_arena_alloc(void){
+    struct apop_arena *out = malloc(sizeof(struct apop_arena));
+    Apop_stopif(!out, return NULL, 0, "malloc failed. Probably out of memory.");
+    *out = (struct apop_arena){.refs=1};
+    pthread_mutex_init(&out->lock, NULL);
+    return out;
+}
+
+struct apop_arena *apop_arena_keep(struct apop_arena *a){
+    if (!a) return NULL;
+    pthread_mutex_lock(&a->lock);
+    a->refs++;
+    pthread_mutex_unlock(&a->lock);
+    return a;
+}
+
+void apop_arena_release(struct apop_arena *a){
+    if (!a) return;
+    pthread_mutex_lock(&a->lock);
+    int left = --a->refs;
+    pthread_mutex_unlock(&a->lock);
+    if (left) return;
+    for (arena_block *b = a->top, *prev; b; b = prev){
+        prev = b->prev;
+        if (b->release) b->release(b->data, b->size);
+        free(b);
+    }
+    pthread_mutex_destroy(&a->lock);
+    free(a);
+}
+
+struct apop_arena *apop_arena_adopt(void *data, size_t size, void (*release)(void *data, size_t size)){
+    struct apop_arena *out = apop_arena_alloc();
+    Apop_stopif(!out, return NULL, 0, "malloc failed. Probably out of memory.");
+    arena_block *b = malloc(sizeof(arena_block));
+    Apop_stopif(!b, apop_arena_release(out); return NULL, 0, "malloc failed. Probably out of memory.");
+    //used==size, so new strings go to new blocks, not into the adopted memory.
+    *b = (arena_block){.size=size, .used=size, .data=data, .release=release};
+    out->top = b;
+    return out;
+}
+
+static int in_block(arena_block const *b, void const *p){
+    uintptr_t x = (uintptr_t)p;
+    return x >= (uintptr_t)b->data && x < (uintptr_t)b->data + b->size;
+}
+
+//Call with the lock held.
+static int owns(struct apop_arena *a, void const *p){
+    for (arena_block *b = a->top; b; b = b->prev)
+        if (in_block(b, p)) return 1;
+    return 0;
+}
+
+//Call with the lock held.
+static void *arena_get(struct apop_arena *a, size_t size){
+    size = (size + sizeof(void*)-1) / sizeof(void*) * sizeof(void*); //keep everything pointer-aligned
+    arena_block *b = a->top;
+    if (!b || b->size - b->used < size){
+        size_t blocksize = b ? b->size + GSL_MIN(b->size, Max_growth) : First_block;
+        if (blocksize < size) blocksize = size;
+        arena_block *newb = malloc(sizeof(arena_block) + blocksize);
+        Apop_stopif(!newb, return NULL, 0, "malloc of a %zu-byte arena block failed. Probably out of memory.", blocksize);
+        *newb = (arena_block){.prev=b, .size=blocksize, .data=(char*)(newb+1)};
+        a->top = b = newb;
+    }
+    void *out = b->data + b->used;
+    b->used += size;
+    return out;
+}
+
+void *apop_arena_malloc(struct apop_arena *a, size_t size){
+    if (!a) return malloc(size);
+    pthread_mutex_lock(&a->lock);
+    void *out = arena_get(a, size);
+    pthread_mutex_unlock(&a->lock);
+    return out;
+}
+
+char *apop_arena_strdup(struct apop_arena *a, char const *s){
+    if (!a) return strdup(s);
+    size_t len = strlen(s)+1;
+    char *out = apop_arena_malloc(a, len);
+    if (out) memcpy(out, s, len);
+    return out;
+}
+
+char *apop_arena_vprintf(struct apop_arena *a, char const *fmt, va_list ap){
+    char *out = NULL;
+    if (!a){
+        vasprintf(&out, fmt, ap);
+        return out;
+    }
+    va_list ap2;
+    va_copy(ap2, ap);
+    int len = vsnprintf(NULL, 0, fmt, ap2);
+    va_end(ap2);
+    if (len >= 0 && (out = apop_arena_malloc(a, len+1)))
+        vsnprintf(out, len+1, fmt, ap);
+    return out;
+}
+
+void apop_arena_free(struct apop_arena *a, void *p){
+    if (!p) return;
+    if (a){
+        pthread_mutex_lock(&a->lock);
+        int mine = owns(a, p);
+        pthread_mutex_unlock(&a->lock);
+        if (mine) return;
+    }
+    free(p);
+}
+
+/* Call with the lock held. Strings stored one after another are usually in the same
+   block, so check the block the last one was in before searching the rest. */
+static void free_unowned(struct apop_arena *a, void **list, size_t n, arena_block **last){
+    for (size_t i=0; i< n; i++){
+        if (!list[i] || (*last && in_block(*last, list[i]))) continue;
+        arena_block *b = a->top;
+        while (b && !in_block(b, list[i])) b = b->prev;
+        if (b) *last = b;
+        else free(list[i]);
+    }
+}
+
+void apop_arena_free_list(struct apop_arena *a, void *list, size_t n){
+    if (!list) return;
+    void **l = list;
+    if (!a){
+        for (size_t i=0; i< n; i++) free(l[i]);
+        return;
+    }
+    arena_block *last = NULL;
+    pthread_mutex_lock(&a->lock);
+    free_unowned(a, l, n, &last);
+    pthread_mutex_unlock(&a->lock);
+}
+
+void apop_arena_free_grid(struct apop_arena *a, void *grid, size_t rows, size_t cols){
+    if (!grid) return;
+    void ***g = grid;
+    if (!a){
+        for (size_t i=0; i< rows; i++) apop_arena_free_list(NULL, g[i], cols);
+        apop_arena_free_list(NULL, g, rows);
+        return;
+    }
+    arena_block *last = NULL;
+    pthread_mutex_lock(&a->lock);
+    for (size_t i=0; i< rows; i++)
+        if (g[i]) free_unowned(a, g[i], cols, &last);
+    free_unowned(a, (void**)g, rows, &last); //then the rows themselves
+    pthread_mutex_unlock(&a->lock);
+}
+
+void *apop_arena_realloc(struct apop_arena *a, void *p, size_t oldsize, size_t newsize){
+    if (!a) return realloc(p, newsize);
+    pthread_mutex_lock(&a->lock);
+    int mine = !p || owns(a, p);
+    void *out = mine ? arena_get(a, newsize) : NULL;
+    pthread_mutex_unlock(&a->lock);
+    if (!mine) return realloc(p, newsize);
+    if (out && p) memcpy(out, p, GSL_MIN(oldsize, newsize));
+    return out;
+}
@@ -357,15 +357,15 @@ APOP_VAR_ENDHEAD
             *substrings = apop_text_alloc(*substrings, matchrow+1, matchcount);
             //match zero is the whole string; ignore.
             for (int i=0; i< matchcount; i++){
+                struct apop_arena *arena = (*substrings)->arena;
+                apop_arena_free(arena, (*substrings)->text[matchrow][i]);
                 if (result[i+1].rm_eo > 0){//GNU peculiarity: match-to-empty marked with -1.
                     int length_of_match = result[i+1].rm_eo - result[i+1].rm_so;
-                    (*substrings)->text[matchrow][i] = malloc(strlen(string)+1);
+                    (*substrings)->text[matchrow][i] = apop_arena_malloc(arena, length_of_match+1);
                     memcpy((*substrings)->text[matchrow][i], string + result[i+1].rm_so, length_of_match);
                     (*substrings)->text[matchrow][i][length_of_match] = '\0';
-                } else{ //matches nothing
-                    (*substrings)->text[matchrow][i] = malloc(1);
-                    (*substrings)->text[matchrow][i][0]='\0';
-                }
+                } else //matches nothing
+                    (*substrings)->text[matchrow][i] = apop_arena_strdup(arena, "");
             }
             string += result[0].rm_eo; //end of whole match;
             matchrow++;
@@ -0,0 +1,372 @@
+/** \file apop_binary.c  A binary format for data sets, read back via mmap with no parsing or copying. */
+/* Copyright (c) 2026 by Ben Klemens.  Licensed under the modified GNU GPL v2; see COPYING and COPYING2.
+
+   Writing a data set out as text and reading it back in means printing and parsing
+   every number. This format is the data set's own memory, written out block by block,
+   so apop_data_mmap can map the file and point the vectors and matrices straight at it.
+
+   --The file is a file_header, then the pages, each a page_header followed by its blocks:
+     vector, matrix, columns, weights, text, names. Every header and block starts at a
+     multiple of Align bytes from the top of the file, and mmap gives a page-aligned base,
+     so the doubles are aligned for vector loads.
+   --Offsets in the headers count from the top of the file; zero means there's no such block.
+   --Text and names are string tables: a strtab_header, an offset for each string
+     (relative to the start of the strings, or No_string for NULL), then the strings,
+     each with its '\0'.
+   --Numbers are in the writer's byte order. The header records it, and the reader refuses
+     a file from the other order rather than swapping, which would mean copying.
+   --The mapping is MAP_PRIVATE, so the data set can be modified in memory; pages are
+     copied only when written to, and nothing goes back to the file.
+   --The mapping belongs to an arena (see apop_arena.c), which every page of the data set
+     holds a reference to, so it is unmapped when the last page is freed. The gsl_vector
+     and gsl_matrix structs don't own their data, so gsl_*_free leaves the mapping alone.
+*/
+#include "apop_internal.h"
+#include <stdint.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define Align 64
+#define Magic "apopdat1"
+#define Byte_order 0x01020304
+#define No_string UINT64_MAX
+
+typedef struct {
+    char magic[8];
+    uint32_t byte_order, page_header_size;
+    uint64_t first_page;
+} file_header;
+
+typedef struct {
+    uint64_t vsize, msize1, msize2, csize1, csize2, wsize, textsize[2];
+    uint64_t colct, rowct, textct;                          //counts of names
+    uint64_t vector, matrix, columns, weights, text, names; //offsets of the blocks
+    uint64_t next;                                          //offset of the next page
+    char title[101], error, has_vector_name;
+} page_header;
+
+typedef struct {
+    uint64_t ct, bytes;
+} strtab_header;
+
+static uint64_t align(uint64_t x){ return (x + Align-1) / Align * Align; }
+
+////////// Writing
+
+//The strings of a text grid or a name list, gathered into one list.
+typedef struct {
+    char const **list;
+    uint64_t ct, bytes;
+} strtab;
+
+static void strtab_count(strtab *s){
+    s->bytes = 0;
+    for (uint64_t i=0; i< s->ct; i++)
+        if (s->list[i]) s->bytes += strlen(s->list[i])+1;
+}
+
+static strtab text_strtab(apop_data const *d){
+    strtab out = {.ct = (d->text ? (uint64_t)d->textsize[0]*d->textsize[1] : 0)};
+    if (!out.ct) return out;
+    out.list = malloc(sizeof(char*) * out.ct);
+    for (size_t i=0; i< d->textsize[0]; i++)
+        memcpy(out.list + i*d->textsize[1], d->text[i], sizeof(char*)*d->textsize[1]);
+    strtab_count(&out);
+    return out;
+}
+
+static strtab name_strtab(apop_name const *n){
+    strtab out = {.ct = n ? !!n->vector + n->colct + n->rowct + n->textct : 0};
+    if (!out.ct) return out;
+    out.list = malloc(sizeof(char*) * out.ct);
+    char const **l = out.list;
+    if (n->vector) *l++ = n->vector;
+    for (int i=0; i< n->colct; i++) *l++ = n->column[i];
+    for (int i=0; i< n->rowct; i++) *l++ = n->row[i];
+    for (int i=0; i< n->textct; i++) *l++ = n->text[i];
+    strtab_count(&out);
+    return out;
+}
+
+static uint64_t strtab_size(strtab s){
+    return sizeof(strtab_header) + sizeof(uint64_t)*s.ct + s.bytes;
+}
+
+typedef struct {
+    FILE *f;
+    uint64_t pos;
+    int bad;
+} writer;
+
+static void w_write(writer *w, void const *data, size_t size, size_t n){
+    if (!n || !size) return;
+    w->bad |= fwrite(data, size, n, w->f) != n;
+    w->pos += size*n;
+}
+
+static void w_pad(writer *w, uint64_t to){
+    static char const zeros[Align];
+    while (w->pos < to) w_write(w, zeros, 1, GSL_MIN(to - w->pos, Align));
+}
+
+static void w_vector(writer *w, gsl_vector const *v){
+    if (v->stride == 1) w_write(w, v->data, sizeof(double), v->size);
+    else for (size_t i=0; i< v->size; i++)
+        w_write(w, v->data + i*v->stride, sizeof(double), 1);
+}
+
+static void w_matrix(writer *w, gsl_matrix const *m){
+    if (m->tda == m->size2) w_write(w, m->data, sizeof(double), m->size1*m->size2);
+    else for (size_t i=0; i< m->size1; i++)
+        w_write(w, m->data + i*m->tda, sizeof(double), m->size2);
+}
+
+static void w_strtab(writer *w, strtab s){
+    w_write(w, &(strtab_header){.ct=s.ct, .bytes=s.bytes}, sizeof(strtab_header), 1);
+    uint64_t offsets[1024], at = 0;
+    for (uint64_t i=0; i< s.ct; i+= 1024){
+        int n = GSL_MIN(1024, s.ct - i);
+        for (int j=0; j< n; j++){
+            char const *str = s.list[i+j];
+            offsets[j] = str ? at : No_string;
+            if (str) at += strlen(str)+1;
+        }
+        w_write(w, offsets, sizeof(uint64_t), n);
+    }
+    for (uint64_t i=0; i< s.ct; i++)
+        if (s.list[i]) w_write(w, s.list[i], 1, strlen(s.list[i])+1);
+}
+
+int apop_data_write_binary(apop_data const *d, FILE *f){
+    Apop_stopif(!f, return 1, 0, "No file to write to.");
+    writer w = {.f=f};
+    file_header fh = {.byte_order=Byte_order, .page_header_size=sizeof(page_header),
+                      .first_page = d ? align(sizeof(file_header)) : 0};
+    memcpy(fh.magic, Magic, sizeof(fh.magic));
+    w_write(&w, &fh, sizeof(file_header), 1);
+    for (apop_data const *p = d; p && !w.bad; p = p->more){
+        strtab text = text_strtab(p), names = name_strtab(p->names);
+        page_header h = {.vsize = p->vector ? p->vector->size : 0, .wsize = p->weights ? p->weights->size : 0,
+                         .msize1 = p->matrix ? p->matrix->size1 : 0, .msize2 = p->matrix ? p->matrix->size2 : 0,
+                         .csize1 = p->columns ? p->columns->size1 : 0, .csize2 = p->columns ? p->columns->size2 : 0,
+                         .textsize = {text.ct ? p->textsize[0] : 0, text.ct ? p->textsize[1] : 0},
+                         .error = p->error};
+        if (p->names){
+            h.colct = p->names->colct;
+            h.rowct = p->names->rowct;
+            h.textct = p->names->textct;
+            h.has_vector_name = !!p->names->vector;
+            memcpy(h.title, p->names->title, sizeof(h.title));
+        }
+        //Lay out the blocks, then write them.
+        uint64_t at = align(w.pos), next = align(at + sizeof(page_header));
+        if (p->vector) {h.vector = next; next = align(next + sizeof(double)*h.vsize);}
+        if (p->matrix) {h.matrix = next; next = align(next + sizeof(double)*h.msize1*h.msize2);}
+        if (p->columns){h.columns = next; next = align(next + sizeof(double)*h.csize1*h.csize2);}
+        if (p->weights){h.weights = next; next = align(next + sizeof(double)*h.wsize);}
+        if (text.ct)   {h.text = next; next = align(next + strtab_size(text));}
+        if (names.ct)  {h.names = next; next = align(next + strtab_size(names));}
+        h.next = p->more ? next : 0;
+
+        w_pad(&w, at);
+        w_write(&w, &h, sizeof(page_header), 1);
+        if (p->vector) {w_pad(&w, h.vector); w_vector(&w, p->vector);}
+        if (p->matrix) {w_pad(&w, h.matrix); w_matrix(&w, p->matrix);}
+        if (p->columns){w_pad(&w, h.columns); w_matrix(&w, p->columns);}
+        if (p->weights){w_pad(&w, h.weights); w_vector(&w, p->weights);}
+        if (text.ct)   {w_pad(&w, h.text); w_strtab(&w, text);}
+        if (names.ct)  {w_pad(&w, h.names); w_strtab(&w, names);}
+        free(text.list);
+        free(names.list);
+    }
+    w.bad |= fflush(f) != 0;
+    Apop_stopif(w.bad, return 1, 0, "Error writing the data set; the output is incomplete.");
+    return 0;
+}
+
+////////// Reading
+
+/* A pointer to n1*n2 items of the given size at offset off, or NULL if that runs off
+   the end of the file or isn't aligned. */
+static void *block(char *base, size_t size, uint64_t off, uint64_t n1, uint64_t n2, size_t eltsize){
+    if (!off || off % sizeof(uint64_t) || off > size) return NULL;
+    if (n2 && n1 > (size - off) / eltsize / n2) return NULL;
+    return base + off;
+}
+
+//Point list[0..ct-1] at the strings in the string table at off. Returns 0 on success.
+static int read_strtab(char *base, size_t size, uint64_t off, uint64_t ct, char **list){
+    strtab_header *sh = block(base, size, off, 1, 1, sizeof(strtab_header));
+    if (!sh || sh->ct != ct) return 1;
+    uint64_t *offsets = block(base, size, off + sizeof(strtab_header), ct, 1, sizeof(uint64_t));
+    if (!offsets) return 1;
+    char *strings = block(base, size, off + sizeof(strtab_header) + sizeof(uint64_t)*ct, sh->bytes, 1, 1);
+    //If the last byte is a '\0', then every string ends inside the mapping.
+    if (!strings || (sh->bytes && strings[sh->bytes-1])) return 1;
+    for (uint64_t i=0; i< ct; i++){
+        if (offsets[i] == No_string) list[i] = NULL;
+        else if (offsets[i] < sh->bytes) list[i] = strings + offsets[i];
+        else return 1;
+    }
+    return 0;
+}
+
+//The struct is on the heap, as gsl_*_free expects; the gsl_block goes in the arena.
+static gsl_vector *wrap_vector(struct apop_arena *a, double *data, size_t n){
+    gsl_vector *v = malloc(sizeof(gsl_vector));
+    gsl_block *b = apop_arena_malloc(a, sizeof(gsl_block));
+    if (!v || !b) {free(v); return NULL;}
+    *b = (gsl_block){.size=n, .data=data};
+    *v = (gsl_vector){.size=n, .stride=1, .data=data, .block=b, .owner=0};
+    return v;
+}
+
+static gsl_matrix *wrap_matrix(struct apop_arena *a, double *data, size_t size1, size_t size2){
+    gsl_matrix *m = malloc(sizeof(gsl_matrix));
+    gsl_block *b = apop_arena_malloc(a, sizeof(gsl_block));
+    if (!m || !b) {free(m); return NULL;}
+    *b = (gsl_block){.size=size1*size2, .data=data};
+    *m = (gsl_matrix){.size1=size1, .size2=size2, .tda=size2, .data=data, .block=b, .owner=0};
+    return m;
+}
+
+static char **name_list(char **from, uint64_t ct){
+    if (!ct) return NULL;
+    char **out = malloc(sizeof(char*)*ct);
+    if (out) memcpy(out, from, sizeof(char*)*ct);
+    return out;
+}
+
+//Read the page whose header is at offset at; put the offset of the next page in *next.
+static apop_data *read_page(char *base, size_t size, uint64_t at, struct apop_arena *a, uint64_t *next){
+    page_header *h = block(base, size, at, 1, 1, sizeof(page_header));
+    Apop_stopif(!h, return NULL, 0, "The page header at byte %" PRIu64 " is past the end of the file.", at);
+    apop_data *d = apop_data_alloc();
+    Apop_stopif(d->error, apop_data_free(d); return NULL, 0, "Allocation error.");
+    if (d->arena){ //from apop_opts.string_arena; we have our own.
+        apop_arena_release(d->names->arena);
+        apop_arena_release(d->arena);
+    }
+    d->arena = apop_arena_keep(a);
+    d->names->arena = apop_arena_keep(a);
+    d->error = h->error;
+    int bad = 0;
+    double *x;
+    if (h->vector)
+        bad |= !(x = block(base, size, h->vector, h->vsize, 1, sizeof(double)))
+               || !(d->vector = wrap_vector(a, x, h->vsize));
+    if (h->matrix && !bad)
+        bad |= !(x = block(base, size, h->matrix, h->msize1, h->msize2, sizeof(double)))
+               || !(d->matrix = wrap_matrix(a, x, h->msize1, h->msize2));
+    if (h->columns && !bad)
+        bad |= !(x = block(base, size, h->columns, h->csize1, h->csize2, sizeof(double)))
+               || !(d->columns = wrap_matrix(a, x, h->csize1, h->csize2));
+    if (h->weights && !bad)
+        bad |= !(x = block(base, size, h->weights, h->wsize, 1, sizeof(double)))
+               || !(d->weights = wrap_vector(a, x, h->wsize));
+    if (h->text && !bad){
+        uint64_t ct = h->textsize[0]*h->textsize[1];
+        char **cells = (ct && h->textsize[1] <= size/h->textsize[0])
+                            ? apop_arena_malloc(a, sizeof(char*)*ct) : NULL;
+        bad |= !cells || read_strtab(base, size, h->text, ct, cells);
+        if (!bad && (d->text = malloc(sizeof(char**)*h->textsize[0]))){
+            for (uint64_t i=0; i< h->textsize[0]; i++)
+                d->text[i] = cells + i*h->textsize[1];
+            d->textsize[0] = h->textsize[0];
+            d->textsize[1] = h->textsize[1];
+        }
+        bad |= !d->text;
+    }
+    if (h->names && !bad){
+        uint64_t ct = h->has_vector_name + h->colct + h->rowct + h->textct;
+        char **list = (ct <= size/sizeof(uint64_t)) ? malloc(sizeof(char*)*ct) : NULL;
+        bad |= !list || read_strtab(base, size, h->names, ct, list);
+        if (!bad){
+            apop_name *n = d->names;
+            char **l = list;
+            if (h->has_vector_name) n->vector = *l++;
+            n->column = name_list(l, h->colct); l += (n->colct = h->colct);
+            n->row = name_list(l, h->rowct);    l += (n->rowct = h->rowct);
+            n->text = name_list(l, h->textct);  n->textct = h->textct;
+        }
+        free(list);
+    }
+    memcpy(d->names->title, h->title, sizeof(h->title));
+    d->names->title[sizeof(h->title)-1] = '\0';
+    Apop_stopif(bad, apop_data_free(d); return NULL, 0, "The page at byte %" PRIu64 " is corrupt "
+                        "or runs past the end of the file.", at);
+    *next = h->next;
+    return d;
+}
+
+static void unmap(void *data, size_t size){ munmap(data, size); }
+
+/** Read a data set written via <tt>apop_data_print(d, "file", .output_type='b')</tt>.
+
+The binary format is the data set's memory, written out as is, so reading it is
+just a matter of mapping the file into memory and pointing the vectors and matrices
+at the right places. There's no parsing and no copying, so reading is as fast as your
+disk (and if the file is in the OS's cache, nearly instantaneous).
+
+\code
+apop_data_print(big_data, "big.apop", .output_type='b');
+...
+//later, maybe in another program:
+apop_data *d = apop_data_mmap("big.apop");
+\endcode
+
+\li The vector, matrix, \c columns, weights, text, names, and all the pages in
+<tt>->more</tt> come back as they were written.
+\li The data set's memory is a private mapping of the file: you can modify the data
+set, but the changes never go back to the file. Pages of the file are copied into
+memory only when you write to them.
+\li The vectors and matrices don't own their memory, so \ref apop_vector_realloc and
+\ref apop_matrix_realloc won't resize them; make a copy via \ref apop_data_copy first.
+\li The file is unmapped when you \ref apop_data_free the data set. A matrix or vector you
+pulled out of the data set and kept is invalid after that.
+\li Numbers are in the byte order of the machine that wrote the file, and I'll refuse
+a file from a machine of the other byte order.
+
+\param filename The file to read.
+\return The data set, or \c NULL if the file couldn't be read or isn't in the right
+format (with an error message, unless <tt>apop_opts.verbose==-1</tt>).
+\ingroup conversions
+*/
+apop_data *apop_data_mmap(char const *filename){
+    Apop_stopif(!filename, return NULL, 0, "I need a file name.");
+    int fd = open(filename, O_RDONLY);
+    Apop_stopif(fd < 0, return NULL, 0, "Couldn't open %s.", filename);
+    struct stat st;
+    Apop_stopif(fstat(fd, &st) || st.st_size < (off_t)sizeof(file_header), close(fd); return NULL,
+                        0, "%s is too short to be an Apophenia binary file.", filename);
+    size_t size = st.st_size;
+    char *base = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    Apop_stopif(base == MAP_FAILED, return NULL, 0, "Couldn't map %s into memory.", filename);
+    file_header *fh = (file_header*)base;
+    Apop_stopif(memcmp(fh->magic, Magic, sizeof(fh->magic)), munmap(base, size); return NULL,
+                        0, "%s isn't an Apophenia binary file.", filename);
+    Apop_stopif(fh->byte_order != Byte_order, munmap(base, size); return NULL,
+                        0, "%s was written on a machine with a different byte order.", filename);
+    Apop_stopif(fh->page_header_size != sizeof(page_header), munmap(base, size); return NULL,
+                        0, "%s has %u-byte page headers, but this version of Apophenia expects %zu-byte "
+                           "headers. Was it written by a different version?", filename,
+                           (unsigned) fh->page_header_size, sizeof(page_header));
+    struct apop_arena *a = apop_arena_adopt(base, size, unmap);
+    Apop_stopif(!a, munmap(base, size); return NULL, 0, "Allocation error.");
+    apop_data *out = NULL, **tail = &out;
+    for (uint64_t at = fh->first_page; at; tail = &(*tail)->more){
+        uint64_t next = 0;
+        *tail = read_page(base, size, at, a, &next);
+        Apop_stopif(!*tail, apop_data_free(out); apop_arena_release(a); return NULL,
+                        0, "Couldn't read %s.", filename);
+        Apop_stopif(next && next <= at, apop_data_free(out); apop_arena_release(a); return NULL,
+                        0, "%s is corrupt: its pages loop.", filename);
+        at = next;
+    }
+    apop_arena_release(a); //the pages hold their own references.
+    return out;
+}
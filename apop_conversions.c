@@ -5,6 +5,13 @@
 #include <regex.h>
 #include <assert.h>
 #include <sqlite3.h>
+#include <ctype.h>
+#include <locale.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 /*extend a string. this prevents a minor leak you'd get if you did
  asprintf(&q, "%s is a teapot.", q);
@@ -191,15 +198,106 @@ apop_data * apop_line_to_data(double *in, int vsize, int rows, int cols){
   return apop_data_fill_base(apop_data_alloc(vsize, rows, cols), in);
 }
 
-static int find_cat_index(char **d, char * r, int start_from, int size){
-//used for apop_db_to_crosstab.
-    int i = start_from % size;	//i is probably the same or i+1.
-	do {
-		if(!strcmp(d[i], r)) return i;
-		i++;
-		i %= size;	//loop around as necessary.
-	} while (i!=start_from); 
-    Apop_assert_c(0, -2, 0, "Something went wrong in the crosstabbing; couldn't find %s.", r);
+/* For apop_db_to_crosstab: the categories along one side of the crosstab, in order of
+   first appearance, with a hash index from name to position, so each row of input is
+   two lookups, not a scan through the whole list of categories. */
+typedef struct {
+    char **names;
+    int ct, space;
+    int *slots;         //position+1, or zero for an empty slot
+    unsigned int mask;
+} cat_index;
+
+//FNV-1a. Unlike names (see apop_name.c), categories are case-sensitive, like SQL's distinct.
+static unsigned int cat_hash(char const *s){
+    unsigned int h = 2166136261u;
+    for ( ; *s; s++) h = (h ^ (unsigned char)*s) * 16777619u;
+    return h;
+}
+
+static void cat_index_free(cat_index *c){
+    for (int i=0; i< c->ct; i++) free(c->names[i]);
+    free(c->names);
+    free(c->slots);
+}
+
+//Return the position of the name in the list, adding it if it's new.
+static int cat_find(cat_index *c, char const *name){
+    if (!c->slots){
+        c->mask = 1023;
+        c->slots = calloc(c->mask+1, sizeof(int));
+    }
+    unsigned int s = cat_hash(name) & c->mask;
+    for ( ; c->slots[s]; s = (s+1) & c->mask)
+        if (!strcmp(c->names[c->slots[s]-1], name)) return c->slots[s]-1;
+    if (c->ct == c->space)
+        c->names = realloc(c->names, sizeof(char*) * (c->space = c->space ? c->space*2 : 64));
+    c->names[c->ct] = strdup(name);
+    c->slots[s] = ++c->ct;
+    if (c->ct*2 > c->mask){ //keep the table at most half full.
+        free(c->slots);
+        c->mask = c->mask*2 + 1;
+        c->slots = calloc(c->mask+1, sizeof(int));
+        for (int i=0; i< c->ct; i++){
+            for (s = cat_hash(c->names[i]) & c->mask; c->slots[s]; s = (s+1) & c->mask) ;
+            c->slots[s] = i+1;
+        }
+    }
+    return c->ct-1;
+}
+
+typedef struct {
+    char const *name;
+    double x;
+    int rank, position;
+} cat_key;
+
+static int cat_key_compare(void const *a, void const *b){
+    cat_key const *ka = a, *kb = b;
+    if (ka->rank != kb->rank) return ka->rank - kb->rank;
+    if (ka->rank == 1 && ka->x != kb->x) return ka->x < kb->x ? -1 : 1;
+    return strcmp(ka->name, kb->name);
+}
+
+/* The positions of the categories in sorted order, the way an SQL order by would
+   usually have them: NULLs (which come back as NaN) first, then numbers in numeric order,
+   then text in strcmp order. */
+static int *cat_order(cat_index const *c){
+    cat_key *keys = malloc(sizeof(cat_key) * c->ct);
+    for (int i=0; i< c->ct; i++){
+        char *end;
+        keys[i] = (cat_key){.name=c->names[i], .position=i, .x=strtod(c->names[i], &end)};
+        keys[i].rank = (end == c->names[i] || *end || isspace(c->names[i][0])) ? 2
+                        : isnan(keys[i].x) ? 0 : 1;
+    }
+    qsort(keys, c->ct, sizeof(cat_key), cat_key_compare);
+    int *out = malloc(sizeof(int) * c->ct);
+    for (int i=0; i< c->ct; i++) out[i] = keys[i].position;
+    free(keys);
+    return out;
+}
+
+/* Make room for at least rct X cct cells, keeping the ones we have. New cells are zero.
+   Grow by half again, not doubling, because this grid can be most of memory. */
+static double *grow_cells(double *cells, size_t *rspace, size_t *cspace, size_t rct, size_t cct){
+    size_t newr = GSL_MAX(*rspace, 16), newc = GSL_MAX(*cspace, 16);
+    while (newr < rct) newr += newr/2;
+    while (newc < cct) newc += newc/2;
+    double *out;
+    if (newc == *cspace){ //just add rows at the end
+        out = realloc(cells, sizeof(double)*newr*newc);
+        Apop_stopif(!out, free(cells); return NULL, 0, "Allocation error for a %zu X %zu grid.", newr, newc);
+        memset(out + *rspace * newc, 0, sizeof(double)*(newr - *rspace)*newc);
+    } else {
+        out = calloc(newr*newc, sizeof(double));
+        Apop_stopif(!out, free(cells); return NULL, 0, "Allocation error for a %zu X %zu grid.", newr, newc);
+        for (size_t i=0; i< *rspace; i++)
+            memcpy(out + i*newc, cells + i * *cspace, sizeof(double) * *cspace);
+        free(cells);
+    }
+    *rspace = newr;
+    *cspace = newc;
+    return out;
 }
 
 /**Give the name of a table in the database, and names of three of its
@@ -214,64 +312,78 @@ r2.
 
 \li  If the query to get data to fill the table (select r1, r2, datacol from tabname) returns an empty data set, then I will return a \c NULL data set and if <tt>apop_opts.verbosity >= 1</tt> print a warning.
 
-\li This setup presumes that there is one value for each (row, col) coordinate in the data. You may want an aggregate instead. There are two ways to do this, both of which hack the fact that this function runs a simple \c select query to generate the data. One is to specify an ad hoc table to pull from:
+\li If there are several rows with the same (row, col) coordinates, their values are
+summed. So one way to get the crosstab of counts is to use 1 as the data column:
+
+\code
+apop_data * out = apop_db_to_crosstab("base_data", "row", "col", "1");
+\endcode
+
+\li You may want some other aggregate instead. There are two ways to do this, both of which hack the fact that this function runs a simple \c select query to generate the data. One is to specify an ad hoc table to pull from:
 
 \code
-apop_data * out = apop_db_to_crosstab("(select row, col, count(*) ct from base_data group by row, col)", "row", "col",  "ct");
+apop_data * out = apop_db_to_crosstab("(select row, col, avg(x) mean from base_data group by row, col)", "row", "col",  "mean");
 \endcode
 
 The other is to use the fact that the table name will be at the end of the query, so you can add conditions to the table:
 
 \code
-apop_data * out = apop_db_to_crosstab("base_data group by row, col", "row", "col", "count(*)");
-//which will expand to "select row, col, count(*) from base_data group by row, col"
+apop_data * out = apop_db_to_crosstab("base_data group by row, col", "row", "col", "avg(x)");
+//which will expand to "select row, col, avg(x) from base_data group by row, col"
 \endcode
 
+\li Cells with no data are zero.
+\li The rows and columns are in sorted order: \c NULL (which is named \c NaN) first, then
+numbers in numeric order, then text in \c strcmp order.
+\li This makes one pass through the output of the query, reading it a block at a time (see
+\ref apop_query_cursor_open), and finds each row's place in the crosstab via a hash table,
+so a big table with thousands of categories isn't much slower than a small one.
+
 \see \ref apop_crosstab_to_db
 
-\exception out->error='n' Name not found error.
-\exception out->error='q' Query returned an empty table (which might mean that it just failed).
+\exception out->error='q' Query error.
+\exception out->error='a' Allocation error.
 
 \ingroup db
 */
 apop_data *apop_db_to_crosstab(char *tabname, char *r1, char *r2, char *datacol){
-    gsl_matrix *out=NULL;
-    int	i, j=0;
-    apop_data *pre_d1=NULL, *pre_d2=NULL, *datachars=NULL;
+    apop_query_cursor *c = apop_query_cursor_open("ttm", 10000, "select %s, %s, %s from %s", r1, r2, datacol, tabname);
     apop_data *outdata = apop_data_alloc();
+    Apop_stopif(!c, outdata->error='q'; return outdata, 0, "error selecting %s, %s, %s from %s.", r1, r2, datacol, tabname);
+    cat_index rows = {}, cols = {};
+    double *cells = NULL;
+    size_t rspace = 0, cspace = 0;
+    for (apop_data *b; !outdata->error && (b = apop_query_cursor_next(c)); )
+        for (size_t k=0; k< b->textsize[0]; k++){
+            int i = cat_find(&rows, b->text[k][0]);
+            int j = cat_find(&cols, b->text[k][1]);
+            if (i >= rspace || j >= cspace)
+                Apop_stopif(!(cells = grow_cells(cells, &rspace, &cspace, rows.ct, cols.ct)),
+                        outdata->error='a'; break, 0, "Allocation error.");
+            cells[i*cspace + j] += gsl_matrix_get(b->matrix, k, 0);
+        }
+    if (c->error) outdata->error = c->error;
+    if (outdata->error) goto bailout;
+    Apop_stopif(!rows.ct, apop_data_free(outdata); goto bailout, 1,
+            "selecting %s, %s, %s from %s returned an empty table.",  r1, r2, datacol, tabname);
+
+    int *rorder = cat_order(&rows), *corder = cat_order(&cols);
+    outdata->matrix = gsl_matrix_alloc(rows.ct, cols.ct);
+    for (int i=0; i< rows.ct; i++){
+        apop_name_add(outdata->names, rows.names[rorder[i]], 'r');
+        for (int j=0; j< cols.ct; j++)
+            gsl_matrix_set(outdata->matrix, i, j, cells[rorder[i]*cspace + corder[j]]);
+    }
+    for (int j=0; j< cols.ct; j++)
+        apop_name_add(outdata->names, cols.names[corder[j]], 'c');
+    free(rorder);
+    free(corder);
 
-    char p = apop_opts.db_name_column[0];
-    apop_opts.db_name_column[0]= '\0';//we put this back at the end.
-    datachars = apop_query_to_text("select %s, %s, %s from %s", r1, r2, datacol, tabname);
-    Apop_stopif(!datachars, return NULL, 1, "selecting %s, %s, %s from %s returned an empty table.",  r1, r2, datacol, tabname);
-    Apop_stopif(datachars->error, goto bailout, 0, "error selecting %s, %s, %s from %s.",  r1, r2, datacol, tabname);
-
-    //A bit inefficient, but well-encapsulated.
-    //Pull the distinct (sorted) list of headers, copy into outdata->names.
-    pre_d1 = apop_query_to_text("select distinct %s, 1 from %s order by %s", r1, tabname, r1);
-    Apop_stopif(!pre_d1||pre_d1->error, outdata->error='q'; goto bailout, 0, "Error querying %s from %s.", r1, tabname);
-    for (i=0; i < pre_d1->textsize[0]; i++)
-        apop_name_add(outdata->names, pre_d1->text[i][0], 'r');
-
-	pre_d2 = apop_query_to_text("select distinct %s from %s order by %s", r2, tabname, r2);
-    Apop_stopif(!pre_d2||pre_d2->error, outdata->error='q'; goto bailout, 0, "Error querying %s from %s.", r1, tabname);
-    for (i=0; i < pre_d2->textsize[0]; i++)
-        apop_name_add(outdata->names, pre_d2->text[i][0], 'c');
-
-	out	= gsl_matrix_calloc(pre_d1->textsize[0], pre_d2->textsize[0]);
-	for (size_t k =0; k< datachars->textsize[0]; k++){
-		i = find_cat_index(outdata->names->row, datachars->text[k][0], i, pre_d1->textsize[0]);
-		j = find_cat_index(outdata->names->column, datachars->text[k][1], j, pre_d2->textsize[0]);
-        Apop_stopif(i==-2 || j == -2, outdata->error='n'; goto bailout, 0, "Something went wrong in the crosstabbing; "
-                                                 "couldn't find %s or %s.", datachars->text[k][0], datachars->text[k][1]);
-		gsl_matrix_set(out, i, j, atof(datachars->text[k][2]));
-	}
     bailout:
-    apop_data_free(pre_d1);
-    apop_data_free(pre_d2);
-    apop_data_free(datachars);
-    outdata->matrix = out;
-    apop_opts.db_name_column[0]= p;
+    apop_query_cursor_free(c);
+    cat_index_free(&rows);
+    cat_index_free(&cols);
+    free(cells);
 	return outdata;
 }
 
@@ -514,6 +626,11 @@ is eqivalent to <tt>1,2,3,4,5," six ",7</tt>.
 
 \li NUL characters are treated as white space, so if your fields have NULs as padding, you should have no problem. NULs inside of a string will probably break.
 
+\li If \ref apop_opts_type "apop_opts.thread_count" is greater than one and the input is a
+regular file (not \c stdin or a pipe), big files are cut into pieces at line breaks (not
+counting line breaks inside quotes), and the pieces are parsed on separate threads. The
+rows come out in file order, and warnings about bad lines give the same row numbers either way.
+
 \li Fixed-width formats are supported (for plain ASCII encoding only), but you have to provide a list of field ending positions. For example, given
 \code
 NUMLEOL
@@ -523,146 +640,268 @@ NUMLEOL
 we have three columns, named NUM, LE, and OL. The names can be read from the first row if you so specify. You will have to provide a list of integers giving the end of each field: 3, 5, 7.
 */
 
-static int prep_text_reading(char const *text_file, FILE **infile){
-    *infile = !strcmp(text_file, "-")
-                    ? stdin
-	                : fopen(text_file, "r");
-    Apop_assert_c(*infile, 1,  0, "Trouble opening %s. Returning NULL.", text_file);
-    return 0;
-}
+/* The text reader.
 
-/////New text file reading
+   A text_reader hands out one line of the input at a time, already split into fields.
+   If the input is a regular file, it is mmapped and we just walk through memory;
+   otherwise (stdin, pipes, ...) we fread it Read_block bytes at a time. Either way,
+   classifying a character is one lookup in a 256-entry table of character types, and
+   runs of plain characters are copied in one go.
 
-typedef struct {int ct; int eof;} line_parse_t;
+   The fields of the current line are written back to back, each NUL-terminated, into one
+   buffer that is reused for every line, so once it has grown to fit the longest line
+   there's no more allocation.
+*/
 
-static line_parse_t parse_a_fixed_line(FILE *infile, apop_data *fn, int const *field_ends){
-    char c = fgetc(infile);
-    int ct = 0, posn=0, thisflen=0, needfield=1;
-    while(c!='\n' && c !=EOF){
-        posn++;
-        if (needfield){//start a new field
-            if (++ct > fn->textsize[0])
-                apop_text_alloc(fn, ct, 1);//realloc text portion.
-            thisflen = 
-            needfield = 0;
-        }
+#define Read_block (1<<20)
+
+typedef struct {
+    char const *p, *end;    //the unread part of the input
+    char *map;              //the mmapped file, or NULL
+    size_t maplen;
+    FILE *f;                //if not mmapped, read from here into buf.
+    char *buf;
+    char type[256];         //see reader_types
+    char *line;             //the fields of the current line, back to back
+    size_t linelen, linesize;
+    size_t *fields;         //where each field starts in line
+    int fieldct, fieldsize;
+    char error;             //'a' if we ran out of memory
+    char plain_point;       //the locale's decimal point is '.'; see fast_strtod.
+} text_reader;
 
-        //extend field:
-        *fn->text[ct-1] = realloc(*fn->text[ct-1], ++thisflen);
-        fn->text[ct-1][0][thisflen-1] = c;
+typedef struct {int ct; int eof;} line_parse_t;
 
-        if (posn==*field_ends){ //close off this field.
-            *fn->text[ct-1] = realloc(*fn->text[ct-1], thisflen+1);
-            fn->text[ct-1][0][thisflen] = '\0';
-            thisflen = 0;
-            field_ends++;
-            needfield=1;
-        } 
-        c = fgetc(infile);
+/* The character types:
+   'w' white space, 'W' white space that's also a delimiter, 'd' delimiter, 'n' newline,
+   '"' and '\'' quotes, '\\' escape, '#' comment, 'r' regular.
+   NUL counts as a white-space delimiter. */
+static void reader_types(char *type, char const *delimiters){
+    for (int i=0; i< 256; i++){
+        int is_delimiter = !i || (strchr(delimiters, i) != NULL);
+        type[i] = (i==' '||i=='\t'|| i==0)? (is_delimiter ? 'W'  : 'w')
+                    :is_delimiter    ? 'd'
+                    :(i == '\n')     ? 'n'
+                    :(i == '"')      ? '"'
+                    :(i == '\'')     ? '\''
+                    :(i == '\\')     ? '\\'
+                    :(i == '#')      ? '#'
+                                     : 'r';
+    }
+}
+
+static text_reader *reader_open(char const *text_file, char const *delimiters){
+    text_reader *r = calloc(1, sizeof(text_reader));
+    Apop_stopif(!r, return NULL, 0, "malloc failed. Probably out of memory.");
+    reader_types(r->type, delimiters);
+    char const *point = localeconv()->decimal_point;
+    r->plain_point = point[0]=='.' && !point[1];
+    if (!strcmp(text_file, "-")) r->f = stdin;
+    else {
+        int fd = open(text_file, O_RDONLY);
+        Apop_stopif(fd < 0, free(r); return NULL, 0, "Trouble opening %s.", text_file);
+        struct stat st;
+        if (!fstat(fd, &st) && S_ISREG(st.st_mode) && st.st_size > 0){
+            r->map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (r->map == MAP_FAILED) r->map = NULL;
+            else {
+                r->maplen = st.st_size;
+                posix_madvise(r->map, r->maplen, POSIX_MADV_SEQUENTIAL);
+                r->p = r->map;
+                r->end = r->map + r->maplen;
+            }
+        }
+        if (r->map) close(fd);
+        else r->f = fdopen(fd, "r");
+        Apop_stopif(!r->map && !r->f, close(fd); free(r); return NULL, 0, "Trouble opening %s.", text_file);
     }
-    if (needfield==0){//user didn't give last field end.
-        *fn->text[ct-1] = realloc(*fn->text[ct-1], thisflen+1);
-        fn->text[ct-1][0][thisflen] = '\0';
+    if (r->f){
+        r->buf = malloc(Read_block);
+        Apop_stopif(!r->buf, if (r->f != stdin) fclose(r->f); free(r); return NULL,
+                0, "malloc failed. Probably out of memory.");
     }
-    return (line_parse_t) {.ct=ct, .eof= (c == EOF)};
+    return r;
 }
 
-typedef struct{
-    char c, type;
-} apop_char_info;
+static void reader_close(text_reader *r){
+    if (!r) return;
+    if (r->map) munmap(r->map, r->maplen);
+    if (r->f && r->f != stdin) fclose(r->f);
+    free(r->buf);
+    free(r->line);
+    free(r->fields);
+    free(r);
+}
 
-static apop_char_info parse_next_char(FILE *f, char const *delimiters){
-    char c = fgetc(f);
-    int is_delimiter = !!strchr(delimiters, c);
-    return (apop_char_info){.c=c, 
-            .type = (c==' '||c=='\t' || c==0)? (is_delimiter ? 'W'  : 'w')
-                    :is_delimiter    ? 'd'
-                    :(c == '\n')     ? 'n'
-                    :(c == '"')      ? '"'
-                    :(c == '\'')     ? '\''
-                    :(c == '\\')     ? '\\'
-                    :(c == EOF)      ? 'E'
-                    :(c == '#')      ? '#'
-                                     : 'r'
-            };
+static int refill(text_reader *r){
+    if (!r->f) return EOF;
+    size_t n = fread(r->buf, 1, Read_block, r->f);
+    if (!n) return EOF;
+    r->p = r->buf;
+    r->end = r->buf + n;
+    return (unsigned char)*r->p++;
 }
 
-//fills fn with a list of strings.
-//returns the count of elements. Negate the count if we're at EOF.
-//fn must already be allocated via apop_data_alloc() [no args].
-static line_parse_t parse_a_line(FILE *infile, apop_data *fn, int const *field_ends, char const *delimiters){
-    int ct=0, thisflen=0, inq=0, inqq=0, infield=0, mlen=5,
-            lastwhite=0, lastnonwhite=0; 
-    if (field_ends) return parse_a_fixed_line(infile, fn, field_ends);
-    apop_char_info ci;
+#define Next(r) ((r)->p < (r)->end ? (unsigned char)*(r)->p++ : refill(r))
+
+//Make room for n more characters on the line.
+static int reserve(text_reader *r, size_t n){
+    if (r->linelen + n <= r->linesize) return 0;
+    size_t newsize = GSL_MAX(64, 2*r->linesize);
+    while (newsize < r->linelen + n) newsize *= 2;
+    char *newline = realloc(r->line, newsize);
+    Apop_stopif(!newline, r->error='a'; return 1, 0, "malloc failed reading a line of text. Probably out of memory.");
+    r->line = newline;
+    r->linesize = newsize;
+    return 0;
+}
+
+static void push(text_reader *r, char c){
+    if (!reserve(r, 1)) r->line[r->linelen++] = c;
+}
+
+static void new_field(text_reader *r){
+    if (r->fieldct == r->fieldsize){
+        int newsize = GSL_MAX(16, 2*r->fieldsize);
+        size_t *newfields = realloc(r->fields, sizeof(size_t)*newsize);
+        Apop_stopif(!newfields, r->error='a'; return, 0, "malloc failed reading a line of text. Probably out of memory.");
+        r->fields = newfields;
+        r->fieldsize = newsize;
+    }
+    r->fields[r->fieldct++] = r->linelen;
+}
+
+/* Read one line into r->line and r->fields, following the rules on the \ref text_format page.
+   The returned count is the number of fields; .eof is set when there's nothing left to read.
+   A blank line gives a count of zero. */
+static line_parse_t read_line(text_reader *r){
+    int inq=0, inqq=0, infield=0, lastwhite=0, c;
+    size_t lastnonwhite=0;
+    char type;
+    r->linelen = r->fieldct = 0;
     do {
-        ci = parse_next_char(infile, delimiters);
+        c = Next(r);
+        type = (c==EOF) ? 'E' : r->type[c];
         //comments are to end of line, so they're basically a newline.
-        if (ci.type=='#' && !(inq||inqq)){
-            for(char c='x'; (c!='\n' && c!=EOF); )
-                c = fgetc(infile);
-            ci.type='n';
+        if (type=='#' && !(inq||inqq)){
+            while (c!='\n' && c!=EOF) c = Next(r);
+            type='n';
         }
 
         //The escape-type cases: \\ and '' and "".
         //If one applies, set the type to regular
-        if (ci.type=='\\'){
-            ci=parse_next_char(infile, delimiters);
-            if (ci.type!='E')
-                ci.type='r';
+        if (type=='\\'){
+            c = Next(r);
+            type = (c==EOF) ? 'E' : 'r';
         }
-        if (((inq && ci.type !='\'') ||(inqq && ci.type !='"')) && ci.type !='E')
-            ci.type='r';
-        if (ci.type=='\'') inq = !inq;
-        else if (ci.type=='"') inqq = !inqq;
+        if (((inq && type !='\'') ||(inqq && type !='"')) && type !='E')
+            type='r';
+        if (type=='\'') inq = !inq;
+        else if (type=='"') inqq = !inqq;
 
-        if (ci.type=='W' && lastwhite==1) 
+        if (type=='W' && lastwhite) 
             continue; //compress these.
-        lastwhite=(ci.type=='W');
+        lastwhite=(type=='W');
 
         if (!infield){
-            if (ci.type=='w') continue; //eat leading spaces.
-            if (strchr("rd", ci.type)                    //new field; if 'dnE', blank field. 
-                   || (strchr("nE", ci.type) && ct>0)){  //Blank fields only at end of lines that already have data; else all-blank line to ignore.
-                if (++ct > fn->textsize[0]) apop_text_alloc(fn, ct, 1);//realloc text portion.
-                *fn->text[ct-1] = realloc(*fn->text[ct-1], 5);
-                thisflen = 0;
-                mlen=5;
+            if (type=='w') continue; //eat leading spaces.
+            if (type=='r' || type=='d'                      //new field; if 'dnE', blank field. 
+                   || ((type=='n' || type=='E') && r->fieldct)){  //Blank fields only at end of lines that already have data; else all-blank line to ignore.
+                new_field(r);
+                lastnonwhite = r->linelen;
                 infield=1;
             } 
         } 
         if (infield){
-            if (ci.type=='d'||ci.type=='n' || ci.type=='E' || ci.type=='W'){
+            if (type=='d'||type=='n' || type=='E' || type=='W'){
                 //delimiter; close off this field.
-                fn->text[ct-1][0][lastnonwhite] = '\0';
-                infield =
-                thisflen =
-                lastnonwhite = 0;
-            } else if (ci.type=='w' || ci.type=='r'){ //extend field
-                thisflen++; //length of string
-                if (thisflen+2 > mlen){
-                    mlen *=2; //length of allocated memory
-                    *fn->text[ct-1] = realloc(*fn->text[ct-1], mlen);
+                r->linelen = lastnonwhite;
+                push(r, '\0');
+                infield = 0;
+            } else if (type=='w'){
+                push(r, c);
+            } else if (type=='r'){ //extend field, and take any plain characters after this in one gulp.
+                push(r, c);
+                if (!(inq||inqq)){
+                    char const *q = r->p;
+                    while (q < r->end && r->type[(unsigned char)*q]=='r') q++;
+                    if (q > r->p && !reserve(r, q - r->p)){
+                        memcpy(r->line + r->linelen, r->p, q - r->p);
+                        r->linelen += q - r->p;
+                        r->p = q;
+                    }
                 }
-                fn->text[ct-1][0][thisflen-1] = ci.c;
-                if (ci.type!='w')
-                    lastnonwhite = thisflen;
+                lastnonwhite = r->linelen;
             }
         }
-    } while (ci.type != 'n' && ci.type != 'E');
-    return (line_parse_t) {.ct=ct, .eof= (ci.type == 'E')};
+    } while (type != 'n' && type != 'E' && !r->error);
+    return (line_parse_t) {.ct= r->error ? 0 : r->fieldct, .eof= (type == 'E' && !r->fieldct) || r->error};
+}
+
+//Fixed-width fields: no quoting, comments, or trimming; just cut the line at the given positions.
+static line_parse_t read_fixed_line(text_reader *r, int const *field_ends){
+    int c = Next(r), posn=0, needfield=1;
+    r->linelen = r->fieldct = 0;
+    while(c!='\n' && c !=EOF && !r->error){
+        posn++;
+        if (needfield){//start a new field
+            new_field(r);
+            needfield = 0;
+        }
+        push(r, c);
+        if (posn==*field_ends){ //close off this field.
+            push(r, '\0');
+            field_ends++;
+            needfield=1;
+        } 
+        c = Next(r);
+    }
+    if (needfield==0) push(r, '\0'); //user didn't give last field end.
+    return (line_parse_t) {.ct= r->error ? 0 : r->fieldct, .eof= (c == EOF && !r->fieldct) || r->error};
+}
+
+static line_parse_t next_line(text_reader *r, int const *field_ends){
+    return field_ends ? read_fixed_line(r, field_ends) : read_line(r);
+}
+
+#define Field(r, i) ((r)->line + (r)->fields[i])
+
+/* The line buffers that parse_a_line fills resize their strings via realloc, so they
+   can't keep their strings in an arena, whatever apop_opts.string_arena says. */
+static apop_data *line_buffer_alloc(void){
+    apop_data *out = apop_data_alloc();
+    if (out->arena){
+        apop_arena_release(out->names->arena);
+        apop_arena_release(out->arena);
+        out->names->arena = out->arena = NULL;
+    }
+    return out;
+}
+
+//Read a line and copy its fields into the text grid of fn, which should be from line_buffer_alloc.
+static line_parse_t parse_a_line(text_reader *r, apop_data *fn, int const *field_ends){
+    line_parse_t L = next_line(r, field_ends);
+    if (L.ct > fn->textsize[0]) apop_text_alloc(fn, L.ct, 1);//realloc text portion.
+    for (int i=0; i< L.ct; i++){
+        size_t len = strlen(Field(r, i)) + 1;
+        *fn->text[i] = realloc(*fn->text[i], len);
+        memcpy(*fn->text[i], Field(r, i), len);
+    }
+    return L;
 }
 
 //On return, fn has copies of the field names, and add_this_line has the first data line.
-static void get_field_names(int has_col_names, char **field_names, FILE *infile, 
-                                apop_data *add_this_line, apop_data *fn, int const *field_ends, char const *delimiters){
+static void get_field_names(int has_col_names, char **field_names, text_reader *r, 
+                                apop_data *add_this_line, apop_data *fn, int const *field_ends){
+    line_parse_t L = {};
     if (has_col_names && field_names == NULL){
         use_names_in_file++;
-        while (fn->textsize[0] ==0) parse_a_line(infile, fn, field_ends, delimiters);
-        parse_a_line(infile, add_this_line, field_ends, delimiters);
+        while (fn->textsize[0] ==0 && !L.eof) L = parse_a_line(r, fn, field_ends);
+        do L = parse_a_line(r, add_this_line, field_ends);
+        while (!L.ct && !L.eof);
     } else{
-        while (add_this_line->textsize[0] ==0) 
-            parse_a_line(infile, add_this_line, field_ends, delimiters);
+        while (add_this_line->textsize[0] ==0 && !L.eof) 
+            L = parse_a_line(r, add_this_line, field_ends);
         fn	= apop_text_alloc(fn, add_this_line->textsize[0], 1);
         for (int i=0; i< fn->textsize[0]; i++)
             if (field_names) apop_text_add(fn, i, 0, field_names[i]);
@@ -670,6 +909,345 @@ static void get_field_names(int has_col_names, char **field_names, FILE *infile,
     }
 }
 
+/* A fast path for the plain decimals that make up most data files. If there are at most
+   19 significant digits, the mantissa fits in a uint64_t; if it's under 2^53 and the
+   power of ten is within 10^±22, both are exact doubles, and one multiplication or
+   division gives the correctly-rounded result (Clinger, 1990). Anything else---hex, inf,
+   nan, long mantissas, big exponents, or something strtod might read further than we
+   would---goes to strtod.
+
+   strtod reads the decimal point of the current locale, and this has always read numbers
+   via strtod, so users in a locale that writes 2,5 get 2.5. The fast path only knows '.',
+   so in any other locale, field_to_double skips it and everything goes to strtod. The
+   reader checks the locale once, when it opens. */
+static double fast_strtod(char const *s, char **end){
+    static const double p10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+            1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    char const *p = s;
+    uint64_t m = 0;
+    int neg = 0, digits = 0, sig = 0, e10 = 0;
+    while (isspace((unsigned char)*p)) p++;
+    if (*p=='-' || *p=='+') neg = (*p++ == '-');
+    for ( ; *p>='0' && *p<='9'; p++, digits++){
+        if (m || *p!='0') sig++;
+        m = m*10 + (*p-'0');
+    }
+    if (*p=='.')
+        for (p++; *p>='0' && *p<='9'; p++, digits++, e10--){
+            if (m || *p!='0') sig++;
+            m = m*10 + (*p-'0');
+        }
+    if (!digits || sig > 19) return strtod(s, end);
+    if (*p=='e' || *p=='E'){
+        char const *q = p+1;
+        int eneg = 0, ex = 0;
+        if (*q=='-' || *q=='+') eneg = (*q++ == '-');
+        if (*q<'0' || *q>'9') return strtod(s, end);
+        for ( ; *q>='0' && *q<='9' && ex < 1000; q++) ex = ex*10 + (*q-'0');
+        e10 += eneg ? -ex : ex;
+        p = q;
+    }
+    if ((*p && !isspace((unsigned char)*p)) || m > ((uint64_t)1<<53) || e10 < -22 || e10 > 22)
+        return strtod(s, end);
+    double out = e10 < 0 ? m / p10[-e10] : m * p10[e10];
+    *end = (char*)p;
+    return neg ? -out : out;
+}
+
+//Blank fields are NaN. Returns zero if the field isn't a number (and *out is NaN).
+static int field_to_double(char const *field, double *out, char plain_point){
+    *out = GSL_NAN;
+    if (!*field) return 1;
+    char *end;
+    double val = plain_point ? fast_strtod(field, &end) : strtod(field, &end);
+    if (field == end) return 0;
+    *out = val;
+    return 1;
+}
+
+/* Reading in chunks.
+
+   Both apop_text_to_data and apop_text_to_db pull the body of the file through a
+   chunk_reader, which hands back one text_chunk of parsed lines at a time, in file order.
+   Usually a chunk is the next Serial_records lines, read by the calling thread. But if
+   the input is mmapped and apop_opts.thread_count > 1, we cut the next stretch of the
+   map into thread_count pieces, and parse them all at once on the thread pool, each with
+   its own text_reader over its own piece.
+
+   Every piece has to start at the start of a line, and because a quoted field can hold a
+   newline, whether a newline ends a line depends on everything before it. So first, each
+   piece is scanned on its own, assuming that it doesn't start inside quotes or a comment,
+   noting the state at the end and where the first line ends. Then, walking the pieces in
+   order, if the previous piece ended inside quotes or a comment, the guess was wrong and
+   we rescan that piece from the right state; either way, the first line end is where the
+   piece really begins. We never cut right after a backslash, so there's no need to ask
+   whether the first character is escaped.
+
+   The chunks count rows from zero, and the callers offset them and print the messages,
+   so errors give the same row numbers they would reading line by line.
+*/
+
+#define Min_chunk (1<<18)
+#define Max_chunk (1<<25)
+#define Serial_records (1<<14)
+
+typedef struct {
+    size_t row;
+    int col;
+    char *field;
+} bad_field;
+
+typedef struct {
+    text_reader *r, sub;    //r is the main reader, or sub, which covers just this piece.
+    int const *field_ends;
+    char mode;              //'d' for apop_text_to_data, 'b' for apop_text_to_db.
+    int hasrows, cols, prepped;
+    size_t maxrec;          //stop after this many records; zero = no limit.
+
+    size_t lines, recct;    //lines read (blank ones included), and records kept.
+    double *vals;           //'d': recct x cols numbers.
+    size_t valsize;
+    char *text;             //'d': row names; 'b': fields prepped for the db. Back to back.
+    size_t textlen, textsize;
+    struct {int ct; size_t line;} *recs; //'b': the field count and line number of each record.
+    size_t recsize;
+    bad_field *bad;         //'d': fields that aren't numbers, if apop_opts.verbose will report them.
+    size_t badct, badsize;
+    int toolong;            //'d': if reading stopped on a line with too many fields, its field count.
+    int eof;
+    char error;
+} text_chunk;
+
+typedef struct {
+    text_reader *r;
+    int const *field_ends;
+    char mode;
+    int hasrows, cols, prepped; //cols<0 means the first line will tell us.
+    text_chunk *chunks;
+    int chunkct, allocated, next, done;
+    char error;
+} chunk_reader;
+
+//Return base, grown if need be to hold n elements; on failure, set *error.
+static void *grow(void *base, size_t *size, size_t n, size_t elmt_size, char *error){
+    if (n <= *size) return base;
+    size_t newsize = GSL_MAX(16, 2 * *size);
+    while (newsize < n) newsize *= 2;
+    void *out = realloc(base, newsize*elmt_size);
+    Apop_stopif(!out, *error='a'; return base, 0, "malloc failed reading a chunk of text. Probably out of memory.");
+    *size = newsize;
+    return out;
+}
+
+static void add_text(text_chunk *c, char const *s){
+    size_t len = strlen(s)+1;
+    c->text = grow(c->text, &c->textsize, c->textlen+len, 1, &c->error);
+    if (c->error) return;
+    memcpy(c->text + c->textlen, s, len);
+    c->textlen += len;
+}
+
+static void data_record(text_chunk *c, line_parse_t L){
+    if (c->cols < 0) c->cols = L.ct - c->hasrows; //the first line sets the width.
+    if (L.ct - c->hasrows > c->cols){
+        c->toolong = L.ct;
+        return;
+    }
+    if (c->hasrows) add_text(c, Field(c->r, 0));
+    c->vals = grow(c->vals, &c->valsize, (c->recct+1)*c->cols, sizeof(double), &c->error);
+    if (c->error) return;
+    double *v = c->vals + c->recct++ * c->cols;
+    for (int col=c->hasrows; col < L.ct; col++)
+        if (!field_to_double(Field(c->r, col), v + col - c->hasrows, c->r->plain_point) && apop_opts.verbose >= 1){
+            c->bad = grow(c->bad, &c->badsize, c->badct+1, sizeof(bad_field), &c->error);
+            if (c->error) return;
+            c->bad[c->badct++] = (bad_field){.row=c->recct, .col=col, .field=strdup(Field(c->r, col))};
+        }
+    for (int col=L.ct; col < c->cols + c->hasrows; col++) //short line
+        v[col - c->hasrows] = GSL_NAN;
+}
+
+static void db_record(text_chunk *c, line_parse_t L){
+    c->recs = grow(c->recs, &c->recsize, c->recct+1, sizeof(*c->recs), &c->error);
+    if (c->error) return;
+    c->recs[c->recct].ct = L.ct;
+    c->recs[c->recct++].line = c->lines;
+    for (int col=0; col < L.ct; col++){
+        char *prepped = prep_string_for_sqlite(c->prepped, Field(c->r, col));
+        add_text(c, XN(prepped));
+        free(prepped);
+    }
+}
+
+static void *parse_chunk(void *in){
+    text_chunk *c = in;
+    for (size_t i=0; i< c->badct; i++) free(c->bad[i].field);
+    c->lines = c->recct = c->textlen = c->badct = 0;
+    c->toolong = c->eof = c->error = 0;
+    while (!c->error && !c->toolong && (!c->maxrec || c->recct < c->maxrec)){
+        line_parse_t L = next_line(c->r, c->field_ends);
+        if (L.eof) {c->eof = 1; break;}
+        c->lines++;
+        if (!L.ct) continue;
+        if (c->mode == 'd') data_record(c, L);
+        else                db_record(c, L);
+    }
+    if (c->r->error) c->error = 'a';
+    return NULL;
+}
+
+enum {Plain, In_single, In_double, In_comment};
+
+/* Walk from p to end, starting in state s, following read_line's rules for quotes,
+   escapes, and comments, and return the state at the end. *first_end gets the position
+   just past the first newline that ends a line, or NULL if there is none; with stop
+   set, we return right there. */
+static int scan_lines(char const *type, int fixed, char const *p, char const *end, int s,
+                                                    char const **first_end, int stop){
+    *first_end = NULL;
+    if (fixed){ //no quotes or comments, so every newline ends a line.
+        char const *nl = memchr(p, '\n', end-p);
+        if (nl) *first_end = nl+1;
+        return Plain;
+    }
+    char special[256]; //outside of quotes and comments, most characters don't matter.
+    for (int i=0; i< 256; i++) special[i] = strchr("\\'\"#n", type[i]) != NULL;
+    for ( ; p < end; p++){
+        char t = type[(unsigned char)*p];
+        if (s == Plain && !special[(unsigned char)*p]) continue;
+        if (s == In_comment){
+            if (*p != '\n') continue;
+        }
+        else if (t == '\\') {p++; continue;} //the next character is plain, whatever it is.
+        else if (s == In_single) {if (t == '\'') s = Plain; continue;}
+        else if (s == In_double) {if (t == '"') s = Plain; continue;}
+        else if (t == '\'') {s = In_single; continue;}
+        else if (t == '"')  {s = In_double; continue;}
+        else if (t == '#')  {s = In_comment; continue;}
+        else if (t != 'n')  continue;
+        s = Plain;  //a line ends here.
+        if (!*first_end){
+            *first_end = p+1;
+            if (stop) return s;
+        }
+    }
+    return s;
+}
+
+typedef struct {
+    char const *type, *from, *to;
+    int fixed, end_state;
+    char const *first_end;
+} scan_task;
+
+static void *scan_piece(void *in){
+    scan_task *t = in;
+    t->end_state = scan_lines(t->type, t->fixed, t->from, t->to, Plain, &t->first_end, 0);
+    return NULL;
+}
+
+//Set up n chunks with the reader's settings.
+static text_chunk *chunks_alloc(chunk_reader *cr, int n){
+    if (n > cr->allocated){
+        text_chunk *newchunks = realloc(cr->chunks, sizeof(text_chunk)*n);
+        Apop_stopif(!newchunks, cr->error='a'; return NULL, 0, "malloc failed. Probably out of memory.");
+        memset(newchunks + cr->allocated, 0, sizeof(text_chunk)*(n - cr->allocated));
+        cr->chunks = newchunks;
+        cr->allocated = n;
+    }
+    for (int i=0; i< n; i++){
+        text_chunk *c = cr->chunks+i;
+        c->field_ends = cr->field_ends;
+        c->mode = cr->mode;
+        c->hasrows = cr->hasrows;
+        c->cols = cr->cols;
+        c->prepped = cr->prepped;
+    }
+    cr->chunkct = n;
+    cr->next = 0;
+    return cr->chunks;
+}
+
+static void chunks_free(chunk_reader *cr){
+    for (int i=0; i< cr->allocated; i++){
+        text_chunk *c = cr->chunks+i;
+        for (size_t j=0; j< c->badct; j++) free(c->bad[j].field);
+        free(c->bad);
+        free(c->vals);
+        free(c->text);
+        free(c->recs);
+        free(c->sub.line);
+        free(c->sub.fields);
+    }
+    free(cr->chunks);
+}
+
+//Cut the next stretch of the map into pieces that start at line starts, and parse them all at once.
+static void read_pieces(chunk_reader *cr, int slots){
+    text_reader *r = cr->r;
+    int fixed = !!cr->field_ends, n = 0;
+    size_t size = GSL_MIN(Max_chunk, GSL_MAX(Min_chunk, (size_t)(r->end - r->p)/slots));
+    scan_task scans[slots];
+    for (char const *from = r->p; n < slots && from < r->end; n++){
+        char const *to = (size_t)(r->end - from) > size ? from + size : r->end;
+        while (to < r->end && r->type[(unsigned char)to[-1]] == '\\') to++;
+        scans[n] = (scan_task){.type=r->type, .fixed=fixed, .from=from, .to=to};
+        from = to;
+    }
+    apop_threadpool_run(scan_piece, scans, sizeof(scan_task), n);
+
+    char const *starts[n+1], *end = scans[n-1].to, *first_end;
+    int s = Plain, pieces = 1;
+    starts[0] = r->p;
+    for (int k=0; k< n; k++){
+        if (s != Plain) //a quote or comment runs over the cut, so the scan started in the wrong state.
+            scans[k].end_state = scan_lines(r->type, fixed, scans[k].from, scans[k].to, s, &scans[k].first_end, 0);
+        if (k && scans[k].first_end) starts[pieces++] = scans[k].first_end;
+        s = scans[k].end_state;
+    }
+    if (end < r->end){ //finish the line that runs past the last cut.
+        scan_lines(r->type, fixed, end, r->end, s, &first_end, 1);
+        end = first_end ? first_end : r->end;
+    }
+    while (starts[pieces-1] >= end) pieces--;
+    starts[pieces] = end;
+
+    text_chunk *c = chunks_alloc(cr, pieces);
+    if (!c) {cr->done = 1; return;}
+    for (int k=0; k< pieces; k++){
+        memcpy(c[k].sub.type, r->type, sizeof(r->type));
+        c[k].sub.plain_point = r->plain_point;
+        c[k].sub.p = starts[k];
+        c[k].sub.end = starts[k+1];
+        c[k].sub.error = 0;
+        c[k].r = &c[k].sub;
+        c[k].maxrec = 0;
+    }
+    apop_threadpool_run(parse_chunk, c, sizeof(text_chunk), pieces);
+    r->p = end;
+    cr->done = (end == r->end);
+}
+
+//The next chunk of parsed lines, or NULL at the end of the input.
+static text_chunk *chunk_next(chunk_reader *cr){
+    if (cr->next < cr->chunkct) return cr->chunks + cr->next++;
+    if (cr->done) return NULL;
+    text_reader *r = cr->r;
+    int slots = (r->map && cr->cols >= 0 && apop_opts.thread_count > 1
+                       && r->end - r->p >= 2*Min_chunk) ? apop_opts.thread_count : 0;
+    if (slots) read_pieces(cr, slots);
+    else {
+        text_chunk *c = chunks_alloc(cr, 1);
+        if (!c) return NULL;
+        c->r = r;
+        c->maxrec = cr->cols < 0 ? 1 : Serial_records; //once we know the width, we can go parallel.
+        parse_chunk(c);
+        cr->done = c->eof;
+    }
+    if (cr->cols < 0 && cr->chunkct) cr->cols = cr->chunks->cols;
+    return cr->next < cr->chunkct ? cr->chunks + cr->next++ : NULL;
+}
+
 /** Read a delimited text file into the matrix element of an \ref apop_data set.
 
   See \ref text_format.
@@ -696,66 +1274,68 @@ APOP_VAR_HEAD apop_data * apop_text_to_data(char const*text_file, int has_row_na
     int const * apop_varad_var(field_ends, NULL);
     const char * apop_varad_var(delimiters, apop_opts.input_delimiters);
 APOP_VAR_END_HEAD
-    apop_data *set = NULL;
-    FILE *infile = NULL;
-    char *str;
-    apop_data *add_this_line= apop_data_alloc();
-    int row = 0,
-        hasrows = (has_row_names == 'y');
-    Apop_stopif(prep_text_reading(text_file, &infile), apop_data *out=apop_data_alloc();out->error='t'; return out,
+    text_reader *r = reader_open(text_file, delimiters);
+    Apop_stopif(!r, apop_data *out=apop_data_alloc();out->error='t'; return out,
             0, "trouble opening %s", text_file);
+    int hasrows = (has_row_names == 'y'), cols;
+    size_t row = 0, space = 0; //rows read, rows allocated in the matrix.
+    apop_data *set = apop_data_alloc();
+    apop_name *header = apop_name_alloc();
 
-    line_parse_t L={ };
     //First, handle the top line, if we're told that it has column names.
     if (has_col_names=='y'){
-        apop_data *field_names = apop_data_alloc();
-        get_field_names(1, NULL, infile, add_this_line, field_names, field_ends, delimiters);
-        L.ct = add_this_line->textsize[0];
-        set = apop_data_alloc(0,1, L.ct - hasrows);
-	    set->names->colct   = 0;
-	    set->names->column	= malloc(sizeof(char*));
-        for (int j=0; j< L.ct - hasrows; j++)
-            apop_name_add(set->names, *field_names->text[j], 'c');
-        apop_data_free(field_names);
+        line_parse_t L;
+        do L = next_line(r, field_ends); while (!L.ct && !L.eof);
+        for (int i=0; i< L.ct; i++)
+            apop_name_add(header, Field(r, i), 'c');
     } 
 
-    //Now do the body.
-	while(!set || (L.ct && !L.eof)){
-        if (!L.ct) { //skip blank lines
-            L=parse_a_line(infile, add_this_line, field_ends, delimiters);
-            continue;
+    //Now do the body, a chunk at a time. The first line sets the width.
+    //The matrix grows by doubling, and is trimmed to size at the end.
+    chunk_reader cr = {.r=r, .field_ends=field_ends, .mode='d', .hasrows=hasrows, .cols=-1};
+    for (text_chunk *c; !set->error && (c = chunk_next(&cr)); ){
+        cols = cr.cols;
+        if (cols > 0 && row + c->recct > space){
+            while (space < row + c->recct) space = space ? 2*space : 16;
+            set->matrix = apop_matrix_realloc(set->matrix, space, cols);
+            Apop_stopif(!set->matrix, set->error='a'; break, 0, "allocation error.");
         }
-        if (!set) set = apop_data_alloc(0, 1, L.ct-hasrows); //for .has_col_names=='n'.
-        row++;
-        int cols = set->matrix  ? set->matrix->size2 : L.ct - hasrows;
-        set->matrix = apop_matrix_realloc(set->matrix, row, cols);
-        Apop_stopif(!set->matrix, set->error='a'; return set, 0, "allocation error.");
-        if (hasrows) {
-            apop_name_add(set->names, *add_this_line->text[0], 'r');
-            Apop_stopif(L.ct-1 > set->matrix->size2, set->error='t'; return set, 1,
-                 "row %i (not counting rownames) has %i elements (not counting the rowname), "
-                 "but I thought this was a data set with %zu elements per row. "
-                 "Stopping the file read; returning what I have so far.", row, L.ct-1, set->matrix->size2);
-        } else Apop_stopif(L.ct > set->matrix->size2, set->error='t'; return set, 1,
-                 "row %i has %i elements, "
-                 "but I thought this was a data set with %zu elements per row. "
-                 "Stopping the file read; returning what I have so far. Set has_row_names?", row, L.ct-1, set->matrix->size2);
-        for (int col=hasrows; col < L.ct; col++){
-            char *thisstr = *add_this_line->text[col];
-            if (strlen(thisstr)){
-                double val = strtod(thisstr, &str);
-                if (thisstr != str)
-                    gsl_matrix_set(set->matrix, row-1, col-hasrows, val);
-                else {
-                    gsl_matrix_set(set->matrix, row-1, col-hasrows, GSL_NAN);
-                    Apop_notify(1, "trouble converting data item %i on data line %i [%s]; writing NaN.", col, row, thisstr);
-                }
-            } else gsl_matrix_set(set->matrix, row-1, col-hasrows, GSL_NAN);
+        char const *name = c->text;
+        for (size_t i=0; i< c->recct; i++){
+            if (cols > 0) memcpy(gsl_matrix_ptr(set->matrix, row+i, 0), c->vals + i*cols, sizeof(double)*cols);
+            if (hasrows){
+                apop_name_add(set->names, name, 'r');
+                name += strlen(name)+1;
+            }
         }
-        L=parse_a_line(infile, add_this_line, field_ends, delimiters);
+        for (size_t i=0; i< c->badct; i++)
+            Apop_notify(1, "trouble converting data item %i on data line %zu [%s]; writing NaN.",
+                            c->bad[i].col, row + c->bad[i].row, c->bad[i].field);
+        row += c->recct;
+        Apop_stopif(c->toolong && hasrows, set->error='t'; break, 1,
+                 "row %zu (not counting rownames) has %i elements (not counting the rowname), "
+                 "but I thought this was a data set with %i elements per row. "
+                 "Stopping the file read; returning what I have so far.", row+1, c->toolong-1, cols);
+        Apop_stopif(c->toolong, set->error='t'; break, 1,
+                 "row %zu has %i elements, "
+                 "but I thought this was a data set with %i elements per row. "
+                 "Stopping the file read; returning what I have so far. Set has_row_names?", row+1, c->toolong, cols);
+        Apop_stopif(c->error, set->error='a'; break, 0, "allocation error reading %s.", text_file);
 	}
-    apop_data_free(add_this_line);
-    if (strcmp(text_file,"-")) fclose(infile);
+    if (cr.error) set->error='a';
+    cols = cr.cols >= 0 ? cr.cols : header->colct;
+    for (int j=0; j< GSL_MIN(header->colct, cols); j++)
+        apop_name_add(set->names, header->column[j], 'c');
+    if (set->matrix){
+        if (row) set->matrix = apop_matrix_realloc(set->matrix, row, cols);
+        else {
+            gsl_matrix_free(set->matrix);
+            set->matrix = NULL;
+        }
+    }
+    chunks_free(&cr);
+    apop_name_free(header);
+    reader_close(r);
 	return set;
 }
 
@@ -998,7 +1578,7 @@ gsl_matrix *apop_matrix_fill_base(gsl_matrix *in, double ap[]){
 
 
 ///////The rest of this file is for apop_text_to_db
-extern sqlite3 *db;
+extern threadlocal sqlite3 *db;
 
 static char *get_field_conditions(char *var, apop_data *field_params){
     if (field_params)
@@ -1078,28 +1658,28 @@ char *prep_string_for_sqlite(int prepped_statements, char const *astring){
     return out;
 }
 
-static void line_to_insert(line_parse_t L, apop_data const*addme, char const *tabname, 
-                             sqlite3_stmt *p_stmt, int row){
-    if (!L.ct) return;
+//Fields are as from prep_string_for_sqlite, with NULL or "" for a missing value.
+static void line_to_insert(int fieldct, char * const *fields, char const *tabname, 
+                             sqlite3_stmt *p_stmt, size_t row){
+    if (!fieldct) return;
     int  field = 1;
     char comma = ' ';
     char *q  = NULL;
     if (!p_stmt) asprintf(&q, "INSERT INTO %s VALUES (", tabname);
-    for (int col=0; col < L.ct; col++){
-        char *prepped = prep_string_for_sqlite(!!p_stmt, *addme->text[col]);
+    for (int col=0; col < fieldct; col++){
+        char const *prepped = fields[col];
         if (p_stmt){
             if (!prepped || !strlen(prepped))
                 field++; //leave NULL and cleared
             else if (sqlite3_bind_text(p_stmt, field++, prepped, -1, SQLITE_TRANSIENT))
-                Apop_notify(0, "Something wrong on line %i, field %i [%s].\n"
-                                            , row, field-1, *addme->text[col]);
+                Apop_notify(0, "Something wrong on line %zu, field %i [%s].\n"
+                                            , row, field-1, prepped);
         } else {
             if (prepped && strlen(prepped)) 
                  xprintf(&q, "%s%c %s", q, comma,  prepped);
             else xprintf(&q, "%s%cNULL", q, comma);
             comma = ',';
         }
-        free(prepped);
     }
     if (!p_stmt){
         apop_query("%s);",q); 
@@ -1107,13 +1687,37 @@ static void line_to_insert(line_parse_t L, apop_data const*addme, char const *ta
     }
 }
 
+typedef struct {
+    char const *tabname;
+    sqlite3_stmt *statement;
+    int ct, batch_size;
+} db_writer;
+
+static int insert_line(db_writer *w, int fieldct, char * const *fields, size_t row){
+    line_to_insert(fieldct, fields, w->tabname, w->statement, row);
+    if (!(w->ct++ % w->batch_size)){
+        if (apop_opts.db_engine != 'm') apop_query("commit; begin;");
+        if (apop_opts.verbose > 0) {Apop_notify(2, ".");fflush(NULL);}
+    }
+    if (w->statement){
+        int err = sqlite3_step(w->statement);
+        if (err!=0 && err != 101) //0=ok, 101=done
+            Apop_notify(0, "sqlite insert query gave error code %i.\n", err);
+        Apop_assert_c(!sqlite3_reset(w->statement), -1, apop_errorlevel, "SQLite error.");
+#if SQLITE_VERSION_NUMBER >= 3003009
+        Apop_assert_c(!sqlite3_clear_bindings(w->statement), -1, apop_errorlevel, "SQLite error."); //needed for NULLs
+#endif
+    }
+    return 0;
+}
+
 /** Read a text file into a database table.
 
   See \ref text_format.
 
 See the \ref apop_ols page for an example that uses this function to read in sample data (also listed on that page).
 
-By the way, there is a begin/commit wrapper that bundles the process into bundles of 10000 inserts per transaction. if you want to change this to more or less frequent commits, you'll need to modify and recompile the code. 
+By the way, there is a begin/commit wrapper that bundles the process into bundles of \ref apop_opts_type "apop_opts.db_batch_size" inserts per transaction (default 100,000). For a scratch database on disk, see also \ref apop_opts_type "apop_opts.db_scratch".
 
 \param text_file    The name of the text file to be read in. If \c "-", then read from \c STDIN. (default = "-")
 \param tabname      The name to give the table in the database (default
@@ -1144,27 +1748,25 @@ APOP_VAR_HEAD int apop_text_to_db(char const *text_file, char *tabname, int has_
     char * apop_varad_var(table_params, NULL)
     const char * apop_varad_var(delimiters, apop_opts.input_delimiters);
 APOP_VAR_END_HEAD
-    int  batch_size  = 10000, not_ok=0,
-      	 col_ct, ct = 0, rows = 1;
-    FILE *infile;
-    apop_data *add_this_line = apop_data_alloc();
+    int  not_ok=0, col_ct, status=0;
+    size_t rows = 1;
+    text_reader *r;
+    apop_data *add_this_line = line_buffer_alloc();
     sqlite3_stmt * statement = NULL;
-    line_parse_t L={1,0};
 
 	Apop_assert_c(!apop_table_exists(tabname), -1, 0, "table %s exists; not recreating it.", tabname);
 
     //get names and the first row.
-    if (prep_text_reading(text_file, &infile)) return -1;
+    if (!(r = reader_open(text_file, delimiters))) return -1;
 	use_names_in_file = 0;    //file-global.
-    apop_data *fn = apop_data_alloc();
-    get_field_names(has_col_names=='y', field_names, infile, 
-                                    add_this_line, fn, field_ends, delimiters);
-    col_ct = L.ct = add_this_line->textsize[0];
+    apop_data *fn = line_buffer_alloc();
+    get_field_names(has_col_names=='y', field_names, r, add_this_line, fn, field_ends);
+    col_ct = add_this_line->textsize[0];
     if (apop_opts.db_engine=='m')
         not_ok = tab_create_mysql(tabname, has_row_names=='y', field_params, table_params, fn);
     else
         not_ok = tab_create_sqlite(tabname, has_row_names=='y', field_params, table_params, fn);
-    Apop_stopif(not_ok, return -1, 0, "Creating the table in the database failed.");
+    Apop_stopif(not_ok, reader_close(r); return -1, 0, "Creating the table in the database failed.");
 #if SQLITE_VERSION_NUMBER < 3003009
     apop_notify(1, "Apophenia was compiled using a version of SQLite from mid-2007 or earlier. "
                     "The code for reading in text files using such an old version is no longer supported, "
@@ -1187,31 +1789,46 @@ APOP_VAR_END_HEAD
 #endif
     //done with table & query setup.
     //convert a data line into SQL: insert into TAB values (0.3, 7, "et cetera");
-	while(L.ct && !L.eof){
-        line_to_insert(L, add_this_line, tabname, statement, rows);
-        if (!(ct++ % batch_size)){
-            if (apop_opts.db_engine != 'm') apop_query("commit; begin;");
-            if (apop_opts.verbose > 0) {Apop_notify(2, ".");fflush(NULL);}
-        }
-        if (statement){
-            int err = sqlite3_step(statement);
-            if (err!=0 && err != 101) //0=ok, 101=done
-                Apop_notify(0, "sqlite insert query gave error code %i.\n", err);
-            Apop_assert_c(!sqlite3_reset(statement), -1, apop_errorlevel, "SQLite error.");
-#if SQLITE_VERSION_NUMBER >= 3003009
-            Apop_assert_c(!sqlite3_clear_bindings(statement), -1, apop_errorlevel, "SQLite error."); //needed for NULLs
-#endif
+    db_writer w = {.tabname=tabname, .statement=statement, .batch_size=GSL_MAX(apop_opts.db_batch_size, 1)};
+    if (col_ct){
+        char *prepped[col_ct];
+        for (int col=0; col < col_ct; col++)
+            prepped[col] = prep_string_for_sqlite(!!statement, *add_this_line->text[col]);
+        status = insert_line(&w, col_ct, prepped, rows);
+        for (int col=0; col < col_ct; col++) free(prepped[col]);
+
+        //The rest of the file, a chunk at a time; see chunk_next.
+        chunk_reader cr = {.r=r, .field_ends=field_ends, .mode='b', .prepped=!!statement};
+        char **fields = NULL, error = 0;
+        size_t fieldsize = 0;
+        for (text_chunk *c; !status && (c = chunk_next(&cr)); ){
+            char *field = c->text;
+            for (size_t i=0; !status && i< c->recct; i++){
+                fields = grow(fields, &fieldsize, c->recs[i].ct, sizeof(char*), &error);
+                Apop_stopif(error, status=-1; break, 0, "allocation error reading %s.", text_file);
+                for (int col=0; col < c->recs[i].ct; col++, field += strlen(field)+1)
+                    fields[col] = field;
+                status = insert_line(&w, c->recs[i].ct, fields, rows + c->recs[i].line);
+            }
+            rows += c->lines;
+            Apop_stopif(c->error, status=-1, 0, "allocation error reading %s.", text_file);
         }
-        do {
-            L = parse_a_line(infile, add_this_line, field_ends, delimiters);
-            rows ++;
-        } while (!L.ct && !L.eof); //skip blank lines
-	}
+        rows++; //the read that found the end of the file.
+        free(fields);
+        chunks_free(&cr);
+        if (cr.error) status = -1;
+    }
     apop_data_free(add_this_line);
+    apop_data_free(fn);
+    reader_close(r);
+    if (status){ //drop the partial batch, and don't leave a transaction open for the next query.
+        if (apop_opts.db_engine != 'm') apop_query("rollback;");
+        if (statement) sqlite3_finalize(statement);
+        return -1;
+    }
     apop_query("commit;");
 	if (use_sqlite_prepared_statements){
         Apop_assert_c(sqlite3_finalize(statement) ==SQLITE_OK, -1, apop_errorlevel, "SQLite error.");
     }
-    if (strcmp(text_file,"-")) fclose(infile);
 	return rows;
 }
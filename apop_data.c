@@ -16,6 +16,8 @@ The apop_data structure joins together a gsl_matrix, apop_name, and a table of s
 
 For allocating the text part, see \ref apop_text_alloc.
 
+If <tt>apop_opts.string_arena=='y'</tt>, the new set keeps its names and text in an arena; see \ref apop_data_use_arena.
+
 The \c weights vector is set to \c NULL. If you need it, allocate it via
 \code d->weights   = gsl_vector_alloc(row_ct); \endcode
 
@@ -65,6 +67,7 @@ APOP_VAR_ENDHEAD
     setme->names = apop_name_alloc();
     Apop_stopif(!setme->names, setme->error='a'; return setme,
                 0, "couldn't allocate names. Probably out of memory.");
+    if (apop_opts.string_arena=='y') apop_data_use_arena(setme);
     return setme;
 }
 
@@ -147,6 +150,9 @@ apop_data * apop_vector_to_data(gsl_vector *v){
  apop_text_free(yourdata->text, yourdata->textsize[0], yourdata->textsize[1]);
  \endcode
  This is what \c apop_data_free uses internally.
+
+ \li If the data set has an arena (see \ref apop_data_use_arena), its strings weren't
+ individually \c malloced, so don't use this; \ref apop_data_free will take care of it.
    */
 void apop_text_free(char ***freeme, int rows, int cols){
     if (rows && cols)
@@ -185,10 +191,18 @@ char apop_data_free_base(apop_data *freeme){
         gsl_vector_free(freeme->vector);
     if (freeme->matrix)  
         gsl_matrix_free(freeme->matrix); 
+    if (freeme->columns)  
+        gsl_matrix_free(freeme->columns); 
     if (freeme->weights)
         gsl_vector_free(freeme->weights);
     apop_name_free(freeme->names);
-    apop_text_free(freeme->text, freeme->textsize[0] , freeme->textsize[1]);
+    if (freeme->arena){
+        if (freeme->textsize[0] && freeme->textsize[1])
+            apop_arena_free_grid(freeme->arena, freeme->text, freeme->textsize[0], freeme->textsize[1]);
+        free(freeme->text);
+        apop_arena_release(freeme->arena);
+    } else
+        apop_text_free(freeme->text, freeme->textsize[0] , freeme->textsize[1]);
     free(freeme);
     return 0;
 }
@@ -227,6 +241,14 @@ void apop_data_memcpy(apop_data *out, const apop_data *in){
                         in->matrix->size1, in->matrix->size2, out->matrix->size1, out->matrix->size2);
         gsl_matrix_memcpy(out->matrix, in->matrix);
     }
+    if (in->columns){
+        Apop_stopif(!out->columns, out->error='p'; return, 1, "in->columns exists but out->columns does not.");
+        Apop_stopif(in->columns->size1 != out->columns->size1 || in->columns->size2 != out->columns->size2, 
+                out->error='d'; return,
+                1, "you're trying to copy a (%zu X %zu) into a (%zu X %zu) column-major matrix.", 
+                        in->columns->size2, in->columns->size1, out->columns->size2, out->columns->size1);
+        gsl_matrix_memcpy(out->columns, in->columns);
+    }
     if (in->vector){
         Apop_stopif(!out->vector, out->error='p'; return, 1, "in->vector exists but out->vector does not.");
         Apop_stopif(in->vector->size != out->vector->size,
@@ -247,6 +269,7 @@ void apop_data_memcpy(apop_data *out, const apop_data *in){
     if (in->names){
         apop_name_free(out->names);
         out->names = apop_name_alloc();
+        out->names->arena = apop_arena_keep(out->arena);
         apop_name_stack(out->names, in->names, 'v');
         apop_name_stack(out->names, in->names, 'r');
         apop_name_stack(out->names, in->names, 'c');
@@ -262,8 +285,10 @@ void apop_data_memcpy(apop_data *out, const apop_data *in){
                     "or use apop_data_copy for automatic allocation.",
                     in->textsize[0] , in->textsize[1] , out->textsize[0] , out->textsize[1]);
         for (size_t i=0; i< in->textsize[0]; i++)
-            for(size_t j=0; j < in->textsize[1]; j ++)
-				apop_text_add(out, i, j, "%s", in->text[i][j]);
+            for(size_t j=0; j < in->textsize[1]; j ++){
+                apop_arena_free(out->arena, out->text[i][j]);
+                out->text[i][j] = apop_arena_strdup(out->arena, in->text[i][j]);
+            }
     }
 }
 
@@ -288,6 +313,7 @@ apop_data *apop_data_copy(const apop_data *in){
     if (!in) return NULL;
     apop_data *out = apop_data_alloc();
     Apop_stopif(out->error, return out, 0, "Allocation error.");
+    if (in->arena) apop_data_use_arena(out);
     if (in->error){
         Apop_notify(1, "the data set to be copied has an error flag of %c. Copying it.", in->error);
         out->error = in->error;
@@ -309,6 +335,11 @@ apop_data *apop_data_copy(const apop_data *in){
         Apop_stopif(!out->matrix, out->error='a'; return out, 0, "Allocation error on matrix "
                     "of size %zu X %zu.", in->matrix->size1, in->matrix->size2);
     }
+    if (in->columns){  
+        out->columns = gsl_matrix_alloc(in->columns->size1, in->columns->size2);
+        Apop_stopif(!out->columns, out->error='a'; return out, 0, "Allocation error on column-major matrix "
+                    "of size %zu X %zu.", in->columns->size2, in->columns->size1);
+    }
     if (in->weights){
         out->weights = gsl_vector_alloc(in->weights->size);
         Apop_stopif(!out->weights, out->error='a'; return out, 0, "Allocation error on weights vector of size %zu.", in->weights->size);
@@ -586,7 +617,9 @@ allocation:
         for (int i=0; i< in->textsize[0]; i++)
             for (int j=0; j< in->textsize[1]; j++){
                 int whichtext = (i >= splitpoint);
-                asprintf(&(out[whichtext]->text[i][j]), "%s", in->text[i][j]);
+                char **cell = &out[whichtext]->text[i - whichtext*splitpoint][j];
+                apop_arena_free(out[whichtext]->arena, *cell);
+                *cell = apop_arena_strdup(out[whichtext]->arena, in->text[i][j]);
             }
     }
     return out;
@@ -600,14 +633,16 @@ allocation:
  */
 static void apop_name_rm_columns(apop_name *n, int *drop){
     apop_name *newname = apop_name_alloc();
+    newname->arena = apop_arena_keep(n->arena);
     size_t initial_colct = n->colct;
     for (size_t i=0; i< initial_colct; i++){
         if (drop[i]==0) apop_name_add(newname, n->column[i],'c');
         else            n->colct--;
-        free(n->column[i]);
+        apop_arena_free(n->arena, n->column[i]);
     }
     free(n->column);
     n->column = newname->column;
+    n->colsize = newname->colsize;
 
     //we need to free the newname struct, but leave the column intact.
     newname->column   = NULL;
@@ -741,13 +776,31 @@ for (int i=0; i< 1e7; i++)
 The \c _ptr functions return a pointer to the given cell. Those functions follow the lead of \c gsl_vector_ptr and \c gsl_matrix_ptr, and like those functions, return a pointer to the appropriate \c double.
 
 These functions use the \ref designated syntax for inputs.
+
+\li If the matrix is stored by columns (see \ref apop_data_to_columns), these functions
+still take (row, column) in the usual order, and will find the right element in the \c columns matrix.
 */
 
+/* The (row, col) element of the matrix, which may be stored by rows in d->matrix or
+   by columns in d->columns. */
+static double *mptr(const apop_data *d, size_t row, size_t col){
+    return d->columns ? gsl_matrix_ptr(d->columns, col, row) : gsl_matrix_ptr(d->matrix, row, col);
+}
+
+static double mget(const apop_data *d, size_t row, size_t col){
+    return d->columns ? gsl_matrix_get(d->columns, col, row) : gsl_matrix_get(d->matrix, row, col);
+}
+
+static void mset(apop_data *d, size_t row, size_t col, double val){
+    if (d->columns) gsl_matrix_set(d->columns, col, row, val);
+    else            gsl_matrix_set(d->matrix, row, col, val);
+}
+
 /* \deprecated  use \ref apop_data_ptr */
 double *apop_data_ptr_ti(apop_data *in, const char* row, const int col){
     int rownum =  apop_name_find(in->names, row, 'r');
     apop_assert_c(rownum != -2,  NULL, 0,"Couldn't find '%s' amongst the row names.", row);
-    return (col >= 0) ? gsl_matrix_ptr(in->matrix, rownum, col)
+    return (col >= 0) ? mptr(in, rownum, col)
                       : gsl_vector_ptr(in->vector, rownum);
 }
 
@@ -755,7 +808,7 @@ double *apop_data_ptr_ti(apop_data *in, const char* row, const int col){
 double *apop_data_ptr_it(apop_data *in, const size_t row, const char* col){
     int colnum =  apop_name_find(in->names, col, 'c');
     apop_assert_c(colnum != -2,  NULL, 0,"Couldn't find '%s' amongst the column names.", col);
-    return (colnum >= 0) ? gsl_matrix_ptr(in->matrix, row, colnum)
+    return (colnum >= 0) ? mptr(in, row, colnum)
                          : gsl_vector_ptr(in->vector, row);
 }
 
@@ -765,7 +818,7 @@ double *apop_data_ptr_tt(apop_data *in, const char *row, const char* col){
     int rownum =  apop_name_find(in->names, row, 'r');
     apop_assert_c(rownum != -2,  NULL, 0,"Couldn't find '%s' amongst the row names.", row);
     apop_assert_c(colnum != -2,  NULL, 0,"Couldn't find '%s' amongst the column names.", col);
-    return (colnum >= 0) ? gsl_matrix_ptr(in->matrix, rownum, colnum)
+    return (colnum >= 0) ? mptr(in, rownum, colnum)
                          : gsl_vector_ptr(in->vector, rownum);
 }
 
@@ -798,11 +851,11 @@ APOP_VAR_HEAD double * apop_data_ptr(apop_data *data, const int row, const int c
 
     //else: row number, column number
     if (col == -1){
-        Apop_assert(data->vector, "You asked for the vector element (col=-1) but it is NULL.");
-        return gsl_vector_ptr(data->vector, row);
+        Apop_assert(d->vector, "You asked for the vector element (col=-1) but it is NULL.");
+        return gsl_vector_ptr(d->vector, row);
     } else {
-        Apop_assert(data->matrix, "You asked for the matrix element (%i, %i) but the matrix is NULL.", row, col);
-        return gsl_matrix_ptr(data->matrix, row,col);
+        Apop_assert(d->matrix || d->columns, "You asked for the matrix element (%i, %i) but the matrix is NULL.", row, col);
+        return mptr(d, row,col);
     }
 APOP_VAR_ENDHEAD
     return NULL;//the main function is blank.
@@ -813,8 +866,8 @@ double apop_data_get_ti(const apop_data *in, const char* row, const int col){
     int rownum =  apop_name_find(in->names, row, 'r');
     Apop_assert_c(rownum != -2,  GSL_NAN, 0,"Couldn't find '%s' amongst the row names.", row);
     if (col >= 0){
-        Apop_assert_nan(in->matrix, "You asked me to get the (%i, %i) element of a NULL matrix.", rownum, col);
-        return gsl_matrix_get(in->matrix, rownum, col);
+        Apop_assert_nan(in->matrix || in->columns, "You asked me to get the (%i, %i) element of a NULL matrix.", rownum, col);
+        return mget(in, rownum, col);
     } else {
         Apop_assert_nan(in->vector, "You asked me to get the %ith element of a NULL vector.", rownum);
         return gsl_vector_get(in->vector, rownum);
@@ -826,8 +879,8 @@ double apop_data_get_it(const apop_data *in, const size_t row, const char* col){
     int colnum = apop_name_find(in->names, col, 'c');
     Apop_assert_c(colnum != -2,  GSL_NAN, 0,"Couldn't find '%s' amongst the column names.", col);
     if (colnum >= 0){
-        Apop_assert_nan(in->matrix, "You asked me to get the (%zu, %i) element of a NULL matrix.", row, colnum);
-        return gsl_matrix_get(in->matrix, row, colnum);
+        Apop_assert_nan(in->matrix || in->columns, "You asked me to get the (%zu, %i) element of a NULL matrix.", row, colnum);
+        return mget(in, row, colnum);
     } else {
         Apop_assert_nan(in->vector, "You asked me to get the %zuth element of a NULL vector.", row);
         return gsl_vector_get(in->vector, row);
@@ -841,8 +894,8 @@ double apop_data_get_tt(const apop_data *in, const char *row, const char* col){
     Apop_assert_c(colnum != -2,  GSL_NAN, 0,"Couldn't find '%s' amongst the column names.", col);
     Apop_assert_c(rownum != -2,  GSL_NAN, 0,"Couldn't find '%s' amongst the row names.", row);
     if (colnum >= 0){
-        Apop_assert_nan(in->matrix, "You asked me to get the (%i, %i) element of a NULL matrix.", rownum, colnum);
-        return gsl_matrix_get(in->matrix, rownum, colnum);
+        Apop_assert_nan(in->matrix || in->columns, "You asked me to get the (%i, %i) element of a NULL matrix.", rownum, colnum);
+        return mget(in, rownum, colnum);
     } else {
         Apop_assert_nan(in->vector, "You asked me to get the %ith element of a NULL vector.", rownum);
         return gsl_vector_get(in->vector, rownum);
@@ -875,8 +928,8 @@ APOP_VAR_HEAD double apop_data_get(const apop_data *data, const size_t row, cons
         return apop_data_get_it(d, row,colname);
     //else: row number, column number
     if (col>=0){
-        Apop_assert_nan(d->matrix, "You asked for the matrix element (%zu, %i) but the matrix is NULL.", row, col);
-        return gsl_matrix_get(d->matrix, row, col);
+        Apop_assert_nan(d->matrix || d->columns, "You asked for the matrix element (%zu, %i) but the matrix is NULL.", row, col);
+        return mget(d, row, col);
     } else {
         Apop_assert_nan(d->vector, "You asked for the vector element (col=-1) but it is NULL.");
         return gsl_vector_get(d->vector, row);
@@ -905,7 +958,7 @@ int apop_data_set_ti(apop_data *in, const char* row, const int col, const double
     Set_gsl_handler
     int rownum =  apop_name_find(in->names, row, 'r');
     Apop_assert_c(rownum != -2, -1, 0, "Couldn't find '%s' amongst the row names. Making no changes.", row);
-    if (col >= 0) gsl_matrix_set(in->matrix, rownum, col, data);
+    if (col >= 0) mset(in, rownum, col, data);
     else          gsl_vector_set(in->vector, rownum, data);
     Unset_gsl_handler
     return error_for_set;
@@ -917,7 +970,7 @@ int apop_data_set_it(apop_data *in, const size_t row, const char* col, const dou
     Set_gsl_handler
     int colnum =  apop_name_find(in->names, col, 'c');
     Apop_assert_c(colnum != -2, -1, 0, "Couldn't find '%s' amongst the column names. Making no changes.", col);
-    if (colnum >= 0)  gsl_matrix_set(in->matrix, row, colnum, data);
+    if (colnum >= 0)  mset(in, row, colnum, data);
     else              gsl_vector_set(in->vector, row, data);
     Unset_gsl_handler
     return error_for_set;
@@ -931,7 +984,7 @@ int apop_data_set_tt(apop_data *in, const char *row, const char* col, const doub
     int rownum =  apop_name_find(in->names, row, 'r');
     Apop_assert_c(colnum != -2, -1, 0, "Couldn't find '%s' amongst the column names. Making no changes.", col);
     Apop_assert_c(rownum != -2, -1, 0, "Couldn't find '%s' amongst the column names. Making no changes.", row);
-    if (colnum >= 0) gsl_matrix_set(in->matrix, rownum, colnum, data);
+    if (colnum >= 0) mset(in, rownum, colnum, data);
     else             gsl_vector_set(in->vector, rownum, data);
     Unset_gsl_handler
     return error_for_set;
@@ -982,8 +1035,8 @@ APOP_VAR_HEAD int apop_data_set(apop_data *data, const size_t row, const int col
     //else: row number, column number
     Set_gsl_handler
     if (col>=0){
-        Apop_assert_negone(d->matrix, "You're trying to set the matrix element (%zu, %i) but the matrix is NULL.", row, col);
-        gsl_matrix_set(d->matrix, row, col, val);
+        Apop_assert_negone(d->matrix || d->columns, "You're trying to set the matrix element (%zu, %i) but the matrix is NULL.", row, col);
+        mset(d, row, col, val);
     } else {
         Apop_assert_negone(d->vector, "You're trying to set a vector element (row=-1) but the vector is NULL.");
         gsl_vector_set(d->vector, row, val);
@@ -1035,8 +1088,8 @@ int apop_data_set_row(apop_data * d, apop_data *row, int row_number){
         Apop_assert_negone(d->textsize[1], "You asked me to copy an apop_data_row with text to "
                 "an apop_data set with no text element.");
         for (int i=0; i < row->textsize[1]; i++){
-            free(d->text[row_number][i]);
-            d->text[row_number][i]= strdup(row->text[0][i]);
+            apop_arena_free(d->arena, d->text[row_number][i]);
+            d->text[row_number][i]= apop_arena_strdup(d->arena, row->text[0][i]);
         }
     }
     if (row->weights){
@@ -1046,8 +1099,8 @@ int apop_data_set_row(apop_data * d, apop_data *row, int row_number){
     }
     if (row->names && row->names->rowct && d->names){
         if (row_number < d->names->rowct){
-            free(d->names->row[row_number]);
-            d->names->row[row_number]=strdup(row->names->row[0]);
+            apop_arena_free(d->names->arena, d->names->row[row_number]);
+            d->names->row[row_number]=apop_arena_strdup(d->names->arena, row->names->row[0]);
         } else if (row_number == d->names->rowct)
             apop_name_add(d->names, row->names->row[0], 'r');
     }
@@ -1138,14 +1191,14 @@ int apop_text_add(apop_data *in, const size_t row, const size_t col, const char
     Apop_assert_negone((in->textsize[0] >= (int)row+1) && (in->textsize[1] >= (int)col+1), "You asked me to put the text "
                             " '%s' at position (%zu, %zu), but the text array has size (%zu, %zu)\n", 
                                fmt,             row, col,                  in->textsize[0], in->textsize[1]);
-    free (in->text[row][col]);
+    apop_arena_free(in->arena, in->text[row][col]);
     if (!fmt){
-        asprintf(&(in->text[row][col]), "%s", apop_opts.db_nan);
+        in->text[row][col] = apop_arena_strdup(in->arena, apop_opts.db_nan);
         return 0;
     }
     va_list argp;
 	va_start(argp, fmt);
-    vasprintf(&(in->text[row][col]), fmt, argp);
+    in->text[row][col] = apop_arena_vprintf(in->arena, fmt, argp);
 	va_end(argp);
     return 0;
 }
@@ -1163,6 +1216,10 @@ int apop_text_add(apop_data *in, const size_t row, const size_t col, const char
   */
 apop_data * apop_text_alloc(apop_data *in, const size_t row, const size_t col){
     if (!in) in  = apop_data_alloc();
+    struct apop_arena *a = in->arena;
+    //With an arena, the new cells can all share one blank, since nobody frees it.
+    char *blank = NULL;
+    #define Blank (!a ? strdup("") : blank ? blank : (blank = apop_arena_strdup(a, "")))
     if (!in->text){
         if (row){
             in->text = malloc(sizeof(char**) * row);
@@ -1171,21 +1228,17 @@ apop_data * apop_text_alloc(apop_data *in, const size_t row, const size_t col){
         }
         if (row && col)
             for (size_t i=0; i< row; i++){
-                in->text[i] = malloc(sizeof(char*) * col);
+                in->text[i] = apop_arena_malloc(a, sizeof(char*) * col);
                 Apop_stopif(!in->text[i], in->error='a'; return in, 
                         0, "malloc failed setting up row %zu (with %zu columns). Probably out of memory.", i, col);
                 for (size_t j=0; j< col; j++)
-                    in->text[i][j] = strdup("");
+                    in->text[i][j] = Blank;
             }
     } else { //realloc
         size_t rows_now = in->textsize[0];
         size_t cols_now = in->textsize[1];
         if (rows_now > row){
-            for (int i=row; i < rows_now; i++){
-                for (int j=0; j < cols_now; j++)
-                    free(in->text[i][j]);
-                free(in->text[i]);
-            }
+            apop_arena_free_grid(a, in->text+row, rows_now-row, cols_now);
             in->text = realloc(in->text, sizeof(char**)*row);
             Apop_stopif(row && !in->text, in->error='a'; return in,
                             0, "realloc failed shrinking down to %zu rows from %zu rows. "
@@ -1196,29 +1249,65 @@ apop_data * apop_text_alloc(apop_data *in, const size_t row, const size_t col){
             Apop_stopif(!in->text, in->error='a'; return in,
                             0, "realloc failed setting up %zu rows. Probably out of memory.", row);
             for (size_t i=rows_now; i < row; i++){
-                in->text[i] = malloc(sizeof(char*) * col);
+                in->text[i] = apop_arena_malloc(a, sizeof(char*) * col);
                 Apop_stopif(!in->text[i], in->error='a'; return in, 
                         0, "malloc failed setting up row %zu (with %zu columns). Probably out of memory.", i, col);
                 for (int j=0; j < cols_now; j++)
-                    in->text[i][j] = strdup("");
+                    in->text[i][j] = Blank;
             }
         }
         if (cols_now > col)
             for (int i=0; i < row; i++)
                 for (int j=col; j < cols_now; j++)
-                    free(in->text[i][j]);
+                    apop_arena_free(a, in->text[i][j]);
         if (cols_now != col)
             for (int i=0; i < row; i++){
-                in->text[i] = realloc(in->text[i], sizeof(char*)*col);
+                in->text[i] = apop_arena_realloc(a, in->text[i], sizeof(char*)*cols_now, sizeof(char*)*col);
                 for (int j=cols_now; j < col; j++) //happens iff cols_now < col
-                    in->text[i][j] = strdup("");
+                    in->text[i][j] = Blank;
             }
     }
+    #undef Blank
     in->textsize[0] = row;
     in->textsize[1] = col;
     return in;
 }
 
+/** Keep the names and text of a data set in an arena.
+
+ Normally, every name and every cell of text is a separately \c malloced string. For
+ a data set with millions of rows of text, that's tens of millions of tiny blocks on the
+ heap, and freeing or copying the data set means freeing or allocating every one of them.
+ A data set with an arena stores its strings back to back in a few large blocks, so
+ \ref apop_data_free releases the whole lot at once, and \ref apop_data_copy fills one
+ new arena rather than calling \c malloc for every string.
+
+ \li Strings already in the data set stay where they are; only strings added afterward
+ go into the arena. So call this before filling the set, or set
+ <tt>apop_opts.string_arena='y'</tt> to have \ref apop_data_alloc (and so \ref
+ apop_query_to_text, \ref apop_text_to_data, ...) do it for every new set.
+ \li \ref apop_text_add, \ref apop_text_alloc, \ref apop_name_add, and the other
+ Apophenia functions know about the arena. If you write to cells yourself, as in
+ <tt>asprintf(&(d->text[i][j]), ...)</tt>, that's still OK: the set can hold a mix of
+ arena and \c malloced strings, and frees each correctly.
+ \li But don't \c free a string in a set with an arena yourself, because it may not be yours
+ to free. Use \ref apop_text_add to replace text, and \ref apop_data_free to clean up, not
+ \ref apop_text_free.
+ \li A string replaced via \ref apop_text_add isn't freed until the whole data set is, so
+ if you're going to rewrite the text of a set over and over, an arena is a bad idea.
+ \li This applies to one page of the data set; pages in <tt>d->more</tt> are unaffected.
+
+ \param d The data set. If \c NULL or it already has an arena, this is a no-op.
+ \exception d->error='a' Allocation error; the set is left as it was.
+\ingroup data_struct
+ */
+void apop_data_use_arena(apop_data *d){
+    if (!d || d->arena) return;
+    d->arena = apop_arena_alloc();
+    Apop_stopif(!d->arena, d->error='a'; return, 0, "Allocation error setting up an arena.");
+    if (d->names && !d->names->arena) d->names->arena = apop_arena_keep(d->arena);
+}
+
 /** Transpose the matrix element of the input \ref apop_data set,
  including the row/column names. The vector and text elements of the input data set are completely ignored.
 
@@ -1236,6 +1325,76 @@ apop_data *apop_data_transpose(apop_data *in){
     return out;
 }
 
+/** Move the matrix of a data set to column-major storage: row \c j of <tt>d->columns</tt>
+ holds column \c j of the matrix, in contiguous memory, and <tt>d->matrix</tt> is set to \c NULL.
+
+ A \c gsl_matrix is stored by rows, so going down a column means jumping \c size2
+ elements at every step. For a wide table, that's a cache miss on every element, and
+ most summary statistics go column by column. If that's your main use of a table, store it by columns.
+
+ \li \ref apop_data_get, \ref apop_data_set, and \ref apop_data_ptr work as always,
+ with the usual (row, column) ordering.
+ \li \ref apop_data_copy, \ref apop_data_memcpy, and \ref apop_data_free handle the \c columns element.
+ \li \ref apop_data_summarize, \ref apop_data_covariance, and \ref apop_data_correlation
+ use contiguous columns when they're available.
+ \li \ref apop_map_sum reads the columns directly for element-wise (\c fn_d and
+ friends) and row- or column-wise (\c fn_v and friends) functions. \ref apop_data_print
+ and \ref apop_data_to_db write a row-major copy.
+ \li \ref apop_map, \ref apop_map_sum with an \c fn_r-type function, \ref apop_estimate,
+ \ref apop_p, \ref apop_log_likelihood, and \ref apop_score stop with an error.
+ \li For everything else, the matrix is still expected to be in <tt>d->matrix</tt>. Use
+ \ref apop_data_to_rows to convert back before calling them.
+ \li To get a column as a contiguous vector, use <tt>Apop_matrix_row(d->columns, j, col_j)</tt>.
+
+ \param d The data set to convert, in place. I only operate on the first page. If \c NULL, or already stored by columns, or lacking a matrix, this is a no-op.
+ \return \c d, for your convenience.
+ \exception d->error='a' Allocation error; the data is left as it was.
+\ingroup data_struct
+ */
+apop_data *apop_data_to_columns(apop_data *d){
+    if (!d || !d->matrix || d->columns) return d;
+    d->columns = gsl_matrix_alloc(d->matrix->size2, d->matrix->size1);
+    Apop_stopif(!d->columns, d->error='a'; return d, 0, "Allocation error on a %zu X %zu matrix.",
+                                                        d->matrix->size2, d->matrix->size1);
+    gsl_matrix_transpose_memcpy(d->columns, d->matrix);
+    gsl_matrix_free(d->matrix);
+    d->matrix = NULL;
+    return d;
+}
+
+/** Move the matrix of a data set stored by columns (see \ref apop_data_to_columns) back to
+ the usual row-major <tt>d->matrix</tt>, and set <tt>d->columns</tt> to \c NULL.
+
+ \param d The data set to convert, in place. I only operate on the first page. If \c NULL or not stored by columns, this is a no-op.
+ \return \c d, for your convenience.
+ \exception d->error='a' Allocation error; the data is left as it was.
+ \exception d->error='p' Both \c matrix and \c columns are present, so I don't know which to keep.
+\ingroup data_struct
+ */
+apop_data *apop_data_to_rows(apop_data *d){
+    if (!d || !d->columns) return d;
+    Apop_stopif(d->matrix, d->error='p'; return d, 0, "This data set has both a matrix and "
+                "a column-major matrix. I don't know which to keep, so I'm not converting.");
+    d->matrix = gsl_matrix_alloc(d->columns->size2, d->columns->size1);
+    Apop_stopif(!d->matrix, d->error='a'; return d, 0, "Allocation error on a %zu X %zu matrix.",
+                                                        d->columns->size2, d->columns->size1);
+    gsl_matrix_transpose_memcpy(d->matrix, d->columns);
+    gsl_matrix_free(d->columns);
+    d->columns = NULL;
+    return d;
+}
+
+/* For the functions that read d->matrix directly (printing, writing to the db):
+   a row-major copy of a column-major page. See internal.h. */
+apop_data *apop_page_by_rows(apop_data const *d){
+    if (!d || !d->columns || d->matrix) return NULL;
+    apop_data page = *d;
+    page.more = NULL;
+    apop_data *out = apop_data_to_rows(apop_data_copy(&page));
+    out->more = d->more;
+    return out;
+}
+
 /** This function will resize a gsl_matrix to a new height or width.
 
 Data in the matrix will be retained. If the new height or width is smaller than the old, then data in the later rows/columns will be cropped away (in a non--memory-leaking manner). If the new height or width is larger than the old, then new cells will be filled with garbage; it is your responsibility to zero out or otherwise fill new rows/columns before use.
@@ -1486,7 +1645,7 @@ APOP_VAR_ENDHEAD
     if (in->text)    apop_text_alloc(in, GSL_MIN(outlength, in->textsize[0]), in->textsize[1]);
     if (in->names && in->names->rowct > outlength){
         for (int k=outlength; k< in->names->rowct; k++)
-            free(in->names->row[k]);
+            apop_arena_free(in->names->arena, in->names->row[k]);
         in->names->rowct = outlength;
     }
 }
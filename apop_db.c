@@ -4,6 +4,9 @@ features like a variance, skew, and kurtosis aggregator for SQL. */
 
 #include "apop_internal.h"
 #include <regex.h>
+#include <errno.h>
+#include <ctype.h>
+#include <sys/time.h>
 
 /** Here are where the options are initially set. See the \ref apop_opts_type
     documentation for details.*/
@@ -14,6 +17,8 @@ apop_opts_type apop_opts	=
             .db_name_column = "row_names", .db_nan = "NaN", 
             .db_engine = '\0',             .db_user = "\0", 
             .db_pass = "\0",               .thread_count = 1,
+            .thread_chunk_size = 0,        .string_arena = 'n',
+            .db_batch_size = 100000,       .db_scratch = 'n',
             .log_file = NULL,
             .rng_seed = 479901,            .version = X.XX };
 
@@ -38,11 +43,17 @@ static gsl_rng* db_rng  = NULL;     //the RNG for the RNG function.
 	va_end(argp);                 \
 	Apop_notify(2, "%s", query);
 
+//How to recognize apop_opts.db_nan in query output; see db_cell.
 typedef struct {
-    int        firstcall;
-    size_t     currentrow;
-    regmatch_t result[3];
-    regex_t    *regex;
+    regex_t    regex;
+    int        is_number; //is apop_opts.db_nan a number, like -999?
+    double     value;     //if so, this is that number.
+} db_nan_t;
+
+typedef struct {
+    int        firstcall, namecol;
+    size_t     currentrow, space;
+    db_nan_t   nan;
     apop_data  *outdata;
 } callback_t;
 
@@ -67,6 +78,19 @@ The Apophenia package assumes you are only using a single SQLite database at a t
 
 When you are done doing your database manipulations, be sure to call \ref apop_db_close if writing to disk.
 
+\li Threads: the thread that calls this function uses the database handle it opens. Any
+other thread that sends a query---such as the threads running an \ref apop_map with
+<tt>apop_opts.thread_count > 1</tt> whose function queries the database---opens its own
+connection to the same database on its first query, so per-group queries can run in
+parallel. For SQLite, if <tt>apop_opts.thread_count > 1</tt> when the database is opened,
+an on-disk database is put in write-ahead log mode (<tt>pragma journal_mode=wal</tt>), so
+any number of readers can run alongside the one writer SQLite allows, and writers wait
+for each other instead of failing. An in-memory database opened while
+<tt>apop_opts.thread_count > 1</tt> is one all threads can connect to; if it was opened
+before you turned on threading, all threads share the one handle, which works but means
+the queries take turns. \ref apop_db_close closes every thread's connection; call it
+from outside of any threaded map.
+
 \param filename
 The name of a file on the hard drive on which to store the database. If
 <tt>NULL</tt>, then the database will be kept in memory (in which case,
@@ -139,7 +163,7 @@ APOP_VAR_END_HEAD
     char *err=NULL, *q2;
     tab_exists_t te = { .name = name };
     tab_exists_t tev = { .name = name };
-	if (db==NULL) return 0;
+	if (!sqlite_thread_db()) return 0;
 	sqlite3_exec(db, "select name from sqlite_master where type='table'", tab_exists_callback, &te, &err); 
 	sqlite3_exec(db, "select name from sqlite_master where type='view'", tab_exists_callback, &tev, &err); 
     char query[]="Selecting names from sqlite_master";//for ERRCHECK.
@@ -178,12 +202,13 @@ APOP_VAR_END_HEAD
 #endif
     else {
         char *err, *query = "db close";//for errcheck.
-        if (vacuum==1 || vacuum=='v') {
+        if ((vacuum==1 || vacuum=='v') && sqlite_thread_db()) {
             sqlite3_exec(db, "VACUUM", NULL, NULL, &err);
             ERRCHECK
         }
-        sqlite3_close(db);
-    	//ERRCHECK
+        pthread_mutex_lock(&db_pool.lock);
+        sqlite_pool_close();
+        pthread_mutex_unlock(&db_pool.lock);
         db  = NULL;
     }
     return 0;
@@ -216,13 +241,13 @@ int apop_query(const char *fmt, ...){
     Fillin(query, fmt)
     if (apop_opts.db_engine == 'm')
 #ifdef HAVE_LIBMYSQLCLIENT
-        {Apop_assert_c(mysql_db, 1, 0, "No mySQL database is open.");
+        {Apop_assert_c(mysql_thread_db(), 1, 0, "No mySQL database is open.");
         apop_mysql_query(query);}
 #else
         Apop_assert_c(0, 1, 0, "Apophenia was compiled without mysql support.")
 #endif
     else 
-        {if (!db) apop_db_open(NULL);
+        {if (!sqlite_thread_db()) apop_db_open(NULL);
         sqlite3_exec(db, query, NULL,NULL, &err);
 	    ERRCHECK
         }
@@ -253,40 +278,61 @@ apop_data * apop_query_to_text(const char * fmt, ...){
     return out;
 }
 
+//Text: NULL, "NULL", and matches to apop_opts.db_nan are NaN; the rest goes through atof.
+static double db_text_cell(db_nan_t *n, char const *text){
+    return !text || !strcmp(text, "NULL") || !regexec(&n->regex, text, 0, NULL, 0)
+				     ? GSL_NAN : atof(text);
+}
+
+static void db_nan_init(db_nan_t *n){
+    char full_divider[103], *tail;
+    sprintf(full_divider, "^%s$", apop_opts.db_nan);
+    regcomp(&n->regex, full_divider, REG_EXTENDED+REG_ICASE+REG_NOSUB);
+    n->value = strtod(apop_opts.db_nan, &tail);
+    n->is_number = *apop_opts.db_nan && !*tail && !gsl_isnan(n->value);
+}
+
+//Numbers are fetched as numbers; text is checked against apop_opts.db_nan, then read via atof.
+static double db_cell(db_nan_t *n, sqlite3_stmt *stmt, int col){
+    int type = sqlite3_column_type(stmt, col);
+    if (type == SQLITE_INTEGER || type == SQLITE_FLOAT){
+        double out = sqlite3_column_double(stmt, col);
+        return (n->is_number && out == n->value) ? GSL_NAN : out;
+    }
+    if (type == SQLITE_NULL) return GSL_NAN;
+    return db_text_cell(n, (char const *)sqlite3_column_text(stmt, col));
+}
+
 //apop_query_to_data callback.
-static int db_to_table(void *qinfo, int argc, char **argv, char **column){
-    int i, ncfound = 0;
+static int db_to_table(void *qinfo, sqlite3_stmt *stmt){
+    int i, ncfound = 0, argc = sqlite3_column_count(stmt);
     callback_t *qi= qinfo;
     if (qi->firstcall){
         qi->firstcall--;
-        namecol = -1;
+        qi->namecol = -1;
         for(i=0; i<argc; i++)
-            if (!strcasecmp(column[i], apop_opts.db_name_column)){
-                namecol = i;
+            if (!strcasecmp(sqlite3_column_name(stmt, i), apop_opts.db_name_column)){
+                qi->namecol = i;
                 ncfound = 1;
                 break;
             }
 	    qi->outdata = argc-ncfound ? apop_data_alloc(1, argc-ncfound) : apop_data_alloc( );
+        qi->space = 1;
         for(i=0; i<argc; i++)
-            if (namecol != i)
-                apop_name_add(qi->outdata->names, column[i], 'c');
-    } else 
-        if (qi->outdata->matrix)
-            apop_matrix_realloc(qi->outdata->matrix, qi->currentrow+1, qi->outdata->matrix->size2);
-	if (argv !=NULL){
-        ncfound =0;
-		for (int jj=0;jj<argc;jj++)
-            if (jj != namecol){
-                double valor = 
-                    !argv[jj] || !strcmp(argv[jj], "NULL")|| !regexec(qi->regex, argv[jj], 1, qi->result, 0)
-				     ? GSL_NAN : atof(argv[jj]);
-                gsl_matrix_set(qi->outdata->matrix,qi->currentrow,jj-ncfound, valor);
-            } else {
-                apop_name_add(qi->outdata->names, argv[jj], 'r');
-                ncfound = 1;
-            }
-		(qi->currentrow)++;
-	}
+            if (qi->namecol != i)
+                apop_name_add(qi->outdata->names, sqlite3_column_name(stmt, i), 'c');
+    }
+    gsl_matrix *m = qi->outdata->matrix;
+    if (m && qi->currentrow == qi->space){ //out of room: double the space for rows.
+        qi->space *= 2;
+        apop_matrix_realloc(m, qi->space, m->size2);
+    }
+    for (int jj=0, col=0; jj<argc; jj++)
+        if (jj == qi->namecol)
+            apop_name_add(qi->outdata->names, (char const *)sqlite3_column_text(stmt, jj), 'r');
+        else if (m && col < m->size2)
+            gsl_matrix_set(m, qi->currentrow, col++, db_cell(&qi->nan, stmt, jj));
+    (qi->currentrow)++;
 	return 0;
 }
 
@@ -294,6 +340,9 @@ static int db_to_table(void *qinfo, int argc, char **argv, char **column){
 
 If \ref apop_opts_type "apop_opts.db_name_column" is set (it defaults to being "row_names"), and the name of a column matches the name, then the row names are read from that column.
 
+\li Numeric columns are read directly as doubles, with no round trip through text, so you get back exactly the number the database holds.
+\li \c NULL is read as \c NaN. So is any text matching \ref apop_opts_type "apop_opts.db_nan" (case-insensitive), and if \c apop_opts.db_nan is itself a number, like <tt>-999</tt>, then so is any numeric cell equal to it.
+
 \exception out->error=='q' Query error. A valid query that returns no rows is not an error; in that case, you get \c NULL.
 */ 
 apop_data * apop_query_to_data(const char * fmt, ...){
@@ -306,28 +355,19 @@ apop_data * apop_query_to_data(const char * fmt, ...){
 #endif
 
     //else
-    char *err=NULL;
-    char full_divider[103];
-    callback_t  qinfo = {.firstcall = 1,
-                       .regex = malloc(sizeof(regex_t))};
-	if (db==NULL) apop_db_open(NULL);
-    sprintf(full_divider, "^%s$", apop_opts.db_nan);
-    regcomp(qinfo.regex, full_divider, REG_EXTENDED+REG_ICASE+REG_NOSUB);
-    sqlite3_exec(db, query,db_to_table,&qinfo, &err); 
-    regfree(qinfo.regex);
-    free(qinfo.regex);
+    callback_t  qinfo = {.firstcall = 1};
+	if (!sqlite_thread_db()) apop_db_open(NULL);
+    db_nan_init(&qinfo.nan);
+    char *err = sqlite_step_all(query, db_to_table, &qinfo);
+    regfree(&qinfo.nan.regex);
+    if (qinfo.outdata && qinfo.outdata->matrix) //trim the doubled space down to size.
+        apop_matrix_realloc(qinfo.outdata->matrix, qinfo.currentrow, qinfo.outdata->matrix->size2);
+    Apop_stopif(err, if (!qinfo.outdata) qinfo.outdata = apop_data_alloc(); qinfo.outdata->error='q';
+            sqlite3_free(err); free(query); return qinfo.outdata, 0, "%s: %s", query, err);
     free (query);
-    ERRCHECK_SET_ERROR(qinfo.outdata)
 	return qinfo.outdata;
 }
 
-//These used to do more, but I'll leave them as a macro anyway in case of future expansion.
-#define Store_settings  \
-    int v = apop_opts.verbose; apop_opts.verbose=0;/*hack to prevent double-printing.*/ \
-
-#define Restore_settings  \
-    apop_opts.verbose=v;
-
 /** Queries the database, and dumps the result into a matrix.
 
   Uses \ref apop_query_to_data and returns just the matrix part; see that function for notes.
@@ -344,9 +384,7 @@ gsl_matrix * apop_query_to_matrix(const char * fmt, ...){
 #else
         Apop_assert_c(0, 0, 0, "Apophenia was compiled without mysql support.")
 #endif
-    Store_settings
     apop_data * outd = apop_query_to_data("%s", query);
-    Restore_settings
     gsl_matrix *outm = NULL;
     if (outd){
         outm = outd->matrix;
@@ -375,10 +413,8 @@ gsl_vector * apop_query_to_vector(const char * fmt, ...){
 #endif
     apop_data *d=NULL;
     gsl_vector *out;
-	if (db==NULL) apop_db_open(NULL);
-    Store_settings
+	if (!sqlite_thread_db()) apop_db_open(NULL);
 	d	= apop_query_to_data("%s", query);
-    Restore_settings
     Apop_assert_c(d, NULL, 2, "Query [%s] turned up a blank table. Returning NULL.", query);
     //else:
     out = gsl_vector_alloc(d->matrix->size1);
@@ -407,10 +443,8 @@ double apop_query_to_float(const char * fmt, ...){
 #endif
     } else {
         apop_data *d=NULL;
-        if (db==NULL) apop_db_open(NULL);
-        Store_settings
+        if (!sqlite_thread_db()) apop_db_open(NULL);
         d = apop_query_to_data("%s", query);
-        Restore_settings
         Apop_assert_c(d, GSL_NAN, 2, "Query [%s] turned up a blank table. Returning NaN.", query);
         out	= apop_data_get(d, 0, 0);
         apop_data_free(d);
@@ -454,6 +488,561 @@ apop_data * apop_query_to_mixed_data(const char *typelist, const char * fmt, ...
     return out;
 }
 
+/* Cursors.
+
+   The cursor's state keeps the prepared statement (SQLite) or unbuffered result set
+   (MySQL) open between calls, plus a type for each column of output. The apop_data
+   block is allocated once, when the cursor is opened, and each call to
+   apop_query_cursor_next overwrites it with the next rows. */
+
+struct apop_cursor_state {
+    char         *types;    //one of nvmtw for each column of output.
+    int          colct, block_size, done;
+    int          use_nan;   //no typelist, so follow apop_query_to_data's rules for NaNs.
+    db_nan_t     nan;
+    sqlite3_stmt *stmt;
+#ifdef HAVE_LIBMYSQLCLIENT
+    MYSQL_RES    *res;
+    MYSQL_ROW    row;
+#endif
+};
+
+//Step to the next row; return 1 if there is one. On error, set cursor->error and return 0.
+static int cursor_step(apop_query_cursor *cursor){
+    struct apop_cursor_state *s = cursor->state;
+#ifdef HAVE_LIBMYSQLCLIENT
+    if (s->res){
+        s->row = mysql_fetch_row(s->res);
+        Apop_stopif(!s->row && mysql_errno(mysql_db), cursor->error='q', 0, 
+                "mysql_fetch_row() failed: %s", mysql_error(mysql_db));
+        return !!s->row;
+    }
+#endif
+    int rc = sqlite3_step(s->stmt);
+    Apop_stopif(rc != SQLITE_ROW && rc != SQLITE_DONE, cursor->error='q', 0, "%s", sqlite3_errmsg(db));
+    return rc == SQLITE_ROW;
+}
+
+static char const *cursor_colname(struct apop_cursor_state *s, int col){
+#ifdef HAVE_LIBMYSQLCLIENT
+    if (s->res) return mysql_fetch_fields(s->res)[col].name;
+#endif
+    return sqlite3_column_name(s->stmt, col);
+}
+
+static char const *cursor_text(struct apop_cursor_state *s, int col){
+#ifdef HAVE_LIBMYSQLCLIENT
+    if (s->res) return s->row[col];
+#endif
+    return (char const *)sqlite3_column_text(s->stmt, col);
+}
+
+static double cursor_double(struct apop_cursor_state *s, int col){
+#ifdef HAVE_LIBMYSQLCLIENT
+    if (s->res) return s->use_nan ? db_text_cell(&s->nan, s->row[col])
+                                  : s->row[col] ? atof(s->row[col]) : GSL_NAN;
+#endif
+    return s->use_nan ? db_cell(&s->nan, s->stmt, col) : column_to_double(s->stmt, col);
+}
+
+//Set s->types from the typelist, or if there's none, as apop_query_to_data would.
+static int cursor_types(struct apop_cursor_state *s, char const *typelist){
+    s->types = calloc(s->colct+1, 1);
+    if (!typelist){
+        int namecol_found = 0;
+        for (int i=0; i< s->colct; i++)
+            s->types[i] = (!namecol_found && !strcasecmp(cursor_colname(s, i), apop_opts.db_name_column)
+                                && ++namecol_found) ? 'n' : 'm';
+        return 0;
+    }
+    Apop_stopif(strlen(typelist) != s->colct, return 1, 0, "you asked for %zu columns in your list of "
+            "types (%s), but your query produced %i columns.", strlen(typelist), typelist, s->colct);
+    for (int i=0; i< s->colct; i++){
+        s->types[i] = tolower(typelist[i]);
+        Apop_stopif(!strchr("nvmtw", s->types[i]), return 1, 0, "The list of types should be "
+                "made of the letters nvmtw; I don't know what to do with '%c'.", typelist[i]);
+    }
+    return 0;
+}
+
+static apop_data *cursor_block(struct apop_cursor_state *s){
+    int vct = !!strchr(s->types, 'v'), wct = !!strchr(s->types, 'w'), mct = 0, tct = 0;
+    for (int i=0; i< s->colct; i++){
+        mct += s->types[i] == 'm';
+        tct += s->types[i] == 't';
+    }
+    apop_data *out = apop_data_alloc(vct ? s->block_size : 0, mct ? s->block_size : 0, mct);
+    if (out->arena){ //we rewrite the text for every block, so an arena would only grow.
+        apop_arena_release(out->names->arena);
+        apop_arena_release(out->arena);
+        out->names->arena = out->arena = NULL;
+    }
+    if (tct) apop_text_alloc(out, s->block_size, tct);
+    if (wct) out->weights = gsl_vector_alloc(s->block_size);
+    for (int i=0; i< s->colct; i++){
+        char type = s->types[i];
+        apop_name_add(out->names, cursor_colname(s, i), type=='n' ? 'h' : type=='m' ? 'c' : type);
+    }
+    return out;
+}
+
+/** Open a cursor over the output of a query, to read it a block of rows at a time.
+
+The other \c apop_query_to_... functions read the entire output of the query into memory
+before returning. For a table that doesn't fit in memory, open a cursor, and then use \ref
+apop_query_cursor_next to read the output a block of rows at a time, or use \ref
+apop_query_cursor_map_sum, \ref apop_query_cursor_moments, \ref
+apop_query_cursor_percentiles, or \ref apop_query_cursor_log_likelihood to run through all
+the blocks for you.
+
+\code
+apop_query_cursor *c = apop_query_cursor_open(NULL, 10000, "select * from %s", tabname);
+for (apop_data *block; (block = apop_query_cursor_next(c)); )
+    running_total += apop_matrix_sum(block->matrix);
+Apop_stopif(c->error, ..., 0, "The query failed partway through.");
+apop_query_cursor_free(c);
+\endcode
+
+\param typelist As with \ref apop_query_to_mixed_data, a string of the letters \c nvmtw, one for
+each column of the query's output, indicating whether the column is a name, vector, matrix
+column, text column, or weight vector. If \c NULL, then the columns are read as by \ref
+apop_query_to_data: the column named \ref apop_opts_type "apop_opts.db_name_column" holds the
+row names, the rest are matrix columns, and text matching \ref apop_opts_type "apop_opts.db_nan" is NaN.
+\param block_size The number of rows in each block.
+\param fmt The query, in <tt>printf</tt> form, followed by any arguments to fill it in.
+
+\return A cursor, to be freed via \ref apop_query_cursor_free when you are done. If
+the query fails outright, or the \c typelist doesn't match the query's output, return \c NULL.
+
+\li The query is one SQL statement.
+\li SQLite: it's OK to run other queries while the cursor is open, but if they modify
+the table being read, the results are up to SQLite.
+\li MySQL: rows are fetched from the server as the cursor asks for them, so
+there can't be any other queries until the cursor is freed.
+*/
+apop_query_cursor * apop_query_cursor_open(const char *typelist, int block_size, const char * fmt, ...){
+    Fillin(query, fmt)
+    Apop_stopif(block_size < 1, free(query); return NULL, 0, "block_size should be at least one; I got %i.", block_size);
+    apop_query_cursor *out = malloc(sizeof(apop_query_cursor));
+    struct apop_cursor_state *s = calloc(1, sizeof(struct apop_cursor_state));
+    *out = (apop_query_cursor){.state = s};
+    s->block_size = block_size;
+    if ((s->use_nan = !typelist)) db_nan_init(&s->nan);
+    if (apop_opts.db_engine == 'm'){
+#ifdef HAVE_LIBMYSQLCLIENT
+        Apop_stopif(!mysql_thread_db() || mysql_query(mysql_db, query)
+                        || !(s->res = mysql_use_result(mysql_db)),
+                apop_query_cursor_free(out); free(query); return NULL,
+                0, "%s: %s", query, mysql_db ? mysql_error(mysql_db) : "no database is open");
+        s->colct = mysql_num_fields(s->res);
+#else
+        Apop_stopif(1, apop_query_cursor_free(out); free(query); return NULL,
+                0, "Apophenia was compiled without mysql support.");
+#endif
+    } else {
+        if (!sqlite_thread_db()) apop_db_open(NULL);
+        int rc = sqlite3_prepare_v2(db, query, -1, &s->stmt, NULL);
+        Apop_stopif(rc != SQLITE_OK || !s->stmt, apop_query_cursor_free(out); free(query); return NULL,
+                0, "%s: %s", query, rc != SQLITE_OK ? sqlite3_errmsg(db) : "no SQL statement");
+        s->colct = sqlite3_column_count(s->stmt);
+    }
+    free(query);
+    Apop_stopif(cursor_types(s, typelist), apop_query_cursor_free(out); return NULL, 0, "dimension error");
+    out->block = cursor_block(s);
+    Apop_stopif(out->block->error, apop_query_cursor_free(out); return NULL, 0, "allocation error");
+    return out;
+}
+
+/** Read the next block of rows from a cursor opened via \ref apop_query_cursor_open.
+
+\return The cursor's block, filled with up to \c block_size rows. The last block is
+shorter. After the last block, return \c NULL.
+
+\li The block belongs to the cursor and is overwritten on the next call, so don't free
+it, and copy anything you want to keep (e.g., via \ref apop_data_copy).
+\li If the database reports an error partway through, I return what was read before the
+error (or \c NULL) and set <tt>cursor->error='q'</tt>.
+*/
+apop_data * apop_query_cursor_next(apop_query_cursor *cursor){
+    if (!cursor || cursor->state->done) return NULL;
+    struct apop_cursor_state *s = cursor->state;
+    apop_data *b = cursor->block;
+    for (int i=0; i< b->names->rowct; i++)
+        free(b->names->row[i]);
+    b->names->rowct = 0;
+
+    size_t r = 0;
+    for ( ; r < s->block_size && cursor_step(cursor); r++){
+        for (int i=0, mcol=0, tcol=0; i< s->colct; i++){
+            char type = s->types[i];
+            if (type == 'n'){
+                char const *name = cursor_text(s, i);
+                apop_name_add(b->names, name ? name : "NaN", 'r');
+            } else if (type == 'v')
+                gsl_vector_set(b->vector, r, cursor_double(s, i));
+            else if (type == 'm')
+                gsl_matrix_set(b->matrix, r, mcol++, cursor_double(s, i));
+            else if (type == 't'){
+                char const *text = cursor_text(s, i);
+                free(b->text[r][tcol]);
+                b->text[r][tcol++] = strdup(text ? text : "NaN");
+            } else if (type == 'w')
+                gsl_vector_set(b->weights, r, cursor_double(s, i));
+        }
+    }
+    cursor->rows += r;
+    if (r < s->block_size){ //the end of the output (or an error).
+        s->done = 1;
+        if (!r) return NULL;
+        if (b->matrix)  apop_matrix_realloc(b->matrix, r, b->matrix->size2);
+        if (b->vector)  apop_vector_realloc(b->vector, r);
+        if (b->weights) apop_vector_realloc(b->weights, r);
+        if (b->textsize[1]) apop_text_alloc(b, r, b->textsize[1]);
+    }
+    return b;
+}
+
+/** Free a cursor opened via \ref apop_query_cursor_open, including its block of data.
+If \c NULL, do nothing.  */
+void apop_query_cursor_free(apop_query_cursor *cursor){
+    if (!cursor) return;
+    struct apop_cursor_state *s = cursor->state;
+    if (s->stmt) sqlite3_finalize(s->stmt);
+#ifdef HAVE_LIBMYSQLCLIENT
+    if (s->res) mysql_free_result(s->res);
+#endif
+    if (s->use_nan) regfree(&s->nan.regex);
+    free(s->types);
+    free(s);
+    apop_data_free(cursor->block);
+    free(cursor);
+}
+
+typedef double apop_fn_d(double);
+typedef double apop_fn_v(gsl_vector*);
+typedef double apop_fn_r(apop_data*);
+typedef double apop_fn_dp(double, void *);
+typedef double apop_fn_vp(gsl_vector*, void *);
+typedef double apop_fn_rp(apop_data*, void *);
+
+/** Run \ref apop_map_sum over every remaining block of a cursor, and return the total.
+
+For example, this sums the log of every element of a table too big to read into memory at once:
+\code
+apop_query_cursor *c = apop_query_cursor_open(NULL, 10000, "select * from bigtab");
+double total = apop_query_cursor_map_sum(c, .fn_d=log);
+apop_query_cursor_free(c);
+\endcode
+
+\param cursor A cursor from \ref apop_query_cursor_open.
+\param fn_d, fn_v, fn_r, fn_dp, fn_vp, fn_rp, param, part As for \ref apop_map_sum.
+
+\li Each block is mapped separately, so use element-by-element or row-by-row functions;
+a function of a whole column (<tt>.part='c'</tt>) would be applied to each block's piece of
+the column in turn.
+\li This function uses the \ref designated syntax for inputs.
+*/
+APOP_VAR_HEAD double apop_query_cursor_map_sum(apop_query_cursor *cursor, apop_fn_d *fn_d, apop_fn_v *fn_v, apop_fn_r *fn_r, apop_fn_dp *fn_dp, apop_fn_vp *fn_vp, apop_fn_rp *fn_rp, void *param, char part){
+    apop_query_cursor * apop_varad_var(cursor, NULL)
+    apop_fn_d * apop_varad_var(fn_d, NULL)
+    apop_fn_v * apop_varad_var(fn_v, NULL)
+    apop_fn_r * apop_varad_var(fn_r, NULL)
+    apop_fn_dp * apop_varad_var(fn_dp, NULL)
+    apop_fn_vp * apop_varad_var(fn_vp, NULL)
+    apop_fn_rp * apop_varad_var(fn_rp, NULL)
+    void * apop_varad_var(param, NULL)
+    char apop_varad_var(part, ((fn_v||fn_vp) ? 'r' : 'a'));
+APOP_VAR_ENDHEAD 
+    double total = 0;
+    for (apop_data *b; (b = apop_query_cursor_next(cursor)); )
+        total += apop_map_sum(b, .fn_d=fn_d, .fn_v=fn_v, .fn_r=fn_r, .fn_dp=fn_dp,
+                                 .fn_vp=fn_vp, .fn_rp=fn_rp, .param=param, .part=part);
+    return total;
+}
+
+/** The log likelihood of all the remaining rows of a cursor, given a parameterized model:
+the sum of \ref apop_log_likelihood over each block.
+
+\param cursor A cursor from \ref apop_query_cursor_open.
+\param m A parameterized model.
+*/
+double apop_query_cursor_log_likelihood(apop_query_cursor *cursor, apop_model *m){
+    double total = 0;
+    for (apop_data *b; (b = apop_query_cursor_next(cursor)); )
+        total += apop_log_likelihood(b, m);
+    return total;
+}
+
+/** The count, mean, and variance of each numeric column of the remaining rows of a cursor,
+in one pass through the data. Each block's statistics are merged into the running totals
+via the formulæ of Chan, Golub, and LeVeque, so there's no loss of precision from
+accumulating sums of squares.
+
+\param cursor A cursor from \ref apop_query_cursor_open.
+\return An \ref apop_data set with one row for the vector (if any) and each matrix column,
+named after the columns, and three columns: <tt>count</tt>, <tt>mean</tt>, and
+<tt>variance</tt>. NaNs are left out of all three, and the variance is the sample
+variance (dividing by count minus one). If there are no rows, return \c NULL.
+*/
+apop_data * apop_query_cursor_moments(apop_query_cursor *cursor){
+    apop_data *out = NULL, *b;
+    while ((b = apop_query_cursor_next(cursor))){
+        int vct = !!b->vector, colct = vct + (b->matrix ? b->matrix->size2 : 0);
+        if (!out){
+            if (!colct) return NULL;
+            out = apop_data_calloc(colct, 3);
+            apop_name_add(out->names, "count", 'c');
+            apop_name_add(out->names, "mean", 'c');
+            apop_name_add(out->names, "variance", 'c'); //M2, the sum of squared deviations, until the end.
+            if (vct) apop_name_add(out->names, b->names->vector ? b->names->vector : "vector", 'r');
+            for (int j=vct; j< colct; j++)
+                apop_name_add(out->names, j-vct < b->names->colct ? b->names->column[j-vct] : "", 'r');
+        }
+        for (int j=0; j< colct; j++){
+            gsl_vector_view colview;
+            gsl_vector *col = (vct && !j) ? b->vector
+                        : (colview = gsl_matrix_column(b->matrix, j-vct), &colview.vector);
+            double n = 0, mean = 0, m2 = 0;
+            for (size_t i=0; i< col->size; i++){
+                double x = gsl_vector_get(col, i);
+                if (gsl_isnan(x)) continue;
+                double delta = x - mean;
+                mean += delta/++n;
+                m2 += delta*(x - mean);
+            }
+            if (!n) continue;
+            double *nn = gsl_matrix_ptr(out->matrix, j, 0), *mm = nn+1, *mm2 = nn+2;
+            double delta = mean - *mm, total = *nn + n;
+            *mm  += delta * n/total;
+            *mm2 += m2 + delta*delta * *nn * n/total;
+            *nn   = total;
+        }
+    }
+    if (out)
+        for (int j=0; j< out->matrix->size1; j++){
+            double n = gsl_matrix_get(out->matrix, j, 0);
+            gsl_matrix_set(out->matrix, j, 2, n > 1 ? gsl_matrix_get(out->matrix, j, 2)/(n-1) : GSL_NAN);
+            if (!n) gsl_matrix_set(out->matrix, j, 1, GSL_NAN);
+        }
+    return out;
+}
+
+/** Estimated percentiles of each numeric column of the remaining rows of a cursor, via
+one \ref apop_sketch per column, so memory use stays fixed however many rows there are.
+
+\param cursor A cursor from \ref apop_query_cursor_open.
+\param rounding 'u', 'd', or 'a', as per \ref apop_vector_percentiles. (Default = 'd'.)
+\param k The accuracy setting for the sketches; see \ref apop_sketch_alloc. (Default = 200.)
+\return An \ref apop_data set with one row for the vector (if any) and each matrix column,
+named after the columns, and 101 columns, named \c 0 through \c 100. So each row of the
+matrix is the 101-element array that \ref apop_vector_percentiles or \ref
+apop_sketch_percentiles would give for that column. NaNs are skipped; a column with no
+numbers gets a row of NaNs. If there are no rows, return \c NULL.
+\exception out->error='a' Allocation error.
+\li This function uses the \ref designated syntax for inputs.
+*/
+APOP_VAR_HEAD apop_data * apop_query_cursor_percentiles(apop_query_cursor *cursor, char rounding, int k){
+    apop_query_cursor * apop_varad_var(cursor, NULL);
+    Apop_stopif(!cursor, return NULL, 0, "NULL cursor.");
+    char apop_varad_var(rounding, 'd');
+    int apop_varad_var(k, 200);
+APOP_VAR_ENDHEAD
+    apop_data *out = NULL, *b;
+    apop_sketch **sketches = NULL;
+    int colct = 0;
+    char error = 0;
+    while ((b = apop_query_cursor_next(cursor))){
+        int vct = !!b->vector;
+        if (!out){
+            colct = vct + (b->matrix ? b->matrix->size2 : 0);
+            if (!colct) return NULL;
+            out = apop_data_alloc(colct, 101);
+            sketches = malloc(sizeof(apop_sketch*)*colct);
+            Apop_stopif(!sketches, out->error='a'; return out, 0, "Allocation error.");
+            for (int j=0; j< colct; j++)
+                if (!(sketches[j] = apop_sketch_alloc(k))) error = 'a';
+            char pct[4];
+            for (int i=0; i< 101; i++){
+                sprintf(pct, "%i", i);
+                apop_name_add(out->names, pct, 'c');
+            }
+            if (vct) apop_name_add(out->names, b->names->vector ? b->names->vector : "vector", 'r');
+            for (int j=vct; j< colct; j++)
+                apop_name_add(out->names, j-vct < b->names->colct ? b->names->column[j-vct] : "", 'r');
+        }
+        for (int j=0; j< colct && !error; j++){
+            gsl_vector_view colview;
+            gsl_vector *col = (vct && !j) ? b->vector
+                        : (colview = gsl_matrix_column(b->matrix, j-vct), &colview.vector);
+            if (apop_sketch_add_vector(sketches[j], col)) error = 'a';
+        }
+    }
+    for (int j=0; out && j< colct; j++){
+        double *pctiles = error ? NULL : apop_sketch_percentiles(sketches[j], rounding);
+        if (!pctiles) error = 'a';
+        else {
+            memcpy(gsl_matrix_ptr(out->matrix, j, 0), pctiles, sizeof(double)*101);
+            free(pctiles);
+        }
+        apop_sketch_free(sketches[j]);
+    }
+    free(sketches);
+    if (error) out->error = error;
+    return out;
+}
+
+/* Bind the variadic arguments to the statement's ? slots, as directed by the typelist.
+   On error, return a message (sqlite3_free it). */
+static char *bind_params(sqlite3_stmt *stmt, char const *types, va_list ap){
+    int ct = types ? strlen(types) : 0;
+    if (ct != sqlite3_bind_parameter_count(stmt))
+        return sqlite3_mprintf("the list of parameter types (%s) has %i elements, but the query "
+                    "has %i slots for parameters.", types ? types : "", ct, sqlite3_bind_parameter_count(stmt));
+    for (int i=0; i< ct; i++){
+        int rc;
+        if (types[i] == 'd')      rc = sqlite3_bind_double(stmt, i+1, va_arg(ap, double));
+        else if (types[i] == 'i') rc = sqlite3_bind_int64(stmt, i+1, va_arg(ap, int));
+        else if (types[i] == 'l') rc = sqlite3_bind_int64(stmt, i+1, va_arg(ap, long));
+        else if (types[i] == 't') rc = sqlite3_bind_text(stmt, i+1, va_arg(ap, char*), -1, SQLITE_TRANSIENT);
+        else if (types[i] == 'n') rc = sqlite3_bind_null(stmt, i+1);
+        else return sqlite3_mprintf("The list of parameter types should be made of the letters "
+                                    "dilnt; I don't know what to do with '%c'.", types[i]);
+        if (rc != SQLITE_OK) return sqlite3_mprintf("%s", sqlite3_errmsg(db));
+    }
+    return NULL;
+}
+
+/* The core of the apop_query_bound family: fetch the statement, bind, and read the output
+   into an apop_data set via db_to_table (or just run it, if want_data is zero). */
+static apop_data *bound_query(int want_data, char *error, char const *types, char const *query, va_list ap){
+    *error = 0;
+    if (apop_opts.db_engine == 'm'){
+#ifdef HAVE_LIBMYSQLCLIENT
+        return mysql_bound_query(want_data, error, types, query, ap);
+#else
+        Apop_stopif(1, *error='q'; return NULL, 0, "Apophenia was compiled without mysql support.");
+#endif
+    }
+    if (!sqlite_thread_db()) apop_db_open(NULL);
+    char *err = NULL;
+    callback_t qinfo = {.firstcall = 1};
+    sqlite3_stmt *stmt = cached_statement(query, &err);
+    if (stmt && !(err = bind_params(stmt, types, ap))){
+        if (want_data) db_nan_init(&qinfo.nan);
+        err = sqlite_step(stmt, want_data ? db_to_table : NULL, &qinfo);
+        if (want_data) regfree(&qinfo.nan.regex);
+    }
+    if (stmt){ //release the statement's locks, and any text bound to it.
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+    }
+    if (qinfo.outdata && qinfo.outdata->matrix)
+        apop_matrix_realloc(qinfo.outdata->matrix, qinfo.currentrow, qinfo.outdata->matrix->size2);
+    Apop_stopif(err, if (want_data && !qinfo.outdata) qinfo.outdata = apop_data_alloc();
+                     if (qinfo.outdata) qinfo.outdata->error='q'; *error='q';
+                     sqlite3_free(err); return qinfo.outdata, 0, "%s: %s", query, err);
+    return qinfo.outdata;
+}
+
+/** Send a query with <tt>?</tt> placeholders, and a list of values to fill them in.
+
+\code
+for (int i=0; i< 5000; i++)
+    apop_query_bound("dt", "insert into results values(?, ?)", gsl_vector_get(v, i), labels[i]);
+
+double mean = apop_query_bound_to_float("t", "select avg(income) from people where state = ?", "Alaska");
+\endcode
+
+Where \ref apop_query and its friends print the query to a string, and the database
+then parses and plans the statement anew every time, these functions keep each thread's
+32 most recently used queries prepared, so sending the same query thousands of times
+(with different values) parses it once. The values are handed to the database as
+numbers or text, so there's no round trip of numbers through text, and no need to escape
+quote marks in text.
+
+\param types A string with one letter for each <tt>?</tt> in the query, giving the type of
+the value to fill in, which follows in the list of arguments: \c d for a \c double, \c i
+for an \c int, \c l for a \c long, \c t for text (a <tt>char*</tt>), or \c n for SQL
+<tt>NULL</tt> (which takes no argument).
+\param query The query, which has to be a single SQL statement. It isn't a <tt>printf</tt>-style format.
+\return 0 on success, 1 on failure.
+
+\li The family: \ref apop_query_bound, \ref apop_query_bound_to_data, \ref
+apop_query_bound_to_matrix, \ref apop_query_bound_to_vector, and \ref
+apop_query_bound_to_float. They return their output in the same form as \ref apop_query,
+\ref apop_query_to_data, and so on.
+\li MySQL: as with SQLite, each thread keeps its statements prepared on the server. As
+with \ref apop_query_to_data on MySQL, every column of the output is read into the matrix.
+*/
+int apop_query_bound(char const *types, char const *query, ...){
+    char error;
+    va_list ap;
+    va_start(ap, query);
+    bound_query(0, &error, types, query, ap);
+    va_end(ap);
+    return !!error;
+}
+
+/** Like \ref apop_query_to_data, but with <tt>?</tt> placeholders in the query filled in by the values in the list. See \ref apop_query_bound for details.
+
+\exception out->error=='q' Query error.
+*/
+apop_data * apop_query_bound_to_data(char const *types, char const *query, ...){
+    char error;
+    va_list ap;
+    va_start(ap, query);
+    apop_data *out = bound_query(1, &error, types, query, ap);
+    va_end(ap);
+    return out;
+}
+
+/** Like \ref apop_query_to_matrix, but with <tt>?</tt> placeholders in the query filled in by the values in the list. See \ref apop_query_bound for details. */
+gsl_matrix * apop_query_bound_to_matrix(char const *types, char const *query, ...){
+    char error;
+    va_list ap;
+    va_start(ap, query);
+    apop_data *d = bound_query(1, &error, types, query, ap);
+    va_end(ap);
+    gsl_matrix *out = NULL;
+    if (d && !error){
+        out = d->matrix;
+        d->matrix = NULL;
+    }
+    apop_data_free(d);
+    return out;
+}
+
+/** Like \ref apop_query_to_vector, but with <tt>?</tt> placeholders in the query filled in by the values in the list. See \ref apop_query_bound for details. */
+gsl_vector * apop_query_bound_to_vector(char const *types, char const *query, ...){
+    char error;
+    va_list ap;
+    va_start(ap, query);
+    apop_data *d = bound_query(1, &error, types, query, ap);
+    va_end(ap);
+    gsl_vector *out = NULL;
+    if (d && !error && d->matrix && d->matrix->size2){
+        out = gsl_vector_alloc(d->matrix->size1);
+        gsl_matrix_get_col(out, d->matrix, 0);
+    }
+    apop_data_free(d);
+    return out;
+}
+
+/** Like \ref apop_query_to_float, but with <tt>?</tt> placeholders in the query filled in by the values in the list. See \ref apop_query_bound for details.
+
+\return The first number in the output, or \c NaN if there are no rows or the query fails.
+*/
+double apop_query_bound_to_float(char const *types, char const *query, ...){
+    char error;
+    va_list ap;
+    va_start(ap, query);
+    apop_data *d = bound_query(1, &error, types, query, ap);
+    va_end(ap);
+    double out = (d && !error && d->matrix) ? apop_data_get(d, 0, 0) : GSL_NAN;
+    apop_data_free(d);
+    return out;
+}
+
 /** \} end query group. */
 
 /* Convenience function for extending a string. 
@@ -469,18 +1058,187 @@ void qxprintf(char **q, char *format, ...){
     free(r);
 }
 
-static void add_a_number (char **q, char *comma, double v){
-    if (gsl_isnan(v))
-        qxprintf(q,"%s%c NULL ", *q, *comma);
-    else if (isinf(v)==1)
-        qxprintf(q,"%s%c  'inf'", *q, *comma);
-    else if (isinf(v)==-1)
-        qxprintf(q,"%s%c  '-inf' ", *q, *comma);
-    else
-        qxprintf(q,"%s%c %g ",*q ,*comma, v);
+/* A string that grows by doubling, so a long query can be built up in linear time,
+   where qxprintf re-copies the whole query on every call. */
+typedef struct {
+    char *s;
+    size_t len, size;
+} growing_string;
+
+static void gs_printf(growing_string *g, char const *format, ...){
+    va_list ap;
+    va_start(ap, format);
+    int n = vsnprintf(NULL, 0, format, ap);
+    va_end(ap);
+    if (g->len + n + 1 > g->size){
+        g->size = GSL_MAX(2*g->size, g->len + n + 1000);
+        g->s = realloc(g->s, g->size);
+    }
+    va_start(ap, format);
+    vsnprintf(g->s + g->len, g->size - g->len, format, ap);
+    va_end(ap);
+    g->len += n;
+}
+
+//Vectors and text may be shorter than the longest part of the data set; pad with NaNs/blanks.
+static double get_or_nan(gsl_vector const *v, size_t i){ return i < v->size ? gsl_vector_get(v, i) : GSL_NAN; }
+
+static char const *text_or_blank(apop_data const *set, size_t i, int j){
+    return i < set->textsize[0] && set->text[i][j] ? set->text[i][j] : "";
+}
+
+static void add_a_number(growing_string *q, char *comma, double v){
+    if (gsl_isnan(v))  gs_printf(q, "%c NULL", *comma);
+    else if (isinf(v)) gs_printf(q, "%c %s9e9999999", *comma, v < 0 ? "-" : "");
+    else               gs_printf(q, "%c %.17g", *comma, v);
+    *comma = ',';
+}
+
+static void add_a_string(growing_string *q, char *comma, char const *in){
+    char *fixed = prep_string_for_sqlite(0, in);
+    gs_printf(q, "%c %s", *comma, fixed ? fixed : "''");
+    free(fixed);
     *comma = ',';
 }
 
+static void bind_a_number(sqlite3_stmt *stmt, int *col, double v){
+    if (gsl_isnan(v)) sqlite3_bind_null(stmt, (*col)++);
+    else              sqlite3_bind_double(stmt, (*col)++, v);
+}
+
+/* Text that reads as a number goes in as a number, as it would have if pasted unquoted
+   into an insert query (see prep_string_for_sqlite); blanks and apop_opts.db_nan go in as ''. */
+static void bind_a_string(sqlite3_stmt *stmt, int *col, char const *in){
+    char *tail;
+    if (!in || !*in || !strcasecmp(apop_opts.db_nan, in))
+        sqlite3_bind_text(stmt, *col, "", 0, SQLITE_STATIC);
+    else {
+        errno = 0;
+        long long i = strtoll(in, &tail, 10);
+        if (!*tail && !errno) sqlite3_bind_int64(stmt, *col, i);
+        else {
+            double d = strtod(in, &tail);
+            if (*tail)           sqlite3_bind_text(stmt, *col, in, -1, SQLITE_STATIC);
+            else if (isnan(d))   sqlite3_bind_null(stmt, *col);
+            else                 sqlite3_bind_double(stmt, *col, d);
+        }
+    }
+    (*col)++;
+}
+
+static void create_data_table(const apop_data *set, const char *tabname, int use_row){
+    int mysql = apop_opts.db_engine == 'm';
+    char const *numtype = mysql ? "double" : "numeric",
+               *texttype = mysql ? "varchar(1000)" : "",
+               *quote = mysql ? "`" : "\"";
+    char comma = ' ', *name;
+    growing_string q = { };
+    gs_printf(&q, "create table %s (", tabname);
+    if (use_row){
+        gs_printf(&q, "\n %s %s", apop_opts.db_name_column, texttype);
+        comma = ',';
+    }
+    if (set->vector){
+        if (!set->names->vector) gs_printf(&q, "%c\n vector %s", comma, numtype);
+        else {
+            gs_printf(&q, "%c\n %s%s%s %s", comma, quote, (name=apop_strip_dots(set->names->vector,'d')), quote, numtype);
+            free(name);
+        }
+        comma = ',';
+    }
+    if (set->matrix)
+        for (int i=0; i< set->matrix->size2; i++){
+            if (set->names->colct <= i) gs_printf(&q, "%c\n c%i %s", comma, i, numtype);
+            else {
+                gs_printf(&q, "%c\n %s%s%s %s", comma, quote, (name=apop_strip_dots(set->names->column[i],'d')), quote, numtype);
+                free(name);
+            }
+            comma = ',';
+        }
+    for (int i=0; i< set->textsize[1]; i++){
+        if (set->names->textct <= i) gs_printf(&q, "%c\n tc%i %s", comma, i, texttype);
+        else {
+            gs_printf(&q, "%c\n %s%s%s %s", comma, quote, (name=apop_strip_dots(set->names->text[i],'d')), quote, texttype);
+            free(name);
+        }
+        comma = ',';
+    }
+    if (set->weights)
+        gs_printf(&q, "%c\n %sweights%s %s", comma, quote, quote, numtype);
+    apop_query("%s);", q.s);
+    free(q.s);
+}
+
+//The SQLite route: one prepared statement, with values bound in place.
+static void data_to_db_prepared(const apop_data *set, const char *tabname, int use_row, int colct, size_t rows){
+    growing_string q = { };
+    sqlite3_stmt *stmt;
+    gs_printf(&q, "insert into %s values (?", tabname);
+    for (int i=1; i< colct; i++)
+        gs_printf(&q, ", ?");
+    gs_printf(&q, ")");
+    Apop_stopif(sqlite3_prepare_v2(db, q.s, -1, &stmt, NULL) != SQLITE_OK, free(q.s); return,
+            0, "%s: %s", q.s, sqlite3_errmsg(db));
+    free(q.s);
+    int batch_size = GSL_MAX(apop_opts.db_batch_size, 1);
+    apop_query("begin;");
+    for (size_t i=0; i< rows; i++){
+        int col = 1;
+        if (use_row)
+            bind_a_string(stmt, &col, i < set->names->rowct ? set->names->row[i] : NULL);
+        if (set->vector)
+            bind_a_number(stmt, &col, get_or_nan(set->vector, i));
+        if (set->matrix)
+            for (int j=0; j< set->matrix->size2; j++)
+                bind_a_number(stmt, &col, i < set->matrix->size1 ? gsl_matrix_get(set->matrix, i, j) : GSL_NAN);
+        for (int j=0; j< set->textsize[1]; j++)
+            bind_a_string(stmt, &col, text_or_blank(set, i, j));
+        if (set->weights)
+            bind_a_number(stmt, &col, get_or_nan(set->weights, i));
+        int err = sqlite3_step(stmt);
+        Apop_stopif(err != SQLITE_DONE, break, 0, "inserting row %zu into %s: %s", i, tabname, sqlite3_errmsg(db));
+        sqlite3_reset(stmt);
+        if (!((i+1) % batch_size) && i+1 < rows)
+            apop_query("commit; begin;");
+    }
+    apop_query("commit;");
+    sqlite3_finalize(stmt);
+}
+
+/* The MySQL route, also used for tables too wide for a prepared statement: text queries,
+   each holding as many rows as fit in about a megabyte. SQLite gets one row per insert
+   (older versions don't take multi-row inserts) and transactions as above. */
+static void data_to_db_text(const apop_data *set, const char *tabname, int use_row, size_t rows){
+    int mysql = apop_opts.db_engine == 'm';
+    int batch_size = GSL_MAX(apop_opts.db_batch_size, 1);
+    growing_string q = { };
+    if (!mysql) apop_query("begin;");
+    for (size_t i=0; i< rows; i++){
+        char comma = ' ';
+        gs_printf(&q, q.len ? ",\n(" : "insert into %s values (", tabname);
+        if (use_row)
+            add_a_string(&q, &comma, i < set->names->rowct ? set->names->row[i] : NULL);
+        if (set->vector)
+            add_a_number(&q, &comma, get_or_nan(set->vector, i));
+        if (set->matrix)
+            for (int j=0; j< set->matrix->size2; j++)
+                add_a_number(&q, &comma, i < set->matrix->size1 ? gsl_matrix_get(set->matrix, i, j) : GSL_NAN);
+        for (int j=0; j< set->textsize[1]; j++)
+            add_a_string(&q, &comma, text_or_blank(set, i, j));
+        if (set->weights)
+            add_a_number(&q, &comma, get_or_nan(set->weights, i));
+        gs_printf(&q, ")");
+        if (!mysql || q.len > 1<<20 || i+1 == rows){
+            apop_query("%s;", q.s);
+            q.len = 0;
+        }
+        if (!mysql && !((i+1) % batch_size) && i+1 < rows)
+            apop_query("commit; begin;");
+    }
+    if (!mysql) apop_query("commit;");
+    free(q.s);
+}
+
 /** Dump an \ref apop_data set into the database.
 
 This function is basically preempted by \ref apop_data_print. Use that one; this may soon no longer be available.
@@ -493,6 +1251,8 @@ Column names are inserted if there are any. If there are, all dots are converted
 
 \li If the table exists; append to. If the table does not exist, create. So perhaps call \ref apop_table_exists <tt>("tabname", 'd')</tt> to ensure that the table is removed ahead of time.
 
+\li Rows go in via a single prepared <tt>insert</tt> statement (for MySQL, many rows per <tt>insert</tt>), with a commit every \ref apop_opts_type "apop_opts.db_batch_size" rows. Numbers are written at full precision. For a scratch database on disk, see also \ref apop_opts_type "apop_opts.db_scratch".
+
 \li You can also call this via \ref apop_data_print <tt>(data, "tabname", .output_type='d', .output_append='w')</tt> to overwrite a new table or with <tt>.output_append='a'</tt> to append.
 
 \param set 	    The name of the matrix
@@ -502,198 +1262,194 @@ Column names are inserted if there are any. If there are, all dots are converted
 */
 void apop_data_to_db(const apop_data *set, const char *tabname, const char output_append){
     Apop_assert_c(set, , 1, "you sent me a NULL data set. Database table %s will not be created.", tabname);
-    int	i,j; 
-    int	ctr		   = 0;
-    int	batch_size = 100;
-    char *q 	   = malloc(1000);
-    char comma     = ' ';
-    int use_row    = strlen(apop_opts.db_name_column) 
+    apop_data *by_rows = apop_page_by_rows(set);
+    if (by_rows){ //stored by columns; write a row-major copy.
+        apop_data_to_db(by_rows, tabname, output_append);
+        by_rows->more = NULL;
+        apop_data_free(by_rows);
+        return;
+    }
+#ifndef HAVE_LIBMYSQLCLIENT
+    Apop_assert_c(apop_opts.db_engine != 'm', , 0, "Apophenia was compiled without mysql support.");
+#endif
+    if (apop_opts.db_engine != 'm' && !sqlite_thread_db()) apop_db_open(NULL);
+    int use_row = strlen(apop_opts.db_name_column) 
                 && ((set->matrix && set->names->rowct == set->matrix->size1)
                     || (set->vector && set->names->rowct == set->vector->size));
+    int colct = use_row + !!set->vector + (set->matrix ? set->matrix->size2 : 0)
+                + set->textsize[1] + !!set->weights;
+    size_t rows = GSL_MAX(set->vector ? set->vector->size : 0,
+                GSL_MAX(set->matrix ? set->matrix->size1 : 0, 
+                        set->textsize[0]));
 
-    int tab_exists = apop_table_exists(tabname);
+    if (!apop_table_exists(tabname))
+        create_data_table(set, tabname, use_row);
+    if (!rows || !colct) return;
+    if (apop_opts.db_engine != 'm' && colct <= 999) //999 = SQLite's default limit on blanks in a prepared statement.
+        data_to_db_prepared(set, tabname, use_row, colct, rows);
+    else
+        data_to_db_text(set, tabname, use_row, rows);
+}
 
-//To start, q will either be "begin;" if the table exists or "create table ... ; begin;" if it doesn't.
-//Except mysql doesn't like transactions like this, so elide the "begin;" in that case.
-    if (tab_exists && !apop_opts.db_engine == 'm')
-        asprintf(&q, "begin;");
-    else if (tab_exists && apop_opts.db_engine == 'm')
-        asprintf(&q, " ");
-    else if (apop_opts.db_engine == 'm')
-#ifdef HAVE_LIBMYSQLCLIENT
-    if (((output_append =='a' || output_append =='A') && apop_table_exists(tabname))){
-        asprintf(&q, " ");
-    else {
-        asprintf(&q, "create table %s (", tabname);
-        if (use_row) {
-            qxprintf(&q, "%s\n %s varchar(1000)", q, apop_opts.db_name_column);
-            comma = ',';
-        }
-        if (set->vector){
-            if(!set->names->vector) 
-                qxprintf(&q, "%s%c\n vector double ", q, comma);
-            else
-                qxprintf(&q, "%s%c\n \"%s\" double ", q,comma, apop_strip_dots(set->names->vector,'d'));
-            comma = ',';
-        }
-        if (set->matrix)
-            for(i=0;i< set->matrix->size2; i++){
-                if(set->names->colct <= i) 
-                    qxprintf(&q, "%s%c\n c%i double ", q, comma,i);
-                 else
-                    qxprintf(&q, "%s%c\n %s  double ", q, comma,apop_strip_dots(set->names->column[i],'d'));
-                comma = ',';
-            }
-        for(i=0;i< set->textsize[1]; i++){
-            if (set->names->textct <= i)
-                qxprintf(&q, "%s%c\n tc%i varchar(1000) ", q, comma,i);
-            else
-                qxprintf(&q, "%s%c\n %s  varchar(1000) ", q, comma,apop_strip_dots(set->names->text[i],'d'));
-            comma = ',';
-        }
-        apop_query("%s); ", q);
-        sprintf(q, " ");
-    }
-#else 
-        Apop_assert_c(0, , 0, "Apophenia was compiled without mysql support.")
-#endif
-    else {
-        if (db==NULL) apop_db_open(NULL);
-        if (((output_append =='a' || output_append =='A') && apop_table_exists(tabname)) )
-            asprintf(&q, " ");
-        else {
-            asprintf(&q, "create table %s (", tabname);
-            if (use_row) {
-                qxprintf(&q, "%s\n %s", q, apop_opts.db_name_column);
-                comma = ',';
-            }
-            if (set->vector){
-                if(!set->names->vector) 	qxprintf(&q, "%s%c\n vector numeric", q, comma);
-                else			qxprintf(&q, "%s%c\n \"%s\"", q, comma,apop_strip_dots(set->names->vector,'d'));
-                comma = ',';
-            }
-            if (set->matrix)
-                for(i=0;i< set->matrix->size2; i++){
-                    if(set->names->colct <= i) 	
-                        qxprintf(&q, "%s%c\n c%i numeric", q, comma,i);
-                    else			
-                        qxprintf(&q, "%s%c\n \"%s\" numeric", q, comma,apop_strip_dots(set->names->column[i],'d'));
-                    comma = ',';
-                }
-            for(i=0; i< set->textsize[1]; i++){
-                if(set->names->textct <= i) 	qxprintf(&q, "%s%c\n tc%i ", q,comma,i);
-                else			qxprintf(&q, "%s%c\n %s ", q, comma, apop_strip_dots(set->names->text[i],'d'));
-                comma = ',';
-            }
-            if (set->weights)
-                qxprintf(&q, "%s%c\n \"weights\" numeric", q, comma);
-            qxprintf(&q,"%s);  begin;",q);
-        }
+/* Merging.
+
+   Both merge functions attach the other database as merge_me, and run everything inside
+   one savepoint, so the whole merge is one transaction (or part of the caller's).
+   --A new table is created via its original create statement, so it keeps its column
+     types and keys, and then filled via insert ... select *. With matching schemas and no
+     indices on the target, SQLite copies the table's pages rather than its rows.
+   --With indices=='y', the target table's indices are dropped before the insert and
+     rebuilt afterward, and the source's indices are added. Building an index once over
+     the full table beats updating it row by row.
+   --sqlite_master stores create statements without the schema name, so create_in
+     splices in the schema of the target.
+*/
+
+static double merge_now(void){
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return t.tv_sec + t.tv_usec/1e6;
+}
+
+//Run a create table or create index statement from sqlite_master in the given schema.
+static int create_in(char const *schema, char const *sql){
+    char const *prefixes[] = {"CREATE TABLE ", "CREATE INDEX ", "CREATE UNIQUE INDEX "};
+    for (int i=0; i< 3; i++){
+        size_t len = strlen(prefixes[i]);
+        if (!strncmp(sql, prefixes[i], len))
+            return apop_query("%s%s.%s", prefixes[i], schema, sql+len);
     }
+    return -1;
+}
 
-    int lim = GSL_MAX(set->vector ? set->vector->size : 0,
-                GSL_MAX(set->matrix ? set->matrix->size1 : 0, 
-                        set->textsize[0]));
-	for(i=0; i< lim; i++){
-        comma = ' ';
-		qxprintf(&q, "%s \n insert into %s values(",q, tabname);
-        if (use_row){
-            char *fixed= prep_string_for_sqlite(0, set->names->row[i]);
-			qxprintf(&q, "%s %s ",q, fixed);
-            free(fixed);
-            comma = ',';
-        }
-        if (set->vector)
-           add_a_number (&q, &comma, gsl_vector_get(set->vector,i));
-        if (set->matrix)
-            for(j=0; j< set->matrix->size2; j++)
-               add_a_number (&q, &comma, gsl_matrix_get(set->matrix,i,j));
-		for(j=0; j< set->textsize[1]; j++){
-            char *fixed= prep_string_for_sqlite(0, set->text[i][j]);
-			qxprintf(&q, "%s%c %s ",q, comma,fixed ? fixed : "''");
-            free(fixed);
-            comma = ',';
-        }
-        if (set->weights)
-           add_a_number (&q, &comma, gsl_vector_get(set->weights,i));
-        qxprintf(&q,"%s);",q);
-		ctr++;
-        apop_query("%s", q); 
-        q[0]='\0';
-		if(ctr==batch_size && apop_opts.db_engine != 'm') {
-            ctr = 0;
-            apop_query("commit;");
-            qxprintf(&q,"begin; \n");
-        }
-	}
-    if ( !(apop_opts.db_engine == 'm') && ctr>0) 
-        apop_query("%s commit;",q);
-	free(q);
+//Recreate each index in the list (columns: name, sql) in the schema, unless there's one by that name already.
+static void add_indices(char const *schema, apop_data *indices){
+    for (int i=0; indices && i< indices->textsize[0]; i++)
+        if (!apop_query_to_float("select count(*) from %s.sqlite_master where type='index' and name='%s'",
+                                        schema, indices->text[i][0]))
+            create_in(schema, indices->text[i][1]);
+}
+
+/* Copy or append one table from schema from to schema to. Returns the number of rows
+   copied, or -1 on error. */
+static long merge_one(char const *from, char const *to, char const *tabname, char indices){
+    double start = merge_now();
+    char *indexq = "select name, sql from %s.sqlite_master where type='index' and tbl_name='%s' and sql is not null";
+    apop_data *to_indices = NULL;
+    if (!apop_query_to_float("select count(*) from %s.sqlite_master where type='table' and name='%s'", to, tabname)){
+        Apop_notify(2, "adding in %s", tabname);
+        apop_data *create = apop_query_to_text("select sql from %s.sqlite_master where type='table' and name='%s'", from, tabname);
+        Apop_stopif(!create || create->error, apop_data_free(create); return -1, 0, "There's no table named %s to merge.", tabname);
+        if (create_in(to, *create->text[0])) //e.g., a virtual table.
+            apop_query("create table %s.\"%s\" as select * from %s.\"%s\" where 0", to, tabname, from, tabname);
+        apop_data_free(create);
+    } else {
+        Apop_notify(2, "merging in %s", tabname);
+        if (indices == 'y' && (to_indices = apop_query_to_text(indexq, to, tabname)))
+            for (int i=0; i< to_indices->textsize[0]; i++)
+                apop_query("drop index %s.\"%s\"", to, to_indices->text[i][0]);
+    }
+    int err = apop_query("insert into %s.\"%s\" select * from %s.\"%s\"", to, tabname, from, tabname);
+    long rows = (err || apop_opts.db_engine == 'm') ? 0 : sqlite3_changes(db);
+    if (indices == 'y'){
+        add_indices(to, to_indices);
+        apop_data *from_indices = apop_query_to_text(indexq, from, tabname);
+        add_indices(to, from_indices);
+        apop_data_free(from_indices);
+    }
+    apop_data_free(to_indices);
+    double secs = merge_now() - start;
+    Apop_notify(2, "%s: %li rows in %g seconds (%g rows/sec)", tabname, rows, secs, secs ? rows/secs : GSL_POSINF);
+    return err ? -1 : rows;
 }
 
 /** Merge a single table from a database on the hard drive with the database currently open.
 
-\param db_file	The name of a file on disk. [default = \c NULL]
+\param db_file	The name of a file on disk. If \c NULL, I assume you've already attached it via <tt>attach database "file.db" as merge_me</tt>. [default = \c NULL]
 \param tabname	The name of the table in that database to be merged in. [No default]
 \param inout  Do we copy data in to the currently-open main db [\c 'i'] or out to the specified auxiliary db[\c 'o']?  [default = 'i']
+\param indices If \c 'y', drop the target table's indices before loading, and build
+them (plus any indices the source table has that the target doesn't) after. For a large
+merge into an indexed table, this is much faster than updating the indices row by row. [default = 'n']
 
-If the table exists in the new database but not in the currently open one, then it is simply copied over. If there is a table with the same name in the currently open database, then the data from the new table is inserted into the main database's table with the same name. [The function just calls <tt>insert into main.tab select * from merge_me.tab</tt>.]
+If the table exists in the new database but not in the currently open one, then it is copied over, along with its column types and keys. If there is a table with the same name in the currently open database, then the data from the new table is inserted into the main database's table with the same name. [The function calls <tt>insert into main.tab select * from merge_me.tab</tt>.]
 
+\li If <tt>apop_opts.verbose >= 2</tt>, I report the rows copied and rows per second.
+\li This is SQLite-only.
+
+\return The number of rows copied, or -1 on error.
 \ingroup db
 This function uses the \ref designated syntax for inputs.
 */
-APOP_VAR_HEAD void apop_db_merge_table(char *db_file, char *tabname, char inout){
+APOP_VAR_HEAD long apop_db_merge_table(char *db_file, char *tabname, char inout, char indices){
     char * apop_varad_var(tabname, NULL);
-    Apop_assert_n(tabname, "I need a non-NULL tabname");
+    Apop_stopif(!tabname, return -1, 0, "I need a non-NULL tabname");
     char * apop_varad_var(db_file, NULL);
     char apop_varad_var(inout, 'i');
+    char apop_varad_var(indices, 'n');
 APOP_VAR_ENDHEAD
-    char maine[] = "main";
-    char merge_me[] = "merge_me";
-    char *from = inout == 'i' ? merge_me : maine;
-    char *to = inout == 'i' ? maine : merge_me ;
-	if (db_file !=NULL)
-		apop_query("attach database \"%s\" as merge_me;", db_file);
-	int d = apop_query_to_float("select count(*) from %s.sqlite_master where name == \"%s\";", to, tabname);
-	if (!d){	//just import table
-		Apop_notify(2, "adding in %s", tabname);
-		apop_query("create table %s.%s as select * from %s.%s;", to, tabname, from, tabname);
-	}
-	else	{			//merge tables.
-		Apop_notify(2, "merging in %s", tabname);
-		apop_query("insert into %s.%s select * from %s.%s;", to, tabname, from, tabname);
-	}
-	if (db_file !=NULL)
+    Apop_stopif(apop_opts.db_engine == 'm', return -1, 0, "Merging databases is SQLite-only.");
+	if (db_file)
+		Apop_stopif(apop_query("attach database '%s' as merge_me;", db_file), return -1,
+                        0, "Couldn't attach %s.", db_file);
+    apop_query("savepoint apop_merge;");
+    long out = merge_one(inout == 'i' ? "merge_me" : "main", inout == 'i' ? "main" : "merge_me", tabname, indices);
+    apop_query("release apop_merge;");
+	if (db_file)
 		apop_query("detach database merge_me;");
+    return out;
 }
 
 /** Merge a database on the hard drive with the database currently open.
 
 \param db_file	The name of a file on disk. [No default; can't be \c NULL]
 \param inout  Do we copy data in to the currently-open main db [\c 'i'] or out to the specified auxiliary db[\c 'o']?  [default = 'i']
+\param indices If \c 'y', build indices after loading each table, not during; see \ref apop_db_merge_table. [default = 'n']
 
 If a table exists in the new database but not in the currently open one, then it is simply copied over. If there are  tables with the same name in both databases, then the data from the new table is inserted into the main database's table with the same name. [The function just calls <tt>insert into main.tab select * from merge_me.tab</tt>.]
 
+\li The whole merge is one transaction.
+\li SQLite allows one writer per database at a time, so the tables are loaded one after
+another. For big merges, consider setting \ref apop_opts_type "apop_opts.db_scratch" before
+opening the target database.
+\li If <tt>apop_opts.verbose >= 2</tt>, I report the rows copied and rows per second, for
+each table and for the whole merge.
 \li This is sqlite-only; I'm not sure if it really makes much sense for mySQL.
 
+\return The number of rows copied, or -1 if any table failed to merge (in which case the
+other tables are still merged).
 This function uses the \ref designated syntax for inputs.
 \ingroup db
 */
-APOP_VAR_HEAD void apop_db_merge(char *db_file, char inout){
+APOP_VAR_HEAD long apop_db_merge(char *db_file, char inout, char indices){
     char * apop_varad_var(db_file, NULL);
-    Apop_assert_n(db_file, "This function copies from a named database file to the currently in-memory database. You need to give me the name of that named db.")
+    Apop_stopif(!db_file, return -1, 0, "This function copies from a named database file to the currently in-memory database. You need to give me the name of that named db.");
     char apop_varad_var(inout, 'i');
+    char apop_varad_var(indices, 'n');
 APOP_VAR_ENDHEAD
-  apop_data	*tab_list;
-	apop_query("attach database \"%s\" as filedb;", db_file);
-	tab_list= apop_query_to_text("select name from %s.sqlite_master where type==\"table\";"
-              , inout == 'i' ? "filedb" : "main" );
-    if(!tab_list) return; //No tables to merge.
-	for(int i=0; i< tab_list->textsize[0]; i++)
-		apop_db_merge_table(db_file, (tab_list->text)[i][0], inout);
-	apop_query("detach database filedb;");
+    Apop_stopif(apop_opts.db_engine == 'm', return -1, 0, "Merging databases is SQLite-only.");
+    Apop_stopif(apop_query("attach database '%s' as merge_me;", db_file), return -1,
+                    0, "Couldn't attach %s.", db_file);
+    double start = merge_now();
+    char *from = inout == 'i' ? "merge_me" : "main", *to = inout == 'i' ? "main" : "merge_me";
+	apop_data *tab_list = apop_query_to_text("select name from %s.sqlite_master where type='table' "
+                                             "and name not like 'sqlite\\_%%' escape '\\'", from);
+    long total = 0;
+    int failed = 0;
+    apop_query("savepoint apop_merge;");
+	for(int i=0; tab_list && i< tab_list->textsize[0]; i++){
+		long rows = merge_one(from, to, tab_list->text[i][0], indices);
+        if (rows < 0) failed = 1;
+        else total += rows;
+    }
+    apop_query("release apop_merge;");
+	apop_query("detach database merge_me;");
 	apop_data_free(tab_list);
+    double secs = merge_now() - start;
+    Apop_notify(2, "%s: %li rows in %g seconds (%g rows/sec)", db_file, total, secs, secs ? total/secs : GSL_POSINF);
+    return failed ? -1 : total;
 }
+
                                                                                                                                
 // Some stats wrappers
 
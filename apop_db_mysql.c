@@ -7,8 +7,23 @@ This file is included directly into \ref apop_db.c. It is read only if APOP_USE_
 #include <my_sys.h>
 #include <mysql.h>
 #include <math.h>
+#include <pthread.h>
 
-static MYSQL *mysql_db; 
+/* As with SQLite, each thread has its own connection. The thread that calls apop_db_open
+   uses the one it opened; other threads connect to the same database on their first
+   query (see mysql_thread_db), and apop_db_close closes them all. */
+static threadlocal MYSQL *mysql_db; 
+static threadlocal unsigned long mysql_generation;
+
+static struct {
+    pthread_mutex_t lock;   //protects everything below
+    char    *name;          //the database apop_db_open connected to
+    MYSQL   **handles;      //every thread's connection, for apop_db_close
+    int     handlect;
+    struct mysql_stmt_cache **caches; //every thread's prepared statements; see mysql_cached_statement.
+    int     cachect;
+    unsigned long generation; //incremented every time the database is opened or closed
+} mysql_pool = {.lock = PTHREAD_MUTEX_INITIALIZER};
 
 static char *opt_host_name = NULL;      /* server host (default=localhost) */
 static unsigned int opt_port_num = 0;   /* port number (use built-in value) */
@@ -32,22 +47,100 @@ static void print_error (MYSQL *conn, char *message) {
     }
 }
 
-static int apop_mysql_db_open(char const *in){
-    Apop_assert(in, "MySQL needs a non-NULL db name.");
-    mysql_db = mysql_init (NULL);
-    Apop_assert(mysql_db, "mysql_init() failed (probably out of memory)");
+static MYSQL *mysql_connect(char const *in){
+    MYSQL *out = mysql_init (NULL);
+    Apop_stopif(!out, return NULL, 0, "mysql_init() failed (probably out of memory)");
     /* connect to server */
-    if (!mysql_real_connect (mysql_db, opt_host_name, apop_opts.db_user, apop_opts.db_pass,
+    if (!mysql_real_connect (out, opt_host_name, apop_opts.db_user, apop_opts.db_pass,
             in, opt_port_num, opt_socket_name, CLIENT_MULTI_STATEMENTS+opt_flags)) {
                 Apop_notify(0, "mysql_real_connect() to %s failed", in);
-                mysql_close (mysql_db);
-                return 1;
+                mysql_close (out);
+                return NULL;
             }
+    pthread_mutex_lock(&mysql_pool.lock);
+    mysql_pool.handles = realloc(mysql_pool.handles, sizeof(MYSQL*)*++mysql_pool.handlect);
+    mysql_pool.handles[mysql_pool.handlect-1] = out;
+    pthread_mutex_unlock(&mysql_pool.lock);
+    return out;
+}
+
+/* The prepared statements behind apop_query_bound and friends, as with SQLite's
+   cached_statement: statements belong to a connection, so each thread keeps its own
+   cache, and the least recently used statement is closed when the cache is full. */
+#define Mysql_cache_size 32
+
+struct mysql_stmt_cache {
+    struct {
+        char *query;
+        MYSQL_STMT *stmt;
+        unsigned long last_used;
+    } slots[Mysql_cache_size];
+    int ct;
+    unsigned long clock;
+};
+
+static threadlocal struct mysql_stmt_cache *mysql_stmt_cache;
+static threadlocal unsigned long mysql_stmt_cache_generation;
+
+static void mysql_stmt_cache_free(struct mysql_stmt_cache *c){
+    for (int i=0; i< c->ct; i++){
+        mysql_stmt_close(c->slots[i].stmt);
+        free(c->slots[i].query);
+    }
+    free(c);
+}
+
+//Call with mysql_pool.lock held.
+static void mysql_pool_close(void){
+    for (int i=0; i< mysql_pool.cachect; i++) //statements go before their connections.
+        mysql_stmt_cache_free(mysql_pool.caches[i]);
+    free(mysql_pool.caches);
+    mysql_pool.caches = NULL;
+    mysql_pool.cachect = 0;
+    for (int i=0; i< mysql_pool.handlect; i++)
+        mysql_close(mysql_pool.handles[i]);
+    free(mysql_pool.handles);
+    mysql_pool.handles = NULL;
+    mysql_pool.handlect = 0;
+    free(mysql_pool.name);
+    mysql_pool.name = NULL;
+    mysql_pool.generation++;
+}
+
+/* Return this thread's connection. If another thread opened the database and this one
+   hasn't connected yet (or its connection was closed since), connect now. */
+static MYSQL *mysql_thread_db(void){
+    pthread_mutex_lock(&mysql_pool.lock);
+    if (mysql_generation != mysql_pool.generation) mysql_db = NULL;
+    char *name = (!mysql_db && mysql_pool.name) ? strdup(mysql_pool.name) : NULL;
+    unsigned long generation = mysql_pool.generation;
+    pthread_mutex_unlock(&mysql_pool.lock);
+    if (name){
+        mysql_db = mysql_connect(name);
+        mysql_generation = generation;
+        free(name);
+    }
+    return mysql_db;
+}
+
+static int apop_mysql_db_open(char const *in){
+    Apop_assert(in, "MySQL needs a non-NULL db name.");
+    pthread_mutex_lock(&mysql_pool.lock);
+    mysql_pool_close(); //if there was a database open, let it go.
+    mysql_generation = mysql_pool.generation;
+    pthread_mutex_unlock(&mysql_pool.lock);
+    if (!(mysql_db = mysql_connect(in))) return 1;
+    pthread_mutex_lock(&mysql_pool.lock);
+    mysql_pool.name = strdup(in);
+    pthread_mutex_unlock(&mysql_pool.lock);
     return 0;
 }
 
 static void apop_mysql_db_close(int ignoreme){
-    mysql_close (mysql_db);
+    pthread_mutex_lock(&mysql_pool.lock);
+    mysql_pool_close();
+    pthread_mutex_unlock(&mysql_pool.lock);
+    mysql_db = NULL;
 }
 
     //Cut & pasted & cleaned from the mysql manual.
@@ -63,6 +156,7 @@ static void process_results(void){
 }
 
 static double apop_mysql_query(char *query){
+    Apop_stopif(!mysql_thread_db(), return 1, 0, "No mySQL database is open.");
     if (mysql_query(mysql_db,query)) {
         print_error (mysql_db, "apop_mysql_query failed");
         return 1;
@@ -72,6 +166,7 @@ static double apop_mysql_query(char *query){
 }
 
 static double apop_mysql_table_exists(char *table, int delme){
+    Apop_stopif(!mysql_thread_db(), return 0, 0, "No mySQL database is open.");
   MYSQL_RES         *res_set = mysql_list_tables(mysql_db, table);
     if (!mysql_list_tables(mysql_db, table)){
          print_error (mysql_db, "show tables query failed.");
@@ -170,6 +265,7 @@ static void * process_result_set_chars (MYSQL *conn, MYSQL_RES *res_set) {
 static void * apop_mysql_query_core(char *query, void *(*callback)(MYSQL*, MYSQL_RES*)){
   MYSQL_RES *res_set;
   apop_data *output;
+    Apop_stopif(!mysql_thread_db(), return NULL, 0, "No mySQL database is open.");
     if (mysql_query (mysql_db, query)){
         print_error (mysql_db, "mysql_query() failed");
         return NULL;
@@ -192,6 +288,7 @@ static double apop_mysql_query_to_float(char *query){
   MYSQL_RES *res_set;
   double out;
   MYSQL_ROW        row;
+    Apop_stopif(!mysql_thread_db(), return GSL_NAN, 0, "No mySQL database is open.");
     if (mysql_query (mysql_db, query) != 0){
          print_error (mysql_db, "mysql_query() failed");
          return GSL_NAN;
@@ -211,3 +308,132 @@ static double apop_mysql_query_to_float(char *query){
     mysql_free_result (res_set);
     return out;
 }
+
+/* Get this thread's prepared version of the query, from the cache if possible, reset and
+   ready to bind. On error, complain and return NULL. */
+static MYSQL_STMT *mysql_cached_statement(char const *query){
+    Apop_stopif(!mysql_thread_db(), return NULL, 0, "No mySQL database is open.");
+    if (mysql_stmt_cache_generation != mysql_generation) mysql_stmt_cache = NULL; //closed by apop_db_close.
+    if (!mysql_stmt_cache){
+        mysql_stmt_cache = calloc(1, sizeof(struct mysql_stmt_cache));
+        mysql_stmt_cache_generation = mysql_generation;
+        pthread_mutex_lock(&mysql_pool.lock);
+        mysql_pool.caches = realloc(mysql_pool.caches, sizeof(struct mysql_stmt_cache*)*++mysql_pool.cachect);
+        mysql_pool.caches[mysql_pool.cachect-1] = mysql_stmt_cache;
+        pthread_mutex_unlock(&mysql_pool.lock);
+    }
+    struct mysql_stmt_cache *c = mysql_stmt_cache;
+    int oldest = 0;
+    for (int i=0; i< c->ct; i++){
+        if (!strcmp(c->slots[i].query, query)){
+            c->slots[i].last_used = ++c->clock;
+            mysql_stmt_reset(c->slots[i].stmt);
+            return c->slots[i].stmt;
+        }
+        if (c->slots[i].last_used < c->slots[oldest].last_used) oldest = i;
+    }
+    MYSQL_STMT *stmt = mysql_stmt_init(mysql_db);
+    Apop_stopif(!stmt, return NULL, 0, "mysql_stmt_init() failed (probably out of memory)");
+    Apop_stopif(mysql_stmt_prepare(stmt, query, strlen(query)), mysql_stmt_close(stmt); return NULL,
+                0, "%s: %s", query, mysql_stmt_error(stmt));
+    int slot = c->ct;
+    if (c->ct == Mysql_cache_size){ //evict the least recently used.
+        slot = oldest;
+        mysql_stmt_close(c->slots[slot].stmt);
+        free(c->slots[slot].query);
+    } else c->ct++;
+    c->slots[slot].query = strdup(query);
+    c->slots[slot].stmt = stmt;
+    c->slots[slot].last_used = ++c->clock;
+    return stmt;
+}
+
+/* Bind the variadic arguments to the statement's ? slots, as directed by the typelist.
+   The values have to stay put until the statement executes, so they go in vals.
+   Returns 0 on success. */
+typedef struct {
+    double d;
+    long long l;
+    int i;
+    unsigned long len;
+} mysql_param;
+
+static int mysql_bind_params(MYSQL_STMT *stmt, MYSQL_BIND *binds, mysql_param *vals,
+                                    char const *types, va_list ap){
+    int ct = types ? strlen(types) : 0;
+    Apop_stopif(ct != mysql_stmt_param_count(stmt), return 1, 0, "the list of parameter types (%s) has "
+                "%i elements, but the query has %lu slots for parameters.", types ? types : "", ct,
+                (unsigned long) mysql_stmt_param_count(stmt));
+    for (int i=0; i< ct; i++){
+        binds[i] = (MYSQL_BIND){.buffer_type = MYSQL_TYPE_NULL};
+        if (types[i] == 'd'){
+            vals[i].d = va_arg(ap, double);
+            if (!gsl_isnan(vals[i].d))
+                binds[i] = (MYSQL_BIND){.buffer_type = MYSQL_TYPE_DOUBLE, .buffer = &vals[i].d};
+        } else if (types[i] == 'i'){
+            vals[i].i = va_arg(ap, int);
+            binds[i] = (MYSQL_BIND){.buffer_type = MYSQL_TYPE_LONG, .buffer = &vals[i].i};
+        } else if (types[i] == 'l'){
+            vals[i].l = va_arg(ap, long);
+            binds[i] = (MYSQL_BIND){.buffer_type = MYSQL_TYPE_LONGLONG, .buffer = &vals[i].l};
+        } else if (types[i] == 't'){
+            char *text = va_arg(ap, char*);
+            if (text){
+                vals[i].len = strlen(text);
+                binds[i] = (MYSQL_BIND){.buffer_type = MYSQL_TYPE_STRING, .buffer = text,
+                                        .buffer_length = vals[i].len, .length = &vals[i].len};
+            }
+        } else Apop_stopif(types[i] != 'n', return 1, 0, "The list of parameter types should be made "
+                                "of the letters dilnt; I don't know what to do with '%c'.", types[i]);
+    }
+    Apop_stopif(ct && mysql_stmt_bind_param(stmt, binds), return 1, 0, "%s", mysql_stmt_error(stmt));
+    return 0;
+}
+
+/* Read the statement's output into a matrix, as apop_mysql_query_to_data does for a
+   query sent as text (NULL is NaN). Return NULL if there are no rows. */
+static apop_data *mysql_stmt_to_data(MYSQL_STMT *stmt, MYSQL_RES *meta, char *error){
+    Apop_stopif(mysql_stmt_store_result(stmt), *error='q'; return NULL, 0, "%s", mysql_stmt_error(stmt));
+    unsigned int colct = mysql_num_fields(meta);
+    my_ulonglong rowct = mysql_stmt_num_rows(stmt);
+    if (!rowct) return NULL;
+    apop_data *out = apop_data_alloc(0, rowct, colct);
+    MYSQL_BIND binds[colct];
+    double row[colct];
+    my_bool nulls[colct];
+    for (unsigned int i=0; i< colct; i++)
+        binds[i] = (MYSQL_BIND){.buffer_type = MYSQL_TYPE_DOUBLE, .buffer = row+i, .is_null = nulls+i};
+    MYSQL_FIELD *fields = mysql_fetch_fields(meta);
+    for (unsigned int i=0; i< colct; i++)
+        apop_name_add(out->names, fields[i].name, 'c');
+    Apop_stopif(mysql_stmt_bind_result(stmt, binds), *error=out->error='q'; return out,
+                        0, "%s", mysql_stmt_error(stmt));
+    int rc;
+    for (size_t r=0; !(rc = mysql_stmt_fetch(stmt)) || rc == MYSQL_DATA_TRUNCATED; r++)
+        for (unsigned int i=0; i< colct; i++)
+            gsl_matrix_set(out->matrix, r, i, nulls[i] ? GSL_NAN : row[i]);
+    Apop_stopif(rc != MYSQL_NO_DATA, *error=out->error='q', 0, "%s", mysql_stmt_error(stmt));
+    return out;
+}
+
+/* The MySQL side of bound_query: fetch the statement, bind, execute, and read the output
+   into an apop_data set if want_data is nonzero. */
+static apop_data *mysql_bound_query(int want_data, char *error, char const *types,
+                                            char const *query, va_list ap){
+    MYSQL_STMT *stmt = mysql_cached_statement(query);
+    Apop_stopif(!stmt, *error='q'; return NULL, 0, "couldn't prepare %s.", query);
+    int ct = mysql_stmt_param_count(stmt);
+    MYSQL_BIND binds[ct ? ct : 1];
+    mysql_param vals[ct ? ct : 1];
+    Apop_stopif(mysql_bind_params(stmt, binds, vals, types, ap), *error='q'; return NULL,
+                                0, "couldn't bind the parameters for %s.", query);
+    Apop_stopif(mysql_stmt_execute(stmt), *error='q'; return NULL, 0, "%s: %s", query, mysql_stmt_error(stmt));
+    apop_data *out = NULL;
+    MYSQL_RES *meta = mysql_stmt_result_metadata(stmt);
+    if (meta){
+        if (want_data) out = mysql_stmt_to_data(stmt, meta, error);
+        mysql_free_result(meta);
+    }
+    mysql_stmt_free_result(stmt);
+    return out;
+}
@@ -4,8 +4,29 @@ This file is included directly into \ref apop_db.c.
 Copyright (c) 2006--2007 by Ben Klemens.  Licensed under the modified GNU GPL v2; see COPYING and COPYING2.  
  */
 #include <sqlite3.h>
-
-sqlite3	*db=NULL;	                //There's only one SQLite database handle. Here it is.
+#include <pthread.h>
+#include <unistd.h>
+
+/* There's one database at a time, but each thread has its own handle to it. The thread
+   that calls apop_db_open uses the handle it opened. Any other thread (like a worker in
+   the thread pool running an apop_map whose function sends queries) opens its own
+   connection to the same database the first time it sends a query; see sqlite_thread_db.
+   apop_db_close closes every thread's handle. */
+threadlocal sqlite3 *db=NULL;
+static threadlocal unsigned long db_generation;
+
+static struct {
+    pthread_mutex_t lock;   //protects everything below
+    sqlite3 *main;          //the handle apop_db_open opened
+    char    *uri;           //what other threads open; if NULL, they share main.
+    int     flags;          //flags for opening uri
+    sqlite3 **handles;      //other threads' handles, for apop_db_close
+    int     handlect;
+    struct stmt_cache **caches; //every thread's prepared statements; see cached_statement.
+    int     cachect;
+    unsigned long generation; //incremented every time the database is opened or closed.
+                              //Written under the lock, but read atomically without it.
+} db_pool = {.lock = PTHREAD_MUTEX_INITIALIZER};
 
 
 /** \page db_moments Database moments (plus pow()!)
@@ -29,6 +50,50 @@ group by whatever
 
 \li The  var/skew/kurtosis functions calculate sample moments, so if you want the population moment, multiply the result by (n-1)/n .
 
+\li These moments are calculated in one pass, via running sums of deviations from the
+running mean, so they give the same answer as \ref apop_vector_var, \ref apop_vector_skew,
+and \ref apop_vector_kurtosis even for data like timestamps, where the mean is huge
+relative to the variance. Like <tt>avg</tt>, they skip NULLs.
+
+\li Quantiles, covariance, correlation, and weighted moments are also available as aggregates:
+
+\code
+select median(x), percentile(x, 95), percentile(x, 2.5, 'a'),
+    median_approx(x), percentile_approx(x, 99),
+    median_sketch(x), percentile_sketch(x, 99.9, 'a'),
+    cov(x, y), covar_samp(x, y), covar_pop(x, y), corr(x, y),
+    weighted_mean(x, w), weighted_var(x, w)
+from table
+group by whatever
+\endcode
+
+The percentile is given as a number from 0 to 100, and the rules match those of \ref
+apop_vector_percentiles: the optional last argument to <tt>median</tt> or
+<tt>percentile</tt> is <tt>'d'</tt> (the default) to round down to the nearest
+observation, <tt>'u'</tt> to round up, or <tt>'a'</tt> to average the two. So
+<tt>median(x)</tt> matches the median from \ref apop_data_summarize, and
+<tt>median(x, 'a')</tt> is the median from your stats textbook.
+
+These exact versions keep a copy of every value in the group until the end of the
+query. For a group too large for that, the <tt>_approx</tt> versions use the P-squared
+algorithm, which keeps five numbers per group no matter how much data goes by; for
+reasonably smooth data, expect the estimate to be accurate to a few parts in a thousand
+of the data's range.
+
+The <tt>_sketch</tt> versions keep a fixed-size \ref apop_sketch_alloc "quantile sketch"
+per group (a few thousand numbers), and take the same optional rounding argument as the
+exact versions. For groups of up to a couple of hundred rows they are exact; past that, the
+rank of the returned value is off by a fraction of a percent of the group size, whatever
+the shape of the data, which makes them the safer bet for lumpy data or far tails.
+
+<tt>cov</tt> and <tt>covar_samp</tt> give the sample covariance; <tt>covar_pop</tt>
+the population covariance. The weighting for <tt>weighted_var</tt> matches \ref
+apop_vector_weighted_var: if the weights sum to one, they are treated as proportions;
+else as frequency weights.
+
+All of these skip rows where any input is NULL, and return NULL for a group with no
+usable rows.
+
 \li For bonus points, there are the <tt>sqrt(x)</tt>, <tt>pow(x,y)</tt>, <tt>exp(x)</tt>,
 <tt>log(x)</tt>, and trig functions. They call the standard math library function
 of the same name to calculate \f$\sqrt{x}\f$, \f$x^y\f$, \f$e^x\f$, \f$\ln(x)\f$,
@@ -41,121 +106,437 @@ from table
 \endcode
 */
 
+/* The moment aggregates keep the count, mean, and sums of powers of deviations from the
+   running mean, updated one row at a time via the formulæ of Welford and Terriberry.
+   Accumulating raw sums of x^2, x^3, ... and subtracting at the end loses everything
+   when the mean is large relative to the spread; this doesn't. To go a step further,
+   everything is measured relative to the first value in the group, so for data like
+   1e9 plus small noise, the deviations are exact. Two sets of these can be combined
+   via the formulæ of Chan et al. */
 typedef struct StdDevCtx StdDevCtx;
 struct StdDevCtx {
-    double avg;     /* avg of terms */
-    double avg2;    /* avg of the squares of terms */
-    double avg3;    /* avg of the cube of terms */
-    double avg4;    /* avg of the fourth-power of terms */
+    double shift;   /* first term, subtracted from every term */
+    double mean;    /* mean of terms, minus the shift */
+    double m2;      /* sum of squared deviations from the mean */
+    double m3;      /* sum of cubed deviations from the mean */
+    double m4;      /* sum of fourth-power deviations from the mean */
     int cnt;        /* Number of terms counted */
 };
 
+static int any_null(int argc, sqlite3_value **argv){
+    for (int i=0; i< argc; i++)
+        if (sqlite3_value_type(argv[i]) == SQLITE_NULL) return 1;
+    return 0;
+}
+
 static void twoStep(sqlite3_context *context, int argc, sqlite3_value **argv){
     if (argc<1) return;
     StdDevCtx *p = sqlite3_aggregate_context(context, sizeof(*p));
-    if (p && argv[0]){
+    if (p && !any_null(1, argv)){
         double x = sqlite3_value_double(argv[0]);
-        double ratio = p->cnt/(p->cnt+1.0);
+        if (!p->cnt) p->shift = x;
+        x -= p->shift;
+        double delta = x - p->mean;
         p->cnt++;
-        p->avg	*= ratio;
-        p->avg2	*= ratio;
-        p->avg += x/(p->cnt +0.0);
-        p->avg2 += gsl_pow_2(x)/(p->cnt +0.0);
+        p->mean += delta/p->cnt;
+        p->m2 += delta*(x - p->mean);
     }
 }
 
 static void threeStep(sqlite3_context *context, int argc, sqlite3_value **argv){
     if (argc<1) return;
     StdDevCtx *p = sqlite3_aggregate_context(context, sizeof(*p));
-    if (p && argv[0]){
+    if (p && !any_null(1, argv)){
         double x = sqlite3_value_double(argv[0]);
-        double ratio =  p->cnt/(p->cnt+1.0);
-        p->cnt++;
-        p->avg	*= ratio;
-        p->avg2	*= ratio;
-        p->avg3	*= ratio;
-        p->avg += x/p->cnt;
-        p->avg2 += gsl_pow_2(x)/p->cnt;
-        p->avg3 += gsl_pow_3(x)/p->cnt;
+        if (!p->cnt) p->shift = x;
+        x -= p->shift;
+        double n1 = p->cnt++, n = p->cnt;
+        double delta = x - p->mean;
+        double delta_n = delta/n;
+        double term1 = delta*delta_n*n1;
+        p->mean += delta_n;
+        p->m3 += term1*delta_n*(n-2) - 3*delta_n*p->m2;
+        p->m2 += term1;
     }
 }
 
 static void fourStep(sqlite3_context *context, int argc, sqlite3_value **argv){
     if( argc<1 ) return;
     StdDevCtx *p = sqlite3_aggregate_context(context, sizeof(*p));
-    if (p && argv[0]){
+    if (p && !any_null(1, argv)){
         double x = sqlite3_value_double(argv[0]);
-        p->cnt++;
-        p->avg = (x + p->avg * (p->cnt-1.))/p->cnt;
-        p->avg2 = (gsl_pow_2(x)+ p->avg2 * (p->cnt-1.))/p->cnt;
-        p->avg3 = (gsl_pow_3(x)+ p->avg3 * (p->cnt-1.))/p->cnt;
-        p->avg4 = (gsl_pow_4(x)+ p->avg4 * (p->cnt-1.))/p->cnt;
+        if (!p->cnt) p->shift = x;
+        x -= p->shift;
+        double n1 = p->cnt++, n = p->cnt;
+        double delta = x - p->mean;
+        double delta_n = delta/n;
+        double delta_n2 = delta_n*delta_n;
+        double term1 = delta*delta_n*n1;
+        p->mean += delta_n;
+        p->m4 += term1*delta_n2*(n*n-3*n+3) + 6*delta_n2*p->m2 - 4*delta_n*p->m3;
+        p->m3 += term1*delta_n*(n-2) - 3*delta_n*p->m2;
+        p->m2 += term1;
     }
 }
 
 static void stdDevFinalizePop(sqlite3_context *context){
     StdDevCtx *p = sqlite3_aggregate_context(context, sizeof(*p));
-    if (p && p->cnt>1)
-      sqlite3_result_double(context, sqrt((p->avg2 - gsl_pow_2(p->avg))));
-    else if (p->cnt == 1)
-      	sqlite3_result_double(context, 0);
+    if (p && p->cnt)
+        sqlite3_result_double(context, sqrt(p->m2/p->cnt));
 }
 
 static void varFinalizePop(sqlite3_context *context){
-  StdDevCtx *p = sqlite3_aggregate_context(context, sizeof(*p));
-    if( p && p->cnt>1 )
-        sqlite3_result_double(context, (p->avg2 - gsl_pow_2(p->avg)));
-    else if (p->cnt == 1)
-    	sqlite3_result_double(context, 0);
+    StdDevCtx *p = sqlite3_aggregate_context(context, sizeof(*p));
+    if (p && p->cnt)
+        sqlite3_result_double(context, p->m2/p->cnt);
 }
 
 static void stdDevFinalize(sqlite3_context *context){
     StdDevCtx *p = sqlite3_aggregate_context(context, sizeof(*p));
-    if( p && p->cnt>1 ){
-      double rCnt = p->cnt;
-      sqlite3_result_double(context,
-         sqrt((p->avg2 - gsl_pow_2(p->avg))*rCnt/(rCnt-1.0)));
-    } else if (p->cnt == 1)
+    if (p && p->cnt>1)
+        sqlite3_result_double(context, sqrt(p->m2/(p->cnt-1.0)));
+    else if (p && p->cnt == 1)
       	sqlite3_result_double(context, 0);
 }
 
 static void varFinalize(sqlite3_context *context){
     StdDevCtx *p = sqlite3_aggregate_context(context, sizeof(*p));
-    if( p && p->cnt>1 ){
-      double rCnt = p->cnt;
-      sqlite3_result_double(context,
-         (p->avg2 - gsl_pow_2(p->avg))*rCnt/(rCnt-1.0));
-    } else if (p->cnt == 1)
+    if (p && p->cnt>1)
+        sqlite3_result_double(context, p->m2/(p->cnt-1.0));
+    else if (p && p->cnt == 1)
       	sqlite3_result_double(context, 0);
 }
 
+//Same as apop_vector_skew: the population skew times n^2/((n-1)(n-2)).
 static void skewFinalize(sqlite3_context *context){
     StdDevCtx *p = sqlite3_aggregate_context(context, sizeof(*p));
-    if( p && p->cnt>1 ){
-      double rCnt = p->cnt;
-      sqlite3_result_double(context,
-         (p->avg3*rCnt - 3*p->avg2*p->avg*rCnt 
-                        + 2*rCnt * gsl_pow_3(p->avg)) * rCnt/((rCnt-1.0)*(rCnt-2.0)));
-    } else if (p->cnt == 1)
+    if (p && p->cnt>2){
+      double n = p->cnt;
+      sqlite3_result_double(context, p->m3 * n/((n-1.0)*(n-2.0)));
+    } else if (p && p->cnt)
       	sqlite3_result_double(context, 0);
 }
 
+//Same as apop_vector_kurtosis.
 static void kurtFinalize(sqlite3_context *context){
     StdDevCtx *p = sqlite3_aggregate_context(context, sizeof(*p));
-    if( p && p->cnt>1 ){
+    if (p && p->cnt>1){
       double n = p->cnt;
-      double kurtovern = p->avg4 - 4*p->avg3*p->avg
-                        + 6 * p->avg2*gsl_pow_2(p->avg)
-                        - 3* gsl_pow_4(p->avg);
-      double var = p->avg2 - gsl_pow_2(p->avg);
+      double kurtovern = p->m4/n;
+      double var = p->m2/n;
       long double coeff0= n*n/(gsl_pow_3(n)*(gsl_pow_2(n)-3*n+3));
       long double coeff1= n*gsl_pow_2(n-1)+ (6*n-9);
       long double coeff2= n*(6*n-9);
       sqlite3_result_double(context, coeff0*(coeff1 * kurtovern + coeff2 * gsl_pow_2(var)));
-    } else if (p->cnt == 1)
+    } else if (p && p->cnt == 1)
       sqlite3_result_double(context, 0);
 }
 
+/* Quantiles, covariances, and weighted moments.
+
+   The aggregates below skip any row where one of the inputs is NULL (as SQL's own avg()
+   does), and return NULL if there were no rows left. */
+
+/* Read the rounding rule, 'd', 'u', or 'a', from the given argument, if there is one. */
+static char get_rounding(int argc, sqlite3_value **argv, int which){
+    if (argc <= which) return 'd';
+    const unsigned char *r = sqlite3_value_text(argv[which]);
+    return (r && (*r=='u' || *r=='a')) ? *r : 'd';
+}
+
+/* Pick percentile p (0--100) from an already-sorted list, using the same rules as
+   apop_vector_percentiles: round the index down, round it up, or average the two. */
+static double sorted_percentile(double const *sorted, size_t n, double p, char rounding){
+    double target = p*(n-1)/100.;
+    size_t index = target;
+    if (index >= n-1 || index == target) return sorted[index];
+    if (rounding == 'u') return sorted[index+1];
+    if (rounding == 'a') return (sorted[index] + sorted[index+1])/2.;
+    return sorted[index];
+}
+
+typedef struct {
+    double *vals;
+    size_t cnt, space;
+    double p;
+    char rounding, error;
+} pctile_ctx;
+
+static void pctile_add(sqlite3_context *context, pctile_ctx *p, double x){
+    if (p->cnt == p->space){
+        size_t space = p->space ? p->space*2 : 256;
+        double *vals = realloc(p->vals, sizeof(double)*space);
+        if (!vals){
+            p->error = 'm';
+            sqlite3_result_error_nomem(context);
+            return;
+        }
+        p->vals = vals;
+        p->space = space;
+    }
+    p->vals[p->cnt++] = x;
+}
+
+static void pctile_first(sqlite3_context *context, pctile_ctx *p, double pct){
+    if (pct < 0 || pct > 100 || gsl_isnan(pct)){
+        p->error = 'p';
+        sqlite3_result_error(context, "the percentile should be between 0 and 100.", -1);
+    }
+    p->p = pct;
+}
+
+//median(x [, rounding])
+static void medianStep(sqlite3_context *context, int argc, sqlite3_value **argv){
+    pctile_ctx *p = sqlite3_aggregate_context(context, sizeof(*p));
+    if (!p || p->error || any_null(1, argv)) return;
+    if (!p->space){
+        p->p = 50;
+        p->rounding = get_rounding(argc, argv, 1);
+    }
+    pctile_add(context, p, sqlite3_value_double(argv[0]));
+}
+
+//percentile(x, p [, rounding])
+static void percentileStep(sqlite3_context *context, int argc, sqlite3_value **argv){
+    pctile_ctx *p = sqlite3_aggregate_context(context, sizeof(*p));
+    if (!p || p->error || any_null(2, argv)) return;
+    if (!p->space){
+        pctile_first(context, p, sqlite3_value_double(argv[1]));
+        p->rounding = get_rounding(argc, argv, 2);
+        if (p->error) return;
+    }
+    pctile_add(context, p, sqlite3_value_double(argv[0]));
+}
+
+static void percentileFinalize(sqlite3_context *context){
+    pctile_ctx *p = sqlite3_aggregate_context(context, sizeof(*p));
+    if (!p) return;
+    if (!p->error && p->cnt){
+        gsl_sort(p->vals, 1, p->cnt);
+        sqlite3_result_double(context, sorted_percentile(p->vals, p->cnt, p->p, p->rounding));
+    }
+    free(p->vals);
+}
+
+/* The P-squared algorithm (Jain and Chlamtac, 1985, Communications of the ACM 28(10))
+   tracks a percentile with five markers, which are nudged toward their target positions
+   via piecewise-parabolic interpolation as data arrives. So the memory used per group
+   is constant, no matter how many rows are in the group. Until the fifth observation
+   arrives, the markers are just the sorted data. */
+typedef struct {
+    double q[5];    /* marker heights */
+    double n[5];    /* marker positions, 1--count */
+    double want[5]; /* desired marker positions */
+    double dwant[5];/* increment in desired positions per observation */
+    double p;       /* target percentile, 0--1 */
+    size_t cnt;
+    char error;
+} p2_ctx;
+
+static double p2_parabolic(p2_ctx *c, int i, int d){
+    double *q = c->q, *n = c->n;
+    return q[i] + d/(n[i+1]-n[i-1])
+                  * ((n[i]-n[i-1]+d)*(q[i+1]-q[i])/(n[i+1]-n[i])
+                    +(n[i+1]-n[i]-d)*(q[i]-q[i-1])/(n[i]-n[i-1]));
+}
+
+static void p2_add(p2_ctx *c, double x){
+    double *q = c->q, *n = c->n;
+    if (c->cnt < 5){
+        int i = c->cnt++;       //insertion sort into the first five slots.
+        for ( ; i > 0 && q[i-1] > x; i--) q[i] = q[i-1];
+        q[i] = x;
+        if (c->cnt == 5){
+            double p = c->p;
+            for (int j=0; j< 5; j++) n[j] = j+1;
+            c->want[0] = 1; c->want[1] = 1+2*p; c->want[2] = 1+4*p;
+            c->want[3] = 3+2*p; c->want[4] = 5;
+            c->dwant[0] = 0; c->dwant[1] = p/2; c->dwant[2] = p;
+            c->dwant[3] = (1+p)/2; c->dwant[4] = 1;
+        }
+        return;
+    }
+    c->cnt++;
+    int k;
+    if (x < q[0])       { q[0] = x; k = 0; }
+    else if (x >= q[4]) { q[4] = x; k = 3; }
+    else for (k=0; k< 3 && x >= q[k+1]; k++) ;
+    for (int i=k+1; i< 5; i++) n[i]++;
+    for (int i=0; i< 5; i++) c->want[i] += c->dwant[i];
+    for (int i=1; i< 4; i++){
+        double d = c->want[i] - n[i];
+        if ((d >= 1 && n[i+1]-n[i] > 1) || (d <= -1 && n[i-1]-n[i] < -1)){
+            int sign = d > 0 ? 1 : -1;
+            double qp = p2_parabolic(c, i, sign);
+            if (q[i-1] < qp && qp < q[i+1]) q[i] = qp;
+            else q[i] += sign*(q[i+sign]-q[i])/(n[i+sign]-n[i]);
+            n[i] += sign;
+        }
+    }
+}
+
+//median_approx(x)
+static void medianApproxStep(sqlite3_context *context, int argc, sqlite3_value **argv){
+    p2_ctx *c = sqlite3_aggregate_context(context, sizeof(*c));
+    if (!c || any_null(1, argv)) return;
+    if (!c->cnt) c->p = 0.5;
+    p2_add(c, sqlite3_value_double(argv[0]));
+}
+
+//percentile_approx(x, p)
+static void percentileApproxStep(sqlite3_context *context, int argc, sqlite3_value **argv){
+    p2_ctx *c = sqlite3_aggregate_context(context, sizeof(*c));
+    if (!c || c->error || any_null(2, argv)) return;
+    if (!c->cnt){
+        double pct = sqlite3_value_double(argv[1]);
+        if (pct < 0 || pct > 100 || gsl_isnan(pct)){
+            c->error = 'p';
+            sqlite3_result_error(context, "the percentile should be between 0 and 100.", -1);
+            return;
+        }
+        c->p = pct/100.;
+    }
+    p2_add(c, sqlite3_value_double(argv[0]));
+}
+
+static void percentileApproxFinalize(sqlite3_context *context){
+    p2_ctx *c = sqlite3_aggregate_context(context, sizeof(*c));
+    if (!c || c->error || !c->cnt) return;
+    if (c->cnt < 5)
+        sqlite3_result_double(context, sorted_percentile(c->q, c->cnt, c->p*100, 'd'));
+    else if (c->p == 0) sqlite3_result_double(context, c->q[0]);
+    else if (c->p == 1) sqlite3_result_double(context, c->q[4]);
+    else sqlite3_result_double(context, c->q[2]);
+}
+
+/* The _sketch versions keep an apop_sketch (see apop_sketch.c) per group. The aggregate
+   context holds only the pointer, which is freed on the way out. */
+typedef struct {
+    apop_sketch *s;
+    double p;
+    char rounding, error;
+} sketch_ctx;
+
+static void sketch_add(sqlite3_context *context, sketch_ctx *c, double x){
+    if (!c->s && !(c->s = apop_sketch_alloc())) c->error = 'm';
+    if (!c->error && apop_sketch_add(c->s, x)) c->error = 'm';
+    if (c->error) sqlite3_result_error_nomem(context);
+}
+
+//median_sketch(x [, rounding])
+static void medianSketchStep(sqlite3_context *context, int argc, sqlite3_value **argv){
+    sketch_ctx *c = sqlite3_aggregate_context(context, sizeof(*c));
+    if (!c || c->error || any_null(1, argv)) return;
+    if (!c->s){
+        c->p = 50;
+        c->rounding = get_rounding(argc, argv, 1);
+    }
+    sketch_add(context, c, sqlite3_value_double(argv[0]));
+}
+
+//percentile_sketch(x, p [, rounding])
+static void percentileSketchStep(sqlite3_context *context, int argc, sqlite3_value **argv){
+    sketch_ctx *c = sqlite3_aggregate_context(context, sizeof(*c));
+    if (!c || c->error || any_null(2, argv)) return;
+    if (!c->s){
+        double pct = sqlite3_value_double(argv[1]);
+        if (pct < 0 || pct > 100 || gsl_isnan(pct)){
+            c->error = 'p';
+            sqlite3_result_error(context, "the percentile should be between 0 and 100.", -1);
+            return;
+        }
+        c->p = pct;
+        c->rounding = get_rounding(argc, argv, 2);
+    }
+    sketch_add(context, c, sqlite3_value_double(argv[0]));
+}
+
+static void percentileSketchFinalize(sqlite3_context *context){
+    sketch_ctx *c = sqlite3_aggregate_context(context, sizeof(*c));
+    if (!c) return;
+    if (!c->error && c->s && apop_sketch_count(c->s))
+        sqlite3_result_double(context, apop_sketch_percentile(c->s, c->p, c->rounding));
+    apop_sketch_free(c->s);
+}
+
+/* Covariance and correlation, via the one-pass co-moment updates. */
+typedef struct {
+    double meanx, meany, m2x, m2y, cxy;
+    size_t cnt;
+} comoment_ctx;
+
+static void comomentStep(sqlite3_context *context, int argc, sqlite3_value **argv){
+    comoment_ctx *p = sqlite3_aggregate_context(context, sizeof(*p));
+    if (!p || any_null(2, argv)) return;
+    double x = sqlite3_value_double(argv[0]);
+    double y = sqlite3_value_double(argv[1]);
+    double dx = x - p->meanx;
+    double dy = y - p->meany;
+    p->cnt++;
+    p->meanx += dx/p->cnt;
+    p->meany += dy/p->cnt;
+    p->cxy += dx*(y - p->meany);
+    p->m2x += dx*(x - p->meanx);
+    p->m2y += dy*(y - p->meany);
+}
+
+static void covFinalize(sqlite3_context *context){
+    comoment_ctx *p = sqlite3_aggregate_context(context, sizeof(*p));
+    if (p && p->cnt>1)
+        sqlite3_result_double(context, p->cxy/(p->cnt-1.));
+    else if (p && p->cnt == 1)
+        sqlite3_result_double(context, 0);
+}
+
+static void covFinalizePop(sqlite3_context *context){
+    comoment_ctx *p = sqlite3_aggregate_context(context, sizeof(*p));
+    if (p && p->cnt)
+        sqlite3_result_double(context, p->cxy/p->cnt);
+}
+
+//Correlation is undefined (NULL) if either variable is constant.
+static void corrFinalize(sqlite3_context *context){
+    comoment_ctx *p = sqlite3_aggregate_context(context, sizeof(*p));
+    if (p && p->cnt>1 && p->m2x > 0 && p->m2y > 0)
+        sqlite3_result_double(context, p->cxy/sqrt(p->m2x*p->m2y));
+}
+
+/* Weighted mean and variance, following apop_vector_weighted_mean and
+   apop_vector_weighted_var: if the weights sum to (about) one, they are proportions,
+   and n is the count of rows; else they are frequency weights, and n is the total
+   weight. Rows with zero weight are skipped. */
+typedef struct {
+    double mean, m2, wsum;
+    size_t cnt;
+} wmoment_ctx;
+
+static void wmomentStep(sqlite3_context *context, int argc, sqlite3_value **argv){
+    wmoment_ctx *p = sqlite3_aggregate_context(context, sizeof(*p));
+    if (!p || any_null(2, argv)) return;
+    double x = sqlite3_value_double(argv[0]);
+    double w = sqlite3_value_double(argv[1]);
+    if (!w) return;
+    p->cnt++;
+    p->wsum += w;
+    double delta = x - p->mean;
+    p->mean += delta * w/p->wsum;
+    p->m2 += w * delta * (x - p->mean);
+}
+
+static void wmeanFinalize(sqlite3_context *context){
+    wmoment_ctx *p = sqlite3_aggregate_context(context, sizeof(*p));
+    if (p && p->cnt)
+        sqlite3_result_double(context, p->mean);
+}
+
+static void wvarFinalize(sqlite3_context *context){
+    wmoment_ctx *p = sqlite3_aggregate_context(context, sizeof(*p));
+    if (!p || !p->cnt) return;
+    double n = p->wsum < 1.1 ? p->cnt : p->wsum;
+    if (n <= 1) sqlite3_result_double(context, 0);
+    else sqlite3_result_double(context, p->m2/p->wsum * n/(n-1));
+}
+
 static void powFn(sqlite3_context *context, int argc, sqlite3_value **argv){
     double base = sqlite3_value_double(argv[0]);
     double exp  = sqlite3_value_double(argv[1]);
@@ -174,35 +555,243 @@ sqfn(sqrt) sqfn(exp) sqfn(log) sqfn(log10) sqfn(sin)
 sqfn(cos) sqfn(tan) sqfn(asin) sqfn(acos) sqfn(atan)
 
 
-static int apop_sqlite_db_open(char const *filename){
-	if (!filename) sqlite3_open(":memory:",&db);
-	else		   sqlite3_open(filename,&db);
-    apop_assert(db, "Not sure why, but the database didn't open.");
-	sqlite3_create_function(db, "stddev", 1, SQLITE_ANY, NULL, NULL, &twoStep, &stdDevFinalize);
-	sqlite3_create_function(db, "std", 1, SQLITE_ANY, NULL, NULL, &twoStep, &stdDevFinalizePop);
-	sqlite3_create_function(db, "stddev_samp", 1, SQLITE_ANY, NULL, NULL, &twoStep, &stdDevFinalize);
-	sqlite3_create_function(db, "stddev_pop", 1, SQLITE_ANY, NULL, NULL, &twoStep, &stdDevFinalizePop);
-	sqlite3_create_function(db, "var", 1, SQLITE_ANY, NULL, NULL, &twoStep, &varFinalize);
-	sqlite3_create_function(db, "var_samp", 1, SQLITE_ANY, NULL, NULL, &twoStep, &varFinalize);
-	sqlite3_create_function(db, "var_pop", 1, SQLITE_ANY, NULL, NULL, &twoStep, &varFinalizePop);
-	sqlite3_create_function(db, "variance", 1, SQLITE_ANY, NULL, NULL, &twoStep, &varFinalizePop);
-	sqlite3_create_function(db, "skew", 1, SQLITE_ANY, NULL, NULL, &threeStep, &skewFinalize);
-	sqlite3_create_function(db, "kurt", 1, SQLITE_ANY, NULL, NULL, &fourStep, &kurtFinalize);
-	sqlite3_create_function(db, "kurtosis", 1, SQLITE_ANY, NULL, NULL, &fourStep, &kurtFinalize);
-	sqlite3_create_function(db, "ln", 1, SQLITE_ANY, NULL, &logFn, NULL, NULL);
-	sqlite3_create_function(db, "ran", 0, SQLITE_ANY, NULL, &rngFn, NULL, NULL);
-	sqlite3_create_function(db, "pow", 2, SQLITE_ANY, NULL, &powFn, NULL, NULL);
-
-#define sqlink(name) sqlite3_create_function(db, #name , 1, SQLITE_ANY, NULL, &name##Fn, NULL, NULL);
+static void sqlite_register_functions(sqlite3 *h){
+    sqlite3_create_function(h, "stddev", 1, SQLITE_ANY, NULL, NULL, &twoStep, &stdDevFinalize);
+    sqlite3_create_function(h, "std", 1, SQLITE_ANY, NULL, NULL, &twoStep, &stdDevFinalizePop);
+    sqlite3_create_function(h, "stddev_samp", 1, SQLITE_ANY, NULL, NULL, &twoStep, &stdDevFinalize);
+    sqlite3_create_function(h, "stddev_pop", 1, SQLITE_ANY, NULL, NULL, &twoStep, &stdDevFinalizePop);
+    sqlite3_create_function(h, "var", 1, SQLITE_ANY, NULL, NULL, &twoStep, &varFinalize);
+    sqlite3_create_function(h, "var_samp", 1, SQLITE_ANY, NULL, NULL, &twoStep, &varFinalize);
+    sqlite3_create_function(h, "var_pop", 1, SQLITE_ANY, NULL, NULL, &twoStep, &varFinalizePop);
+    sqlite3_create_function(h, "variance", 1, SQLITE_ANY, NULL, NULL, &twoStep, &varFinalizePop);
+    sqlite3_create_function(h, "skew", 1, SQLITE_ANY, NULL, NULL, &threeStep, &skewFinalize);
+    sqlite3_create_function(h, "kurt", 1, SQLITE_ANY, NULL, NULL, &fourStep, &kurtFinalize);
+    sqlite3_create_function(h, "kurtosis", 1, SQLITE_ANY, NULL, NULL, &fourStep, &kurtFinalize);
+    sqlite3_create_function(h, "median", 1, SQLITE_ANY, NULL, NULL, &medianStep, &percentileFinalize);
+    sqlite3_create_function(h, "median", 2, SQLITE_ANY, NULL, NULL, &medianStep, &percentileFinalize);
+    sqlite3_create_function(h, "percentile", 2, SQLITE_ANY, NULL, NULL, &percentileStep, &percentileFinalize);
+    sqlite3_create_function(h, "percentile", 3, SQLITE_ANY, NULL, NULL, &percentileStep, &percentileFinalize);
+    sqlite3_create_function(h, "median_approx", 1, SQLITE_ANY, NULL, NULL, &medianApproxStep, &percentileApproxFinalize);
+    sqlite3_create_function(h, "percentile_approx", 2, SQLITE_ANY, NULL, NULL, &percentileApproxStep, &percentileApproxFinalize);
+    sqlite3_create_function(h, "median_sketch", 1, SQLITE_ANY, NULL, NULL, &medianSketchStep, &percentileSketchFinalize);
+    sqlite3_create_function(h, "median_sketch", 2, SQLITE_ANY, NULL, NULL, &medianSketchStep, &percentileSketchFinalize);
+    sqlite3_create_function(h, "percentile_sketch", 2, SQLITE_ANY, NULL, NULL, &percentileSketchStep, &percentileSketchFinalize);
+    sqlite3_create_function(h, "percentile_sketch", 3, SQLITE_ANY, NULL, NULL, &percentileSketchStep, &percentileSketchFinalize);
+    sqlite3_create_function(h, "cov", 2, SQLITE_ANY, NULL, NULL, &comomentStep, &covFinalize);
+    sqlite3_create_function(h, "covar_samp", 2, SQLITE_ANY, NULL, NULL, &comomentStep, &covFinalize);
+    sqlite3_create_function(h, "covar_pop", 2, SQLITE_ANY, NULL, NULL, &comomentStep, &covFinalizePop);
+    sqlite3_create_function(h, "corr", 2, SQLITE_ANY, NULL, NULL, &comomentStep, &corrFinalize);
+    sqlite3_create_function(h, "weighted_mean", 2, SQLITE_ANY, NULL, NULL, &wmomentStep, &wmeanFinalize);
+    sqlite3_create_function(h, "weighted_var", 2, SQLITE_ANY, NULL, NULL, &wmomentStep, &wvarFinalize);
+    sqlite3_create_function(h, "ln", 1, SQLITE_ANY, NULL, &logFn, NULL, NULL);
+    sqlite3_create_function(h, "ran", 0, SQLITE_ANY, NULL, &rngFn, NULL, NULL);
+    sqlite3_create_function(h, "pow", 2, SQLITE_ANY, NULL, &powFn, NULL, NULL);
+
+#define sqlink(name) sqlite3_create_function(h, #name , 1, SQLITE_ANY, NULL, &name##Fn, NULL, NULL);
     sqlink(sqrt) sqlink(exp) sqlink(sin) sqlink(cos)
     sqlink(tan) sqlink(asin) sqlink(acos) sqlink(atan) sqlink(log) sqlink(log10)
-	apop_query("pragma short_column_names");
+    sqlite3_exec(h, "pragma short_column_names", NULL, NULL, NULL);
+    //Wait for other threads' writes to finish, rather than fail. Threading may be turned
+    //on after the database opens, so don't check apop_opts.thread_count here.
+    sqlite3_busy_timeout(h, 60000);
+}
+
+/* The prepared statements behind apop_query_bound and friends. Statements belong to
+   a connection, and connections to threads, so each thread has its own cache. When the
+   cache is full, the least recently used statement is finalized to make room. */
+#define Statement_cache_size 32
+
+struct stmt_cache {
+    struct {
+        char *query;
+        sqlite3_stmt *stmt;
+        unsigned long last_used;
+    } slots[Statement_cache_size];
+    int ct;
+    unsigned long clock;
+};
+
+static threadlocal struct stmt_cache *stmt_cache;
+static threadlocal unsigned long stmt_cache_generation;
+
+static void stmt_cache_free(struct stmt_cache *c){
+    for (int i=0; i< c->ct; i++){
+        sqlite3_finalize(c->slots[i].stmt);
+        free(c->slots[i].query);
+    }
+    free(c);
+}
+
+//Call with db_pool.lock held.
+static void sqlite_pool_close(void){
+    for (int i=0; i< db_pool.cachect; i++) //statements go before their connections.
+        stmt_cache_free(db_pool.caches[i]);
+    free(db_pool.caches);
+    db_pool.caches = NULL;
+    db_pool.cachect = 0;
+    for (int i=0; i< db_pool.handlect; i++)
+        sqlite3_close(db_pool.handles[i]);
+    free(db_pool.handles);
+    db_pool.handles = NULL;
+    db_pool.handlect = 0;
+    if (db_pool.main) sqlite3_close(db_pool.main);
+    db_pool.main = NULL;
+    free(db_pool.uri);
+    db_pool.uri = NULL;
+    __atomic_store_n(&db_pool.generation, db_pool.generation+1, __ATOMIC_RELEASE);
+}
+
+/* Return this thread's handle to the database. If another thread opened the database and
+   this thread hasn't connected yet, or its connection is to a since-closed database,
+   connect now. Return NULL if no database is open.
+
+   This runs on every query, so the usual case---this thread already has a connection,
+   and nobody has closed the database since---checks the generation without the lock. */
+static sqlite3 *sqlite_thread_db(void){
+    if (db && db_generation == __atomic_load_n(&db_pool.generation, __ATOMIC_ACQUIRE))
+        return db;
+    pthread_mutex_lock(&db_pool.lock);
+    if (db_generation != db_pool.generation) db = NULL; //closed by apop_db_close.
+    if (!db && db_pool.main){
+        db_generation = db_pool.generation;
+        if (!db_pool.uri) db = db_pool.main;
+        else if (sqlite3_open_v2(db_pool.uri, &db, db_pool.flags, NULL) != SQLITE_OK){
+            Apop_notify(0, "Couldn't open a connection to %s for this thread: %s. "
+                           "Sharing the main thread's.", db_pool.uri, sqlite3_errmsg(db));
+            sqlite3_close(db);
+            db = db_pool.main;
+        } else {
+            sqlite_register_functions(db);
+            db_pool.handles = realloc(db_pool.handles, sizeof(sqlite3*)*++db_pool.handlect);
+            db_pool.handles[db_pool.handlect-1] = db;
+        }
+    }
+    pthread_mutex_unlock(&db_pool.lock);
+    return db;
+}
+
+/* Other threads connect to the same database file. An in-memory database is normally
+   private to its connection, so if you'll be using threads, we put it in SQLite's memdb
+   VFS, under a name other connections in this process can open. If the database opened
+   before threading was turned on, other threads share the one handle (SQLite makes sure
+   they take turns). */
+static int apop_sqlite_db_open(char const *filename){
+    static int memdb_count;
+    pthread_mutex_lock(&db_pool.lock);
+    sqlite_pool_close(); //if there was a database open, let it go.
+    db = NULL;
+	if (filename){
+        sqlite3_open(filename, &db);
+        db_pool.uri = strdup(filename);
+        db_pool.flags = SQLITE_OPEN_READWRITE;
+    }
+#if SQLITE_VERSION_NUMBER >= 3036000
+    else if (apop_opts.thread_count > 1 && sqlite3_libversion_number() >= 3036000){
+        asprintf(&db_pool.uri, "file:/apop-%i-%i?vfs=memdb", (int)getpid(), memdb_count++);
+        db_pool.flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_URI;
+        sqlite3_open_v2(db_pool.uri, &db, db_pool.flags | SQLITE_OPEN_CREATE, NULL);
+    }
+#endif
+	else sqlite3_open(":memory:",&db);
+    db_pool.main = db;
+    db_generation = db_pool.generation;
+    pthread_mutex_unlock(&db_pool.lock);
+    apop_assert(db, "Not sure why, but the database didn't open.");
+    sqlite_register_functions(db);
+    if (apop_opts.db_scratch == 'y')
+        apop_query("pragma synchronous=off; pragma journal_mode=memory;");
+    else if (filename && apop_opts.thread_count > 1)
+        apop_query("pragma journal_mode=wal"); //readers don't block the writer, or each other.
     return 0;
 }
 
+/* Step through a prepared statement, and call row_fn on every row of output. Where
+   sqlite3_exec renders every value as text, this hands over the statement itself, so the
+   callback can fetch numbers as numbers. If row_fn returns nonzero, stop.
+   Returns NULL on success, or an error message; sqlite3_free it. */
+static char *sqlite_step(sqlite3_stmt *stmt, int (*row_fn)(void *info, sqlite3_stmt *stmt), void *info){
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+        if (row_fn && row_fn(info, stmt)) return sqlite3_mprintf("query aborted");
+    return (rc != SQLITE_DONE) ? sqlite3_mprintf("%s", sqlite3_errmsg(db)) : NULL;
+}
+
+//Run each statement in the query via sqlite_step.
+static char *sqlite_step_all(char const *query, int (*row_fn)(void *info, sqlite3_stmt *stmt), void *info){
+    char const *tail = query;
+    while (tail && *tail){
+        sqlite3_stmt *stmt = NULL;
+        if (sqlite3_prepare_v2(db, tail, -1, &stmt, &tail) != SQLITE_OK)
+            return sqlite3_mprintf("%s", sqlite3_errmsg(db));
+        if (!stmt) continue; //just white space or a comment
+        char *err = sqlite_step(stmt, row_fn, info);
+        sqlite3_finalize(stmt);
+        if (err) return err;
+    }
+    return NULL;
+}
+
+/* Get this thread's prepared version of the query, from the cache if possible, reset and
+   ready to bind. The query must be a single statement. On error, return NULL and put a
+   message in *err (sqlite3_free it). */
+static sqlite3_stmt *cached_statement(char const *query, char **err){
+    *err = NULL;
+    if (stmt_cache_generation != db_generation) stmt_cache = NULL; //closed by apop_db_close.
+    if (!stmt_cache){
+        stmt_cache = calloc(1, sizeof(struct stmt_cache));
+        stmt_cache_generation = db_generation;
+        pthread_mutex_lock(&db_pool.lock);
+        db_pool.caches = realloc(db_pool.caches, sizeof(struct stmt_cache*)*++db_pool.cachect);
+        db_pool.caches[db_pool.cachect-1] = stmt_cache;
+        pthread_mutex_unlock(&db_pool.lock);
+    }
+    struct stmt_cache *c = stmt_cache;
+    int oldest = 0;
+    for (int i=0; i< c->ct; i++){
+        if (!strcmp(c->slots[i].query, query)){
+            c->slots[i].last_used = ++c->clock;
+            sqlite3_reset(c->slots[i].stmt);
+            sqlite3_clear_bindings(c->slots[i].stmt);
+            return c->slots[i].stmt;
+        }
+        if (c->slots[i].last_used < c->slots[oldest].last_used) oldest = i;
+    }
+    sqlite3_stmt *stmt = NULL;
+    char const *tail;
+    if (sqlite3_prepare_v2(db, query, -1, &stmt, &tail) != SQLITE_OK){
+        *err = sqlite3_mprintf("%s", sqlite3_errmsg(db));
+        return NULL;
+    }
+    while (tail && (isspace(*tail) || *tail == ';')) tail++;
+    if (!stmt || (tail && *tail)){
+        *err = sqlite3_mprintf(stmt ? "only one SQL statement at a time, please."
+                                    : "no SQL statement");
+        sqlite3_finalize(stmt);
+        return NULL;
+    }
+    int slot = c->ct;
+    if (c->ct == Statement_cache_size){ //evict the least recently used.
+        slot = oldest;
+        sqlite3_finalize(c->slots[slot].stmt);
+        free(c->slots[slot].query);
+    } else c->ct++;
+    c->slots[slot].query = strdup(query);
+    c->slots[slot].stmt = stmt;
+    c->slots[slot].last_used = ++c->clock;
+    return stmt;
+}
+
+//NULL is NaN; text (which SQLite lets into any column) gets read via atof.
+static double column_to_double(sqlite3_stmt *stmt, int col){
+    int type = sqlite3_column_type(stmt, col);
+    if (type == SQLITE_NULL) return GSL_NAN;
+    if (type == SQLITE_INTEGER || type == SQLITE_FLOAT) return sqlite3_column_double(stmt, col);
+    return atof((char const *)sqlite3_column_text(stmt, col));
+}
+
 //these are global for the apop_db_to_... callbacks.
-int namecol;
-static int firstcall;
+static threadlocal int namecol;
+static threadlocal int firstcall;
 
 //This is the callback for apop_query_to_text.
 static int db_to_chars(void *o,int argc, char **argv, char **column){
@@ -227,7 +816,8 @@ static int db_to_chars(void *o,int argc, char **argv, char **column){
             apop_name_add(d->names, argv[jj], 'r'); 
             ncshift ++;
         } else {
-            asprintf(&(d->text[rows][jj-ncshift]), "%s", (argv[jj]==NULL)? "NaN": argv[jj]);
+            apop_arena_free(d->arena, d->text[rows][jj-ncshift]);
+            d->text[rows][jj-ncshift] = apop_arena_strdup(d->arena, (argv[jj]==NULL)? "NaN": argv[jj]);
             if(addnames)
                 apop_name_add(d->names, column[jj], 't'); 
         }
@@ -238,7 +828,7 @@ apop_data * apop_sqlite_query_to_text(char *query){
     char *err = NULL;
     apop_data *out = apop_data_alloc();
     firstcall = 1;
-    if (db==NULL) apop_db_open(NULL);
+    if (!sqlite_thread_db()) apop_db_open(NULL);
     sqlite3_exec(db, query, db_to_chars, out, &err); ERRCHECK_SET_ERROR(out)
     if (out->textsize[0]==0){
         apop_data_free(out);
@@ -251,6 +841,7 @@ typedef struct {
     apop_data  *d;
     int        intypes[5];//names, vectors, mcols, textcols, weights.
     int        current, thisrow, error_thrown;
+    size_t     space;     //rows allocated so far
     const char *instring;
 } apop_qt;
 
@@ -272,12 +863,23 @@ static void count_types(apop_qt *in, const char *intypes){
         Apop_notify(1, "You asked apop_query_to_mixed for multiple weighting vectors. I'll ignore all but the last one.");
 }
 
-static int multiquery_callback(void *instruct, int argc, char **argv, char **column){
+//Resize everything in the output to the given number of rows.
+static void multiquery_resize(apop_qt *in, size_t rows){
+    if (in->d->matrix)  apop_matrix_realloc(in->d->matrix, rows, in->intypes[2]);
+    if (in->d->vector)  apop_vector_realloc(in->d->vector, rows);
+    if (in->d->weights) apop_vector_realloc(in->d->weights, rows);
+    if (in->d->textsize[1])
+        in->d->text = realloc(in->d->text, sizeof(char **)*rows);
+    in->space = rows;
+}
+
+static int multiquery_callback(void *instruct, sqlite3_stmt *stmt){
     apop_qt *in = instruct;
     char c;
     int thistcol    = 0, 
         thismcol    = 0,
         colct       = 0,
+        argc        = sqlite3_column_count(stmt),
         i, addnames = 0;
     in->thisrow ++;
     if (!in->d) {
@@ -291,42 +893,39 @@ static int multiquery_callback(void *instruct, int argc, char **argv, char **col
             in->d->textsize[1]  = in->intypes[3];
             in->d->text         = malloc(sizeof(char***));
         }
+        in->space = 1;
     }
     if (!(in->d->names->colct + in->d->names->textct + (in->d->names->vector!=NULL)))
         addnames++;
+    if (in->thisrow > in->space) //out of room: double the space for rows.
+        multiquery_resize(in, 2*in->space);
     if (in->d->textsize[1]){
         in->d->textsize[0]         = in->thisrow;
-        in->d->text                = realloc(in->d->text, sizeof(char ***)*in->thisrow);
-        in->d->text[in->thisrow-1] = malloc(sizeof(char**) * in->d->textsize[1]);
+        in->d->text[in->thisrow-1] = apop_arena_malloc(in->d->arena, sizeof(char*) * in->d->textsize[1]);
     }
-    if (in->intypes[2])
-        apop_matrix_realloc(in->d->matrix, in->thisrow, in->intypes[2]);
     for (i=in->current=0; i< argc; i++){
-        c   = in->instring[in->current++];
+        c   = in->instring[in->current];
+        if (c) in->current++;
         if (c=='n'||c=='N'){
-            apop_name_add(in->d->names, (argv[i]? argv[i] : "NaN")  , 'r'); 
+            char const *name = (char const *)sqlite3_column_text(stmt, i);
+            apop_name_add(in->d->names, (name ? name : "NaN")  , 'r'); 
             if(addnames)
-                apop_name_add(in->d->names, column[i], 'h'); 
+                apop_name_add(in->d->names, sqlite3_column_name(stmt, i), 'h'); 
         } else if (c=='v'||c=='V'){
-            apop_vector_realloc(in->d->vector, in->thisrow);
-            apop_data_set(in->d, in->thisrow-1, -1, 
-                                    argv[i] ? atof(argv[i]) : GSL_NAN);
+            gsl_vector_set(in->d->vector, in->thisrow-1, column_to_double(stmt, i));
             if(addnames)
-                apop_name_add(in->d->names, column[i], 'v'); 
+                apop_name_add(in->d->names, sqlite3_column_name(stmt, i), 'v'); 
         } else if (c=='m'||c=='M'){
-            apop_data_set(in->d, in->thisrow-1, thismcol++, 
-                                    argv[i] ? atof(argv[i]) : GSL_NAN);
+            gsl_matrix_set(in->d->matrix, in->thisrow-1, thismcol++, column_to_double(stmt, i));
             if(addnames)
-                apop_name_add(in->d->names, column[i], 'c'); 
+                apop_name_add(in->d->names, sqlite3_column_name(stmt, i), 'c'); 
         } else if (c=='t'||c=='T'){
-            asprintf(&(in->d->text[in->thisrow-1][thistcol++]), "%s", 
-			                        argv[i] ? argv[i] : "NaN");
+            char const *text = (char const *)sqlite3_column_text(stmt, i);
+            in->d->text[in->thisrow-1][thistcol++] = apop_arena_strdup(in->d->arena, text ? text : "NaN");
             if(addnames)
-                apop_name_add(in->d->names, column[i], 't'); 
+                apop_name_add(in->d->names, sqlite3_column_name(stmt, i), 't'); 
         } else if (c=='w'||c=='W'){
-            apop_vector_realloc(in->d->weights, in->thisrow);
-            gsl_vector_set(in->d->weights, in->thisrow-1, 
-                                    argv[i] ? atof(argv[i]) : GSL_NAN);
+            gsl_vector_set(in->d->weights, in->thisrow-1, column_to_double(stmt, i));
         }
         colct++;
     }
@@ -340,13 +939,13 @@ static int multiquery_callback(void *instruct, int argc, char **argv, char **col
 apop_data *apop_sqlite_multiquery(const char *intypes, char *query){
     apop_assert(intypes, "You gave me NULL for the list of input types. I can't work with that.");
     apop_assert(query, "You gave me a NULL query. I can't work with that.");
-    char *err = NULL;
     apop_qt info = { };
     count_types(&info, intypes);
-	if (!db) apop_db_open(NULL);
-    sqlite3_exec(db, query, multiquery_callback, &info, &err); 
-    Apop_stopif(info.error_thrown, if (!info.d) apop_data_alloc(); info.d->error='d'; return info.d,
-            0, "dimension error");
+	if (!sqlite_thread_db()) apop_db_open(NULL);
+    char *err = sqlite_step_all(query, multiquery_callback, &info);
+    if (info.d) multiquery_resize(&info, info.thisrow);
+    Apop_stopif(info.error_thrown, if (!info.d) info.d = apop_data_alloc(); info.d->error='d';
+            sqlite3_free(err); return info.d, 0, "dimension error");
     ERRCHECK_SET_ERROR(info.d)
 	return info.d;
 }
@@ -17,6 +17,9 @@
    then dispatches segments do different threads, and either the vectorloop or forloop that does all the
    actual math.
 
+   apop_map and apop_map_sum instead gather every page into a single list of work and
+   hand that to the thread pool in one go.
+
  */
 #include "apop_internal.h"
 static gsl_vector*mapply_core(gsl_matrix *m, gsl_vector *vin, void *fn, gsl_vector *vout, int use_index, int use_param,void *param, char post_22);
@@ -36,6 +39,76 @@ typedef double apop_fn_vi(gsl_vector*, int);
 typedef double apop_fn_di(double, int);
 typedef double apop_fn_ri(apop_data*, int);
 
+/* apop_map works in two passes. First, walk the pages (just the first, unless
+   all_pages='y'), allocating the output pages and listing the work to be done on each
+   as a segment. Then run every segment as a single job on the thread pool (see map_run,
+   below), so a chain of short pages gets spread over the threads just like one long page. */
+struct map_segment;
+typedef struct {
+    void *fn;
+    apop_fn_r *fn_r; apop_fn_rp *fn_rp; apop_fn_rpi *fn_rpi; apop_fn_ri *fn_ri;
+    void *param;
+    int use_index, use_param, by_apop_rows, inplace, all_pages;
+    char part;
+    struct map_segment *segs;
+    int segct;
+    size_t ct; //units of work, summed over all segments
+} map_job;
+static void map_add_segment(map_job *job, apop_data *in, apop_data *out, char kind);
+static void map_run(map_job *job);
+
+//Allocate the output for this page and queue up its work, then do the same for the next page.
+static apop_data *map_prep_page(apop_data *in, map_job *job){
+    char part = job->part;
+    Apop_stop_if_columns(in, apop_data *out=apop_data_alloc(); out->error='p'; return out);
+    Get_vmsizes(in); //vsize, msize1, msize2, maxsize
+    apop_data *out = NULL;
+    if (job->inplace)
+       out = in;
+    else 
+         out = job->by_apop_rows ? apop_data_alloc(GSL_MAX(in->textsize[0], maxsize))
+             : part == 'v' || (in->vector && ! in->matrix) ? apop_data_alloc(vsize)
+             : part == 'm' ? apop_data_alloc(msize1, msize2)
+             : part == 'a' ? apop_data_alloc(vsize, msize1, msize2)
+             : part == 'r' ? apop_data_alloc(msize1)
+             : part == 'c' ?  apop_data_alloc(msize2) : NULL;
+    if (in->names){
+        if (part == 'v'  || (in->vector && ! in->matrix)) {
+             apop_name_stack(out->names, in->names, 'v');
+             apop_name_stack(out->names, in->names, 'r');
+        }
+        else if (part == 'm'){
+             apop_name_stack(out->names, in->names, 'r');
+             apop_name_stack(out->names, in->names, 'c');
+        }
+        else if (job->by_apop_rows || part == 'a')
+             out->names = apop_name_copy(in->names);
+        else if (part == 'r')
+             apop_name_stack(out->names, in->names, 'r');
+        else if (part == 'c')
+            apop_name_stack(in->names, out->names, 'r', 'c');
+    }
+
+    if (job->by_apop_rows)
+        map_add_segment(job, in, out, 'r');
+    else {
+        if (in->vector && (part == 'v' || part=='a'))
+            map_add_segment(job, in, out, 'v');
+        if (in->matrix && (part == 'm' || part=='a'))
+            map_add_segment(job, in, out, 'e');
+        if (part == 'r' || part == 'c'){
+            Apop_stopif(!in->matrix, if (!out) out=apop_data_alloc(); out->error='p'; return out,
+                           0, "You asked for me to operate on the %cs of the matrix, but the matrix is NULL.", part);
+            map_add_segment(job, in, out, 'm');
+        }
+    }
+    if (job->all_pages && in->more){
+        out->more = map_prep_page(in->more, job);
+        Apop_stopif(out->more->error, out->error=out->more->error, 1, "Error in subpage; marked parent page with same error code.");
+    }
+    return out;
+}
+
 
 /**
   Apply a function to every element of a data set, matrix or vector; or, apply a vector-taking function to every row or column of a matrix.
@@ -87,13 +160,13 @@ if you set \c inplace='n', then I will return an \ref apop_data set whose \c vec
 element is as long as your data set (i.e., as long as the longest of your text, vector,
 or matrix parts).
 
-\li If you set <tt>apop_opts.thread_count</tt> to a value greater than one, I will split the data set into as many chunks as you specify, and process them simultaneously. You need to watch out for the usual hang-ups about multithreaded programming, but if your data is iid, and each row's processing is independent of the others, you should have no problems. Bear in mind that generating threads takes some small overhead, so simple cases like adding a few hundred numbers will actually be slower when threading.
+\li If you set <tt>apop_opts.thread_count</tt> to a value greater than one, I will split the data set into chunks and process them simultaneously on that many threads. Threads that finish their chunks early take over chunks from threads that are running behind, so rows of very uneven cost balance out; set <tt>apop_opts.thread_chunk_size</tt> to control the size of the chunks. You need to watch out for the usual hang-ups about multithreaded programming, but if your data is iid, and each row's processing is independent of the others, you should have no problems. The threads are started on the first threaded call and then kept waiting for the next job, so there is no per-call thread-creation cost; still, handing out the work takes some small overhead, so simple cases like adding a few hundred numbers may be no faster when threading.
 
 \param inplace  If zero, generate a new \ref apop_data set for output, which will contain the mapped values (and the names from the original set). If one, modify in place. The \c double \f$\to\f$ \c double versions, \c 'v', \c 'm', and \c 'a', write to exactly the same location as before. The \c gsl_vector \f$\to\f$ \c double versions, \c 'r', and \c 'c', will write to the vector. Be careful: if you are writing in place and there is already a vector there, then the original vector is lost. (Default = 0)
 
 \param all_pages If \c 'y', then I follow the \c more pointer to subsequent pages, else I
-handle only the first page of data. [I abuse this for an internal semaphore, by the way, so your input must always be nonnegative and  less than 1,000. Of course, 'y' and 'n' fit these rules fine.]
-Default: \c 'n'. 
+handle only the first page of data. All the pages are handed to the threads as one job, so
+a data set with many short pages threads as well as one with a single long page. Default: \c 'n'. 
 
 \return if <tt>.inplace='n'</tt> (the default), a newly allocated \ref apop_data set representing the result of mapping your function onto the input data set. if <tt>.inplace='y'</tt>, a pointer to your original data set, modified in place.
 
@@ -133,87 +206,23 @@ APOP_VAR_ENDHEAD
                         0, "You asked for a vector-oriented operation (.part='r' or .part='c'), but "
                         "gave me a scalar-oriented function. Did you mean part=='a'?");
 
-    //Allocate output
-    Get_vmsizes(in); //vsize, msize1, msize2, maxsize
-    apop_data *out = NULL;
-    if (inplace)
-       out = in;
-    else 
-         out = by_apop_rows ? apop_data_alloc(GSL_MAX(in->textsize[0], maxsize))
-             : part == 'v' || (in->vector && ! in->matrix) ? apop_data_alloc(vsize)
-             : part == 'm' ? apop_data_alloc(msize1, msize2)
-             : part == 'a' ? apop_data_alloc(vsize, msize1, msize2)
-             : part == 'r' ? apop_data_alloc(msize1)
-             : part == 'c' ?  apop_data_alloc(msize2) : NULL;
-    if (in->names){
-        if (part == 'v'  || (in->vector && ! in->matrix)) {
-             apop_name_stack(out->names, in->names, 'v');
-             apop_name_stack(out->names, in->names, 'r');
-        }
-        else if (part == 'm'){
-             apop_name_stack(out->names, in->names, 'r');
-             apop_name_stack(out->names, in->names, 'c');
-        }
-        else if (by_apop_rows || part == 'a')
-             out->names = apop_name_copy(in->names);
-        else if (part == 'r')
-             apop_name_stack(out->names, in->names, 'r');
-        else if (part == 'c')
-            apop_name_stack(in->names, out->names, 'r', 'c');
-    }
-
-#define PLACE(fn) {if (inplace == 'y') fn; else gsl_vector_set(out->vector, i, fn);}
-
-    //Call mapply_core.
-    if (by_apop_rows){
-        for (size_t i=0; i<GSL_MAX(in->textsize[0], maxsize); i++){
-            Apop_data_row(in, i, the_row);
-            if (fn_r) PLACE(fn_r(the_row))
-            else if (fn_rp)
-                PLACE(fn_rp(the_row, param))
-            else if (fn_rpi)
-                PLACE(fn_rpi(the_row, param, i))
-            else if (fn_ri)
-                PLACE(fn_ri(the_row, i))
-        }
-    } else {
-        if (in->vector && (part == 'v' || part=='a'))
-            mapply_core(NULL, in->vector, fn, out->vector, use_index, use_param, param, 'r');
-        if (in->matrix && (part == 'm' || part=='a')){
-            int smaller_dim = GSL_MIN(in->matrix->size1, in->matrix->size2);
-            for (int i=0; i< smaller_dim; i++){
-                if (smaller_dim == in->matrix->size1){
-                    Apop_row(in, i, onevector);
-                    Apop_row(out, i, twovector);
-                    mapply_core(NULL, onevector, fn, twovector, use_index, use_param, param, 'r');
-                }else{
-                    Apop_col(in, i, onevector);
-                    Apop_col(out, i, twovector);
-                    mapply_core(NULL, onevector, fn, twovector, use_index, use_param, param, 'c');
-                }
-            }
-        }
-        if (part == 'r' || part == 'c'){
-            Apop_stopif(!in->matrix, if (!out) out=apop_data_alloc(); out->error='p'; return out,
-                           0, "You asked for me to operate on the %cs of the matrix, but the matrix is NULL.", part);
-            mapply_core(in->matrix, NULL, fn, out->vector, use_index, use_param, param, part);
-        }
-    }
-    if ((all_pages=='y' || all_pages=='Y') && in->more){
-        out->more = apop_map_base(in->more, fn_d, fn_v, fn_r, fn_dp, fn_vp, fn_rp, fn_dpi, fn_vpi, fn_rpi, fn_di, fn_vi, fn_ri, param, inplace, part, all_pages);
-        Apop_stopif(out->more->error, out->error=out->more->error, 1, "Error in subpage; marked parent page with same error code.");
-    }
+    map_job job = {.fn=fn, .fn_r=fn_r, .fn_rp=fn_rp, .fn_rpi=fn_rpi, .fn_ri=fn_ri, .param=param,
+                   .use_index=use_index, .use_param=use_param, .by_apop_rows=by_apop_rows,
+                   .inplace=inplace, .part=part, .all_pages=(all_pages=='y' || all_pages=='Y')};
+    apop_data *out = map_prep_page(in, &job);
+    map_run(&job);
     return out;
 }
 
 typedef struct {
-    size_t      *limlist;
+    size_t      limlist[2];
     void        *fn;
     gsl_matrix  *m;
     gsl_vector  *v, *vin;
     int use_index, use_param;
     char rc;
     void *param;
+    void *(*loop)(void*);
 } threadpass;
 
 static void *forloop(void *t){
@@ -282,43 +291,175 @@ static void *oldvectorloop(void *t){
     return NULL;
 }
 
-static size_t *threadminmax(const int threadno, const int totalct, const int threadct){
-    int segment_size = totalct/threadct;
-    size_t *out = malloc(sizeof(size_t)*3);
-    out[0] = threadno*segment_size;
-    out[1] = (threadno==threadct-1) ? totalct : (threadno+1)*segment_size;
-    out[2] = threadno;
-    return out;
+//apop_threadpool_for hands us a chunk of rows; run the loop on just those.
+static void mapply_chunk(void *in, size_t lo, size_t hi, int slot){
+    threadpass tc = *(threadpass*)in;
+    tc.limlist[0] = lo;
+    tc.limlist[1] = hi;
+    tc.loop(&tc);
 }
 
 static gsl_vector*mapply_core(gsl_matrix *m, gsl_vector *vin, void *fn, gsl_vector *vout, int use_index, int use_param,void *param, char post_22){
-    int           threadct    = apop_opts.thread_count;
-    pthread_t     thread_id[threadct];
-    int           i;
-    threadpass    tp[threadct];
-    for (i=0 ; i<threadct; i++)
-        tp[i] = (threadpass) {
-            .limlist   = threadminmax(i, 
-                    m? ((!post_22 || post_22 == 'r') ? m->size1 : m->size2) : vin->size ,threadct),
+    threadpass tp = (threadpass) {
             .fn = fn,   .m = m, 
             .vin = vin, .v = vout,
             .use_index = use_index, .use_param= use_param,
-            .param = param, .rc = post_22
+            .param = param, .rc = post_22,
+            .loop = m ? (post_22 ? forloop : oldforloop)
+                      : (post_22 ? vectorloop : oldvectorloop)
         };
-    if (threadct==1){ //don't thread.
-        if (m)  post_22 ? forloop(tp) : oldforloop(tp);
-        else    post_22 ? vectorloop(tp) : oldvectorloop(tp);
-    } else {
-        for (i=0 ; i<threadct; i++){
-            if (m)  pthread_create(&thread_id[i], NULL,post_22 ? forloop : oldforloop,(tp+i));
-            else    pthread_create(&thread_id[i], NULL,post_22 ? vectorloop : oldvectorloop,(tp+i));
+    size_t ct = m? ((!post_22 || post_22 == 'r') ? m->size1 : m->size2) : vin->size;
+    apop_threadpool_for(mapply_chunk, &tp, ct, apop_opts.thread_count);
+    return vout;
+}
+
+/* The row-wise functions get one row at a time as an apop_data set. Apop_data_row
+   would build a full set of views (including a copy of the names struct) for every row;
+   here the views are set up once per chunk, and then each row just repoints the data
+   pointers. What the user's function sees is the same as what Apop_data_row would give. */
+typedef struct {
+    gsl_vector v, w;
+    gsl_matrix m;
+    apop_name n;
+    apop_data d;
+} row_view;
+
+static void row_view_init(row_view *rv, apop_data *in){
+    *rv = (row_view){};
+    if (in->vector) {rv->v = *in->vector; rv->v.size = 1; rv->v.owner = 0;}
+    if (in->weights){rv->w = *in->weights; rv->w.size = 1; rv->w.owner = 0;}
+    if (in->matrix) {rv->m = *in->matrix; rv->m.size1 = 1; rv->m.owner = 0;}
+    if (in->names) rv->n = (apop_name){.vector = in->names->vector, .column = in->names->column,
+                                       .text = in->names->text, .colct = in->names->colct,
+                                       .textct = in->names->textct};
+}
+
+static apop_data *row_view_set(row_view *rv, apop_data *in, size_t row){
+    rv->d = (apop_data){.textsize = {in->textsize[0] ? 1 : 0, in->textsize[1]},
+                        .text = in->text ? in->text + row : NULL};
+    if (in->vector && in->vector->size > row){
+        rv->v.data = in->vector->data + row * in->vector->stride;
+        rv->d.vector = &rv->v;
+    }
+    if (in->weights && in->weights->size > row){
+        rv->w.data = in->weights->data + row * in->weights->stride;
+        rv->d.weights = &rv->w;
+    }
+    if (in->matrix && in->matrix->size1 > row){
+        rv->m.data = in->matrix->data + row * in->matrix->tda;
+        rv->d.matrix = &rv->m;
+    }
+    if (in->names){
+        rv->n.row = (in->names->row && in->names->rowct > row) ? in->names->row + row : NULL;
+        rv->n.rowct = rv->n.row ? 1 : 0;
+        rv->d.names = &rv->n;
+    }
+    return &rv->d;
+}
+
+/* One page's worth of apop_map work, covering [start, start+ct) of the whole job. Kinds:
+   'r' = rows of the page as apop_data sets (the fn_r family); the count includes text-only rows
+   'v' = elements of the vector
+   'e' = elements of the matrix, run along the rows or columns (rc), whichever is longer
+   'm' = rows or columns of the matrix (part='r' or 'c') as vectors
+*/
+typedef struct map_segment {
+    apop_data *in, *out;
+    size_t start, ct;
+    char kind, rc;
+    threadpass tp;
+} map_segment;
+
+static void map_add_segment(map_job *job, apop_data *in, apop_data *out, char kind){
+    Get_vmsizes(in); //maxsize
+    map_segment seg = {.in=in, .out=out, .start=job->ct, .kind=kind,
+                       .tp = {.fn = job->fn, .use_index = job->use_index,
+                              .use_param = job->use_param, .param = job->param}};
+    if (kind == 'r')
+        seg.ct = GSL_MAX(in->textsize[0], maxsize);
+    else if (kind == 'v'){
+        seg.ct = in->vector->size;
+        seg.tp.vin = in->vector;
+        seg.tp.v = out->vector;
+        seg.tp.loop = vectorloop;
+    } else if (kind == 'e'){
+        //Same traversal as always: the index sent to fn_di & co. is the position within a
+        //row if there are fewer rows than columns, else the position within a column.
+        seg.ct = in->matrix->size1 * in->matrix->size2;
+        seg.rc = in->matrix->size1 <= in->matrix->size2 ? 'r' : 'c';
+    } else if (kind == 'm'){
+        seg.ct = job->part == 'r' ? in->matrix->size1 : in->matrix->size2;
+        seg.tp.m = in->matrix;
+        seg.tp.v = out->vector;
+        seg.tp.rc = job->part;
+        seg.tp.loop = forloop;
+    }
+    if (!seg.ct) return;
+    job->segs = realloc(job->segs, sizeof(map_segment)*(job->segct+1));
+    job->segs[job->segct++] = seg;
+    job->ct += seg.ct;
+}
+
+static void map_rows(map_job *j, map_segment *seg, size_t lo, size_t hi){
+    apop_data *in = seg->in, *out = seg->out;
+    row_view rv;
+    row_view_init(&rv, in);
+#define PLACE(fn) {if (j->inplace == 'y') fn; else gsl_vector_set(out->vector, i, fn);}
+    for (size_t i=lo; i< hi; i++){
+        apop_data *the_row = row_view_set(&rv, in, i);
+        if (j->fn_r) PLACE(j->fn_r(the_row))
+        else if (j->fn_rp)
+            PLACE(j->fn_rp(the_row, j->param))
+        else if (j->fn_rpi)
+            PLACE(j->fn_rpi(the_row, j->param, i))
+        else if (j->fn_ri)
+            PLACE(j->fn_ri(the_row, i))
+    }
+#undef PLACE
+}
+
+//Elements [lo, hi) of the matrix, counting along rows (or columns, if rc=='c').
+static void map_elements(map_segment *seg, size_t lo, size_t hi){
+    gsl_matrix *m = seg->in->matrix, *mout = seg->out->matrix;
+    size_t len = seg->rc == 'r' ? m->size2 : m->size1;
+    while (lo < hi){
+        size_t line = lo/len, pos = lo%len;
+        size_t end = GSL_MIN(len, pos + (hi-lo));
+        gsl_vector vin = seg->rc == 'r' ? gsl_matrix_row(m, line).vector : gsl_matrix_column(m, line).vector;
+        gsl_vector vout = seg->rc == 'r' ? gsl_matrix_row(mout, line).vector : gsl_matrix_column(mout, line).vector;
+        threadpass tc = seg->tp;
+        tc.vin = &vin;
+        tc.v = &vout;
+        tc.limlist[0] = pos;
+        tc.limlist[1] = end;
+        vectorloop(&tc);
+        lo += end - pos;
+    }
+}
+
+//The thread pool hands us a chunk of the whole job, which may span several segments.
+static void map_chunk(void *in, size_t lo, size_t hi, int slot){
+    map_job *j = in;
+    for (int s=0; s< j->segct && lo < hi; s++){
+        map_segment *seg = j->segs+s;
+        if (lo >= seg->start + seg->ct) continue;
+        size_t from = lo - seg->start,
+               to = GSL_MIN(hi, seg->start + seg->ct) - seg->start;
+        if (seg->kind == 'r') map_rows(j, seg, from, to);
+        else if (seg->kind == 'e') map_elements(seg, from, to);
+        else {
+            threadpass tc = seg->tp;
+            tc.limlist[0] = from;
+            tc.limlist[1] = to;
+            tc.loop(&tc);
         }
-        for (i=0 ; i<threadct; i++)
-            pthread_join(thread_id[i], NULL);
+        lo = seg->start + to;
     }
-    for (i=0 ; i<threadct; i++)
-        free(tp[i].limlist);
-    return vout;
+}
+
+static void map_run(map_job *job){
+    apop_threadpool_for(map_chunk, job, job->ct, apop_opts.thread_count);
+    free(job->segs);
 }
 
 /** \defgroup mapply Map or apply a function to a vector or matrix
@@ -329,7 +470,7 @@ There are two types, which were developed at different times. The \ref apop_map
 
 Here are a few technical details of usage:
 
-\li If \c apop_opts.thread_count is greater than one, then the matrix will be broken into chunks and each sent to a different thread. Notice that the GSL is generally threadsafe, and SQLite is threadsafe conditional on several commonsense caveats that you'll find in the SQLite documentation.
+\li If \c apop_opts.thread_count is greater than one, then the matrix will be broken into chunks and each sent to a different thread. The threads are started on first use and kept waiting between calls; if you change \c apop_opts.thread_count, the next call will resize the set of waiting threads. Notice that the GSL is generally threadsafe, and SQLite is threadsafe conditional on several commonsense caveats that you'll find in the SQLite documentation.
 
 \li Apart from \ref apop_map_sum (which does minimal internal allocation), the \c ...sum functions are convenience functions that just call \c ...map and then add up the contents. Thus, you will need to have adequate memory for the allocation of the temp matrix/vector.
 \{ */
@@ -469,78 +610,152 @@ double apop_matrix_map_sum(const gsl_matrix *in, double (*fn)(gsl_vector*)){
     return out;
 }
 
-/*I abuse the macro system to do threading, because the variadic function takes
-     exactly one input, which is what the pthread_create function needs. The alternative,
-     writing a function to handle every argument to apop_map_sum to re-generate the
-     variadic_apop_map_sum_type struct, would be an uglier hack.
+/* apop_map_sum keeps a compensated sum (Neumaier's variant of Kahan summation): the
+   running total, plus the low-order bits that fell off the end of the total so far.
+   It's a few more flops per element, which is noise next to the function call.
+   If the total hits +/-inf, the compensation term is garbage, so skip it. */
+typedef struct {
+    double sum, c;
+} kahan_sum;
 
-     This function wraps variadic_apop_map_sum so that we're of the form pthread wants, void *(*)(void*),
-     instead of double (*)(variadic_type_apop_map_sum).  The main of
-     variadic_apop_map_sum just uses Apop_data_rows (and some abuse of that macro's
-     internals) to generate the subsets, then each thread calls this function to do the work.
+static void kahan_add(kahan_sum *k, double x){
+    double t = k->sum + x;
+    k->c += (fabs(k->sum) >= fabs(x)) ? (k->sum - t) + x : (x - t) + k->sum;
+    k->sum = t;
+}
 
-     How does apop_map_sum know if it's in the middle of a thread? I add 1000 to the all_pages integer. 
-     If threadct =0 or all_pages >=1000, then process as normal.
-*/
-void *apop_map_sum_for_threading(void *in){
-    double *val = malloc(sizeof(double));
-    *val = variadic_apop_map_sum(*(variadic_type_apop_map_sum*)in);
-    return val;
+static double kahan_total(kahan_sum k){ return gsl_finite(k.c) ? k.sum + k.c : k.sum; }
+
+/* For the reproducible sum, each page is cut into blocks of this many rows,
+   whatever the thread count or chunk size. Each block is summed on its own, then the
+   block sums are added up in order. */
+static const size_t repro_block = 1024;
+
+/* With all_pages='y', every page goes into the same job. Page p covers rows
+   [start, start+ct) of the job, and blocks [firstblock, firstblock+blockct). */
+typedef struct {
+    apop_data *in;
+    size_t start, ct, firstblock, blockct;
+} map_sum_page;
+
+typedef struct {
+    apop_fn_d *fn_d; apop_fn_v *fn_v; apop_fn_r *fn_r;
+    apop_fn_dp *fn_dp; apop_fn_vp *fn_vp; apop_fn_rp *fn_rp;
+    apop_fn_dpi *fn_dpi; apop_fn_vpi *fn_vpi; apop_fn_rpi *fn_rpi;
+    apop_fn_di *fn_di; apop_fn_vi *fn_vi; apop_fn_ri *fn_ri;
+    void *param;
+    char part;
+    map_sum_page *pages;
+    int pagect;
+    kahan_sum *sums;
+} map_sum_job;
+
+/* A page stored by columns (apop_data_to_columns) has no ->matrix, but its ->columns is
+   the transpose, so the element and row/column functions can still read it. */
+#define Get_column_sizes(in) \
+    if ((in)->columns && !(in)->matrix){ msize1 = (in)->columns->size2; msize2 = (in)->columns->size1; }
+
+//Rows on this page (or columns if part=='c') that the function will be applied to.
+static size_t map_sum_count(map_sum_job *j, apop_data *in){
+    Get_vmsizes(in); //vsize, msize1, msize2, maxsize
+    if (j->fn_r || j->fn_ri || j->fn_rpi || j->fn_rp)
+        return GSL_MAX(maxsize, in->textsize[0]);
+    Get_column_sizes(in);
+    if (j->part =='m' || j->part == 'v' || j->part == 'a')
+        return GSL_MAX(vsize, msize1);
+    return (j->part=='r') ? msize1 : (j->part=='c') ? msize2 : 0;
+}
+
+//Sum the function values for rows [lo, hi) (or columns, if part=='c') of one page.
+static kahan_sum map_sum_rows(map_sum_job *j, apop_data *in, size_t lo, size_t hi){
+    kahan_sum sum = {}, *out = &sum;
+    void *param = j->param;
+    Get_vmsizes(in); //firstcol, msize2
+    Get_column_sizes(in);
+    if (j->fn_r || j->fn_ri || j->fn_rpi || j->fn_rp){
+        row_view rv;
+        row_view_init(&rv, in);
+        for (size_t i=lo; i < hi; i++){
+            apop_data *arow = row_view_set(&rv, in, i);
+            if (j->fn_r) kahan_add(out, j->fn_r(arow));
+            else if (j->fn_rp) kahan_add(out, j->fn_rp(arow, param));
+            else if (j->fn_ri) kahan_add(out, j->fn_ri(arow, i));
+            else               kahan_add(out, j->fn_rpi(arow, param, i));
+        }
+    } else if (j->part =='m' || j->part == 'v' || j->part == 'a'){
+        if (j->part =='m') firstcol= 0; //don't traverse vector, even if present
+        if (j->part =='v') msize2= 0; //don't traverse matrix, even if present
+        for (size_t i=lo; i < hi; i++)
+            for (int k=firstcol; k < msize2; k++){
+                double val = apop_data_get(in, i, k);
+                if (j->fn_d) kahan_add(out, j->fn_d(val));
+                else if (j->fn_dp) kahan_add(out, j->fn_dp(val, param));
+                else if (j->fn_di) kahan_add(out, j->fn_di(val, i));
+                else               kahan_add(out, j->fn_dpi(val, param, i));
+            }
+    } else {
+        gsl_vector_view v;
+        for (size_t i=lo; i < hi; i++){
+            if (in->matrix)
+                v = (j->part=='r')
+                    ? gsl_matrix_row(in->matrix, i)
+                    : gsl_matrix_column(in->matrix, i);
+            else
+                v = (j->part=='r')
+                    ? gsl_matrix_column(in->columns, i)
+                    : gsl_matrix_row(in->columns, i);
+            if       (j->fn_v)  kahan_add(out, j->fn_v(&v.vector));
+            else if (j->fn_vp)  kahan_add(out, j->fn_vp(&v.vector, param));
+            else if (j->fn_vi)  kahan_add(out, j->fn_vi(&v.vector, i));
+            else                kahan_add(out, j->fn_vpi(&v.vector, param, i));
+        }
+    }
+    return sum;
+}
+
+/* The thread pool hands us a chunk of rows, possibly running over several pages, which
+   we add to this thread's running sum. */
+static void map_sum_chunk(void *in, size_t lo, size_t hi, int slot){
+    map_sum_job *j = in;
+    for (int p=0; p< j->pagect && lo < hi; p++){
+        map_sum_page *page = j->pages+p;
+        if (lo >= page->start + page->ct) continue;
+        size_t to = GSL_MIN(hi, page->start + page->ct);
+        kahan_sum chunk = map_sum_rows(j, page->in, lo - page->start, to - page->start);
+        kahan_add(j->sums+slot, chunk.sum);
+        kahan_add(j->sums+slot, chunk.c);
+        lo = to;
+    }
+}
+
+//The thread pool hands us a chunk of blocks; each block gets its own sum.
+static void map_sum_blocks(void *in, size_t lo, size_t hi, int slot){
+    map_sum_job *j = in;
+    int p = 0;
+    for (size_t b=lo; b < hi; b++){
+        while (b >= j->pages[p].firstblock + j->pages[p].blockct) p++;
+        map_sum_page *page = j->pages+p;
+        size_t first = (b - page->firstblock)*repro_block;
+        j->sums[b] = map_sum_rows(j, page->in, first, GSL_MIN(first + repro_block, page->ct));
+    }
 }
 
 /** A function that effectively calls \ref apop_map and returns the sum of the resulting elements. Thus, this function returns a single \c double. See the \ref apop_map page for details of the inputs, which are the same here, except that \c inplace doesn't make sense---this function will always just add up the input function outputs.
 
   See also the \ref mapply "map/apply page" for details.
 
+\param reproducible The sum is compensated (Kahan-style), so it is accurate, but if
+<tt>apop_opts.thread_count > 1</tt> the rows are split among threads in an order that
+depends on the thread count and timing, so the last bits of the sum may change from run
+to run. If you need exactly the same answer every time regardless of thread count (e.g.,
+so that an MLE search takes exactly the same path), set <tt>.reproducible='y'</tt>. Then
+I add up fixed blocks of rows and combine them in a fixed order, at the cost of a little
+scheduling overhead. Default: \c 'n'.
+
 \li I don't copy the input data to send to your input function. Therefore, if your function modifies its inputs as a side-effect, your data set will be modified as this function runs.
  \ingroup mapply
  */
-APOP_VAR_HEAD double apop_map_sum(apop_data *in, apop_fn_d *fn_d, apop_fn_v *fn_v, apop_fn_r *fn_r, apop_fn_dp *fn_dp, apop_fn_vp *fn_vp, apop_fn_rp *fn_rp, apop_fn_dpi *fn_dpi,  apop_fn_vpi *fn_vpi, apop_fn_rpi *fn_rpi, apop_fn_di *fn_di, apop_fn_vi *fn_vi, apop_fn_ri *fn_ri, void *param, char part, int all_pages){ 
-
-    //The first half of the wrapper function is about threading. See notes attached to apop_map_sum_for_threading.
-    int threadct = apop_opts.thread_count;
-    if (threadct > 1 && varad_in.all_pages <1000){
-        pthread_t     thread_id[threadct];
-        variadic_type_apop_map_sum inputs[threadct];
-        apop_data slices[threadct];
-        gsl_vector v[threadct], w[threadct];
-        gsl_matrix m[threadct];
-        Get_vmsizes(varad_in.in);
-        int totalct = GSL_MAX(vsize, GSL_MAX(msize1, varad_in.in->textsize[0]));
-        int segment_size  = totalct/threadct;
-        for (int i=0 ; i<threadct; i++){
-            inputs[i] = varad_in;
-            /*Copy the inputs, use Apop_data_rows to get slices, use all_pages to mark that this is
-            in-thread processing, then run this function on the subsetted copy of the inputs.  
-            The tedium is in copying the substructures (but not data) so they persist past the loop. */
-            int bottom=i*segment_size;
-            Apop_data_rows(varad_in.in, bottom, i==threadct-1 ? totalct-bottom : segment_size, somerows);
-            slices[i] = *somerows; //copy the struct, because on the next loop it'll be different.
-            v[i] = somerows->vector ? *(somerows->vector): (gsl_vector){};
-            w[i] = somerows->weights ? *(somerows->weights): (gsl_vector){};
-            m[i] = somerows->matrix ? *(somerows->matrix): (gsl_matrix){};
-            slices[i].vector = somerows->vector ? &v[i] : 0;
-            slices[i].weights = somerows->weights ? &w[i] : 0;
-            slices[i].matrix = somerows->matrix ?&m[i] : 0;
-            inputs[i].in = slices+i;
-            inputs[i].all_pages = varad_in.all_pages+1000;
-            pthread_create(&thread_id[i], NULL, apop_map_sum_for_threading, inputs+i);
-        }
-        double sum = 0;
-        void *partsum;
-        for (int i=0 ; i<threadct; i++){
-            pthread_join(thread_id[i], &partsum);
-//printf("part %i: %g\n", i, *(double*)partsum);
-//apop_data_show(slices+i);
-            sum+= *(double*)partsum;
-            free(partsum);
-        }
-
-        inputs[0].in = varad_in.in->more;
-        inputs[0].all_pages -= 1000;
-        return sum + (((varad_in.all_pages=='y' || varad_in.all_pages=='Y') && varad_in.in->more) ? variadic_apop_map_sum(inputs[0]): 0);
-    }
-
+APOP_VAR_HEAD double apop_map_sum(apop_data *in, apop_fn_d *fn_d, apop_fn_v *fn_v, apop_fn_r *fn_r, apop_fn_dp *fn_dp, apop_fn_vp *fn_vp, apop_fn_rp *fn_rp, apop_fn_dpi *fn_dpi,  apop_fn_vpi *fn_vpi, apop_fn_rpi *fn_rpi, apop_fn_di *fn_di, apop_fn_vi *fn_vi, apop_fn_ri *fn_ri, void *param, char part, int all_pages, char reproducible){ 
     apop_data * apop_varad_var(in, NULL)
     apop_fn_v * apop_varad_var(fn_v, NULL)
     apop_fn_d * apop_varad_var(fn_d, NULL)
@@ -556,48 +771,147 @@ APOP_VAR_HEAD double apop_map_sum(apop_data *in, apop_fn_d *fn_d, apop_fn_v *fn_
     apop_fn_ri * apop_varad_var(fn_ri, NULL)
     void * apop_varad_var(param, NULL)
     char apop_varad_var(part, ((fn_v||fn_vp||fn_vpi||fn_vi) ? 'r' : 'a'));
-    if (varad_in.all_pages >= 1000) varad_in.all_pages -= 1000;
     int apop_varad_var(all_pages, 'n')
+    char apop_varad_var(reproducible, 'n')
 APOP_VAR_ENDHEAD 
-    Get_vmsizes(in);
-    double outsum = 0;
-    if (fn_r || fn_ri || fn_rpi || fn_rp)
-        for (int i=0; i < GSL_MAX(maxsize, in->textsize[0]); i++){
-            Apop_data_row(in, i, arow);
-            if (fn_r) outsum += fn_r(arow);
-            else if (fn_rp) outsum += fn_rp(arow, param);
-            else if (fn_ri) outsum += fn_ri(arow, i);
-            else            outsum += fn_rpi(arow, param, i);
-        }
-    else {
+    if (!in) return 0;
+    map_sum_job job = {.fn_d=fn_d, .fn_v=fn_v, .fn_r=fn_r, .fn_dp=fn_dp, .fn_vp=fn_vp,
+                       .fn_rp=fn_rp, .fn_dpi=fn_dpi, .fn_vpi=fn_vpi, .fn_rpi=fn_rpi,
+                       .fn_di=fn_di, .fn_vi=fn_vi, .fn_ri=fn_ri, .param=param, .part=part};
+    if (!(fn_r || fn_ri || fn_rpi || fn_rp)){
         if (part =='m' || part == 'v' || part == 'a'){
-        apop_assert(fn_d || fn_dp || fn_di || fn_dpi, "You specified .part='a', which means I need one of .fn_d, .fn_dp, .fn_di, or .fn_dpi specified");
-        if (part =='m') firstcol= 0; //don't traverse vector, even if present
-        if (part =='v') msize2= 0; //don't traverse matrix, even if present
-        for (int i=0; i < GSL_MAX(vsize, msize1); i++)
-            for (int j=firstcol; j < msize2; j++){
-                double val = apop_data_get(in, i, j);
-                if (fn_d) outsum += fn_d(val);
-                else if (fn_dp) outsum += fn_dp(val, param);
-                else if (fn_di) outsum += fn_di(val, i);
-                else            outsum += fn_dpi(val, param, i);
-            }
-        } else if (part =='r' ||part =='c'){
-            apop_assert(fn_v || fn_vp || fn_vi || fn_vpi, "You specified .part='a', which means I need one of .fn_v, .fn_vp, .fn_vi, or .fn_vpi specified");
-            long int max = (part=='r') ? msize1 : msize2;
-            gsl_vector_view v;
-            for (int i=0; i < max; i++){
-                v = (part=='r')
-                    ? gsl_matrix_row(in->matrix, i)
-                    : gsl_matrix_column(in->matrix, i);
-                if       (fn_v)  outsum += fn_v(&v.vector);
-                else if (fn_vp)  outsum += fn_vp(&v.vector, param);
-                else if (fn_vi)  outsum += fn_vi(&v.vector, i);
-                else             outsum += fn_vpi(&v.vector, param, i);
-            }
-        }
+            apop_assert(fn_d || fn_dp || fn_di || fn_dpi, "You specified .part='%c', which means I need one of .fn_d, .fn_dp, .fn_di, or .fn_dpi specified", part);
+        } else if (part =='r' ||part =='c')
+            apop_assert(fn_v || fn_vp || fn_vi || fn_vpi, "You specified .part='%c', which means I need one of .fn_v, .fn_vp, .fn_vi, or .fn_vpi specified", part);
     }
-        return outsum + 
-                    (((all_pages=='y' || all_pages=='Y') && in->more) ? apop_map_sum_base(in->more, fn_d, fn_v, fn_r, fn_dp, fn_vp, fn_rp, fn_dpi, fn_vpi, fn_rpi, fn_di, fn_vi, fn_ri, param, part, all_pages) : 0);
+
+    int pagect = 0;
+    for (apop_data *p=in; p; p = (all_pages=='y' || all_pages=='Y') ? p->more : NULL)
+        pagect++;
+    map_sum_page pages[pagect];
+    size_t ct = 0, blockct = 0;
+    apop_data *p = in;
+    for (int i=0; i< pagect; i++, p=p->more){
+        if (fn_r || fn_ri || fn_rpi || fn_rp) Apop_stop_if_columns(p, return GSL_NAN);
+        pages[i] = (map_sum_page){.in=p, .start=ct, .ct=map_sum_count(&job, p), .firstblock=blockct};
+        pages[i].blockct = (pages[i].ct + repro_block - 1)/repro_block;
+        ct += pages[i].ct;
+        blockct += pages[i].blockct;
     }
+    job.pages = pages;
+    job.pagect = pagect;
+
+    kahan_sum outsum = {};
+    if (reproducible == 'y' || reproducible == 'Y'){
+        job.sums = malloc(sizeof(kahan_sum)*GSL_MAX(blockct, 1));
+        apop_threadpool_for(map_sum_blocks, &job, blockct, apop_opts.thread_count);
+        for (size_t b=0; b < blockct; b++){
+            kahan_add(&outsum, job.sums[b].sum);
+            kahan_add(&outsum, job.sums[b].c);
+        }
+        free(job.sums);
+    } else {
+        int slotct = GSL_MAX(apop_opts.thread_count, 1);
+        kahan_sum sums[slotct];
+        for (int i=0; i< slotct; i++) sums[i] = (kahan_sum){};
+        job.sums = sums;
+        apop_threadpool_for(map_sum_chunk, &job, ct, slotct);
+        for (int i=0; i< slotct; i++){
+            kahan_add(&outsum, sums[i].sum);
+            kahan_add(&outsum, sums[i].c);
+        }
+    }
+    return kahan_total(outsum);
+}
 /** \} */
+
+/* Batch sums, for the built-in models' log likelihoods and scores (see internal.h).
+
+   apop_map_sum calls the user's function once per element, via a function pointer,
+   which leaves the compiler nothing to optimize. A batch kernel instead gets a run of
+   contiguous doubles and can loop over them in vector registers. As with the reproducible
+   map_sum, the vector and matrix are cut into fixed blocks of repro_block elements, the
+   blocks are spread over the thread pool, and the block sums are added up in order, so
+   the answer doesn't depend on the thread count. A vector with a stride is copied a block
+   at a time into a buffer. */
+typedef struct {
+    const double *base;
+    size_t rows, rowlen, tda, stride;
+    size_t firstblock, blockct;
+} batch_array;
+
+typedef struct {
+    apop_batch_kernel *kernel;
+    const void *param;
+    int sumct, arrayct;
+    batch_array arrays[2];
+    double *blocksums;
+} batch_job;
+
+static void batch_block(batch_job *j, batch_array *a, size_t b, double *sums){
+    size_t lo = (b - a->firstblock)*repro_block,
+           hi = GSL_MIN(lo + repro_block, a->rows * a->rowlen);
+    double buffer[a->stride == 1 ? 1 : repro_block];
+    while (lo < hi){
+        size_t row = lo / a->rowlen, col = lo % a->rowlen,
+               len = GSL_MIN(a->rowlen - col, hi - lo);
+        const double *x = a->base + row*a->tda + col*a->stride;
+        if (a->stride != 1){
+            for (size_t i=0; i< len; i++) buffer[i] = x[i*a->stride];
+            x = buffer;
+        }
+        j->kernel(x, len, j->param, sums);
+        lo += len;
+    }
+}
+
+static void batch_blocks(void *in, size_t lo, size_t hi, int slot){
+    batch_job *j = in;
+    int a = 0;
+    for (size_t b=lo; b < hi; b++){
+        while (b >= j->arrays[a].firstblock + j->arrays[a].blockct) a++;
+        double *sums = j->blocksums + b*j->sumct;
+        for (int k=0; k< j->sumct; k++) sums[k] = 0;
+        batch_block(j, j->arrays+a, b, sums);
+    }
+}
+
+void apop_batch_sum(apop_data const *d, apop_batch_kernel *kernel, const void *param, double *sums, int sumct){
+    batch_job j = {.kernel=kernel, .param=param, .sumct=sumct};
+    gsl_vector *v = d ? d->vector : NULL;
+    gsl_matrix *m = d ? d->matrix : NULL;
+    if (v && v->size)
+        j.arrays[j.arrayct++] = (batch_array){.base=v->data, .rows=1, .rowlen=v->size, .stride=v->stride};
+    if (m && m->size1 && m->size2)
+        j.arrays[j.arrayct++] = (m->tda == m->size2) //contiguous: treat as one long row.
+            ? (batch_array){.base=m->data, .rows=1, .rowlen=m->size1*m->size2, .stride=1}
+            : (batch_array){.base=m->data, .rows=m->size1, .rowlen=m->size2, .tda=m->tda, .stride=1};
+    size_t blockct = 0;
+    for (int a=0; a< j.arrayct; a++){
+        j.arrays[a].firstblock = blockct;
+        j.arrays[a].blockct = (j.arrays[a].rows*j.arrays[a].rowlen + repro_block - 1)/repro_block;
+        blockct += j.arrays[a].blockct;
+    }
+    j.blocksums = malloc(sizeof(double)*sumct*GSL_MAX(blockct, 1));
+    Apop_stopif(!j.blocksums, for (int k=0; k< sumct; k++) sums[k] = GSL_NAN; return,
+            0, "malloc failed. Probably out of memory.");
+    apop_threadpool_for(batch_blocks, &j, blockct, apop_opts.thread_count);
+    for (int k=0; k< sumct; k++){
+        kahan_sum total = {};
+        for (size_t b=0; b< blockct; b++)
+            kahan_add(&total, j.blocksums[b*sumct + k]);
+        sums[k] = kahan_total(total);
+    }
+    free(j.blocksums);
+}
+
+//The plain sum, for the models that need only that (see internal.h).
+Apop_vectorize void apop_sum_kernel(const double *x, size_t n, const void *ignored, double *sums){
+    double total[Apop_lanes] = {};
+    size_t i = 0;
+    for ( ; i+Apop_lanes <= n; i+= Apop_lanes)
+        for (int l=0; l< Apop_lanes; l++)
+            total[l] += x[i+l];
+    for ( ; i< n; i++) total[0] += x[i];
+    for (int l=0; l< Apop_lanes; l++) sums[0] += total[l];
+}
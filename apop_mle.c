@@ -36,6 +36,7 @@ typedef struct {
     FILE        **trace_file;
     double      best_ll;
     char        want_cov, want_predicted, want_tests, want_info;
+    char        multistart; //'y' = one of several concurrent searches; leave SIGINT to the driver.
     jmp_buf     bad_eval_jump;
 }   infostruct;
 
@@ -96,6 +97,11 @@ Apop_settings_init(apop_mle,
     Apop_varad_set(mu_t, 1.002); 
     Apop_varad_set(t_min, 5.0e-1);
     Apop_varad_set(rng, NULL);
+//multi-start:
+    Apop_varad_set(starts, 0);
+    Apop_varad_set(starting_points, NULL);
+    Apop_varad_set(start_dist, NULL);
+    Apop_varad_set(start_spread, 1);
 )
 
 //deprecated; left to make some examples in Modeling with Data coherent.
@@ -413,7 +419,7 @@ static void fdf_shell(const gsl_vector *beta, void *i, double *f, gsl_vector *df
     dnegshell(beta, i, df);
 }
 
-static int ctrl_c;
+static volatile sig_atomic_t ctrl_c;
 static void mle_sigint(){ ctrl_c ++; }
 
 static int setup_starting_point(apop_mle_settings *mp, gsl_vector *x){
@@ -424,6 +430,15 @@ static int setup_starting_point(apop_mle_settings *mp, gsl_vector *x){
     return 0;
 }
 
+static void add_covariance(infostruct *i){
+    apop_model *est = i->model;
+    if (i->want_cov=='y' && est->parameters->vector && !est->parameters->matrix){
+        apop_model_numerical_covariance(i->data, est, Apop_settings_get(est,apop_mle,delta));
+        if (i->want_tests=='y')
+            apop_estimate_parameter_tests (est);
+    }
+}
+
 static void auxinfo(apop_data *params, infostruct *i, int status, double ll){
     Get_vmsizes(params); //tsize = total # of parameters
     apop_model	*est    = i->model; //just an alias.
@@ -431,11 +446,7 @@ static void auxinfo(apop_data *params, infostruct *i, int status, double ll){
        if(est->constraint)
         apop_assert(!est->constraint(i->data, est), "the maximum likelihood search ended "
                                             "at a point that doesn't satisfy the model's constraints.");*/
-    if (i->want_cov=='y' && est->parameters->vector && !est->parameters->matrix){
-        apop_model_numerical_covariance(i->data, est, Apop_settings_get(est,apop_mle,delta));
-        if (i->want_tests=='y')
-            apop_estimate_parameter_tests (est);
-    }
+    add_covariance(i);
     int param_ct = tsize;
     if (i->want_info){
         //Did the sending function save last value of f()?
@@ -488,9 +499,11 @@ Inside the infostruct, you'll find these elements:
         .fdf	= (apop_fdf_with_void) fdf_shell,
         .n		= betasize,
         .params	= i};
-    ctrl_c = 0;
 	gsl_multimin_fdfminimizer_set (s, &minme, i->beta, mp->step_size, mp->tolerance);
-    signal(SIGINT, mle_sigint);
+    if (i->multistart != 'y'){
+        ctrl_c = 0;
+        signal(SIGINT, mle_sigint);
+    }
     do { 	
         iter++;
         if (setjmp(i->bad_eval_jump)) {
@@ -507,7 +520,7 @@ Inside the infostruct, you'll find these elements:
             if(mp->verbose)	printf ("Minimum found.\n");
         }
     } while (status == GSL_CONTINUE && iter < mp->max_iterations && !ctrl_c);
-    signal(SIGINT, NULL);
+    if (i->multistart != 'y') signal(SIGINT, NULL);
 	if (iter==mp->max_iterations) {
 		apopstatus	= -1;
 		if (mp->verbose) printf("No min!!\n");
@@ -534,13 +547,15 @@ static apop_model *	apop_maximum_likelihood_no_d(apop_data * data, infostruct *
     double size;
     s = gsl_multimin_fminimizer_alloc(gsl_multimin_fminimizer_nmsimplex, betasize);
     ss = gsl_vector_alloc(betasize);
-    ctrl_c      =
     apopstatus = 0; //assume failure until we score a success.
     gsl_vector_set_all (ss,  mp->step_size);
     gsl_multimin_function  minme = {.f = negshell, .n= betasize, .params = i};
     gsl_multimin_fminimizer_set (s, &minme, i->beta,  ss);
     //i->beta = s->x;
-    signal(SIGINT, mle_sigint);
+    if (i->multistart != 'y'){
+        ctrl_c = 0;
+        signal(SIGINT, mle_sigint);
+    }
     do {  
         iter++;
         if (setjmp(i->bad_eval_jump)) {
@@ -565,12 +580,14 @@ static apop_model *	apop_maximum_likelihood_no_d(apop_data * data, infostruct *
             }
         }
     } while (status == GSL_CONTINUE && iter < mp->max_iterations && !ctrl_c);
-    signal(SIGINT, NULL);
+    if (i->multistart != 'y') signal(SIGINT, NULL);
 	if (iter == mp->max_iterations && mp->verbose)
 		Apop_notify(1, "Optimization reached maximum number of iterations.");
     if (status == GSL_SUCCESS) apopstatus = 0;
     apop_data_unpack(s->x, est->parameters);
 	gsl_multimin_fminimizer_free(s);
+    gsl_vector_free(ss);
+    gsl_vector_free(i->beta);
     auxinfo(est->parameters, i, apopstatus, i->best_ll);
 	return est;
 }
@@ -631,6 +648,209 @@ void get_desires(apop_model *m, infostruct *info){
     info->want_predicted = (want && want->predicted =='y') ? 'y' : 'n';
 }
 
+/* One search from one starting point, using the settings attached to dist. If
+   multistart=='y', this is one of several searches running at once, so leave SIGINT
+   and the covariance to the driver. If the search writes a trace_path to a file, it
+   goes to *trace_file, which the caller closes. */
+static apop_model *one_search(apop_data *data, apop_model *dist, char multistart, FILE **trace_file){
+    apop_mle_settings *mp = apop_settings_get_group(dist, apop_mle);
+    infostruct info = {.data           = data,
+                       .use_constraint = 1,
+                       .trace_file     = trace_file,
+                       .model          = dist,
+                       .multistart     = multistart};
+    get_desires(dist, &info);
+    if (multistart == 'y'){
+        info.want_cov = info.want_tests = 'n';
+        info.want_info = 'y'; //the driver reads each start's status from the info page.
+    }
+    info.beta = apop_data_pack(dist->parameters, NULL, .all_pages='y');
+    if (setup_starting_point(mp, info.beta)) return NULL;
+    *info.trace_file = NULL;
+    info.model->data = data;
+    if (mp->dim_cycle_tolerance)          return dim_cycle(data, dist, info);
+    if (mp->trace_path)                   info.trace_path = mp->trace_path;
+	if (mp->method == APOP_SIMAN)         return apop_annealing(&info);  //below.
+    else if (mp->method==APOP_SIMPLEX_NM) return apop_maximum_likelihood_no_d(data, &info);
+    else if (mp->method == APOP_RF_NEWTON ||
+            mp->method == APOP_RF_HYBRID_NOSCALE ||
+            mp->method == APOP_RF_HYBRID) return  find_roots (info);
+	//else, Conjugate Gradient:
+	return apop_maximum_likelihood_w_d(data, &info);
+}
+
+/** \page multistart Multi-start searches
+
+A likelihood with several local optima (a Waring, a mixture, ...) will send a search
+to whichever optimum is nearest its starting point. The usual fix is to start from many
+points and keep the best result. Set \c starts in the \ref apop_mle_settings group to
+have \ref apop_maximum_likelihood do this for you:
+
+\code
+Apop_model_add_group(your_model, apop_mle, .starts=100, .start_spread=5);
+apop_model *est = apop_estimate(your_data, *your_model);
+apop_data_show(apop_data_get_page(est->info, "<Multistart optima>"));
+\endcode
+
+\li The starting points are the rows of \c starting_points, if any, and then draws from
+\c start_dist, if any, and otherwise uniform draws from the box centered at \c starting_pt
+(or at all ones) with half-width \c start_spread. If \c start_dist has one dimension,
+I make one draw per parameter; else it has to draw a whole parameter vector at a time.
+
+\li All starting points are drawn before any search begins, and each search gets its own
+copy of the model and its own RNG, seeded from <tt>apop_opts.rng_seed++</tt>. So the
+results depend on the seed, and not on \ref apop_opts_type "apop_opts.thread_count"
+(except for rounding in sums that your likelihood splits among threads).
+
+\li The searches run one after another. A model has no way (yet) to declare that its
+\c log_likelihood (or \c p) and \c constraint are safe to call from several threads at
+once, and plenty of models keep scratch space in static variables. But each search gets
+the threads: functions like \ref apop_map_sum inside your likelihood run on up to \ref
+apop_opts_type "apop_opts.thread_count" threads as usual.
+
+\li The \c trace_path setting is ignored for the individual searches.
+
+\li The parameters and \c info of the best search (by log likelihood) are copied into the
+model you sent in, which is returned as usual (but if you've added an \ref
+apop_parts_wanted_settings group with <tt>.info='n'</tt>, the winner's \c info is dropped).
+The covariance, if requested, is calculated for the winner only.
+
+\li The model's \c info gets a page named <tt>"<Multistart optima>"</tt>, with one row per
+starting point. The vector is the log likelihood; the matrix columns are the status
+(see \ref apop_maximum_likelihood; recorded for every start, whatever \ref
+apop_parts_wanted_settings says), the optimum found (<tt>"optimum 0"</tt>, <tt>"optimum
+1"</tt>, ...), then the starting point (<tt>"start 0"</tt>, ...). Use \ref apop_data_sort to
+rank them.
+
+\li Ctrl-C cancels the starting points that haven't begun and stops the running
+gradient and simplex searches at their current points.
+\ingroup mle
+*/
+
+typedef struct {
+    apop_model *model;
+    apop_data  *data;
+    gsl_rng    *rng;
+    double     ll;
+    char       done;
+} start_task;
+
+static void *run_start(void *in){
+    start_task *t = in;
+    t->ll = GSL_NAN;
+    if (ctrl_c) return NULL; //the user asked us to stop.
+    FILE *trace_file = NULL; //trace_path is off for multistart searches, so this stays NULL.
+    one_search(t->data, t->model, 'y', &trace_file);
+    t->ll = get_ll(t->data, t->model);
+    t->done = 'y';
+    return NULL;
+}
+
+static apop_model *multistart(apop_data *data, apop_model *dist, apop_mle_settings *mp){
+    gsl_vector *base = apop_data_pack(dist->parameters, NULL, .all_pages='y');
+    setup_starting_point(mp, base);
+    int betasize = base->size;
+    Apop_stopif(mp->starting_points && !mp->starting_points->matrix,
+            gsl_vector_free(base); dist->error='d'; return dist, 0,
+            "Your starting_points set has no matrix; put one starting point in each row of the matrix.");
+    int rowct = mp->starting_points ? mp->starting_points->matrix->size1 : 0;
+    int startct = mp->starts ? mp->starts : rowct;
+    Apop_stopif(rowct && mp->starting_points->matrix->size2 != betasize,
+            gsl_vector_free(base); dist->error='d'; return dist, 0,
+            "Your starting_points matrix has %zu columns, but the model has %i parameters.",
+            mp->starting_points->matrix->size2, betasize);
+    Apop_stopif(mp->start_dist && startct > rowct && mp->start_dist->dsize != 1
+                    && mp->start_dist->dsize != betasize,
+            gsl_vector_free(base); dist->error='d'; return dist, 0,
+            "Your start_dist makes draws of size %i, but the model has %i parameters.",
+            mp->start_dist->dsize, betasize);
+
+    apop_data *optima = apop_data_alloc(startct, startct, 1 + 2*betasize);
+    start_task *tasks = malloc(sizeof(start_task)*startct);
+    for (int i=0; i< startct; i++){
+        double *start = gsl_matrix_ptr(optima->matrix, i, 1+betasize);
+        gsl_rng *r = apop_rng_alloc(apop_opts.rng_seed++);
+        if (i < rowct)
+            for (int j=0; j< betasize; j++)
+                start[j] = gsl_matrix_get(mp->starting_points->matrix, i, j);
+        else if (mp->start_dist && mp->start_dist->dsize == betasize)
+            apop_draw(start, r, mp->start_dist);
+        else if (mp->start_dist)
+            for (int j=0; j< betasize; j++)
+                apop_draw(start+j, r, mp->start_dist);
+        else for (int j=0; j< betasize; j++)
+            start[j] = gsl_vector_get(base, j) + gsl_ran_flat(r, -mp->start_spread, mp->start_spread);
+
+        apop_model *copy = apop_model_copy(*dist);
+        apop_mle_settings *cmp = Apop_settings_get_group(copy, apop_mle);
+        cmp->starts = 0;
+        cmp->starting_points = NULL;
+        cmp->starting_pt = start;
+        cmp->rng = r;
+        cmp->trace_path = NULL;
+        tasks[i] = (start_task){.model=copy, .data=data, .rng=r};
+    }
+    ctrl_c = 0;
+    signal(SIGINT, mle_sigint);
+    //One at a time, because the model may not be thread-safe; see the notes above.
+    for (int i=0; i< startct; i++) run_start(tasks+i);
+    signal(SIGINT, NULL);
+
+    int best = -1;
+    for (int i=0; i< startct; i++){
+        apop_model *m = tasks[i].model;
+        apop_data_set(optima, i, -1, tasks[i].ll);
+        if (tasks[i].done != 'y'){
+            for (int j=0; j< 1+betasize; j++)
+                gsl_matrix_set(optima->matrix, i, j, GSL_NAN);
+            continue;
+        }
+        apop_data_set(optima, i, 0, m->info ? apop_data_get(m->info, .rowname="status") : GSL_NAN);
+        gsl_vector_view opt = gsl_vector_view_array(gsl_matrix_ptr(optima->matrix, i, 1), betasize);
+        apop_data_pack(m->parameters, &opt.vector, .all_pages='y');
+        if (!gsl_isnan(tasks[i].ll) && (best == -1 || tasks[i].ll > tasks[best].ll)) best = i;
+    }
+    apop_name_add(optima->names, "log likelihood", 'v');
+    apop_name_add(optima->names, "status", 'c');
+    char name[40];
+    for (int j=0; j< betasize; j++){
+        sprintf(name, "optimum %i", j);
+        apop_name_add(optima->names, name, 'c');
+    }
+    for (int j=0; j< betasize; j++){
+        sprintf(name, "start %i", j);
+        apop_name_add(optima->names, name, 'c');
+    }
+
+    if (best >= 0){
+        apop_model *winner = tasks[best].model;
+        apop_data_free(dist->parameters);
+        apop_data_free(dist->info);
+        dist->parameters = winner->parameters;
+        dist->info = winner->info;
+        winner->parameters = winner->info = NULL;
+    }
+    dist->data = data;
+    infostruct info = {.data = data, .model = dist};
+    get_desires(dist, &info);
+    apop_parts_wanted_settings *want = apop_settings_get_group(dist, apop_parts_wanted);
+    if (want && want->info != 'y'){ //the starts needed their info pages, but the user doesn't.
+        apop_data_free(dist->info);
+        dist->info = NULL;
+    }
+    if (best >= 0) add_covariance(&info);
+    if (!dist->info) dist->info = apop_data_alloc();
+    apop_data_add_page(dist->info, optima, "<Multistart optima>");
+
+    for (int i=0; i< startct; i++){
+        apop_model_free(tasks[i].model);
+        gsl_rng_free(tasks[i].rng);
+    }
+    free(tasks);
+    gsl_vector_free(base);
+    return dist;
+}
+
 /** The maximum likelihood calculations. All of the settings are specified by adding a
   \ref apop_mle_settings struct to your model, so see the many notes there. Notably,
   the default method is the Fletcher-Reeves conjugate gradient method, and if your model
@@ -659,29 +879,19 @@ else
 \endcode
 
 \li During the search for an optimum, ctrl-C (SIGINT) will halt the search, and the function will return whatever parameters the search was on at the time.
+
+\li If the \c starts element of the settings is greater than one, or \c starting_points is
+set, I run a search from each of several starting points and return the best. See \ref multistart.
  \ingroup mle */
 apop_model *apop_maximum_likelihood(apop_data * data, apop_model *dist){
     apop_mle_settings   *mp = apop_settings_get_group(dist, apop_mle);
     if (!mp) mp = Apop_model_add_group(dist, apop_mle, .parent=dist);
     Apop_assert(dist->parameters, "Not enough information to allocate parameters over which to optimize.")
-    infostruct info = {.data           = data,
-                       .use_constraint = 1,
-                       .trace_file     = malloc(sizeof(FILE *)),
-                       .model          = dist};
-    get_desires(dist, &info);
-    info.beta = apop_data_pack(dist->parameters, NULL, .all_pages='y');
-    if (setup_starting_point(mp, info.beta)) return NULL;
-    *info.trace_file = NULL;
-    info.model->data = data;
-    if (mp->dim_cycle_tolerance)          return dim_cycle(data, dist, info);
-    if (mp->trace_path)                   info.trace_path = mp->trace_path;
-	if (mp->method == APOP_SIMAN)         return apop_annealing(&info);  //below.
-    else if (mp->method==APOP_SIMPLEX_NM) return apop_maximum_likelihood_no_d(data, &info);
-    else if (mp->method == APOP_RF_NEWTON ||
-            mp->method == APOP_RF_HYBRID_NOSCALE ||
-            mp->method == APOP_RF_HYBRID) return  find_roots (info);
-	//else, Conjugate Gradient:
-	return apop_maximum_likelihood_w_d(data, &info);
+    if (mp->starts > 1 || mp->starting_points) return multistart(data, dist, mp);
+    FILE *trace_file = NULL;
+    apop_model *out = one_search(data, dist, 'n', &trace_file);
+    if (trace_file && trace_file != stdout) fclose(trace_file);
+    return out;
 }
 
 /** 
@@ -867,8 +1077,9 @@ static apop_model * apop_annealing(infostruct *i){
                          .t_initial     = mp->t_initial,
                          .mu_t          = mp->mu_t,
                          .t_min         = mp->t_min};
-    static const gsl_rng *r;
-    if (!r) r = mp->rng ? mp->rng : apop_rng_alloc(apop_opts.rng_seed++);
+    static gsl_rng *spare_rng; //used when the settings don't provide one.
+    gsl_rng *r = mp->rng;
+    if (!r) r = spare_rng ? spare_rng : (spare_rng = apop_rng_alloc(apop_opts.rng_seed++));
     //these two are done at apop_maximum_likelihood:
     //i->beta = apop_data_pack(ep->parameters, NULL, .all_pages='y');
     //setup_starting_point(mp, i->beta);
@@ -883,8 +1094,9 @@ static apop_model * apop_annealing(infostruct *i){
         apopstatus = -1;
         goto done;
     }
-    if (!setjmp(anneal_jump)){
-        signal(SIGINT, anneal_sigint);
+    //anneal_jump is global, so searches run by the multistart driver can't use it.
+    if (i->multistart == 'y' || !setjmp(anneal_jump)){
+        if (i->multistart != 'y') signal(SIGINT, anneal_sigint);
         gsl_siman_solve(r,    // const gsl_rng * r
           i,                  // void * x0_p
           annealing_energy,   // gsl_siman_Efunc_t Ef
@@ -897,12 +1109,11 @@ static apop_model * apop_annealing(infostruct *i){
           betasize,           // size_t element_size
           simparams);         // gsl_siman_params_t params
     }
-    signal(SIGINT, NULL);
+    if (i->multistart != 'y') signal(SIGINT, NULL);
     apop_data_unpack(i->beta, i->model->parameters); 
     apop_estimate_parameter_tests(i->model);
     apopstatus = 0;
 done:
-    if (mp->rng) r = NULL;
     auxinfo(i->model->parameters, i, apopstatus, i->best_ll);
     return i->model;
 }
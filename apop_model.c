@@ -211,6 +211,7 @@ method may assume that \c apop_prep has already been called.
 */
 apop_model *apop_estimate(apop_data *d, apop_model m){
     apop_model *out = apop_model_copy(m);
+    Apop_stop_if_columns(d, out->error='d'; return out);
     apop_prep(d, out);
     if (out->estimate)
         return out->estimate(d, out); 
@@ -226,6 +227,7 @@ apop_model *apop_estimate(apop_data *d, apop_model m){
 */
 double apop_p(apop_data *d, apop_model *m){
     Nullcheck_m(m, GSL_NAN);
+    Apop_stop_if_columns(d, return GSL_NAN);
     if (m->p)
         return m->p(d, m);
     else if (m->log_likelihood)
@@ -243,6 +245,7 @@ double apop_p(apop_data *d, apop_model *m){
 */
 double apop_log_likelihood(apop_data *d, apop_model *m){
     Nullcheck_m(m, GSL_NAN); //Nullcheck_p(m); //Too many models don't use the params.
+    Apop_stop_if_columns(d, return GSL_NAN);
     if (m->log_likelihood)
         return m->log_likelihood(d, m);
     else if (m->p)
@@ -261,6 +264,7 @@ double apop_log_likelihood(apop_data *d, apop_model *m){
 */
 void apop_score(apop_data *d, gsl_vector *out, apop_model *m){
     Nullcheck_m(m, );
+    Apop_stop_if_columns(d, if (out) gsl_vector_set_all(out, GSL_NAN); return);
     if (m->score){
         m->score(d, out, m);
         return;
@@ -4,6 +4,149 @@
 #include "apop_internal.h"
 #include <stdio.h>
 #include <regex.h>
+#include <ctype.h>
+#include <pthread.h>
+
+/* Name lookups.
+
+   Most lookups are for a name that's in the list verbatim (up to case), and compiling
+   a regex and running it against every name in the list is overkill for that. So
+   apop_name_find first looks for an exact, case-insensitive match, and only if that
+   fails does it go to the regex search.
+
+   --Long lists get a hash index, built on the first search. The index is keyed on the
+     address and length of the list, not stored in the apop_name itself, because the
+     Apop_data_row family makes throwaway apop_names pointing to their parent's lists.
+     This way the views share the parent's index, and nothing leaks when a view goes out
+     of scope.
+   --The indices and the last few compiled regexes sit in a small per-thread cache, so
+     threads never have to lock anything to look up a name.
+   --apop_name_add and apop_name_free drop the index for any list they change. But users
+     (and other threads) can edit names behind our back, so every hit from the index gets
+     checked against the list itself, and a miss is confirmed with a plain scan before we
+     go on to the regex. A stale index can't give a wrong answer, only a slower one.
+*/
+
+#define Index_min 16  //Shorter lists are just scanned.
+#define Cache_size 8
+
+typedef struct {
+    char **list;
+    int ct, mask;
+    int *slots;   //position in the list+1, or zero for an empty slot
+} name_index;
+
+typedef struct {
+    char *pattern;
+    regex_t re;
+} compiled_regex;
+
+typedef struct {
+    name_index indices[Cache_size];
+    compiled_regex regexes[Cache_size];
+    int next_index, next_regex;
+} name_cache;
+
+static pthread_key_t cache_key;
+static pthread_once_t cache_key_once = PTHREAD_ONCE_INIT;
+
+static void cache_free(void *in){
+    name_cache *c = in;
+    for (int i=0; i< Cache_size; i++){
+        free(c->indices[i].slots);
+        if (c->regexes[i].pattern){
+            free(c->regexes[i].pattern);
+            regfree(&c->regexes[i].re);
+        }
+    }
+    free(c);
+}
+
+static void cache_key_create(void){ pthread_key_create(&cache_key, cache_free); }
+
+//This thread's cache. Returns NULL if there isn't one yet and create is zero, or if we
+//couldn't make one, in which case we just do without.
+static name_cache *get_cache(int create){
+    pthread_once(&cache_key_once, cache_key_create);
+    name_cache *c = pthread_getspecific(cache_key);
+    if (c || !create) return c;
+    c = calloc(1, sizeof(name_cache));
+    if (c && pthread_setspecific(cache_key, c)){
+        free(c);
+        return NULL;
+    }
+    return c;
+}
+
+//Called before a list is realloced or freed.
+static void forget_list(char **list){
+    name_cache *c;
+    if (!list || !(c = get_cache(0))) return;
+    for (int i=0; i< Cache_size; i++)
+        if (c->indices[i].list == list){
+            free(c->indices[i].slots);
+            c->indices[i] = (name_index){ };
+        }
+}
+
+//FNV-1a, ignoring case.
+static unsigned int name_hash(char const *s){
+    unsigned int h = 2166136261u;
+    for ( ; *s; s++)
+        h = (h ^ (unsigned char)tolower((unsigned char)*s)) * 16777619u;
+    return h;
+}
+
+static name_index *get_index(name_cache *c, char **list, int ct){
+    for (int i=0; i< Cache_size; i++)
+        if (c->indices[i].list == list && c->indices[i].ct == ct && c->indices[i].slots)
+            return c->indices+i;
+    name_index *x = c->indices + c->next_index;
+    c->next_index = (c->next_index+1) % Cache_size;
+    int size = 32;
+    while (size < 2*ct) size *= 2;
+    free(x->slots);
+    *x = (name_index){.list=list, .ct=ct, .mask=size-1, .slots=calloc(size, sizeof(int))};
+    if (!x->slots) return NULL;
+    for (int i=0; i< ct; i++){
+        int s = name_hash(list[i]) & x->mask;
+        while (x->slots[s] && strcasecmp(list[x->slots[s]-1], list[i]))
+            s = (s+1) & x->mask;
+        if (!x->slots[s]) x->slots[s] = i+1; //else it's a duplicate; the first one wins.
+    }
+    return x;
+}
+
+static int exact_find(name_cache *c, char **list, int ct, char const *in){
+    name_index *x;
+    if (c && ct >= Index_min && (x = get_index(c, list, ct)))
+        for (int s = name_hash(in) & x->mask; x->slots[s]; s = (s+1) & x->mask)
+            if (!strcasecmp(list[x->slots[s]-1], in)) return x->slots[s]-1;
+    for (int i=0; i< ct; i++)
+        if (!strcasecmp(list[i], in)) return i;
+    return -2;
+}
+
+//Find the compiled regex in the cache, or compile it. Returns NULL if it won't compile.
+static regex_t *get_regex(name_cache *c, char const *in, regex_t *scratch){
+    if (!c) return regcomp(scratch, in, REG_EXTENDED + REG_ICASE) ? NULL : scratch;
+    for (int i=0; i< Cache_size; i++)
+        if (c->regexes[i].pattern && !strcmp(c->regexes[i].pattern, in))
+            return &c->regexes[i].re;
+    compiled_regex *r = c->regexes + c->next_regex;
+    c->next_regex = (c->next_regex+1) % Cache_size;
+    if (r->pattern){
+        free(r->pattern);
+        regfree(&r->re);
+        r->pattern = NULL;
+    }
+    if (regcomp(&r->re, in, REG_EXTENDED + REG_ICASE)) return NULL;
+    if (!(r->pattern = strdup(in))){
+        regfree(&r->re);
+        return regcomp(scratch, in, REG_EXTENDED + REG_ICASE) ? NULL : scratch;
+    }
+    return &r->re;
+}
 
 /** Allocates a name structure
 \return	An allocated, empty name structure.  In the very unlikely event that \c malloc fails, return \c NULL.
@@ -16,6 +159,21 @@ apop_name * apop_name_alloc(void){
 	return init_me;
 }
 
+/* Put add_me at the end of a list that now has ct elements. *space is how many the list
+   has room for; when it runs out, the space doubles, so adding n names costs O(n)
+   copying, not O(n^2), and most adds don't call realloc at all. */
+static char **add_to_list(apop_name *n, char **list, int *space, int ct, char const *add_me){
+    if (ct > *space){
+        int newspace = *space ? *space : 4;
+        while (newspace < ct) newspace *= 2;
+        forget_list(list);
+        list = realloc(list, sizeof(char*) * newspace);
+        *space = newspace;
+    }
+    list[ct-1] = apop_arena_strdup(n->arena, add_me);
+    return list;
+}
+
 /** Adds a name to the \ref apop_name structure. Puts it at the end of the given list.
 
 \param n 	An existing, allocated \ref apop_name structure.
@@ -36,32 +194,23 @@ int apop_name_add(apop_name * n, char const *add_me, char type){
         return 1;
 	} 
 	if (type == 'v'){
-		n->vector	= realloc(n->vector,  strlen(add_me) + 1);
-		strcpy(n->vector, add_me);
+        apop_arena_free(n->arena, n->vector);
+		n->vector	= apop_arena_strdup(n->arena, add_me);
 		return 1;
 	} 
 	if (type == 'r'){
-		n->rowct++;
-		n->row	= realloc(n->row, sizeof(char*) * n->rowct);
-		n->row[n->rowct -1]	= malloc(strlen(add_me) + 1);
-		strcpy(n->row[n->rowct -1], add_me);
+		n->row	= add_to_list(n, n->row, &n->rowsize, ++n->rowct, add_me);
 		return n->rowct;
 	} 
 	if (type == 't'){
-		n->textct++;
-		n->text	= realloc(n->text, sizeof(char*) * n->textct);
-		n->text[n->textct -1]	= malloc(strlen(add_me) + 1);
-		strcpy(n->text[n->textct -1], add_me);
+		n->text	= add_to_list(n, n->text, &n->textsize, ++n->textct, add_me);
 		return n->textct;
 	}
 	//else assume (type == 'c')
         if (type != 'c')
             Apop_notify(2,"You gave me >%c<, I'm assuming you meant c; "
                              " copying column names.", type);
-		n->colct++;
-		n->column	= realloc(n->column, sizeof(char*) * n->colct);
-		n->column[n->colct -1]	= malloc(strlen(add_me) + 1);
-		strcpy(n->column[n->colct -1], add_me);
+		n->column	= add_to_list(n, n->column, &n->colsize, ++n->colct, add_me);
 		return n->colct;
 }
 
@@ -102,18 +251,18 @@ void apop_name_print(apop_name * n){
 \ingroup names 	*/
 void  apop_name_free(apop_name * free_me){
     if (!free_me) return; //only needed if users are doing tricky things like newdata = (apop_data){.matrix=...};
-    int	i;
-	for (i=0; i < free_me->colct; i++)
-		free(free_me->column[i]);
-	for (i=0; i < free_me->textct; i++)
-		free(free_me->text[i]);
-	for (i=0; i < free_me->rowct; i++)
-		free(free_me->row[i]);
-    if (free_me->vector)
-        free(free_me->vector);
+    struct apop_arena *a = free_me->arena;
+    apop_arena_free_list(a, free_me->column, free_me->colct);
+    apop_arena_free_list(a, free_me->text, free_me->textct);
+    apop_arena_free_list(a, free_me->row, free_me->rowct);
+    apop_arena_free(a, free_me->vector);
+    forget_list(free_me->column);
+    forget_list(free_me->text);
+    forget_list(free_me->row);
 	free(free_me->column);
 	free(free_me->text);
 	free(free_me->row);
+    apop_arena_release(a);
 	free(free_me);
 }
 
@@ -172,9 +321,17 @@ apop_name * apop_name_copy(apop_name *in){
 
 /** Finds the position of an element in a list of names.
 
-The function uses case-insensitive regular expressions to search. 
+The function first looks for a name that matches \c in exactly, ignoring case. If there is
+none, it treats \c in as a case-insensitive regular expression and returns the first name
+that matches.
 
-For example, "p.val.*" will match "P value", "p.value", and "p values".
+For example, "p.val.*" will match "P value", "p.value", and "p values". If your list
+has both "Mean" and "Mean of x", then searching for "mean" will find "Mean" wherever it
+is in the list.
+
+Looking up an exact name is fast: long lists get a hash index, built the first time you
+search them. Compiled regular expressions are also cached, so looking up the same
+pattern repeatedly doesn't recompile it every time.
 
 \param n        the \ref apop_name object to search.
 \param in       the name you seek; see above.
@@ -186,7 +343,6 @@ For example, "p.val.*" will match "P value", "p.value", and "p values".
 \ingroup names */
 int apop_name_find(const apop_name *n, const char *in, const char type){
     Apop_assert_negone(in, "Searching for NULL.");
-    regex_t re;
     char **list;
     int  listct;
     if (type == 'r' || type == 'R'){
@@ -201,17 +357,18 @@ int apop_name_find(const apop_name *n, const char *in, const char type){
         list    = n->column;
         listct  = n->colct;
     }
-    int compiled_ok = !regcomp(&re, in, REG_EXTENDED + REG_ICASE);
-    Apop_assert_negone(compiled_ok, "Regular expression \"%s\" didn't compile.", in);
-    for (int i = 0; i < listct; i++)
-        if (!regexec(&re, list[i], 0, NULL, 0)){
-            regfree(&re);
-            return i;
-        }
-    if ((type=='c' || type == 'C') && n->vector && !regexec(&re, n->vector, 0, NULL, 0)){
-        regfree(&re);
-        return -1;
-    }
-    regfree(&re);
-    return -2;
+    int is_col = (type=='c' || type == 'C');
+    name_cache *c = get_cache(1);
+    int out = exact_find(c, list, listct, in);
+    if (out != -2) return out;
+    if (is_col && n->vector && !strcasecmp(n->vector, in)) return -1;
+
+    regex_t scratch, *re = get_regex(c, in, &scratch);
+    Apop_assert_negone(re, "Regular expression \"%s\" didn't compile.", in);
+    for (int i = 0; i < listct && out == -2; i++)
+        if (!regexec(re, list[i], 0, NULL, 0)) out = i;
+    if (out == -2 && is_col && n->vector && !regexec(re, n->vector, 0, NULL, 0))
+        out = -1;
+    if (re == &scratch) regfree(&scratch);
+    return out;
 }
@@ -45,8 +45,10 @@ function.
   \param output_file The name of the output file, if any. For a database, the table to write.
   \param output_pipe If you have already opened a file and have a \c FILE* on hand, use
   this instead of giving the file name.
-  \param output_type \c 'p' = pipe, \c 'f'= file, \c 'd' = database, \c 's' = stdout
-  \param output_append \c 'a' = append (default), \c 'w' = write over.
+  \param output_type \c 'p' = pipe, \c 'f'= file, \c 'd' = database, \c 's' = stdout,
+  \c 'b' = binary file (only \ref apop_data_print; see \ref apop_data_mmap)
+  \param output_append \c 'a' = append (default), \c 'w' = write over. A binary file is
+  always written over.
 
 This function merges the global and specific rules. It tries to do what you mean in
 ambiguous cases. Any function-specific option you send always overrules the global option.
@@ -79,7 +81,8 @@ void apop_prep_output(char **output_file, FILE ** output_pipe, char *output_type
         *output_pipe = stdout;  //won't be used.
     else       
         *output_pipe = *output_file
-                        ? fopen(*output_file, *output_append == 'a' ? "a" : "w") 
+                        ? fopen(*output_file, *output_type == 'b' ? "wb"
+                                            : *output_append == 'a' ? "a" : "w") 
                         : stdout;
 }
 
@@ -348,6 +351,13 @@ static void apop_data_print_core(const apop_data *data, FILE *f, char displaytyp
         fprintf(f, "NULL\n");
         return;
     }
+    apop_data *by_rows = apop_page_by_rows(data);
+    if (by_rows){ //stored by columns; print a row-major copy.
+        apop_data_print_core(by_rows, f, displaytype);
+        by_rows->more = NULL;
+        apop_data_free(by_rows);
+        return;
+    }
     int i, j, L = 0, 
         start   = (data->vector)? -1 : 0,
         end     = (data->matrix)? data->matrix->size2 : 0,
@@ -418,6 +428,8 @@ static void apop_data_print_core(const apop_data *data, FILE *f, char displaytyp
 
 \li See \ref apop_prep_output for more on how printing settings are set.
 \li See also the legible output section of the \ref outline for more details and examples.
+\li With <tt>.output_type='b'</tt>, the data set and all its pages are written in a
+binary format, which \ref apop_data_mmap reads back without parsing or copying anything.
 \li This function uses the \ref designated syntax for inputs.
 \ingroup apop_print */
 APOP_VAR_HEAD void apop_data_print(const apop_data *data, Output_declares){
@@ -432,6 +444,14 @@ APOP_VAR_ENDHEAD
         free(undotted);
         return;
     }
+    Apop_stopif(!output_pipe, return, 0, "Couldn't open %s for writing.", output_file ? output_file : "the output");
+    if (output_type == 'b'){
+        int failed = apop_data_write_binary(data, output_pipe);
+        if (output_file) failed |= !!fclose(output_pipe); //fclose flushes, so it can fail too.
+        Apop_stopif(failed, return, 0, "Error writing the binary data to %s.",
+                                        output_file ? output_file : "the output pipe");
+        return;
+    }
     apop_data_print_core(data, output_pipe, output_type);
     if (data && data->more) {
         output_append='a';
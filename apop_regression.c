@@ -316,7 +316,7 @@ APOP_VAR_ENDHEAD
         apop_data **split = apop_data_split(d, col+1, 'c');
         //stack names, then matrices
         for (int i=0; i < d->names->colct; i++)
-            free(d->names->column[i]);
+            apop_arena_free(d->names->arena, d->names->column[i]);
         apop_name_stack(d->names, split[0]->names, 'c');
         for (int k = d->names->colct; k < (split[0]->matrix ? split[0]->matrix->size2 : 0); k++)
             apop_name_add(d->names, "", 'c'); //pad so the name stacking is aligned (if needed)
@@ -0,0 +1,337 @@
+/** \file apop_sketch.c  Quantile sketches: percentiles of a stream, in bounded space. */
+/* Copyright (c) 2026 by Ben Klemens.  Licensed under the modified GNU GPL v2; see COPYING and COPYING2.
+
+   This is the KLL sketch (Karnin, Lang, and Liberty, 2016, "Optimal Quantile
+   Approximation in Streams"). The sketch is a stack of compactors. Level h holds items
+   that each stand in for 2^h observations. New data goes into level zero. When the
+   sketch as a whole is over its budget, the lowest level that is over its own capacity
+   is sorted, and every other item (starting from the first or second, by coin flip) is
+   promoted to the next level up; the rest are thrown away. A level's capacity is about
+   k (2/3)^(depth from the top), so the top levels, whose items carry the most weight,
+   get the most room, and the whole sketch holds under 3k items.
+
+   Merging two sketches is just concatenating them level by level and compacting until
+   the result is within budget again, so sketches of separate chunks of data can be
+   combined in any order.
+
+   Until the first compaction, the sketch holds every item, and percentiles come out
+   exactly as apop_vector_percentiles would give them. The min and max are tracked
+   separately, so slots 0 and 100 are always exact.
+*/
+#include "apop_internal.h"
+
+struct apop_sketch {
+    int k, levelct;
+    double **levels;
+    size_t *sizes, *spaces;
+    size_t n, held, budget;
+    double min, max;
+    unsigned long long coin;    //xorshift state
+};
+
+static size_t capacity(apop_sketch const *s, int h){
+    double c = ceil(s->k * pow(2/3., s->levelct-1-h));
+    return c < 2 ? 2 : c;
+}
+
+static int add_level(apop_sketch *s){
+    int h = s->levelct;
+    double **levels = realloc(s->levels, sizeof(double*)*(h+1));
+    Apop_stopif(!levels, return 1, 0, "Allocation error.");
+    s->levels = levels;
+    size_t *sizes = realloc(s->sizes, sizeof(size_t)*(h+1));
+    Apop_stopif(!sizes, return 1, 0, "Allocation error.");
+    s->sizes = sizes;
+    size_t *spaces = realloc(s->spaces, sizeof(size_t)*(h+1));
+    Apop_stopif(!spaces, return 1, 0, "Allocation error.");
+    s->spaces = spaces;
+    s->levels[h] = NULL;
+    s->sizes[h] = s->spaces[h] = 0;
+    s->levelct++;
+    s->budget = 0;
+    for (int i=0; i< s->levelct; i++) s->budget += capacity(s, i);
+    return 0;
+}
+
+static int reserve(apop_sketch *s, int h, size_t ct){
+    if (s->sizes[h] + ct <= s->spaces[h]) return 0;
+    size_t space = GSL_MAX(s->sizes[h] + ct, 2*s->spaces[h]);
+    double *l = realloc(s->levels[h], sizeof(double)*space);
+    Apop_stopif(!l, return 1, 0, "Allocation error.");
+    s->levels[h] = l;
+    s->spaces[h] = space;
+    return 0;
+}
+
+static int coin_flip(apop_sketch *s){
+    s->coin ^= s->coin << 13;
+    s->coin ^= s->coin >> 7;
+    s->coin ^= s->coin << 17;
+    return s->coin & 1;
+}
+
+//Promote half of every over-capacity level, lowest first, until we're within budget.
+static int compress(apop_sketch *s){
+    for (int h=0; h< s->levelct && s->held >= s->budget; h++){
+        if (s->sizes[h] < capacity(s, h)) continue;
+        if (h+1 == s->levelct && add_level(s)) return 1;
+        size_t pairs = s->sizes[h]/2;
+        if (reserve(s, h+1, pairs)) return 1;
+        double *l = s->levels[h];
+        gsl_sort(l, 1, s->sizes[h]);
+        //An odd one out stays behind, at the front of the level.
+        size_t start = s->sizes[h] % 2, offset = coin_flip(s);
+        double *up = s->levels[h+1] + s->sizes[h+1];
+        for (size_t i=0; i< pairs; i++)
+            up[i] = l[start + 2*i + offset];
+        s->sizes[h+1] += pairs;
+        s->sizes[h] = start;
+        s->held -= pairs;
+    }
+    return 0;
+}
+
+/** Allocate a quantile sketch, which estimates the percentiles of a data stream
+without keeping the stream in memory.
+
+\code
+apop_sketch *s = apop_sketch_alloc();
+for (apop_data *block; (block = apop_query_cursor_next(cursor)); )
+    apop_sketch_add_vector(s, block->vector);
+double *pctiles = apop_sketch_percentiles(s);
+printf("median: %g; 99th percentile: %g\n", pctiles[50], pctiles[99]);
+free(pctiles);
+apop_sketch_free(s);
+\endcode
+
+\param k The accuracy knob. The sketch holds fewer than about \f$3k\f$ numbers no
+matter how much data you give it, and the error in the rank of a returned percentile is
+proportional to \f$1/k\f$: with the default <tt>k=200</tt>, a percentile's rank is
+usually within a few tenths of a percent of where it should be, and with 99% confidence
+is within about 1.7%. (Default: 200; minimum: 8)
+
+\return A sketch, to be freed with \ref apop_sketch_free. \c NULL on allocation failure.
+
+\li Given the same data in the same order, the sketch always gives the same output.
+\li Sketches of separate chunks of data can be combined via \ref apop_sketch_merge; see
+that function for using sketches with threads.
+\li There is also an SQL aggregate, <tt>percentile_sketch(x, p)</tt>; see \ref db_moments.
+\li This function uses the \ref designated syntax for inputs.
+*/
+APOP_VAR_HEAD apop_sketch * apop_sketch_alloc(int k){
+    int apop_varad_var(k, 200);
+    Apop_stopif(k < 8, k = 8, 1, "k=%i is too small to be useful; using k=8.", k);
+APOP_VAR_ENDHEAD
+    apop_sketch *s = malloc(sizeof(apop_sketch));
+    Apop_stopif(!s, return NULL, 0, "Allocation error.");
+    *s = (apop_sketch){.k = k, .min = GSL_POSINF, .max = GSL_NEGINF, .coin = 0x2545F4914F6CDD1DULL};
+    Apop_stopif(add_level(s), apop_sketch_free(s); return NULL, 0, "Allocation error.");
+    return s;
+}
+
+/** Free a sketch allocated via \ref apop_sketch_alloc, \ref apop_sketch_copy, or
+ \ref apop_sketch_merge.
+ */
+void apop_sketch_free(apop_sketch *s){
+    if (!s) return;
+    for (int h=0; h< s->levelct; h++) free(s->levels[h]);
+    free(s->levels);
+    free(s->sizes);
+    free(s->spaces);
+    free(s);
+}
+
+/** Add one number to a sketch. NaNs are skipped.
+
+\return Zero on success; nonzero if there was an allocation error, in which case \c x
+isn't counted.
+ */
+int apop_sketch_add(apop_sketch *s, double x){
+    Apop_stopif(!s, return 1, 0, "NULL sketch.");
+    if (gsl_isnan(x)) return 0;
+    if (reserve(s, 0, 1)) return 1;
+    s->levels[0][s->sizes[0]++] = x;
+    s->held++;
+    s->n++;
+    if (x < s->min) s->min = x;
+    if (x > s->max) s->max = x;
+    return s->held >= s->budget ? compress(s) : 0;
+}
+
+/** Add every element of a vector to a sketch. NaNs are skipped.
+
+\param s A sketch from \ref apop_sketch_alloc.
+\param v A vector. \c NULL is OK, and adds nothing.
+\return Zero on success; nonzero on allocation error.
+ */
+int apop_sketch_add_vector(apop_sketch *s, gsl_vector const *v){
+    if (!v) return 0;
+    for (size_t i=0; i< v->size; i++)
+        if (apop_sketch_add(s, gsl_vector_get(v, i))) return 1;
+    return 0;
+}
+
+/** Fold the data summarized in one sketch into another, so that \c into summarizes
+both data sets. Sketches with different \c k can be merged; the output keeps the
+\c k of \c into.
+
+This makes it easy to sketch a data set in chunks, in any order, on any number of
+threads, so long as each thread writes only to its own sketch. E.g., with OpenMP:
+
+\code
+apop_sketch *total = apop_sketch_alloc();
+#pragma omp parallel
+{
+    apop_sketch *mine = apop_sketch_alloc();
+    #pragma omp for
+    for (int i=0; i< chunk_ct; i++)
+        apop_sketch_add_vector(mine, chunks[i]);
+    #pragma omp critical
+    apop_sketch_merge(total, mine);
+    apop_sketch_free(mine);
+}
+\endcode
+
+\param into The sketch to be added to. If \c NULL, I return a copy of \c from.
+\param from The sketch to add in; not modified.
+\return \c into, or \c NULL on allocation error.
+*/
+apop_sketch * apop_sketch_merge(apop_sketch *into, apop_sketch const *from){
+    if (!into) return apop_sketch_copy(from);
+    if (!from) return into;
+    while (into->levelct < from->levelct)
+        Apop_stopif(add_level(into), return NULL, 0, "Allocation error.");
+    for (int h=0; h< from->levelct; h++){
+        Apop_stopif(reserve(into, h, from->sizes[h]), return NULL, 0, "Allocation error.");
+        memcpy(into->levels[h] + into->sizes[h], from->levels[h], sizeof(double)*from->sizes[h]);
+        into->sizes[h] += from->sizes[h];
+        into->held += from->sizes[h];
+    }
+    into->n += from->n;
+    if (from->min < into->min) into->min = from->min;
+    if (from->max > into->max) into->max = from->max;
+    while (into->held >= into->budget){
+        size_t before = into->held;
+        Apop_stopif(compress(into), return NULL, 0, "Allocation error.");
+        if (into->held == before) break;
+    }
+    return into;
+}
+
+/** Return a copy of a sketch, which can be added to independently of the original.
+ */
+apop_sketch * apop_sketch_copy(apop_sketch const *s){
+    if (!s) return NULL;
+    apop_sketch *out = apop_sketch_alloc(s->k);
+    if (!out) return NULL;
+    out->coin = s->coin;
+    Apop_stopif(!apop_sketch_merge(out, s), apop_sketch_free(out); return NULL, 0, "Allocation error.");
+    return out;
+}
+
+/** The count of (non-NaN) numbers that have been added to the sketch.
+ */
+size_t apop_sketch_count(apop_sketch const *s){ return s ? s->n : 0; }
+
+typedef struct {
+    double x;
+    size_t weight;
+} weighted_item;
+
+static int by_value(void const *a, void const *b){
+    double x = ((weighted_item const *)a)->x, y = ((weighted_item const *)b)->x;
+    return (x > y) - (x < y);
+}
+
+//Sorted items with cumulative weights: items[i].weight is the count of observations <= items[i].x.
+static weighted_item *cumulative(apop_sketch const *s){
+    weighted_item *items = malloc(sizeof(weighted_item) * GSL_MAX(s->held, 1));
+    Apop_stopif(!items, return NULL, 0, "Allocation error.");
+    size_t ct = 0;
+    for (int h=0; h< s->levelct; h++)
+        for (size_t i=0; i< s->sizes[h]; i++)
+            items[ct++] = (weighted_item){.x = s->levels[h][i], .weight = (size_t)1 << h};
+    qsort(items, ct, sizeof(weighted_item), by_value);
+    for (size_t i=1; i< ct; i++) items[i].weight += items[i-1].weight;
+    return items;
+}
+
+//The value with the given (zero-based) rank: the first item whose cumulative weight exceeds it.
+static double at_rank(apop_sketch const *s, weighted_item const *items, size_t rank){
+    if (rank == 0) return s->min;
+    if (rank >= s->n-1) return s->max;
+    size_t lo = 0, hi = s->held-1;
+    while (lo < hi){
+        size_t mid = (lo+hi)/2;
+        if (items[mid].weight > rank) hi = mid;
+        else lo = mid+1;
+    }
+    return items[lo].x;
+}
+
+//Same index arithmetic and rounding rules as apop_vector_percentiles.
+static double sketch_percentile(apop_sketch const *s, weighted_item const *items, double p, char rounding){
+    double target = p*(s->n-1)/100.;
+    size_t index = target;
+    if (index >= s->n-1 || index == target) return at_rank(s, items, index);
+    if (rounding == 'u') return at_rank(s, items, index+1);
+    if (rounding == 'a') return (at_rank(s, items, index) + at_rank(s, items, index+1))/2.;
+    return at_rank(s, items, index);
+}
+
+/** Estimate percentiles from a sketch, in the same form as \ref apop_vector_percentiles: an
+array of size 101, where \c returned_vector[95] gives the value of the 95th percentile, for example.
+\c returned_vector[0] and \c returned_vector[100] are the exact min and max.
+
+\param s A sketch, from \ref apop_sketch_alloc.
+\param rounding 'u', 'd', or 'a', as per \ref apop_vector_percentiles. (Default = 'd'.)
+\return A \c malloced array of 101 doubles, which you'll want to \c free. If the
+sketch is empty, every element is NaN. Return \c NULL on allocation error.
+
+\li If fewer than about \c k numbers have been added, the output is exactly what \ref
+apop_vector_percentiles would give for the same data.
+\li This function uses the \ref designated syntax for inputs.
+*/
+APOP_VAR_HEAD double * apop_sketch_percentiles(apop_sketch const *s, char rounding){
+    apop_sketch const * apop_varad_var(s, NULL);
+    Apop_stopif(!s, return NULL, 0, "NULL sketch.");
+    char apop_varad_var(rounding, 'd');
+APOP_VAR_ENDHEAD
+    double *pctiles = malloc(sizeof(double) * 101);
+    Apop_stopif(!pctiles, return NULL, 0, "Allocation error.");
+    if (!s->n){
+        for (int i=0; i< 101; i++) pctiles[i] = GSL_NAN;
+        return pctiles;
+    }
+    weighted_item *items = cumulative(s);
+    Apop_stopif(!items, free(pctiles); return NULL, 0, "Allocation error.");
+    for (int i=0; i< 101; i++)
+        pctiles[i] = sketch_percentile(s, items, i, rounding);
+    pctiles[0] = s->min;
+    pctiles[100] = s->max;
+    free(items);
+    return pctiles;
+}
+
+/** Estimate a single percentile from a sketch.
+
+\param s A sketch, from \ref apop_sketch_alloc.
+\param p The percentile, from 0 to 100. Need not be an integer. (No default)
+\param rounding 'u', 'd', or 'a', as per \ref apop_vector_percentiles. (Default = 'd'.)
+\return The estimate, or NaN if the sketch is empty or \c p is out of range.
+\li This function uses the \ref designated syntax for inputs.
+*/
+APOP_VAR_HEAD double apop_sketch_percentile(apop_sketch const *s, double p, char rounding){
+    apop_sketch const * apop_varad_var(s, NULL);
+    Apop_stopif(!s, return GSL_NAN, 0, "NULL sketch.");
+    double p = varad_in.p; //no default: p=0 is meaningful.
+    Apop_stopif(!(p >= 0 && p <= 100), return GSL_NAN, 0, "The percentile should be between 0 and 100; I got %g.", p);
+    char apop_varad_var(rounding, 'd');
+APOP_VAR_ENDHEAD
+    if (!s->n) return GSL_NAN;
+    weighted_item *items = cumulative(s);
+    Apop_stopif(!items, return GSL_NAN, 0, "Allocation error.");
+    double out = p == 0 ? s->min : p == 100 ? s->max : sketch_percentile(s, items, p, rounding);
+    free(items);
+    return out;
+}
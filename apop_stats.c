@@ -5,6 +5,15 @@
 #include <gsl/gsl_rng.h>
 #include <gsl/gsl_eigen.h>
 
+/* Column i of the matrix of an apop_data set. If the set is stored by columns (see
+   apop_data_to_columns), that's a contiguous row of d->columns; else it's the usual
+   column view of d->matrix, striding over whole rows. */
+#define Data_col(d, i, v) gsl_vector apop_dc_##v = (d)->columns                           \
+                                ? gsl_matrix_row((d)->columns, (i)).vector             \
+                                : gsl_matrix_column((d)->matrix, (i)).vector;          \
+                          gsl_vector *v = &apop_dc_##v;
+#define Data_colct(d) ((d)->columns ? (d)->columns->size1 : (d)->matrix->size2)
+
 
 /** \defgroup vector_moments Calculate moments (mean, var, kurtosis) for the data in a gsl_vector.
 
@@ -400,20 +409,125 @@ void apop_matrix_mean_and_var(const gsl_matrix *data, double *mean, double *var)
     *var  = avg2 - gsl_pow_2(avg); //E[x^2] - E^2[x]
 }
 
+/* Selection for apop_data_summarize's median: quickselect with a median-of-three
+   pivot, so we only partially order the column instead of sorting it. If the
+   partitions keep coming out lopsided (more than about 2 log2(n) rounds), give up and
+   sort what's left, which keeps the worst case at n log n. Rearranges x. */
+static double select_kth(double *x, size_t n, size_t k){
+    long lo = 0, hi = n-1;
+    int budget = 2;
+    for (size_t m=n; m > 1; m /= 2) budget += 2;
+    while (hi > lo){
+        if (hi - lo < 16 || !budget--){
+            gsl_sort(x+lo, 1, hi-lo+1);
+            return x[k];
+        }
+        long mid = lo + (hi-lo)/2;
+        double t;
+        #define Swap(a, b) (t = x[a], x[a] = x[b], x[b] = t)
+        if (x[mid] < x[lo]) Swap(mid, lo);
+        if (x[hi] < x[lo])  Swap(hi, lo);
+        if (x[hi] < x[mid]) Swap(hi, mid);
+        double pivot = x[mid];
+        long i = lo, j = hi;
+        while (i <= j){
+            while (x[i] < pivot) i++;
+            while (pivot < x[j]) j--;
+            if (i <= j){
+                Swap(i, j);
+                i++;
+                j--;
+            }
+        }
+        #undef Swap
+        if ((long)k <= j)      hi = j;
+        else if ((long)k >= i) lo = i;
+        else return x[k]; //k is in the band of elements equal to the pivot.
+    }
+    return x[k];
+}
+
+typedef struct {
+    apop_data *in, *out;
+    double **scratch; //one copy-of-a-column buffer per slot, allocated on first use.
+    int error;
+} summarize_job;
+
+/* One pass per column for the moments and extrema, then a selection for the median.
+   Each column's numbers are written to its own row of the output, so the columns can
+   go to different threads. */
+static void summarize_cols(void *in, size_t lo, size_t hi, int slot){
+    summarize_job *j = in;
+    size_t n = j->in->columns ? j->in->columns->size2 : j->in->matrix->size1;
+    gsl_vector *w = j->in->weights;
+    if (!j->scratch[slot]) j->scratch[slot] = malloc(sizeof(double)*n);
+    Apop_stopif(!j->scratch[slot], j->error='a'; return, 0, "Allocation error.");
+    double *x = j->scratch[slot];
+    for (size_t c=lo; c< hi; c++){
+        Data_col(j->in, c, v);
+        if (!n){
+            for (int k=0; k< 6; k++) gsl_matrix_set(j->out->matrix, c, k, GSL_NAN);
+            continue;
+        }
+        double min = gsl_vector_get(v, 0), max = min;
+        double mean, var;
+        if (!w){ //Sums of deviations from the first element, which keeps E(x^2)-E^2(x) stable.
+            long double shift = min, sum = 0, sumsq = 0;
+            for (size_t i=0; i< n; i++){
+                double vv = x[i] = gsl_vector_get(v, i);
+                long double d = vv - shift;
+                sum   += d;
+                sumsq += d*d;
+                if (vv < min) min = vv;
+                if (vv > max) max = vv;
+            }
+            mean = shift + sum/n;
+            var = (sumsq - sum*sum/n)/(n-1.);
+        } else { //Same sums, same n rule, as apop_vector_weighted_{mean,var}.
+            long double sum = 0, wsum = 0, sumsq = 0;
+            for (size_t i=0; i< n; i++){
+                double vv = x[i] = gsl_vector_get(v, i);
+                double ww = gsl_vector_get(w, i);
+                sum   += ww * vv;
+                sumsq += ww * gsl_pow_2(vv);
+                wsum  += ww;
+                if (vv < min) min = vv;
+                if (vv > max) max = vv;
+            }
+            mean = sum/wsum;
+            double len = (wsum < 1.1 ? n : wsum);
+            var = (sumsq/len - gsl_pow_2(sum/len)) * len/(len -1.);
+        }
+		gsl_matrix_set(j->out->matrix, c, 0, mean);
+		gsl_matrix_set(j->out->matrix, c, 1, sqrt(var));
+		gsl_matrix_set(j->out->matrix, c, 2, var);
+		gsl_matrix_set(j->out->matrix, c, 3, min);
+		gsl_matrix_set(j->out->matrix, c, 4, select_kth(x, n, (n-1)/2));
+		gsl_matrix_set(j->out->matrix, c, 5, max);
+    }
+}
+
 /** Put summary information about the columns of a table (mean, std dev, variance, min, median, max) in a table.
 
 \param indata The table to be summarized. An \ref apop_data structure.
 \return     An \ref apop_data structure with one row for each column in the original table, and a column for each summary statistic. May have a <tt>weights</tt> element.
 \exception out->error='a'  Allocation error.
 
+\li Each column is read once for the mean, variance, min, and max, and then the median
+is found by partially sorting a copy of the column, rather than fully sorting it. If
+there are weights, the mean and variance are weighted as per \ref
+apop_vector_weighted_mean and \ref apop_vector_weighted_var; the median is not weighted.
+\li The median is the lower of the two middle values when there is an even number of
+rows, matching <tt>apop_vector_percentiles(v)[50]</tt>.
+\li The columns are split among <tt>apop_opts.thread_count</tt> threads.
 \li This function gives more columns than you probably want; use \ref apop_data_prune_columns to pick the ones you want to see.
 \todo We should probably let this summarize rows as well. 
 \ingroup    output */
 apop_data * apop_data_summarize(apop_data *indata){
     Apop_assert_c(indata, NULL, 0, "You sent me a NULL apop_data set. Returning NULL.");
-    Apop_assert_c(indata->matrix, NULL, 0, "You sent me an apop_data set with a NULL matrix. Returning NULL.");
-    apop_data *out = apop_data_alloc(indata->matrix->size2, 6);
-    double mean, var;
+    Apop_assert_c(indata->matrix || indata->columns, NULL, 0, "You sent me an apop_data set with a NULL matrix. Returning NULL.");
+    size_t colct = Data_colct(indata);
+    apop_data *out = apop_data_alloc(colct, 6);
     char rowname[10000]; //crashes on more than 10^9995 columns.
 	apop_name_add(out->names, "mean", 'c');
 	apop_name_add(out->names, "std dev", 'c');
@@ -424,28 +538,17 @@ apop_data * apop_data_summarize(apop_data *indata){
 	if (indata->names !=NULL)
         apop_name_stack(out->names,indata->names, 'r', 'c');
 	else
-		for (size_t i=0; i< indata->matrix->size2; i++){
+		for (size_t i=0; i< colct; i++){
 			sprintf(rowname, "col %zu", i);
 			apop_name_add(out->names, rowname, 'r');
 		}
-	for (size_t i=0; i< indata->matrix->size2; i++){
-        Apop_matrix_col(indata->matrix, i, v);
-        if (!indata->weights){
-            mean	= apop_vector_mean(v);
-            var 	= apop_vector_var_m(v,mean);
-        } else {
-            mean	= apop_vector_weighted_mean(v,indata->weights);
-            var 	= apop_vector_weighted_var(v,indata->weights);
-        } 
-        double *pctiles = apop_vector_percentiles(v);
-		gsl_matrix_set(out->matrix, i, 0, mean);
-		gsl_matrix_set(out->matrix, i, 1, sqrt(var));
-		gsl_matrix_set(out->matrix, i, 2, var);
-		gsl_matrix_set(out->matrix, i, 3, pctiles[0]);
-		gsl_matrix_set(out->matrix, i, 4, pctiles[50]);
-		gsl_matrix_set(out->matrix, i, 5, pctiles[100]);
-        free(pctiles);
-	}
+    int slotct = GSL_MAX(apop_opts.thread_count, 1);
+    double *scratch[slotct];
+    for (int i=0; i< slotct; i++) scratch[i] = NULL;
+    summarize_job job = {.in=indata, .out=out, .scratch=scratch};
+    apop_threadpool_for(summarize_cols, &job, colct, slotct);
+    for (int i=0; i< slotct; i++) free(scratch[i]);
+    if (job.error) out->error = job.error;
 	return out;
 }
 
@@ -569,51 +672,145 @@ double apop_vector_weighted_cov(const gsl_vector *v1, const gsl_vector *v2, cons
     return (sumsq/len  - sum1*sum2/gsl_pow_2(len)) *(len/(len-1));
 }
 
+//Fill means with the (weighted) column means; return the total weight.
+static double weighted_means(gsl_matrix const *m, gsl_matrix const *cols, gsl_vector const *w, double *means){
+    size_t n = m ? m->size1 : cols->size2, p = m ? m->size2 : cols->size1;
+    long double sums[p], wsum = w ? 0 : n;
+    for (size_t j=0; j< p; j++) sums[j] = 0;
+    for (size_t i=0; w && i< n; i++) wsum += gsl_vector_get(w, i);
+    if (m) for (size_t i=0; i< n; i++){
+        double const *row = gsl_matrix_const_ptr(m, i, 0);
+        double wi = w ? gsl_vector_get(w, i) : 1;
+        for (size_t j=0; j< p; j++) sums[j] += wi * row[j];
+    } else for (size_t j=0; j< p; j++){
+        double const *col = gsl_matrix_const_ptr(cols, j, 0);
+        for (size_t i=0; i< n; i++) sums[j] += (w ? gsl_vector_get(w, i) : 1) * col[i];
+    }
+    for (size_t j=0; j< p; j++) means[j] = sums[j]/wsum;
+    return wsum;
+}
+
+/* Set the lower triangle of out to sum_i w_i (x_ij - mean_j)(x_ik - mean_k), a block of
+   rows at a time via dsyrk. The weights must be nonnegative. */
+static int centered_crossproducts(gsl_matrix const *m, gsl_matrix const *cols, gsl_vector const *w,
+                                                    double const *means, gsl_matrix *out){
+    size_t n = m ? m->size1 : cols->size2, p = m ? m->size2 : cols->size1;
+    //About a megabyte of buffer, but at least 256 rows per dsyrk so it has something to chew on.
+    size_t block = GSL_MIN(n, GSL_MAX(256, (1<<17)/GSL_MAX(p, 1)));
+    gsl_matrix *buf = m ? gsl_matrix_alloc(block, p) : gsl_matrix_alloc(p, block);
+    double *sw = malloc(sizeof(double)*block);
+    Apop_stopif(!buf || !sw, if (buf) gsl_matrix_free(buf); free(sw); return 'a', 0, "Allocation error.");
+    gsl_matrix_set_zero(out);
+    for (size_t lo=0; lo< n; lo+= block){
+        size_t ct = GSL_MIN(block, n-lo);
+        for (size_t i=0; i< ct; i++) sw[i] = w ? sqrt(gsl_vector_get(w, lo+i)) : 1;
+        if (m){
+            for (size_t i=0; i< ct; i++){
+                double const *row = gsl_matrix_const_ptr(m, lo+i, 0);
+                double *brow = gsl_matrix_ptr(buf, i, 0);
+                for (size_t j=0; j< p; j++) brow[j] = (row[j] - means[j])*sw[i];
+            }
+            gsl_matrix_const_view b = gsl_matrix_const_submatrix(buf, 0, 0, ct, p);
+            gsl_blas_dsyrk(CblasLower, CblasTrans, 1, &b.matrix, 1, out);
+        } else {
+            for (size_t j=0; j< p; j++){
+                double const *col = gsl_matrix_const_ptr(cols, j, lo);
+                double *bcol = gsl_matrix_ptr(buf, j, 0);
+                for (size_t i=0; i< ct; i++) bcol[i] = (col[i] - means[j])*sw[i];
+            }
+            gsl_matrix_const_view b = gsl_matrix_const_submatrix(buf, 0, 0, p, ct);
+            gsl_blas_dsyrk(CblasLower, CblasNoTrans, 1, &b.matrix, 1, out);
+        }
+    }
+    gsl_matrix_free(buf);
+    free(sw);
+    return 0;
+}
+
+/* The covariance engine behind the four functions below.
+
+   Give it a row-major matrix m, or a set stored by columns (d->columns, one data
+   column per row; see apop_data_to_columns), and optionally weights. One pass gets the
+   (weighted) means; then the data is centered a block of rows at a time into a buffer,
+   and dsyrk adds the block's cross-products to the lower triangle of out. So the input
+   is read twice, is never written to, and all the arithmetic is in BLAS-3.
+
+   With weights, the block is scaled by sqrt(w) before the dsyrk. The sample-size rule is
+   that of apop_vector_weighted_cov: len is the total weight, unless the weights sum to
+   less than 1.1, in which case len is the row count. That function computes
+   (S_xy - S_x S_y/len)/(len-1), where the S's are weighted sums; from the centered
+   cross-products C_xy = S_xy - S_x S_y/W that's (C_xy + mean_x mean_y W(1-W/len))/(len-1),
+   and the correction is zero when len==W.
+
+   Negative weights have no square root; for those, fall back to the pairwise loop. */
+static int covariance_core(gsl_matrix const *m, gsl_matrix const *cols, gsl_vector const *w, gsl_matrix *out){
+    size_t n = m ? m->size1 : cols->size2, p = m ? m->size2 : cols->size1;
+    Apop_stopif(w && w->size != n, gsl_matrix_set_all(out, GSL_NAN); return 0, 0,
+            "The data has %zu rows but the weights vector has size %zu. Returning NaNs.", n, w->size);
+    #define Col(j, v) gsl_vector_const_view v = m ? gsl_matrix_const_column(m, j) : gsl_matrix_const_row(cols, j);
+    if (w) for (size_t i=0; i< n; i++)
+        if (gsl_vector_get(w, i) < 0){
+            for (size_t j=0; j< p; j++)
+                for (size_t k=0; k<= j; k++){
+                    Col(j, vj);
+                    Col(k, vk);
+                    gsl_matrix_set(out, j, k, apop_vector_weighted_cov(&vj.vector, &vk.vector, w));
+                    gsl_matrix_set(out, k, j, gsl_matrix_get(out, j, k));
+                }
+            return 0;
+        }
+
+    double means[p];
+    double wsum = weighted_means(m, cols, w, means);
+    Apop_stopif(centered_crossproducts(m, cols, w, means, out), return 'a', 0, "Allocation error.");
+
+    double len = (w && wsum < 1.1) ? n : wsum;
+    double correction = w ? wsum*(1 - wsum/len) : 0;
+    for (size_t j=0; j< p; j++)
+        for (size_t k=0; k<= j; k++){
+            double c = (gsl_matrix_get(out, j, k) + means[j]*means[k]*correction)/(len-1);
+            gsl_matrix_set(out, j, k, c);
+            gsl_matrix_set(out, k, j, c);
+        }
+    return 0;
+    #undef Col
+}
+
+//Scale cov_ij by 1/(sigma_i sigma_j), with the variances from the diagonal.
+static void cov_to_correlation(gsl_matrix *cov){
+    size_t p = cov->size1;
+    double sd[p];
+    for (size_t i=0; i< p; i++) sd[i] = sqrt(gsl_matrix_get(cov, i, i));
+    for (size_t i=0; i< p; i++)
+        for (size_t j=0; j< p; j++)
+            gsl_matrix_set(cov, i, j, gsl_matrix_get(cov, i, j)/(sd[i]*sd[j]));
+}
+
 /** Returns the variance/covariance matrix relating each column with each other.
 
 This is the \c gsl_matrix  version of \ref apop_data_covariance; if you have column names, use that one.
 
 \param in 	A data matrix: rows are observations, columns are variables. (No default, must not be \c NULL)
-\param normalize
-'n', 'N', or 1 = subtract the mean from each column, thus changing the input data but speeding up the computation.<br>
-anything else (like 0)= don't modify the input data (default = no modification)
+\param normalize Ignored. This used to give the option to subtract the column means from
+the input data in place to save time; the calculation now centers a block of rows at a
+time in a separate buffer and is faster than that was, and the input is never modified.
 
 \return Returns the variance/covariance matrix relating each column with each other. This function allocates the matrix for you.
 This is the sample version---dividing by \f$n-1\f$, not \f$n\f$.
 It uses the \ref designated syntax for inputs.
+
+\li The cross-products are accumulated via the BLAS's \c dsyrk, a block of rows at a
+time, so the speed is about that of one matrix multiplication, and a BLAS with threads
+will use them.
 \ingroup matrix_moments */
 APOP_VAR_HEAD gsl_matrix *apop_matrix_covariance(gsl_matrix *in, const char normalize){
     gsl_matrix *apop_varad_var(in, NULL)
     Apop_assert_c(in,  NULL, 0, "Input matrix is NULL. Returning same.");
     const char apop_varad_var(normalize, 0)
 APOP_VAR_ENDHEAD
-    gsl_matrix *out;
-    double means[in->size2];
-    gsl_vector_view	v1, v2;
-	if (normalize == 1 || normalize=='n' || normalize == 'N'){
-		out	= gsl_matrix_alloc(in->size2, in->size2);
-		apop_matrix_normalize(in,'c', 0);
-		gsl_blas_dgemm(CblasTrans,CblasNoTrans, 1, in, in, 0, out);
-	    gsl_matrix_scale(out, 1.0/(in->size1-1));
-	}
-	else{
-		out	= gsl_matrix_calloc(in->size2, in->size2);
-		for(size_t i=0; i< in->size2; i++){
-			Apop_matrix_col(in, i, v);
-			means[i]	= apop_mean(v);
-		}
-		for(size_t i=0; i< in->size2; i++){
-			v1		= gsl_matrix_column(in, i);
-			for(size_t j=i; j< in->size2; j++){
-			    v2		= gsl_matrix_column(in, j);
-                apop_matrix_increment(out, i, j, 
-					   gsl_stats_covariance_m (v1.vector.data, v1.vector.stride, v2.vector.data,  v2.vector.stride,
-                                                    v2.vector.size, means[i], means[j]));
-				if (i != j)	//set the symmetric element.
-					gsl_matrix_set(out, j, i, gsl_matrix_get(out, i, j));
-			}
-	    }
-    }
+    gsl_matrix *out = gsl_matrix_alloc(in->size2, in->size2);
+    Apop_stopif(!out, return NULL, 0, "Allocation error.");
+    Apop_stopif(covariance_core(in, NULL, NULL, out), gsl_matrix_free(out); return NULL, 0, "Allocation error.");
 	return out;
 }
 
@@ -622,9 +819,7 @@ APOP_VAR_ENDHEAD
 This is the \c gsl_matrix  version of \ref apop_data_correlation; if you have column names, use that one.
 
 \param in 	A data matrix: rows are observations, columns are variables. (No default, must not be \c NULL)
-\param normalize
-'n' or 'N' = subtract the mean from each column, thus changing the input data but speeding up the computation.<br>
-anything else (like 0)= don't modify the input data (default = no modification)
+\param normalize Ignored; see \ref apop_matrix_covariance. The input is never modified.
 
 \return Returns the variance/covariance matrix relating each column with each other. This function allocates the matrix for you.
 
@@ -635,41 +830,31 @@ APOP_VAR_HEAD gsl_matrix *apop_matrix_correlation(gsl_matrix *in, const char nor
     apop_assert_c(in,  NULL, 0, "Input matrix is NULL; returning NULL.");
     const char apop_varad_var(normalize, 0)
 APOP_VAR_ENDHEAD
-    gsl_matrix *out = apop_matrix_covariance(in, normalize);
-    for(size_t i=0; i< in->size2; i++){
-        APOP_MATRIX_COL(in, i, cvin);
-        APOP_MATRIX_COL(out, i, cvout);
-        APOP_MATRIX_ROW(out, i, rvout);
-        double std_dev = sqrt(apop_var(cvin));
-        gsl_vector_scale(cvout, 1.0/std_dev);
-        gsl_vector_scale(rvout, 1.0/std_dev);
-    }
+    gsl_matrix *out = apop_matrix_covariance(in);
+    if (out) cov_to_correlation(out);
     return out;
 }
 
 /** Returns the variance/covariance matrix relating each column of the matrix to each other column.
 
-This is the \ref apop_data version of \ref apop_matrix_covariance; if you don't have column names or weights, or would like to use the speed-saving and data-destroying normalization option, use that one.
+This is the \ref apop_data version of \ref apop_matrix_covariance; if you don't have column names or weights, use that one.
 
-\param in 	An \ref apop_data set. If the weights vector is set, I'll take it into account.
+\param in 	An \ref apop_data set. If the weights vector is set, I'll take it into account, as per \ref apop_vector_weighted_cov.
 
 \return Returns a \ref apop_data set the variance/covariance matrix relating each column with each other.
 \exception out->error='a'  Allocation error.
+
+\li The input is not modified, and the weighted version doesn't copy the data; see
+\ref apop_matrix_covariance for notes on speed.
 \ingroup matrix_moments */
 apop_data *apop_data_covariance(const apop_data *in){
     Apop_assert_c(in,  NULL, 1, "You sent me a NULL apop_data set. Returning NULL.");
-    Apop_assert_c(in->matrix,  NULL, 1, "You sent me an apop_data set with a NULL matrix. Returning NULL.");
-    apop_data *out = apop_data_alloc(in->matrix->size2, in->matrix->size2);
+    Apop_assert_c(in->matrix || in->columns,  NULL, 1, "You sent me an apop_data set with a NULL matrix. Returning NULL.");
+    size_t colct = Data_colct(in);
+    apop_data *out = apop_data_alloc(colct, colct);
     Apop_stopif(out->error, return out, 0, "allocation error.");
-    for (size_t i=0; i < in->matrix->size2; i++){
-        for (size_t j=i; j < in->matrix->size2; j++){
-            Apop_col(in, i, v1);
-            Apop_col(in, j, v2);
-            double var = apop_vector_weighted_cov(v1, v2, in->weights);
-            gsl_matrix_set(out->matrix, i,j, var);
-            if (i!=j) gsl_matrix_set(out->matrix, j,i, var);
-        }
-    }
+    Apop_stopif(covariance_core(in->columns ? NULL : in->matrix, in->columns, in->weights, out->matrix),
+            out->error='a'; return out, 0, "Allocation error.");
     apop_name_stack(out->names, in->names, 'c');
     apop_name_stack(out->names, in->names, 'r', 'c');
     return out;
@@ -677,7 +862,7 @@ apop_data *apop_data_covariance(const apop_data *in){
 
 /** Returns the matrix of correlation coefficients \f$(\sigma^2_{xy}/(\sigma_x\sigma_y))\f$ relating each column with each other.
 
-This is the \ref apop_data version of \ref apop_matrix_correlation; if you don't have column names or weights, (or want the option for the faster, data-destroying version), use that one.
+This is the \ref apop_data version of \ref apop_matrix_correlation; if you don't have column names or weights, use that one.
 
 \param in 	A data matrix: rows are observations, columns are variables. If you give me a weights vector, I'll use it.
 
@@ -686,17 +871,264 @@ This is the \ref apop_data version of \ref apop_matrix_correlation; if you don't
 \ingroup matrix_moments */
 apop_data *apop_data_correlation(const apop_data *in){
     apop_data *out = apop_data_covariance(in);
-    for(size_t i=0; i< in->matrix->size2; i++){
-        Apop_col(in, i, cvin);
-        Apop_col(out, i, cvout);
-        Apop_row(out, i, rvout);
-        double std_dev = sqrt(apop_vector_weighted_var(cvin, in->weights));
-        gsl_vector_scale(cvout, 1.0/std_dev);
-        gsl_vector_scale(rvout, 1.0/std_dev);
-    }
+    if (!out || out->error) return out;
+    cov_to_correlation(out->matrix);
     return out;
 }
 
+/* Running moments.
+
+   For each column, an apop_moments keeps the total weight W, the weighted mean, and the
+   weighted sums of powers of deviations from that mean, M2, M3, M4, plus the matrix of
+   weighted cross-products of deviations, C (whose diagonal is M2). Two sets of these
+   combine via the formulæ of Chan, Golub, and LeVeque, as generalized to higher moments
+   and weights by Pébay (2008, Sandia Report SAND2008-6212); adding one row is combining
+   with a set of one. The sample-size rules are those of the apop_vector_weighted_...
+   functions, which reduce to the unweighted ones when every weight is one. */
+struct apop_moments {
+    size_t colct, n;
+    double w;
+    double *mean, *m2, *m3, *m4;
+    gsl_matrix *cross;  //lower triangle only.
+};
+
+/** Allocate a running tally of moments for a set of columns, to which you can add data a
+row or a block at a time, and from which you can get the mean, variance, skew, kurtosis,
+and covariances at any point, without the data being stored anywhere.
+
+\code
+apop_moments *m = apop_moments_alloc(3);
+for (apop_data *block; (block = apop_query_cursor_next(cursor)); )
+    apop_moments_push_batch(m, block);
+printf("mean of column 0: %g; cov(0, 2): %g\n", apop_moments_mean(m, 0), apop_moments_cov(m, 0, 2));
+apop_moments_free(m);
+\endcode
+
+Tallies of different chunks of data can be combined via \ref apop_moments_merge, so
+each thread can keep its own and merge at the end.
+
+The results match those of the vector functions, to within rounding:
+
+<table>
+<tr><td>\ref apop_moments_mean</td><td>\ref apop_vector_mean, or \ref apop_vector_weighted_mean</td></tr>
+<tr><td>\ref apop_moments_var</td><td>\ref apop_vector_var, or \ref apop_vector_weighted_var</td></tr>
+<tr><td>\ref apop_moments_skew_pop</td><td>\ref apop_vector_skew_pop, or \ref apop_vector_weighted_skew</td></tr>
+<tr><td>\ref apop_moments_kurtosis_pop</td><td>\ref apop_vector_kurtosis_pop, or \ref apop_vector_weighted_kurt</td></tr>
+<tr><td>\ref apop_moments_skew</td><td>\ref apop_vector_skew</td></tr>
+<tr><td>\ref apop_moments_kurtosis</td><td>\ref apop_vector_kurtosis</td></tr>
+<tr><td>\ref apop_moments_cov</td><td>\ref apop_vector_cov, or \ref apop_vector_weighted_cov</td></tr>
+</table>
+
+If every weight is one (as when you use \ref apop_moments_push_batch on a data set with
+no weights), you get the first version; else the weighted version, with the same rule
+for interpreting the weights: if they sum to less than 1.1, they are treated as
+proportions, and the count of rows is the sample size; else as frequency weights, and
+the total weight is the sample size.
+
+Unlike the vector functions, the numbers here are kept as deviations from the running
+mean, so there is no loss of precision for data like timestamps, whose mean is large
+relative to their spread.
+
+\param colct The number of columns to track.
+\return A tally, to be freed via \ref apop_moments_free; \c NULL on allocation error.
+\li NaNs are not skipped: one NaN in a column makes that column's moments NaN.
+*/
+apop_moments *apop_moments_alloc(size_t colct){
+    Apop_stopif(!colct, return NULL, 0, "I need at least one column.");
+    apop_moments *m = calloc(1, sizeof(apop_moments));
+    Apop_stopif(!m, return NULL, 0, "Allocation error.");
+    m->colct = colct;
+    m->mean = calloc(colct, sizeof(double));
+    m->m2 = calloc(colct, sizeof(double));
+    m->m3 = calloc(colct, sizeof(double));
+    m->m4 = calloc(colct, sizeof(double));
+    m->cross = gsl_matrix_calloc(colct, colct);
+    Apop_stopif(!m->mean || !m->m2 || !m->m3 || !m->m4 || !m->cross,
+            apop_moments_free(m); return NULL, 0, "Allocation error.");
+    return m;
+}
+
+/** Free a tally from \ref apop_moments_alloc.  */
+void apop_moments_free(apop_moments *m){
+    if (!m) return;
+    free(m->mean); free(m->m2); free(m->m3); free(m->m4);
+    if (m->cross) gsl_matrix_free(m->cross);
+    free(m);
+}
+
+/* Combine a set of rows with total weight wb, mean mb, and sums m2b..m4b, crossb into a.
+   Any of the b arrays may be NULL, meaning all zeros (as for a single row). */
+static void moments_combine(apop_moments *a, size_t nb, double wb, double const *mb, double const *m2b,
+                        double const *m3b, double const *m4b, gsl_matrix const *crossb){
+    size_t p = a->colct;
+    double wa = a->w, w = wa + wb;
+    a->n += nb;
+    if (!wb) return;
+    double delta[p];
+    for (size_t j=0; j< p; j++){
+        double d = delta[j] = mb[j] - a->mean[j];
+        double M2b = m2b ? m2b[j] : 0, M3b = m3b ? m3b[j] : 0, M4b = m4b ? m4b[j] : 0;
+        double M2a = a->m2[j], M3a = a->m3[j];
+        a->m4[j] += M4b + gsl_pow_4(d)*wa*wb*(wa*wa - wa*wb + wb*wb)/gsl_pow_3(w)
+                        + 6*d*d*(wa*wa*M2b + wb*wb*M2a)/(w*w) + 4*d*(wa*M3b - wb*M3a)/w;
+        a->m3[j] += M3b + gsl_pow_3(d)*wa*wb*(wa - wb)/(w*w) + 3*d*(wa*M2b - wb*M2a)/w;
+        a->m2[j] += M2b + d*d*wa*wb/w;
+        a->mean[j] += d*wb/w;
+    }
+    for (size_t j=0; j< p; j++)
+        for (size_t k=0; k<= j; k++)
+            *gsl_matrix_ptr(a->cross, j, k) += (crossb ? gsl_matrix_get(crossb, j, k) : 0)
+                                                + delta[j]*delta[k]*wa*wb/w;
+    a->w = w;
+}
+
+/** Add one row of data to a tally.
+
+\param m A tally from \ref apop_moments_alloc.
+\param row An array of numbers, one for each column being tracked.
+\param weight The weight for the row; use 1 for unweighted data.
+\return Zero on success; nonzero if \c m or \c row is \c NULL.
+*/
+int apop_moments_push(apop_moments *m, double const *row, double weight){
+    Apop_stopif(!m || !row, return 1, 0, "NULL input.");
+    moments_combine(m, 1, weight, row, NULL, NULL, NULL, NULL);
+    return 0;
+}
+
+/** Add every row of an \ref apop_data set's matrix (or, for a one-column tally, its vector
+if there is no matrix) to a tally, using its weights if it has any.
+
+The moments of the block are calculated on their own, with two passes through the block
+and the cross-products via BLAS, and then combined with the tally so far. So this is
+much faster than pushing one row at a time, and to feed the tally in blocks from an
+\ref apop_query_cursor_open "apop_query_cursor" is as precise as calculating from the
+whole data set at once.
+
+\param m A tally from \ref apop_moments_alloc.
+\param d A data set, with as many matrix columns as \c m tracks. May be stored by columns
+(see \ref apop_data_to_columns).
+\return Zero on success; nonzero on allocation error or size mismatch.
+*/
+int apop_moments_push_batch(apop_moments *m, apop_data const *d){
+    Apop_stopif(!m || !d, return 1, 0, "NULL input.");
+    gsl_matrix const *mx = d->columns ? NULL : d->matrix, *cols = d->columns;
+    gsl_matrix vm; //a one-column matrix over the vector, stride and all.
+    if (!mx && !cols && d->vector && m->colct == 1){
+        vm = (gsl_matrix){.size1=d->vector->size, .size2=1, .tda=d->vector->stride, .data=d->vector->data};
+        mx = &vm;
+    }
+    Apop_stopif(!mx && !cols, return 1, 0, "The data set has no matrix.");
+    size_t n = mx ? mx->size1 : cols->size2, p = mx ? mx->size2 : cols->size1;
+    Apop_stopif(p != m->colct, return 1, 0, "The tally has %zu columns, but the data has %zu.", m->colct, p);
+    gsl_vector const *w = d->weights;
+    Apop_stopif(w && w->size != n, return 1, 0, "The data has %zu rows but the weights vector has size %zu.", n, w->size);
+    if (!n) return 0;
+    int negative = 0;
+    for (size_t i=0; w && i< n && !negative; i++) negative = gsl_vector_get(w, i) < 0;
+    if (negative){ //no sqrt(w) for the crossproducts, so go row by row.
+        double row[p];
+        for (size_t i=0; i< n; i++){
+            for (size_t j=0; j< p; j++)
+                row[j] = mx ? gsl_matrix_get(mx, i, j) : gsl_matrix_get(cols, j, i);
+            moments_combine(m, 1, gsl_vector_get(w, i), row, NULL, NULL, NULL, NULL);
+        }
+        return 0;
+    }
+
+    double means[p], m3[p], m4[p];
+    double wb = weighted_means(mx, cols, w, means);
+    gsl_matrix *cross = gsl_matrix_alloc(p, p);
+    Apop_stopif(!cross || centered_crossproducts(mx, cols, w, means, cross),
+            if (cross) gsl_matrix_free(cross); return 1, 0, "Allocation error.");
+    double m2[p];
+    for (size_t j=0; j< p; j++){
+        m2[j] = gsl_matrix_get(cross, j, j);
+        long double s3 = 0, s4 = 0;
+        for (size_t i=0; i< n; i++){
+            double dev = (mx ? gsl_matrix_get(mx, i, j) : gsl_matrix_get(cols, j, i)) - means[j];
+            double wi = w ? gsl_vector_get(w, i) : 1;
+            s3 += wi*gsl_pow_3(dev);
+            s4 += wi*gsl_pow_4(dev);
+        }
+        m3[j] = s3;
+        m4[j] = s4;
+    }
+    moments_combine(m, n, wb, means, m2, m3, m4, cross);
+    gsl_matrix_free(cross);
+    return 0;
+}
+
+/** Fold the tally \c from into the tally \c into, which then describes both data sets.
+
+\param into A tally. If \c NULL, allocate a new one (with as many columns as \c from).
+\param from Another tally, with as many columns as \c into; not modified.
+\return \c into, or \c NULL on error.
+*/
+apop_moments *apop_moments_merge(apop_moments *into, apop_moments const *from){
+    Apop_stopif(!from, return into, 1, "Merging in a NULL tally; returning the original.");
+    if (!into) into = apop_moments_alloc(from->colct);
+    if (!into) return NULL;
+    Apop_stopif(into->colct != from->colct, return NULL, 0, "Tallies of %zu and %zu columns can't be merged.",
+                                                            into->colct, from->colct);
+    moments_combine(into, from->n, from->w, from->mean, from->m2, from->m3, from->m4, from->cross);
+    return into;
+}
+
+/** The count of rows pushed into the tally. */
+size_t apop_moments_count(apop_moments const *m){ return m ? m->n : 0; }
+
+//The sample size, as per the rules for weights above; and the column check.
+static double moments_len(apop_moments const *m, size_t col){
+    Apop_stopif(!m, return GSL_NAN, 0, "NULL tally.");
+    Apop_stopif(col >= m->colct, return GSL_NAN, 0, "Asked for column %zu of a tally of %zu columns.", col, m->colct);
+    return m->w < 1.1 ? m->n : m->w;
+}
+
+/** The mean of a column of a tally; see \ref apop_moments_alloc. */
+double apop_moments_mean(apop_moments const *m, size_t col){
+    if (gsl_isnan(moments_len(m, col))) return GSL_NAN;
+    return m->n ? m->mean[col] : GSL_NAN;
+}
+
+/** The covariance between two columns of a tally; see \ref apop_moments_alloc. */
+double apop_moments_cov(apop_moments const *m, size_t col1, size_t col2){
+    double len = moments_len(m, GSL_MAX(col1, col2));
+    if (gsl_isnan(len)) return GSL_NAN;
+    //As in apop_vector_weighted_cov's (S_xy - S_x S_y/len)/(len-1), where S_xy = C_xy + W mean_x mean_y.
+    return (gsl_matrix_get(m->cross, GSL_MAX(col1, col2), GSL_MIN(col1, col2))
+            + m->mean[col1]*m->mean[col2]*m->w*(1 - m->w/len))/(len-1);
+}
+
+/** The sample variance of a column of a tally; see \ref apop_moments_alloc. */
+double apop_moments_var(apop_moments const *m, size_t col){ return apop_moments_cov(m, col, col); }
+
+/** The population skew, \f$\sum_i (x_i - \mu)^3/n\f$, of a column of a tally; see \ref apop_moments_alloc. */
+double apop_moments_skew_pop(apop_moments const *m, size_t col){
+    double len = moments_len(m, col);
+    return gsl_isnan(len) ? len : m->m3[col]/len;
+}
+
+/** The population kurtosis, \f$\sum_i (x_i - \mu)^4/n\f$, of a column of a tally; see \ref apop_moments_alloc. */
+double apop_moments_kurtosis_pop(apop_moments const *m, size_t col){
+    double len = moments_len(m, col);
+    return gsl_isnan(len) ? len : m->m4[col]/len;
+}
+
+/** The sample skew of a column of a tally, corrected as in \ref apop_vector_skew; see \ref apop_moments_alloc. */
+double apop_moments_skew(apop_moments const *m, size_t col){
+    double n = moments_len(m, col);
+    return apop_moments_skew_pop(m, col) * gsl_pow_2(n)/((n-1.)*(n-2.));
+}
+
+/** The sample kurtosis of a column of a tally, corrected as in \ref apop_vector_kurtosis; see \ref apop_moments_alloc. */
+double apop_moments_kurtosis(apop_moments const *m, size_t col){
+    double n = moments_len(m, col);
+    long double coeff0= n*n/(gsl_pow_3(n)*(gsl_pow_2(n)-3*n+3));
+    long double coeff1= n*gsl_pow_2(n-1)+ (6*n-9);
+    long double coeff2= n*(6*n-9);
+    return  coeff0 *(coeff1 * apop_moments_kurtosis_pop(m, col) + coeff2 * gsl_pow_2(apop_moments_var(m, col)*(n-1.)/n));
+}
+
 static void get_one_row(apop_data *p, apop_data *a_row, int i, int min, int max){
     for (int j=min; j< max; j++)
         apop_data_set(a_row, 0, j-min, apop_data_get(p, i, j));
@@ -0,0 +1,252 @@
+/** \file apop_threads.c  A persistent pool of worker threads for the map/apply family. */
+/* Copyright (c) 2026 by Ben Klemens.  Licensed under the modified GNU GPL v2; see COPYING and COPYING2.
+
+   The first version of apop_map and friends called pthread_create and pthread_join
+   thread_count times on every call. A log likelihood gets summed via apop_map_sum
+   thousands of times per MLE search, so on small and medium data sets the cost of
+   starting threads swamped the math. So instead we keep a pool of workers around.
+
+   --The pool is started on first use, with apop_opts.thread_count-1 workers; the thread
+     that called apop_threadpool_run is the last worker.
+   --If apop_opts.thread_count has changed since the last run, the pool is shut down and
+     restarted at the new size before running the job.
+   --The workers are shut down and joined at exit.
+   --Only one job runs on the pool at a time. If a job is already running---because the
+     user is calling Apophenia from several threads, or because the function being mapped
+     itself calls apop_map---then the new job just runs serially in the calling thread.
+     This also guarantees we never deadlock waiting on ourselves.
+*/
+#include "apop_internal.h"
+#include <pthread.h>
+
+static struct {
+    pthread_mutex_t lock;      //protects everything below
+    pthread_cond_t  go, done;
+    pthread_t       *threads;
+    int             workerct;
+    int             shutdown;
+    unsigned long   generation; //incremented with every new job
+
+    //The current job:
+    void *(*fn)(void*);
+    char   *tasks;
+    size_t  tasksize;
+    int     taskct, next_task, unfinished;
+} pool = {.lock = PTHREAD_MUTEX_INITIALIZER, .go = PTHREAD_COND_INITIALIZER,
+          .done = PTHREAD_COND_INITIALIZER};
+
+//Held by whoever is running a job on the pool; also protects starting/stopping the pool.
+static pthread_mutex_t pool_in_use = PTHREAD_MUTEX_INITIALIZER;
+
+//Grab tasks from the current job until there are none left.
+static void run_tasks(void){
+    pthread_mutex_lock(&pool.lock);
+    while (pool.next_task < pool.taskct){
+        void *this_task = pool.tasks + pool.tasksize * pool.next_task++;
+        void *(*fn)(void*) = pool.fn;
+        pthread_mutex_unlock(&pool.lock);
+        fn(this_task);
+        pthread_mutex_lock(&pool.lock);
+        if (!--pool.unfinished) pthread_cond_broadcast(&pool.done);
+    }
+    pthread_mutex_unlock(&pool.lock);
+}
+
+static void *worker(void *ignored){
+    unsigned long seen = 0;
+    while (1){
+        pthread_mutex_lock(&pool.lock);
+        while (pool.generation == seen && !pool.shutdown)
+            pthread_cond_wait(&pool.go, &pool.lock);
+        if (pool.shutdown){
+            pthread_mutex_unlock(&pool.lock);
+            return NULL;
+        }
+        seen = pool.generation;
+        pthread_mutex_unlock(&pool.lock);
+        run_tasks();
+    }
+}
+
+//Call with pool_in_use held.
+static void pool_stop(void){
+    if (!pool.workerct) return;
+    pthread_mutex_lock(&pool.lock);
+    pool.shutdown = 1;
+    pthread_cond_broadcast(&pool.go);
+    pthread_mutex_unlock(&pool.lock);
+    for (int i=0; i< pool.workerct; i++)
+        pthread_join(pool.threads[i], NULL);
+    free(pool.threads);
+    pool.threads = NULL;
+    pool.workerct =
+    pool.shutdown = 0;
+}
+
+static void pool_stop_at_exit(void){
+    pthread_mutex_lock(&pool_in_use);
+    pool_stop();
+    pthread_mutex_unlock(&pool_in_use);
+}
+
+//Call with pool_in_use held.
+static void pool_resize(int workerct){
+    static int registered_exit_hook;
+    pool_stop();
+    if (workerct < 1) return;
+    if (!registered_exit_hook++) atexit(pool_stop_at_exit);
+    pool.threads = malloc(sizeof(pthread_t) * workerct);
+    Apop_stopif(!pool.threads, return, 0, "malloc failed. Probably out of memory.");
+    for ( ; pool.workerct < workerct; pool.workerct++)
+        Apop_stopif(pthread_create(pool.threads+pool.workerct, NULL, worker, NULL), return,
+                0, "Couldn't start thread %i of %i; using the %i I have.",
+                pool.workerct+1, workerct, pool.workerct);
+}
+
+/* Run <tt>fn(tasks+i*tasksize)</tt> for each i in [0, taskct), splitting the tasks among
+ the threads of the pool. Returns once every task has finished.
+
+ There are <tt>apop_opts.thread_count</tt> threads running at once (the calling thread
+ included), so set up one task per thread for evenly-sized jobs.
+
+ The task function has the form pthread_create wants, but the return value is ignored;
+ write any output to the task struct.
+ */
+void apop_threadpool_run(void *(*fn)(void*), void *tasks, size_t tasksize, int taskct){
+    if (taskct < 1) return;
+    if (taskct == 1 || apop_opts.thread_count <= 1 || pthread_mutex_trylock(&pool_in_use)){
+        for (int i=0; i< taskct; i++)
+            fn((char*)tasks + i*tasksize);
+        return;
+    }
+    if (pool.workerct != apop_opts.thread_count-1) pool_resize(apop_opts.thread_count-1);
+
+    pthread_mutex_lock(&pool.lock);
+    pool.fn = fn;
+    pool.tasks = tasks;
+    pool.tasksize = tasksize;
+    pool.taskct = pool.unfinished = taskct;
+    pool.next_task = 0;
+    pool.generation++;
+    pthread_cond_broadcast(&pool.go);
+    pthread_mutex_unlock(&pool.lock);
+
+    run_tasks();
+
+    pthread_mutex_lock(&pool.lock);
+    while (pool.unfinished)
+        pthread_cond_wait(&pool.done, &pool.lock);
+    pthread_mutex_unlock(&pool.lock);
+    pthread_mutex_unlock(&pool_in_use);
+}
+
+/* Work stealing.
+
+   apop_threadpool_for splits [0, n) into one contiguous range per slot. Each slot
+   eats its range grain items at a time; when it runs dry, it finds the slot with the most
+   left and takes the back half of that slot's range. So if some rows are much more
+   expensive than others, the threads that drew the cheap rows pick up the slack instead
+   of sitting idle.
+
+   The grain is apop_opts.thread_chunk_size, or if that's zero, enough for about eight
+   chunks per slot.
+*/
+
+typedef struct {
+    pthread_mutex_t lock;
+    size_t lo, hi;
+} work_range;
+
+typedef struct {
+    void (*fn)(void *, size_t, size_t, int);
+    void *info;
+    size_t grain;
+    int slotct;
+    work_range *ranges;
+} stealing_job;
+
+typedef struct {
+    stealing_job *job;
+    int slot;
+} slot_task;
+
+//Returns zero if there was nothing left anywhere to steal.
+static int steal(stealing_job *j, int me){
+    int victim = -1;
+    size_t most = 0;
+    for (int i=0; i< j->slotct; i++){
+        if (i == me) continue;
+        pthread_mutex_lock(&j->ranges[i].lock);
+        size_t left = j->ranges[i].hi - j->ranges[i].lo;
+        pthread_mutex_unlock(&j->ranges[i].lock);
+        if (left > most){
+            most = left;
+            victim = i;
+        }
+    }
+    if (victim == -1) return 0;
+
+    work_range *v = j->ranges+victim;
+    pthread_mutex_lock(&v->lock);
+    size_t left = v->hi - v->lo;
+    size_t take = left > j->grain ? left/2 : left;
+    size_t hi = v->hi;
+    v->hi -= take;
+    pthread_mutex_unlock(&v->lock);
+
+    pthread_mutex_lock(&j->ranges[me].lock);
+    j->ranges[me].lo = hi - take;
+    j->ranges[me].hi = hi;
+    pthread_mutex_unlock(&j->ranges[me].lock);
+    return 1; //even if take==0 because somebody beat us to it; try again.
+}
+
+static void *run_slot(void *in){
+    slot_task *t = in;
+    stealing_job *j = t->job;
+    work_range *mine = j->ranges + t->slot;
+    do {
+        while (1){
+            pthread_mutex_lock(&mine->lock);
+            if (mine->lo >= mine->hi){
+                pthread_mutex_unlock(&mine->lock);
+                break;
+            }
+            size_t lo = mine->lo;
+            size_t hi = mine->lo = GSL_MIN(lo + j->grain, mine->hi);
+            pthread_mutex_unlock(&mine->lock);
+            j->fn(j->info, lo, hi, t->slot);
+        }
+    } while (steal(j, t->slot));
+    return NULL;
+}
+
+/* Call <tt>fn(info, lo, hi, slot)</tt> on chunks [lo, hi) that together cover [0, n),
+ spreading the chunks over the thread pool with work stealing.
+
+ \c slot is in [0, slotct), and no two chunks with the same slot run at the same time, so
+ you can use it to index an array of per-thread accumulators. Use
+ <tt>slotct=apop_opts.thread_count</tt> unless you have reason to want fewer.
+ */
+void apop_threadpool_for(void (*fn)(void *info, size_t lo, size_t hi, int slot), void *info, size_t n, int slotct){
+    if (!n) return;
+    if (slotct > n) slotct = n;
+    if (slotct <= 1){
+        fn(info, 0, n, 0);
+        return;
+    }
+    work_range ranges[slotct];
+    slot_task tasks[slotct];
+    stealing_job job = {.fn = fn, .info = info, .slotct = slotct, .ranges = ranges,
+                        .grain = apop_opts.thread_chunk_size > 0 ? apop_opts.thread_chunk_size
+                                                                 : GSL_MAX(1, n/(slotct*8))};
+    for (int i=0; i< slotct; i++){
+        pthread_mutex_init(&ranges[i].lock, NULL);
+        ranges[i].lo = i*(n/slotct);
+        ranges[i].hi = (i==slotct-1) ? n : (i+1)*(n/slotct);
+        tasks[i] = (slot_task){.job=&job, .slot=i};
+    }
+    apop_threadpool_run(run_slot, tasks, sizeof(slot_task), slotct);
+    for (int i=0; i< slotct; i++)
+        pthread_mutex_destroy(&ranges[i].lock);
+}
@@ -7,37 +7,47 @@
 #include <unistd.h>
 
 int main(int argc, char **argv){
-int         merge_ct = 0;
+int         merge_ct = 0, failed = 0;
 char		c, 
-		*delimiter,
-		msg[1000], **merges = NULL;
-	sprintf(msg, "%s [-v] [-t table_name] [-t next_tabname] main_db.db db_to_merge_into_main.db\n"
+		msg[1000], **merges = NULL, indices = 'n';
+	sprintf(msg, "%s [-v] [-i] [-s] [-t table_name] [-t next_tabname] main_db.db db_to_merge_into_main.db [more dbs to merge...]\n"
 			     "   -t\ttable to merge. If none, do all in the source db. Use as many as you'd like.\n"
-			     "   -v\tverbose\n", argv[0]); 
+			     "   -i\tbuild indices after loading each table, rather than updating them row by row\n"
+			     "   -s\tscratch mode: don't wait for the disk after each write. Faster, but if the machine\n"
+			     "     \tcrashes mid-merge, main_db.db may be corrupt. See apop_opts.db_scratch.\n"
+			     "   -v\tverbose: report rows per second for each table\n", argv[0]); 
 	if(argc<3){
 		printf("%s", msg);
 		return 0;
 	}
-	delimiter	= malloc(5);
-	strcpy(delimiter, ",");
-	while ((c = getopt (argc, argv, "vht:")) != -1){
+	while ((c = getopt (argc, argv, "vhist:")) != -1){
 		switch (c){
 		  case 'v':
 			apop_opts.verbose	++;
 			break;
+		  case 'i':
+			indices = 'y';
+			break;
+		  case 's':
+			apop_opts.db_scratch = 'y';
+			break;
 		  case 'h':
 			printf("%s", msg);
 			return 0;
           case 't':
-            merges = realloc(merges, sizeof(char*)*merge_ct++);
+            merges = realloc(merges, sizeof(char*)*++merge_ct);
             merges[merge_ct-1] = optarg;
 		}
 	}
-	apop_db_open(argv[optind]);
-    if (merge_ct)
-        for (int i=0; i< merge_ct; i++)
-            apop_db_merge_table(argv[optind +1], merges[i]);
-    else
-        apop_db_merge(argv[optind +1]);
-	apop_db_close('n');
+    Apop_stopif(optind+2 > argc, return 1, 0, "I need a main database and at least one database to merge into it.");
+	Apop_stopif(apop_db_open(argv[optind]), return 1, 0, "Couldn't open %s.", argv[optind]);
+    for (int f=optind+1; f< argc; f++){
+        if (merge_ct)
+            for (int i=0; i< merge_ct; i++)
+                failed |= apop_db_merge_table(argv[f], merges[i], .indices=indices) < 0;
+        else
+            failed |= apop_db_merge(argv[f], .indices=indices) < 0;
+    }
+    apop_db_close('n');
+    return failed;
 }
@@ -26,10 +26,33 @@ apop_data * apop_query_to_mixed_data(const char *typelist, const char * fmt, ...
 gsl_vector * apop_query_to_vector(const char * fmt, ...) __attribute__ ((format (printf,1,2)));
 double apop_query_to_float(const char * fmt, ...) __attribute__ ((format (printf,1,2)));
 
+int apop_query_bound(char const *types, char const *query, ...);
+apop_data * apop_query_bound_to_data(char const *types, char const *query, ...);
+gsl_matrix * apop_query_bound_to_matrix(char const *types, char const *query, ...);
+gsl_vector * apop_query_bound_to_vector(char const *types, char const *query, ...);
+double apop_query_bound_to_float(char const *types, char const *query, ...);
+
+/** A cursor over the output of a query, which reads the output a block of rows at a time.
+ See \ref apop_query_cursor_open. */
+typedef struct {
+    apop_data *block; /**< The block of rows most recently returned by \ref apop_query_cursor_next. */
+    size_t    rows;   /**< The count of rows read so far. */
+    char      error;  /**< 'q': the database reported an error partway through reading rows. */
+    struct apop_cursor_state *state; /**< Internal details. */
+} apop_query_cursor;
+
+apop_query_cursor * apop_query_cursor_open(const char *typelist, int block_size, const char * fmt, ...) __attribute__ ((format (printf,3,4)));
+apop_data * apop_query_cursor_next(apop_query_cursor *cursor);
+void apop_query_cursor_free(apop_query_cursor *cursor);
+APOP_VAR_DECLARE double apop_query_cursor_map_sum(apop_query_cursor *cursor, double (*fn_d)(double), double (*fn_v)(gsl_vector*), double (*fn_r)(apop_data *), double (*fn_dp)(double! void *), double (*fn_vp)(gsl_vector*! void *), double (*fn_rp)(apop_data *! void *), void *param, char part);
+double apop_query_cursor_log_likelihood(apop_query_cursor *cursor, apop_model *m);
+apop_data * apop_query_cursor_moments(apop_query_cursor *cursor);
+APOP_VAR_DECLARE apop_data * apop_query_cursor_percentiles(apop_query_cursor *cursor, char rounding, int k);
+
 void apop_data_to_db(const apop_data *set, const char *tabname, char);
 
-APOP_VAR_DECLARE void apop_db_merge(char *db_file, char inout);
-APOP_VAR_DECLARE void apop_db_merge_table(char *db_file, char *tabname, char inout);
+APOP_VAR_DECLARE long apop_db_merge(char *db_file, char inout, char indices);
+APOP_VAR_DECLARE long apop_db_merge_table(char *db_file, char *tabname, char inout, char indices);
 
 double apop_db_t_test(char * tab1, char *col1, char *tab2, char *col2);
 double apop_db_paired_t_test(char * tab1, char *col1, char *col2);
@@ -925,6 +925,13 @@ Outlineheader  sumstats  Summary stats
 \li\ref apop_data_summarize ()
 \li\ref apop_vector_moving_average()
 \li\ref apop_vector_percentiles()
+\li\ref apop_sketch_alloc()
+\li\ref apop_sketch_add()
+\li\ref apop_sketch_add_vector()
+\li\ref apop_sketch_merge()
+\li\ref apop_sketch_percentiles()
+\li\ref apop_sketch_percentile()
+\li\ref apop_query_cursor_percentiles()
 
         See also:
 
@@ -952,6 +959,10 @@ Outlineheader  moments  Moments
 \li\ref apop_matrix_covariance ()
 \li\ref apop_matrix_mean ()
 \li\ref apop_matrix_mean_and_var ()
+\li\ref apop_moments_alloc ()
+\li\ref apop_moments_push ()
+\li\ref apop_moments_push_batch ()
+\li\ref apop_moments_merge ()
 \li\ref apop_matrix_sum ()
 \li\ref apop_mean()
 \li\ref apop_sum()
@@ -980,6 +991,7 @@ Outlineheader convsec   Conversion among types
 \li\ref apop_array_to_data()
 \li\ref apop_array_to_matrix()
 \li\ref apop_array_to_vector()
+\li\ref apop_data_mmap()
 \li\ref apop_line_to_data()
 \li\ref apop_line_to_matrix()
 \li\ref apop_matrix_to_data()
@@ -1789,6 +1801,7 @@ static double beta_zero_greater_than_x_constraint(apop_data *data, apop_model *v
 endofdiv
 
 \li\ref apop_estimate_restart : Restarting an MLE with different settings can improve results.
+\li\ref multistart : Searching from many starting points at once, and keeping the best.
 \li\ref apop_maximum_likelihood()
 \li\ref apop_model_numerical_covariance()
 \li\ref apop_numerical_gradient()
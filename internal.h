@@ -16,6 +16,17 @@
     int maxsize = GSL_MAX(vsize, GSL_MAX(msize1, d?d->textsize[0]:0));\
     (void)(tsize||wsize||firstcol||maxsize) /*prevent unused variable complaints */;
 
+/* A page converted by apop_data_to_columns has a NULL matrix, so Get_vmsizes reports no
+ matrix at all. Functions that read d->matrix directly stop via this, rather than quietly
+ treating the data as empty. */
+#define Apop_stop_if_columns(d, onfail) Apop_stopif((d) && (d)->columns && !(d)->matrix, onfail, 0, \
+        "%s is stored by columns (see apop_data_to_columns), which this function doesn't read. " \
+        "Convert it via apop_data_to_rows first.", #d)
+
+//apop_data.c: if d's first page is stored by columns, a row-major copy of that page,
+//whose ->more is d->more (so set it to NULL before freeing). Else, NULL.
+struct apop_data *apop_page_by_rows(struct apop_data const *d);
+
 // Define a static variable, and initialize on first use.
 #define Staticdef(type, name, def) static type (name) = NULL; if (!(name)) (name) = (def);
 
@@ -36,6 +47,62 @@ void xprintf(char **q, char *format, ...);
 char *prep_string_for_sqlite(int prepped_statements, char const *astring);//apop_conversions.c
 void apop_gsl_error(const char *reason, const char *file, int line, int gsl_errno); //apop_linear_algebra.c
 
+#include <stddef.h> //size_t
+#include <stdarg.h> //va_list
+//apop_threads.c: run fn on each of taskct structs in the tasks array, using the persistent thread pool.
+void apop_threadpool_run(void *(*fn)(void*), void *tasks, size_t tasksize, int taskct);
+//apop_threads.c: run fn on chunks covering [0, n), with work stealing among slotct threads.
+void apop_threadpool_for(void (*fn)(void *info, size_t lo, size_t hi, int slot), void *info, size_t n, int slotct);
+
+/* apop_mapply.c: Batch sums for the models' log likelihoods and scores. A kernel gets
+ a contiguous array x of n doubles, and adds its contribution to each of sums[0], sums[1], ....
+ apop_batch_sum runs it over the vector and matrix of d and fills sums[0..sumct-1]. */
+struct apop_data;
+struct apop_arena;
+typedef void apop_batch_kernel(const double *x, size_t n, const void *param, double *sums);
+void apop_batch_sum(struct apop_data const *d, apop_batch_kernel *kernel, const void *param, double *sums, int sumct);
+
+/* apop_arena.c: Storage for the strings of names and text grids. With a NULL arena,
+ these are plain malloc, strdup, vasprintf, realloc, and free. apop_arena_free only
+ frees pointers the arena doesn't own, and apop_arena_realloc copies into new
+ arena space if the arena owns the input. */
+struct apop_arena *apop_arena_alloc(void);
+struct apop_arena *apop_arena_keep(struct apop_arena *a); //add a reference; returns a.
+void apop_arena_release(struct apop_arena *a);  //drop a reference; the last one frees the arena.
+void *apop_arena_malloc(struct apop_arena *a, size_t size);
+char *apop_arena_strdup(struct apop_arena *a, char const *s);
+char *apop_arena_vprintf(struct apop_arena *a, char const *fmt, va_list ap);
+void apop_arena_free(struct apop_arena *a, void *p);
+//apop_arena_free for each of the n pointers in list, and for each cell of a grid like
+//apop_data's text, then each of its rows. The list or grid itself is yours to free.
+void apop_arena_free_list(struct apop_arena *a, void *list, size_t n);
+void apop_arena_free_grid(struct apop_arena *a, void *grid, size_t rows, size_t cols);
+void *apop_arena_realloc(struct apop_arena *a, void *p, size_t oldsize, size_t newsize);
+//An arena that owns [data, data+size), and calls release(data, size) when freed.
+struct apop_arena *apop_arena_adopt(void *data, size_t size, void (*release)(void *data, size_t size));
+
+/* apop_binary.c: write the data set, and all its pages, in the format apop_data_mmap reads.
+ Returns 0 on success. */
+#include <stdio.h> //FILE
+int apop_data_write_binary(struct apop_data const *d, FILE *f);
+
+/* Kernels keep Apop_lanes independent running sums, which the compiler can hold in
+ vector registers without reordering anybody's additions. Apop_vectorize compiles the
+ kernel for AVX-512, AVX2, and plain x86-64, and the loader picks the best one the CPU
+ supports. Elsewhere, it's just a plain function. */
+#define Apop_lanes 8
+#if defined(__x86_64__) && defined(__linux__) && defined(__has_attribute)
+    #if __has_attribute(target_clones)
+        #define Apop_vectorize __attribute__((target_clones("avx512f","avx2","default")))
+    #endif
+#endif
+#ifndef Apop_vectorize
+    #define Apop_vectorize
+#endif
+
+//apop_mapply.c: a batch kernel that adds x[0] through x[n-1] to sums[0].
+apop_batch_kernel apop_sum_kernel;
+
 //For when we're forced to use a global variable.
 #undef threadlocal
 #ifdef _ISOC11_SOURCE 
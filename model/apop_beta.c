@@ -43,10 +43,19 @@ typedef struct{
     double alpha, beta; 
 } ab_type;
 
-static double betamap(double x, void *abin) {
-    ab_type *ab = abin; 
-    return (x < 0 || x > 1) ? 0
-                : (ab->alpha-1) * log(x) + (ab->beta-1) *log(1-x); 
+//Values outside [0, 1] are taken to contribute nothing to the log likelihood.
+Apop_vectorize static void beta_kernel(const double *x, size_t n, const void *abin, double *sums){
+    const ab_type *ab = abin;
+    double ll[Apop_lanes] = {};
+    size_t i = 0;
+    for ( ; i+Apop_lanes <= n; i+= Apop_lanes)
+        for (int l=0; l< Apop_lanes; l++)
+            ll[l] += (x[i+l] < 0 || x[i+l] > 1) ? 0
+                        : (ab->alpha-1) * log(x[i+l]) + (ab->beta-1) *log(1-x[i+l]);
+    for ( ; i< n; i++)
+        ll[0] += (x[i] < 0 || x[i] > 1) ? 0
+                        : (ab->alpha-1) * log(x[i]) + (ab->beta-1) *log(1-x[i]);
+    for (int l=0; l< Apop_lanes; l++) sums[0] += ll[l];
 }
 
 static double beta_log_likelihood(apop_data *d, apop_model *p){
@@ -55,21 +64,40 @@ static double beta_log_likelihood(apop_data *d, apop_model *p){
     ab_type ab = { .alpha = apop_data_get(p->parameters,0,-1),
                    .beta  = apop_data_get(p->parameters,1,-1)
     };
-	return apop_map_sum(d, .fn_dp = betamap, .param=&ab) + gsl_sf_lnbeta(ab.alpha, ab.beta) * tsize;
+    double ll;
+    apop_batch_sum(d, beta_kernel, &ab, &ll, 1);
+	return ll + gsl_sf_lnbeta(ab.alpha, ab.beta) * tsize;
 }
 
-static double dbeta_callback(double x){ return log(1-x); }
+//sums[0] += sum of ln(x); sums[1] += sum of ln(1-x).
+Apop_vectorize static void dbeta_kernel(const double *x, size_t n, const void *ignored, double *sums){
+    double lnx[Apop_lanes] = {}, ln1mx[Apop_lanes] = {};
+    size_t i = 0;
+    for ( ; i+Apop_lanes <= n; i+= Apop_lanes)
+        for (int l=0; l< Apop_lanes; l++){
+            lnx[l] += log(x[i+l]);
+            ln1mx[l] += log(1-x[i+l]);
+        }
+    for ( ; i< n; i++){
+        lnx[0] += log(x[i]);
+        ln1mx[0] += log(1-x[i]);
+    }
+    for (int l=0; l< Apop_lanes; l++){
+        sums[0] += lnx[l];
+        sums[1] += ln1mx[l];
+    }
+}
 
 static void beta_dlog_likelihood(apop_data *d, gsl_vector *gradient, apop_model *m){
     Nullcheck_mpd(d, m, )
     Get_vmsizes(d) //tsize
     double bb	= gsl_vector_get(m->parameters->vector, 0);
     double a	= gsl_vector_get(m->parameters->vector, 1);
-    double lnsum = apop_map_sum(d, log);
-    double ln_x_minus_1_sum = apop_map_sum(d, dbeta_callback);
+    double sums[2]; //sum of ln(x), sum of ln(1-x)
+    apop_batch_sum(d, dbeta_kernel, NULL, sums, 2);
 	//Psi is the derivative of the log gamma function.
-	gsl_vector_set(gradient, 0, lnsum  + (-gsl_sf_psi(a) + gsl_sf_psi(a+bb))*tsize);
-	gsl_vector_set(gradient, 1, ln_x_minus_1_sum  + (-gsl_sf_psi(bb) + gsl_sf_psi(a+bb))*tsize);
+	gsl_vector_set(gradient, 0, sums[0]  + (-gsl_sf_psi(a) + gsl_sf_psi(a+bb))*tsize);
+	gsl_vector_set(gradient, 1, sums[1]  + (-gsl_sf_psi(bb) + gsl_sf_psi(a+bb))*tsize);
 }
 
 static double beta_constraint(apop_data *data, apop_model *v){
@@ -28,9 +28,17 @@ static double gamma_constraint(apop_data *data, apop_model *v){
 
 typedef struct {double a, b, ln_ga_plus_a_ln_b;} abstruct;
 
-static double apply_for_gamma(double x, void *abin) { 
-    abstruct *ab = abin;
-    return x ? ((ab->a-1)*log(x) - x/ab->b - ab->ln_ga_plus_a_ln_b) : 0; 
+//Zeros are taken to contribute nothing to the log likelihood.
+Apop_vectorize static void gamma_kernel(const double *x, size_t n, const void *abin, double *sums){
+    const abstruct *ab = abin;
+    double ll[Apop_lanes] = {};
+    size_t i = 0;
+    for ( ; i+Apop_lanes <= n; i+= Apop_lanes)
+        for (int l=0; l< Apop_lanes; l++)
+            ll[l] += x[i+l] ? ((ab->a-1)*log(x[i+l]) - x[i+l]/ab->b - ab->ln_ga_plus_a_ln_b) : 0;
+    for ( ; i< n; i++)
+        ll[0] += x[i] ? ((ab->a-1)*log(x[i]) - x[i]/ab->b - ab->ln_ga_plus_a_ln_b) : 0;
+    for (int l=0; l< Apop_lanes; l++) sums[0] += ll[l];
 }
 
 static double gamma_log_likelihood(apop_data *d, apop_model *p){
@@ -43,25 +51,39 @@ static double gamma_log_likelihood(apop_data *d, apop_model *p){
         ln_b   = log(ab.b),
         a_ln_b = ab.a * ln_b;
     ab.ln_ga_plus_a_ln_b = ln_ga + a_ln_b;
-    llikelihood = apop_map_sum(d, .fn_dp = apply_for_gamma, .param = &ab);
+    apop_batch_sum(d, gamma_kernel, &ab, &llikelihood, 1);
     return llikelihood;
 }
 
-static double a_callback(double x, void *ab){ return log(x)- *(double*)ab; }
-
-static double b_callback(double x, void *abv){ 
-    double *ab = abv;
-    return x/gsl_pow_2(ab[0]) - ab[1]; 
+//sums[0] += sum of ln(x); sums[1] += sum of x.
+Apop_vectorize static void gamma_score_kernel(const double *x, size_t n, const void *ignored, double *sums){
+    double lnx[Apop_lanes] = {}, xsum[Apop_lanes] = {};
+    size_t i = 0;
+    for ( ; i+Apop_lanes <= n; i+= Apop_lanes)
+        for (int l=0; l< Apop_lanes; l++){
+            lnx[l] += log(x[i+l]);
+            xsum[l] += x[i+l];
+        }
+    for ( ; i< n; i++){
+        lnx[0] += log(x[i]);
+        xsum[0] += x[i];
+    }
+    for (int l=0; l< Apop_lanes; l++){
+        sums[0] += lnx[l];
+        sums[1] += xsum[l];
+    }
 }
 
 static void gamma_dlog_likelihood(apop_data *d, gsl_vector *gradient, apop_model *p){
     Nullcheck_mp(p, ) 
+    Get_vmsizes(d) //tsize
     double  a = gsl_vector_get(p->parameters->vector, 0),
         	b = gsl_vector_get(p->parameters->vector, 1);
     double psi_a_ln_b  = gsl_sf_psi(a) + log(b);
-    double b_and_ab[2] = {b, a/b};
-    gsl_vector_set(gradient, 0, apop_map_sum(d, .fn_dp = a_callback, .param=&psi_a_ln_b));
-    gsl_vector_set(gradient, 1, apop_map_sum(d, .fn_dp = b_callback, .param=&b_and_ab));
+    double sums[2];
+    apop_batch_sum(d, gamma_score_kernel, NULL, sums, 2);
+    gsl_vector_set(gradient, 0, sums[0] - tsize*psi_a_ln_b);
+    gsl_vector_set(gradient, 1, sums[1]/gsl_pow_2(b) - tsize*a/b);
 }
 
 /* \adoc RNG Just a wrapper for \c gsl_ran_gamma.
@@ -34,18 +34,35 @@ static double positive_sigma_constraint(apop_data *data, apop_model *v){
     return apop_linear_constraint(v->parameters->vector, constraint, 1e-5);
 }
 
-//This just takes the sum of (x-mu)^2. Using gsl_ran_gaussian_pdf
+//This just takes the sums of (x-mu) and (x-mu)^2. Using gsl_ran_gaussian_pdf
 //would be to calculate log(exp((x-mu)^2)) == slow.
-static double apply_me(double x, void *mu){ return x - *(double *)mu; }
-
-static double apply_me2(double x, void *mu){ return gsl_pow_2(x - *(double *)mu); }
+Apop_vectorize static void normal_kernel(const double *x, size_t n, const void *mu_in, double *sums){
+    double mu = *(const double *)mu_in, dev[Apop_lanes] = {}, dev2[Apop_lanes] = {};
+    size_t i = 0;
+    for ( ; i+Apop_lanes <= n; i+= Apop_lanes)
+        for (int l=0; l< Apop_lanes; l++){
+            double diff = x[i+l] - mu;
+            dev[l] += diff;
+            dev2[l] += diff*diff;
+        }
+    for ( ; i< n; i++){
+        dev[0] += x[i] - mu;
+        dev2[0] += gsl_pow_2(x[i] - mu);
+    }
+    for (int l=0; l< Apop_lanes; l++){
+        sums[0] += dev[l];
+        sums[1] += dev2[l];
+    }
+}
 
 static double normal_log_likelihood(apop_data *d, apop_model *params){
     Nullcheck_mpd(d, params, GSL_NAN);
     Get_vmsizes(d)
     double mu = gsl_vector_get(params->parameters->vector,0);
     double sd = gsl_vector_get(params->parameters->vector,1);
-    long double ll  = -apop_map_sum(d, .fn_dp = apply_me2, .param = &mu)/(2*gsl_pow_2(sd));
+    double sums[2];
+    apop_batch_sum(d, normal_kernel, &mu, sums, 2);
+    long double ll  = -sums[1]/(2*gsl_pow_2(sd));
     ll -= tsize*(M_LNPI+M_LN2+log(sd));
 	return ll;
 }
@@ -95,11 +112,10 @@ static void normal_dlog_likelihood(apop_data *d, gsl_vector *gradient, apop_mode
     Get_vmsizes(d)
     double mu = gsl_vector_get(params->parameters->vector,0),
            sd = gsl_vector_get(params->parameters->vector,1),
-           dll, sll;
-    dll = apop_map_sum(d, .fn_dp = apply_me, .param=&mu);
-    sll = apop_map_sum(d, .fn_dp = apply_me2, .param=&mu);
-    gsl_vector_set(gradient, 0, dll/gsl_pow_2(sd));
-    gsl_vector_set(gradient, 1, sll/gsl_pow_3(sd)- tsize /sd);
+           sums[2]; //sum of (x-mu), sum of (x-mu)^2
+    apop_batch_sum(d, normal_kernel, &mu, sums, 2);
+    gsl_vector_set(gradient, 0, sums[0]/gsl_pow_2(sd));
+    gsl_vector_set(gradient, 1, sums[1]/gsl_pow_3(sd)- tsize /sd);
 }
 
 /* \adoc predict Returns the mean, regardless of the input data you give (including
@@ -71,34 +71,27 @@ static double biprobit_log_likelihood(apop_data *d, apop_model *p){
 	return total_prob;
 }
 
-static double val;
-static double unordered(double in){ return in == val; }
-
-// This is just a for loop that runs a probit on each column.
+/* This is just a for loop that runs a probit on each column: the outcome is one for
+   the rows with that column's option, else zero. The scratch data lives on the stack,
+   so that several searches (e.g., a multistart MLE) can call this at once. */
 static double multiprobit_log_likelihood(apop_data *d, apop_model *p){
     Nullcheck_mpd(d, p, GSL_NAN)
     gsl_vector *val_vector = get_category_table(d)->vector;
     if (val_vector->size==2) return biprobit_log_likelihood(d, p);
     //else, multinomial loop
-    static apop_model *spare_probit = NULL;
-    if (!spare_probit){
-        spare_probit = apop_model_copy(apop_probit);
-        spare_probit->parameters = apop_data_alloc();
-    }
-    Staticdef(apop_data *, working_data, apop_data_alloc());
-    working_data->matrix = d->matrix;
     gsl_vector *original_outcome = d->vector;
+    gsl_vector *outcome = gsl_vector_alloc(original_outcome->size);
+    apop_data working_data = {.vector=outcome, .matrix=d->matrix};
     double ll = 0;
-    double *vals = val_vector->data;
     for(size_t i=0; i < p->parameters->matrix->size2; i++){
         Apop_col(p->parameters, i, param);
-        val = vals[i];
-        working_data->vector = apop_vector_map(original_outcome, unordered);
-        spare_probit->parameters->matrix = apop_vector_to_matrix(param);
-        ll  += apop_log_likelihood(working_data, spare_probit);
-        gsl_vector_free(working_data->vector); //yup. It's inefficient.
-        gsl_matrix_free(spare_probit->parameters->matrix);
+        for (size_t j=0; j< outcome->size; j++)
+            gsl_vector_set(outcome, j, gsl_vector_get(original_outcome, j) == val_vector->data[i]);
+        apop_data params = {.matrix=apop_vector_to_matrix(param)};
+        ll += biprobit_log_likelihood(&working_data, &(apop_model){.parameters=&params});
+        gsl_matrix_free(params.matrix);
     }
+    gsl_vector_free(outcome);
 	return ll;
 }
 
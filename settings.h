@@ -194,6 +194,16 @@ delta;
     double      k, t_initial, mu_t, t_min ;
     gsl_rng     *rng;
     char        *trace_path; ///< See \ref trace_path
+//multi-start:
+    int         starts; /**< If greater than one, run this many searches concurrently and
+                          keep the best. If zero (the default) but \c starting_points is
+                          set, run one search per row of \c starting_points. See \ref multistart. */
+    apop_data   *starting_points; /**< A matrix with one starting point per row, in the
+                          order \ref apop_data_pack would put the parameters. */
+    apop_model  *start_dist; /**< Starting points beyond those in \c starting_points are
+                          drawn from this model. If \c NULL, draw each element uniformly
+                          from \c starting_pt plus or minus \c start_spread. */
+    double      start_spread; /**< Half the width of the default box for drawing starting points. Default: 1. */
     apop_model  *parent;
 } apop_mle_settings;
 
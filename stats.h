@@ -148,6 +148,34 @@ double apop_matrix_mean(const gsl_matrix *data);
 void apop_matrix_mean_and_var(const gsl_matrix *data, double *mean, double *var);
 apop_data * apop_data_summarize(apop_data *data);
 
+//Running moments
+typedef struct apop_moments apop_moments;
+apop_moments * apop_moments_alloc(size_t colct);
+void apop_moments_free(apop_moments *m);
+int apop_moments_push(apop_moments *m, double const *row, double weight);
+int apop_moments_push_batch(apop_moments *m, apop_data const *d);
+apop_moments * apop_moments_merge(apop_moments *into, apop_moments const *from);
+size_t apop_moments_count(apop_moments const *m);
+double apop_moments_mean(apop_moments const *m, size_t col);
+double apop_moments_var(apop_moments const *m, size_t col);
+double apop_moments_cov(apop_moments const *m, size_t col1, size_t col2);
+double apop_moments_skew_pop(apop_moments const *m, size_t col);
+double apop_moments_kurtosis_pop(apop_moments const *m, size_t col);
+double apop_moments_skew(apop_moments const *m, size_t col);
+double apop_moments_kurtosis(apop_moments const *m, size_t col);
+
+//Quantile sketches (apop_sketch.c)
+typedef struct apop_sketch apop_sketch;
+APOP_VAR_DECLARE apop_sketch * apop_sketch_alloc(int k);
+void apop_sketch_free(apop_sketch *s);
+int apop_sketch_add(apop_sketch *s, double x);
+int apop_sketch_add_vector(apop_sketch *s, gsl_vector const *v);
+apop_sketch * apop_sketch_merge(apop_sketch *into, apop_sketch const *from);
+apop_sketch * apop_sketch_copy(apop_sketch const *s);
+size_t apop_sketch_count(apop_sketch const *s);
+APOP_VAR_DECLARE double * apop_sketch_percentiles(apop_sketch const *s, char rounding);
+APOP_VAR_DECLARE double apop_sketch_percentile(apop_sketch const *s, double p, char rounding);
+
 apop_data *apop_test_fisher_exact(apop_data *intab); //in apop_fisher.c
 
 //from apop_t_f_chi.c:
@@ -0,0 +1,58 @@
+/* Time apop_data_to_db writing a big matrix to a database on disk.
+
+   Not run by make check; build it via make db_write_bench, then run e.g.
+   ./db_write_bench -r 1000000 -c 20 -f /tmp/bench.db
+
+   Each configuration writes to a fresh copy of the database file. The first
+   commits every 100 rows, as apop_data_to_db used to; the second uses the default
+   apop_opts.db_batch_size; the third also sets apop_opts.db_scratch.
+*/
+#include <apop.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+static double now(){
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return t.tv_sec + t.tv_usec/1e6;
+}
+
+int main(int argc, char **argv){
+    int rows = 100000, cols = 20;
+    char *file = "db_write_bench.db";
+    char c;
+    while((c = getopt(argc, argv, "r:c:f:h"))!=-1)
+        if (c == 'r')      rows = atoi(optarg);
+        else if (c == 'c') cols = atoi(optarg);
+        else if (c == 'f') file = optarg;
+        else {
+            printf("Time apop_data_to_db.\n-r rows of data (default 100000)\n"
+                   "-c columns of data (default 20)\n-f database file (default db_write_bench.db)\n");
+            return 0;
+        }
+    apop_data *d = apop_data_alloc(rows, cols);
+    for (int i=0; i< rows; i++)
+        for (int j=0; j< cols; j++)
+            apop_data_set(d, i, j, i + j/(j+1.));
+
+    struct {char const *name; int batch_size; char scratch;} configs[] = {
+        {"batch 100", 100, 'n'},
+        {"default batch", apop_opts.db_batch_size, 'n'},
+        {"default batch + scratch", apop_opts.db_batch_size, 'y'}};
+    printf("configuration\tseconds\trows/sec\tcells/sec\n");
+    for (int i=0; i< sizeof(configs)/sizeof(configs[0]); i++){
+        unlink(file);
+        apop_opts.db_batch_size = configs[i].batch_size;
+        apop_opts.db_scratch = configs[i].scratch;
+        apop_db_open(file);
+        double start = now();
+        apop_data_print(d, "bench", .output_type='d');
+        double t = now() - start;
+        Apop_stopif(apop_query_to_float("select count(*) from bench") != rows, return 1, 0,
+                "wrote %g rows, not %i", apop_query_to_float("select count(*) from bench"), rows);
+        apop_db_close();
+        printf("%s\t%g\t%g\t%g\n", configs[i].name, t, rows/t, rows*(double)cols/t);
+    }
+    unlink(file);
+    apop_data_free(d);
+}
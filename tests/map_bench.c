@@ -0,0 +1,85 @@
+/* Time the per-call overhead of apop_map_sum at various thread counts.
+
+   Not run by make check; build it via make map_bench, then run e.g.
+   ./map_bench -t 8 -n 20000 -r 1000
+
+   For comparison, the "spawn" column does the same work the way apop_map_sum used to:
+   pthread_create and pthread_join a fresh set of threads on every call.
+*/
+#include <apop.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+static double log_plus_one(double in){ return log(in+1);}
+
+typedef struct {
+    gsl_vector *v;
+    size_t lo, hi;
+    double sum;
+} slice;
+
+static void *sum_a_slice(void *in){
+    slice *s = in;
+    s->sum = 0;
+    for (size_t i=s->lo; i< s->hi; i++)
+        s->sum += log_plus_one(gsl_vector_get(s->v, i));
+    return NULL;
+}
+
+static double spawn_per_call(gsl_vector *v, int threadct){
+    pthread_t thread_id[threadct];
+    slice slices[threadct];
+    size_t segment_size = v->size/threadct;
+    for (int i=0; i< threadct; i++){
+        slices[i] = (slice){.v=v, .lo=i*segment_size, .hi= i==threadct-1 ? v->size : (i+1)*segment_size};
+        pthread_create(thread_id+i, NULL, sum_a_slice, slices+i);
+    }
+    double sum = 0;
+    for (int i=0; i< threadct; i++){
+        pthread_join(thread_id[i], NULL);
+        sum += slices[i].sum;
+    }
+    return sum;
+}
+
+static double now(){
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return t.tv_sec + t.tv_usec/1e6;
+}
+
+int main(int argc, char **argv){
+    int maxthreads = 4, calls = 10000, rows = 1000;
+    char c;
+    while((c = getopt(argc, argv, "t:n:r:h"))!=-1)
+        if (c == 't')      maxthreads = atoi(optarg);
+        else if (c == 'n') calls = atoi(optarg);
+        else if (c == 'r') rows = atoi(optarg);
+        else {
+            printf("Time apop_map_sum calls.\n-t max thread count (default 4)\n"
+                   "-n calls per test (default 10000)\n-r rows of data (default 1000)\n");
+            return 0;
+        }
+    apop_data *d = apop_data_alloc(rows);
+    for (int i=0; i< rows; i++)
+        apop_data_set(d, i, -1, i);
+
+    printf("threads\tpool (us/call)\tspawn (us/call)\n");
+    for (int t=1; t<= maxthreads; t++){
+        apop_opts.thread_count = t;
+        double pool_sum = 0, spawn_sum = 0;
+        double start = now();
+        for (int i=0; i< calls; i++)
+            pool_sum += apop_map_sum(d, .fn_d=log_plus_one, .part='v');
+        double pool_time = now() - start;
+
+        start = now();
+        for (int i=0; i< calls; i++)
+            spawn_sum += spawn_per_call(d->vector, t);
+        double spawn_time = now() - start;
+        Apop_stopif(fabs(pool_sum - spawn_sum) > 1e-6*fabs(spawn_sum), return 1, 0,
+                "pooled sum %g != spawned sum %g", pool_sum, spawn_sum);
+        printf("%i\t%g\t%g\n", t, pool_time*1e6/calls, spawn_time*1e6/calls);
+    }
+    apop_data_free(d);
+}
@@ -1,4 +1,5 @@
 #include <apop.h>
+#include <locale.h>
 
 //assertions never return a value.
 #undef Apop_assert
@@ -313,6 +314,15 @@ void test_skew_and_kurt(){
     Diff (apop_var(v) ,apop_query_to_float("select var(vals) from t"),tol6);
     Diff (apop_vector_skew(v) ,apop_query_to_float("select skew(vals) from t"),tol6);
     Diff (apop_vector_kurt(v) ,apop_query_to_float("select kurt(vals) from t"),tol5);
+
+    //Same data, shifted way up. The old sum-of-squares versions lost about half the digits here.
+    apop_query("insert into t values(NULL)");
+    apop_query("update t set vals = vals + 1e7");
+    gsl_vector_add_constant(v, 1e7);
+    assert(fabs(apop_query_to_float("select var(vals) from t")/apop_var(v) - 1) < 1e-8);
+    assert(fabs(apop_query_to_float("select skew(vals) from t")/apop_vector_skew(v) - 1) < 1e-5);
+    assert(fabs(apop_query_to_float("select kurt(vals) from t")/apop_vector_kurt(v) - 1) < 1e-6);
+    gsl_vector_free(v);
     apop_table_exists("t",1);
 }
 
@@ -588,6 +598,41 @@ double          t, v;
     t    = gsl_matrix_get(s->matrix, 2, 1);
     v    = sqrt((2*2 +3*3 +3*3 +4.*4.)/3.);
     assert (t == v) ;
+
+    //The one-pass, threaded version should match the one-stat-at-a-time functions,
+    //for odd and even row counts, with and without weights.
+    int tc = apop_opts.thread_count;
+    for (int rows=1000; rows <= 1001; rows++){
+        apop_data *d = apop_data_alloc(rows, 5);
+        d->weights = gsl_vector_alloc(rows);
+        for (int i=0; i< rows; i++){
+            gsl_vector_set(d->weights, i, 1+i%3);
+            for (int j=0; j< 5; j++)
+                apop_data_set(d, i, j, j%2 ? (i*(j+7))%13 : sin(i*(j+1))*1e3);
+        }
+        for (apop_opts.thread_count=1; apop_opts.thread_count <=3; apop_opts.thread_count+=2)
+            for (int weighted=0; weighted < 2; weighted++){
+                gsl_vector *w = d->weights;
+                if (!weighted) d->weights = NULL;
+                apop_data *summ = apop_data_summarize(d);
+                d->weights = w;
+                for (int j=0; j< 5; j++){
+                    Apop_col(d, j, col);
+                    double mean = weighted ? apop_vector_weighted_mean(col, w) : apop_vector_mean(col);
+                    double var = weighted ? apop_vector_weighted_var(col, w) : apop_vector_var(col);
+                    double *pctiles = apop_vector_percentiles(col);
+                    assert(fabs(apop_data_get(summ, j, .colname="mean") - mean) < 1e-8);
+                    assert(fabs(apop_data_get(summ, j, .colname="variance") - var) < 1e-10*(1+var));
+                    assert(apop_data_get(summ, j, .colname="min") == pctiles[0]);
+                    assert(apop_data_get(summ, j, .colname="median") == pctiles[50]);
+                    assert(apop_data_get(summ, j, .colname="max") == pctiles[100]);
+                    free(pctiles);
+                }
+                apop_data_free(summ);
+            }
+        apop_data_free(d);
+    }
+    apop_opts.thread_count = tc;
 }
 
 void test_dot(){
@@ -1144,6 +1189,23 @@ void test_crosstabbing() {
     apop_data *d = apop_db_to_crosstab("snp_ct", "a_allele", "b_allele", "ct");
     assert(apop_data_get_tt(d, "A", "G")==5);
     assert(apop_data_get_tt(d, "C", "G")==1);
+
+    //Hundreds of categories, with repeated (row, col) pairs, which get summed.
+    apop_query("create table ct_big(r, c, x); begin;");
+    for (int i=0; i< 20000; i++)
+        apop_query("insert into ct_big values(%i, 'c%i', %i)", i%300, (i*7)%211, i%5);
+    apop_query("commit;");
+    apop_data *big = apop_db_to_crosstab("ct_big", "r", "c", "x");
+    assert(big->matrix->size1 == 300 && big->matrix->size2 == 211);
+    for (int i=0; i< 300; i++) assert(atoi(big->names->row[i]) == i); //numeric order, not 0, 1, 10, ...
+    assert(!strcmp(big->names->column[1], "c1") && !strcmp(big->names->column[2], "c10"));
+    apop_data *sums = apop_query_to_mixed_data("ttm", "select r, c, sum(x) from ct_big group by r, c");
+    for (int k=0; k< sums->textsize[0]; k++)
+        assert(apop_data_get_tt(big, sums->text[k][0], sums->text[k][1]) == apop_data_get(sums, k, 0));
+    assert(apop_matrix_sum(big->matrix) == apop_query_to_float("select sum(x) from ct_big"));
+    apop_data_free(big);
+    apop_data_free(sums);
+    apop_data_free(d);
 }
 
 void test_mvn_gamma(){
@@ -1169,6 +1231,597 @@ void test_data_to_db() {
     unlink("snps2");
 }
 
+void test_bulk_data_to_db(){
+    int prior_batch = apop_opts.db_batch_size;
+    apop_opts.db_batch_size = 7; //so we cross several commits.
+    apop_data *d = apop_text_alloc(apop_data_alloc(1000, 1000, 2), 1000, 1);
+    d->weights = gsl_vector_alloc(1000);
+    apop_name_add(d->names, "a", 'c');
+    apop_name_add(d->names, "b", 'c');
+    apop_name_add(d->names, "t", 't');
+    for (int i=0; i< 1000; i++){
+        apop_data_set(d, i, -1, i/3.);
+        apop_data_set(d, i, 0, i%10 ? i/7. : GSL_NAN);
+        apop_data_set(d, i, 1, -i*1e-9);
+        gsl_vector_set(d->weights, i, i+0.5);
+        apop_text_add(d, i, 0, i%2 ? "it's %i" : "%i", i);
+    }
+    apop_table_exists("bulk", 'd');
+    apop_data_print(d, "bulk", .output_type='d');
+    apop_data_print(d, "bulk", .output_type='d', .output_append='a');
+    apop_opts.db_batch_size = prior_batch;
+    assert(apop_query_to_float("select count(*) from bulk") == 2000);
+
+    apop_data *back = apop_query_to_mixed_data("vmmtw", "select vector, a, b, t, weights from bulk");
+    for (int i=0; i< 2000; i++){ //numbers come back bit-for-bit.
+        int r = i % 1000;
+        assert(apop_data_get(back, i, -1) == r/3.);
+        assert(r%10 ? apop_data_get(back, i, 0) == r/7. : gsl_isnan(apop_data_get(back, i, 0)));
+        assert(apop_data_get(back, i, 1) == -r*1e-9);
+        assert(gsl_vector_get(back->weights, i) == r + 0.5);
+        assert(!strcmp(back->text[i][0], d->text[r][0]));
+    }
+    apop_data_free(back);
+    apop_data_free(d);
+}
+
+static double square(double x){ return x*x; }
+
+void test_query_cursor(){
+    apop_query("create table cursed(row_names, a, b, t);");
+    apop_query("begin;");
+    for (int i=0; i< 2503; i++)
+        apop_query("insert into cursed values('r%i', %i, %s, 'x%i')", i, i, i%10 ? "1.5" : "NULL", i);
+    apop_query("commit;");
+
+    //Blocks of 1000, 1000, and 503 rows, which add up to the whole table.
+    apop_query_cursor *c = apop_query_cursor_open(NULL, 1000, "select row_names, a, b from cursed");
+    apop_data *whole = apop_query_to_data("select row_names, a, b from cursed");
+    size_t row = 0;
+    for (apop_data *b; (b = apop_query_cursor_next(c)); row += b->matrix->size1){
+        assert(b->matrix->size1 == (row < 2000 ? 1000 : 503));
+        assert(b->names->rowct == b->matrix->size1);
+        assert(!strcmp(b->names->column[1], "b"));
+        for (size_t i=0; i< b->matrix->size1; i++){
+            assert(!strcmp(b->names->row[i], whole->names->row[row+i]));
+            assert(apop_data_get(b, i, 0) == apop_data_get(whole, row+i, 0));
+            double x = apop_data_get(b, i, 1);
+            assert(gsl_isnan(x) ? gsl_isnan(apop_data_get(whole, row+i, 1)) : x == 1.5);
+        }
+    }
+    assert(row == 2503 && c->rows == 2503 && !c->error);
+    assert(!apop_query_cursor_next(c));
+    apop_query_cursor_free(c);
+
+    c = apop_query_cursor_open("nvt", 100, "select row_names, a, t from cursed");
+    assert(apop_query_cursor_map_sum(c, .fn_d=square) == 2502.*2503*5005/6);
+    assert(!strcmp(c->block->text[2][0], "x2502"));
+    apop_query_cursor_free(c);
+
+    //The block never keeps an arena, and opening a cursor leaves the global setting alone.
+    char prior_arena = apop_opts.string_arena;
+    apop_opts.string_arena = 'y';
+    c = apop_query_cursor_open("nvt", 100, "select row_names, a, t from cursed");
+    assert(!c->block->arena && !c->block->names->arena && apop_opts.string_arena == 'y');
+    for (apop_data *b; (b = apop_query_cursor_next(c)); )
+        assert(!strcmp(b->text[0][0]+1, b->names->row[0]+1)); //x123 and r123
+    apop_query_cursor_free(c);
+    apop_opts.string_arena = prior_arena;
+
+    c = apop_query_cursor_open("mm", 64, "select a, b from cursed");
+    apop_data *moments = apop_query_cursor_moments(c);
+    apop_query_cursor_free(c);
+    apop_data *summary = apop_data_summarize(whole);
+    assert(apop_data_get(moments, .rowname="a", .colname="count") == 2503);
+    assert(fabs(apop_data_get(moments, .rowname="a", .colname="mean") - 1251) < 1e-9);
+    assert(fabs(apop_data_get(moments, .rowname="a", .colname="variance")
+                - apop_data_get(summary, .rowname="a", .colname="variance")) < 1e-6);
+    assert(apop_data_get(moments, .rowname="b", .colname="count") == 2252);
+    assert(apop_data_get(moments, .rowname="b", .colname="variance") == 0);
+
+    apop_model *n = apop_model_set_parameters(apop_normal, 1000, 700);
+    c = apop_query_cursor_open(NULL, 300, "select a from cursed");
+    apop_data *a_only = apop_query_to_data("select a from cursed");
+    assert(fabs(apop_query_cursor_log_likelihood(c, n) - apop_log_likelihood(a_only, n)) < 1e-6);
+    apop_query_cursor_free(c);
+
+    assert(!apop_query_cursor_open("nm", 10, "select a from cursed")); //wrong column count
+    c = apop_query_cursor_open(NULL, 10, "select a from cursed where a < 0");
+    assert(c && !apop_query_cursor_next(c));
+    apop_query_cursor_free(c);
+    apop_data_free(whole);
+    apop_data_free(summary);
+    apop_data_free(moments);
+    apop_data_free(a_only);
+    apop_model_free(n);
+}
+
+static double group_mean(double g){ return apop_query_to_float("select avg(x) from grouped where g=%g", g); }
+
+static double group_write(double g){ return apop_query("insert into from_threads values(%g)", g); }
+
+//Threads in an apop_map each get their own connection to the database.
+void test_threaded_queries(){
+    int prior_threads = apop_opts.thread_count;
+    apop_db_close();
+    apop_opts.thread_count = 4;
+    apop_db_open(NULL);
+    apop_query("create table grouped(g, x); create table from_threads(g);");
+    apop_query("begin;");
+    for (int i=0; i< 10000; i++)
+        apop_query("insert into grouped values(%i, %i)", i%40, i);
+    apop_query("commit;");
+    gsl_vector *groups = gsl_vector_alloc(40);
+    for (int i=0; i< 40; i++) gsl_vector_set(groups, i, i);
+    gsl_vector *means = apop_vector_map(groups, group_mean);
+    for (int i=0; i< 40; i++)
+        assert(gsl_vector_get(means, i) == (9960 + 2*i)/2.);
+    gsl_vector *written = apop_vector_map(groups, group_write);
+    assert(apop_vector_sum(written) == 0); //apop_query returns zero on success.
+    assert(apop_query_to_float("select count(*) from from_threads") == 40);
+    assert(apop_query_to_float("select sum(g) from from_threads") == 780);
+
+    //Workers still hold connections to the old database; they have to notice it closed.
+    apop_db_close();
+    apop_db_open(NULL);
+    apop_query("create table grouped(g, x);");
+    for (int i=0; i< 40; i++)
+        apop_query("insert into grouped values(%i, %i)", i, -i);
+    gsl_vector_free(means);
+    means = apop_vector_map(groups, group_mean);
+    for (int i=0; i< 40; i++)
+        assert(gsl_vector_get(means, i) == -i);
+    apop_opts.thread_count = prior_threads;
+    gsl_vector_free(means);
+    gsl_vector_free(written);
+    gsl_vector_free(groups);
+}
+
+//Merge a database file with a new table and a table the main db already has.
+void test_db_merge(){
+    unlink("merge_shard.db");
+    apop_query("attach database 'merge_shard.db' as shard;"
+               "create table shard.mt1(id integer primary key, name text not null, x real);"
+               "create index shard.mt1_x on mt1(x);"
+               "create table shard.mt2(g, y);");
+    apop_query("begin;");
+    for (int i=0; i< 1000; i++)
+        apop_query("insert into shard.mt1 values(%i, 'n%i', %g);", i, i, i/4.);
+    for (int i=0; i< 500; i++)
+        apop_query("insert into shard.mt2 values(%i, %i);", i%7, i);
+    apop_query("commit; detach database shard;");
+    apop_query("create table mt2(g, y); create index mt2_g on mt2(g); insert into mt2 values(-1, -1);");
+
+    assert(apop_db_merge("merge_shard.db", .indices='y') == 1500);
+    assert(apop_query_to_float("select count(*) from mt1") == 1000);
+    assert(apop_query_to_float("select sum(x) from mt1") == 999*1000/8.);
+    assert(apop_query_to_float("select count(*) from mt2") == 501);
+    assert(apop_query_to_float("select count(*) from sqlite_master where type='index' "
+                               "and name in ('mt1_x', 'mt2_g')") == 2);
+    int v_was = apop_opts.verbose;
+    apop_opts.verbose = -1;
+    assert(apop_query("insert into mt1 values(1, 'dup', 0)")); //the primary key came along.
+    assert(apop_db_merge_table("merge_shard.db", "no_such_table") == -1);
+    apop_opts.verbose = v_was;
+    assert(apop_db_merge_table("merge_shard.db", "mt2") == 500);
+    assert(apop_query_to_float("select count(*) from mt2 where g=3") == 2*71);
+    unlink("merge_shard.db");
+}
+
+//The blocked covariance should match the pairwise functions, with or without weights,
+//and leave the input alone even when asked to normalize.
+void test_covariance(){
+    gsl_matrix *base = gsl_matrix_alloc(700, 9);
+    for (int i=0; i< 700; i++)
+        for (int j=0; j< 9; j++)
+            gsl_matrix_set(base, i, j, (i*(j+5))%23 + (j==3 ? 1e3 : 0) + sin(i*j));
+    gsl_matrix_view sub = gsl_matrix_submatrix(base, 0, 1, 700, 6);  //tda != size2
+    apop_data *d = apop_matrix_to_data(&sub.matrix);
+    gsl_matrix *before = apop_matrix_copy(&sub.matrix);
+    gsl_vector *w = gsl_vector_alloc(700);
+    for (int i=0; i< 700; i++) gsl_vector_set(w, i, 1 + i%4);
+    for (int weighted=0; weighted< 3; weighted++){
+        d->weights = weighted ? w : NULL;
+        if (weighted == 2) gsl_vector_scale(w, 1./apop_sum(w)); //weights as proportions
+        apop_data *cov = apop_data_covariance(d), *cor = apop_data_correlation(d);
+        for (int i=0; i< 6; i++)
+            for (int j=0; j< 6; j++){
+                Apop_col(d, i, vi);
+                Apop_col(d, j, vj);
+                double c = apop_vector_weighted_cov(vi, vj, d->weights);
+                assert(fabs(apop_data_get(cov, i, j) - c) < 1e-8*(1+fabs(c)));
+                double r = c/sqrt(apop_vector_weighted_var(vi, d->weights)*apop_vector_weighted_var(vj, d->weights));
+                assert(fabs(apop_data_get(cor, i, j) - r) < 1e-8);
+            }
+        apop_data_free(cov);
+        apop_data_free(cor);
+    }
+    gsl_matrix *mcov = apop_matrix_covariance(&sub.matrix, 'n');
+    Apop_matrix_col(&sub.matrix, 2, c2);
+    Apop_matrix_col(&sub.matrix, 4, c4);
+    assert(fabs(gsl_matrix_get(mcov, 2, 4) - apop_vector_cov(c2, c4)) < 1e-8);
+    for (int i=0; i< 700; i++)
+        for (int j=0; j< 6; j++)
+            assert(gsl_matrix_get(before, i, j) == gsl_matrix_get(&sub.matrix, i, j));
+    gsl_matrix_free(mcov);
+    gsl_matrix_free(before);
+    d->weights = NULL;
+    d->matrix = NULL;
+    apop_data_free(d);
+    gsl_matrix_free(base);
+    gsl_vector_free(w);
+}
+
+//Running moments, fed a row at a time or in merged blocks, should match the vector functions.
+void test_running_moments(){
+    int n = 500;
+    apop_data *d = apop_data_alloc(n, 3);
+    d->weights = gsl_vector_alloc(n);
+    for (int i=0; i< n; i++){
+        gsl_vector_set(d->weights, i, 1 + i%3);
+        for (int j=0; j< 3; j++)
+            apop_data_set(d, i, j, (i*(j+3))%17 + (j==2 ? 1e5 : 0) + (i%29==0)*20);
+    }
+    for (int weighted=0; weighted< 2; weighted++){
+        gsl_vector *w = weighted ? d->weights : NULL;
+        apop_moments *by_row = apop_moments_alloc(3), *by_block = NULL;
+        for (int i=0; i< n; i++){
+            Apop_row(d, i, r);
+            apop_moments_push(by_row, r->data, w ? gsl_vector_get(w, i) : 1);
+        }
+        gsl_vector *wsave = d->weights;
+        d->weights = w;
+        for (int lo=0; lo< n; lo+= 128){
+            Apop_data_rows(d, lo, GSL_MIN(128, n-lo), block);
+            apop_moments *part = apop_moments_alloc(3);
+            apop_moments_push_batch(part, block);
+            by_block = apop_moments_merge(by_block, part);
+            apop_moments_free(part);
+        }
+        d->weights = wsave;
+        for (apop_moments *m = by_row; m; m = (m==by_row) ? by_block : NULL){
+            assert(apop_moments_count(m) == n);
+            for (int j=0; j< 3; j++){
+                Apop_col(d, j, v);
+                #define close_to(a, b) assert(fabs((a) - (b)) < 1e-7*(1+fabs(a)))
+                close_to(apop_vector_weighted_mean(v, w), apop_moments_mean(m, j));
+                close_to(apop_vector_weighted_var(v, w), apop_moments_var(m, j));
+                close_to(w ? apop_vector_weighted_skew(v, w) : apop_vector_skew_pop(v), apop_moments_skew_pop(m, j));
+                close_to(w ? apop_vector_weighted_kurt(v, w) : apop_vector_kurtosis_pop(v), apop_moments_kurtosis_pop(m, j));
+                if (!w) close_to(apop_vector_skew(v), apop_moments_skew(m, j));
+                if (!w) close_to(apop_vector_kurtosis(v), apop_moments_kurtosis(m, j));
+                for (int k=0; k< 3; k++){
+                    Apop_col(d, k, v2);
+                    close_to(apop_vector_weighted_cov(v, v2, w), apop_moments_cov(m, j, k));
+                }
+            }
+        }
+        apop_moments_free(by_row);
+        apop_moments_free(by_block);
+    }
+
+    //Weights summing to less than 1.1 are proportions, so the sample size is the row count.
+    gsl_vector_scale(d->weights, 1./apop_vector_sum(d->weights));
+    apop_moments *by_row = apop_moments_alloc(3), *by_block = apop_moments_alloc(3);
+    for (int i=0; i< n; i++){
+        Apop_row(d, i, r);
+        apop_moments_push(by_row, r->data, gsl_vector_get(d->weights, i));
+    }
+    apop_moments_push_batch(by_block, d);
+    for (apop_moments *m = by_row; m; m = (m==by_row) ? by_block : NULL)
+        for (int j=0; j< 3; j++){
+            Apop_col(d, j, v);
+            double sx = 0, sxx = 0;
+            for (int i=0; i< n; i++){
+                double x = gsl_vector_get(v, i), wi = gsl_vector_get(d->weights, i);
+                sx += wi*x;
+                sxx += wi*x*x;
+            }
+            close_to(sx, apop_moments_mean(m, j));
+            close_to((sxx - sx*sx/n)/(n-1.), apop_moments_var(m, j));
+            close_to(apop_vector_weighted_var(v, d->weights), apop_moments_var(m, j));
+            close_to(apop_vector_weighted_skew(v, d->weights), apop_moments_skew_pop(m, j));
+        }
+    apop_moments_free(by_row);
+    apop_moments_free(by_block);
+    apop_data_free(d);
+}
+
+/* Three options, so the probit runs its multinomial loop. A search with one start, and
+   data where the options depend on x. */
+static apop_data *three_option_data(){
+    gsl_rng *r = apop_rng_alloc(23);
+    apop_data *d = apop_data_alloc(600, 2);
+    for (int i=0; i< 600; i++){
+        double x = 2*gsl_rng_uniform(r) - 1, u = gsl_rng_uniform(r);
+        apop_data_set(d, i, 0, u < 0.3 + 0.2*x ? 0 : u < 0.7 ? 1 : 2);
+        apop_data_set(d, i, 1, x);
+    }
+    gsl_rng_free(r);
+    return d;
+}
+
+static apop_model *probit_search(apop_data *d, apop_data *starting_points, int starts){
+    apop_model *m = apop_model_copy(apop_probit);
+    Apop_model_add_group(m, apop_mle, .method=APOP_SIMPLEX_NM, .tolerance=1e-8, .want_cov='n',
+                        .starting_points=starting_points, .starts=starts, .start_spread=1);
+    apop_model *out = apop_estimate(d, *m);
+    apop_model_free(m);
+    return out;
+}
+
+//Multistart searches on the multinomial probit, with one thread and with several.
+void test_multistart(){
+    apop_data *d = three_option_data();
+    int threads = apop_opts.thread_count, seed = apop_opts.rng_seed;
+    apop_model *est[2];
+    apop_data *tables[2];
+    for (int i=0; i< 2; i++){
+        apop_opts.thread_count = i ? 3 : 1;
+        apop_opts.rng_seed = seed;
+        est[i] = probit_search(d, NULL, 6);
+        tables[i] = apop_data_get_page(est[i]->info, "<Multistart optima>");
+        assert(tables[i] && tables[i]->matrix->size1 == 6 && tables[i]->matrix->size2 == 9);
+        assert(apop_data_get(est[i]->info, .rowname="log likelihood") == gsl_vector_max(tables[i]->vector));
+    }
+    //Draws are made before the searches start, so the thread count changes only rounding.
+    for (int i=0; i< 6; i++){
+        assert(fabs(apop_data_get(tables[0], i, -1) - apop_data_get(tables[1], i, -1)) < 1e-6);
+        for (int j=0; j< 9; j++)
+            assert(fabs(apop_data_get(tables[0], i, j) - apop_data_get(tables[1], i, j)) < 1e-4);
+    }
+    Apop_col_t(tables[0], "start 0", start0);
+    for (int i=0; i< 6; i++) assert(fabs(gsl_vector_get(start0, i) - 1) <= 1);
+    for (int i=0; i< 2; i++)
+        for (int j=0; j< 2; j++)
+            assert(fabs(apop_data_get(est[0]->parameters, i, j) - apop_data_get(est[1]->parameters, i, j)) < 1e-4);
+
+    //Every start's status is recorded, even if the user wants no info page.
+    apop_model *quiet = apop_model_copy(apop_probit);
+    Apop_model_add_group(quiet, apop_mle, .method=APOP_SIMPLEX_NM, .tolerance=1e-8, .starts=3);
+    Apop_model_add_group(quiet, apop_parts_wanted);
+    apop_model *quiet_est = apop_estimate(d, *quiet);
+    apop_data *quiet_optima = apop_data_get_page(quiet_est->info, "<Multistart optima>");
+    for (int i=0; i< 3; i++)
+        assert(!gsl_isnan(apop_data_get(quiet_optima, i, .colname="status")));
+    assert(apop_name_find(quiet_est->info->names, "log likelihood", 'r') == -2);
+    apop_model_free(quiet);
+    apop_model_free(quiet_est);
+
+    //Given starting points come first, and have to be in the matrix.
+    apop_data *points = apop_data_alloc(2, 4);
+    gsl_matrix_set_all(points->matrix, 0.5);
+    apop_model *given = probit_search(d, points, 0);
+    apop_data *optima = apop_data_get_page(given->info, "<Multistart optima>");
+    assert(optima->matrix->size1 == 2 && apop_data_get(optima, 1, .colname="start 3") == 0.5);
+    apop_data *vector_only = apop_data_fill(apop_data_alloc(4), 0, 0, 0, 0);
+    int v = apop_opts.verbose;
+    apop_opts.verbose = -1;
+    apop_model *bad = probit_search(d, vector_only, 0);
+    apop_opts.verbose = v;
+    assert(bad->error == 'd');
+
+    apop_opts.thread_count = threads;
+    apop_model_free(est[0]);
+    apop_model_free(est[1]);
+    apop_model_free(given);
+    apop_model_free(bad);
+    apop_data_free(points);
+    apop_data_free(vector_only);
+    apop_data_free(d);
+}
+
+//Sketches are exact for short streams; for long ones, merged chunks should land near the truth.
+void test_sketch(){
+    gsl_vector *v = gsl_vector_alloc(150);
+    apop_sketch *s = apop_sketch_alloc();
+    for (int i=0; i< 150; i++){
+        gsl_vector_set(v, i, (i*37)%101);
+        apop_sketch_add(s, (i*37)%101);
+    }
+    apop_sketch_add(s, GSL_NAN);
+    assert(apop_sketch_count(s) == 150);
+    for (char *r = "dua"; *r; r++){
+        double *exact = apop_vector_percentiles(v, *r), *sk = apop_sketch_percentiles(s, *r);
+        for (int i=0; i< 101; i++) assert(exact[i] == sk[i]);
+        free(exact); free(sk);
+    }
+    gsl_sort_vector(v);
+    assert(apop_sketch_percentile(s, 2.5) == gsl_vector_get(v, 3)); //2.5*(150-1)/100 rounds down to 3.
+
+    int n = 200000;
+    apop_sketch *whole = NULL;
+    for (int chunk=0; chunk< 4; chunk++){
+        apop_sketch *part = apop_sketch_alloc();
+        for (int i=chunk; i< n; i+=4) apop_sketch_add(part, (i*7919)%n);
+        whole = apop_sketch_merge(whole, part);
+        apop_sketch_free(part);
+    }
+    double *pctiles = apop_sketch_percentiles(whole);
+    assert(apop_sketch_count(whole) == n);
+    assert(pctiles[0] == 0 && pctiles[100] == n-1);
+    for (int i=1; i< 100; i++)      //the data is 0...n-1, so the value is the rank.
+        assert(fabs(pctiles[i] - i*(n-1)/100.) < n*0.02);
+    free(pctiles);
+    apop_sketch_free(whole);
+
+    apop_query("create table sk(g, x); begin;");
+    for (int i=0; i< 5000; i++) apop_query("insert into sk values(%i, %i);", i%2, i);
+    apop_query("commit;");
+    apop_data *q = apop_query_to_data("select g, median(x), median_sketch(x), percentile_sketch(x, 100) "
+                                      "from sk group by g");
+    for (int g=0; g< 2; g++){
+        assert(fabs(apop_data_get(q, g, 1) - apop_data_get(q, g, 2)) < 5000*0.02);
+        assert(apop_data_get(q, g, 3) == 4998+g);
+    }
+    apop_query_cursor *c = apop_query_cursor_open(NULL, 300, "select x from sk where g=1");
+    apop_data *cp = apop_query_cursor_percentiles(c);
+    assert(cp->matrix->size1 == 1 && cp->matrix->size2 == 101);
+    assert(apop_data_get(cp, 0, .colname="0") == 1 && apop_data_get(cp, 0, .colname="100") == 4999);
+    apop_query_cursor_free(c);
+    apop_data_free(cp);
+    apop_data_free(q);
+    apop_sketch_free(s);
+    gsl_vector_free(v);
+}
+
+//Write a multi-page data set in the binary format and map it back in.
+void test_binary_io(){
+    apop_data *d = apop_data_alloc(7, 7, 3);
+    for (int i=0; i< 7; i++){
+        apop_data_set(d, i, -1, i/3.);
+        for (int j=0; j< 3; j++) apop_data_set(d, i, j, i*10+j);
+        apop_name_add(d->names, "row", 'r');
+    }
+    apop_name_add(d->names, "vec", 'v');
+    apop_name_add(d->names, "c0", 'c');
+    apop_name_add(d->names, "t0", 't');
+    snprintf(d->names->title, 101, "a title");
+    d->weights = apop_vector_copy(d->vector);
+    apop_text_alloc(d, 7, 2);
+    for (int i=0; i< 7; i++) apop_text_add(d, i, i%2, "cell %i", i);
+    gsl_matrix *base = gsl_matrix_alloc(5, 9);  //the second page's matrix is a view, with tda != size2.
+    for (int i=0; i< 5*9; i++) base->data[i] = i;
+    gsl_matrix_view sub = gsl_matrix_submatrix(base, 1, 2, 4, 3);
+    apop_data *p2 = apop_data_add_page(d, apop_data_alloc(), "<second page>");
+    p2->matrix = &sub.matrix;
+    apop_data_add_page(d, apop_data_to_columns(apop_matrix_to_data(apop_matrix_copy(d->matrix))), "columns");
+    apop_data_print(d, "binary.dat", .output_type='b');
+
+    apop_data *m = apop_data_mmap("binary.dat");
+    assert(m->vector->size == 7 && m->matrix->size1 == 7 && m->matrix->size2 == 3);
+    for (int i=0; i< 7; i++){
+        assert(apop_data_get(m, i, -1) == i/3. && gsl_vector_get(m->weights, i) == i/3.);
+        for (int j=0; j< 3; j++) assert(apop_data_get(m, i, j) == i*10+j);
+        assert(!strcmp(m->text[i][i%2], d->text[i][i%2]));
+        assert(!strcmp(m->names->row[i], "row"));
+    }
+    assert(!strcmp(m->text[0][1], "") && m->textsize[0] == 7 && m->textsize[1] == 2);
+    assert(!strcmp(m->names->vector, "vec") && !strcmp(m->names->column[0], "c0"));
+    assert(!strcmp(m->names->text[0], "t0") && !strcmp(m->names->title, "a title"));
+    assert(m->names->colct == 1 && m->names->rowct == 7 && m->names->textct == 1);
+    assert((size_t)m->matrix->data % 64 == 0);
+    apop_data *m2 = apop_data_get_page(m, "<second page>");
+    assert(m2->matrix->size1 == 4 && m2->matrix->size2 == 3 && !m2->vector && !m2->text);
+    for (int i=0; i< 4; i++)
+        for (int j=0; j< 3; j++) assert(apop_data_get(m2, i, j) == gsl_matrix_get(&sub.matrix, i, j));
+    apop_data *m3 = apop_data_get_page(m, "columns");
+    assert(!m3->matrix && m3->columns->size1 == 3 && gsl_matrix_get(m3->columns, 2, 6) == 62);
+    assert(!m3->more);
+
+    //Changes to the mapped set stay in memory; new strings go to the heap.
+    apop_data_set(m, 0, 0, -1);
+    apop_text_add(m, 0, 0, "a new string, rather longer than the old one");
+    apop_name_add(m->names, "c1", 'c');
+    apop_data *c = apop_data_copy(m);
+    assert(apop_data_get(c, 0, 0) == -1 && !strcmp(c->names->column[1], "c1"));
+    apop_data_free(m);
+    m = apop_data_mmap("binary.dat");
+    assert(apop_data_get(m, 0, 0) == 0 && !strcmp(m->text[0][0], "cell 0"));
+
+    //A truncated file is refused.
+    FILE *f = fopen("binary.dat", "r+");
+    assert(!ftruncate(fileno(f), 400));
+    fclose(f);
+    int v_was = apop_opts.verbose;
+    apop_opts.verbose = -1;
+    assert(!apop_data_mmap("binary.dat"));
+    assert(!apop_data_mmap("no such file.dat"));
+    apop_data_print(d, "no such directory/binary.dat", .output_type='b'); //complains, doesn't crash.
+    apop_opts.verbose = v_was;
+    unlink("binary.dat");
+    p2->matrix = NULL;
+    apop_data_free(d);
+    apop_data_free(m);
+    apop_data_free(c);
+    gsl_matrix_free(base);
+}
+
+//The ?-placeholder queries, including more distinct queries than the statement cache holds.
+void test_bound_queries(){
+    apop_query("create table bound(i, x, name);");
+    apop_query("begin;");
+    for (int i=0; i< 1000; i++)
+        assert(!apop_query_bound("idt", "insert into bound values(?, ?, ?)",
+                            i, i/3., (i%2) ? "O'Brien" : "\"quoted\""));
+    assert(!apop_query_bound("in", "insert into bound values(?, 1, ?)", 1000));
+    apop_query("commit;");
+    assert(apop_query_bound_to_float("t", "select count(*) from bound where name = ?", "O'Brien") == 500);
+    assert(apop_query_bound_to_float("", "select count(*) from bound where name is null") == 1);
+    assert(apop_query_bound_to_float("l", "select x from bound where i = ?", 999L) == 999/3.);
+    for (int rep=0; rep< 2; rep++)
+        for (int i=0; i< 50; i++){ //50 distinct queries, so the cache evicts and reprepares.
+            char *q;
+            asprintf(&q, "select sum(x) from bound where i < ? + %i", i);
+            assert(fabs(apop_query_bound_to_float("i", q, 10) - (9+i)*(10+i)/6.) < 1e-10);
+            free(q);
+        }
+
+    apop_data *d = apop_query_bound_to_data("dd", "select i, x from bound where x between ? and ?", 10., 20.);
+    assert(d->matrix->size1 == 31 && d->matrix->size2 == 2);
+    assert(apop_data_get(d, 0, 0) == 30 && apop_data_get(d, 30, 1) == 20);
+    gsl_vector *v = apop_query_bound_to_vector("i", "select x from bound where i < ?", 9);
+    assert(v->size == 9 && apop_vector_sum(v) == 12);
+    gsl_matrix *m = apop_query_bound_to_matrix("ii", "select i, i*? from bound where i < ?", 2, 5);
+    assert(m->size1 == 5 && gsl_matrix_get(m, 4, 1) == 8);
+    assert(!apop_query_bound_to_data("i", "select * from bound where i < ?", -1));
+
+    int v_was = apop_opts.verbose;
+    apop_opts.verbose = -1;
+    assert(apop_query_bound("i", "insert into bound values(?, ?, ?)", 3)); //too few types
+    assert(apop_query_bound("", "select 1; select 2"));
+    assert(isnan(apop_query_bound_to_float("", "select * from no_such_table")));
+    apop_opts.verbose = v_was;
+    apop_data_free(d);
+    gsl_vector_free(v);
+    gsl_matrix_free(m);
+}
+
+//The SQL quantile, covariance, and weighted aggregates should match the in-C versions.
+void test_db_aggregates(){
+    int n = 1001;
+    gsl_vector *x = gsl_vector_alloc(n), *y = gsl_vector_alloc(n), *w = gsl_vector_alloc(n);
+    apop_query("create table aggs(g, x, y, w);");
+    apop_query("begin;");
+    for (int i=0; i< n; i++){
+        gsl_vector_set(x, i, (i*37 % 101) / 7.);
+        gsl_vector_set(y, i, gsl_vector_get(x, i)*2 + (i % 13));
+        gsl_vector_set(w, i, 1 + i%4);
+        apop_query("insert into aggs values(%i, %.17g, %.17g, %g)", i%2,
+                gsl_vector_get(x, i), gsl_vector_get(y, i), gsl_vector_get(w, i));
+    }
+    apop_query("insert into aggs values(0, NULL, 1, 1)"); //skipped by everything below.
+    apop_query("insert into aggs values(0, NULL, NULL, NULL)");
+    apop_query("commit;");
+
+    for (char *r = "dua"; *r; r++){
+        double *pctiles = apop_vector_percentiles(x, *r);
+        for (int i=0; i<= 100; i+= 5)
+            assert(apop_query_to_float("select percentile(x, %i, '%c') from aggs", i, *r) == pctiles[i]);
+        assert(apop_query_to_float("select median(x, '%c') from aggs", *r) == pctiles[50]);
+        free(pctiles);
+    }
+    double *pctiles = apop_vector_percentiles(x);
+    assert(apop_query_to_float("select median(x) from aggs") == pctiles[50]);
+    for (int i=1; i< 100; i+= 7) //x runs from 0 to 14.3.
+        assert(fabs(apop_query_to_float("select percentile_approx(x, %i) from aggs", i) - pctiles[i]) < 0.2);
+    assert(fabs(apop_query_to_float("select median_approx(x) from aggs") - pctiles[50]) < 0.2);
+    free(pctiles);
+
+    assert(fabs(apop_query_to_float("select cov(x, y) from aggs") - apop_vector_cov(x, y)) < 1e-8);
+    assert(fabs(apop_query_to_float("select covar_pop(x, y) from aggs") - apop_vector_cov(x, y)*(n-1.)/n) < 1e-8);
+    assert(fabs(apop_query_to_float("select corr(x, y) from aggs") - apop_vector_correlation(x, y)) < 1e-8);
+    assert(fabs(apop_query_to_float("select weighted_mean(x, w) from aggs") - apop_vector_weighted_mean(x, w)) < 1e-8);
+    assert(fabs(apop_query_to_float("select weighted_var(x, w) from aggs") - apop_vector_weighted_var(x, w)) < 1e-8);
+
+    assert(gsl_isnan(apop_query_to_float("select median(x) from aggs where 0")));
+    assert(gsl_isnan(apop_query_to_float("select corr(x, 1) from aggs")));
+    apop_data *groups = apop_query_to_data("select g, median(x), percentile_approx(x, 50), corr(x, y) from aggs group by g");
+    assert(groups->matrix->size1 == 2);
+    apop_data_free(groups);
+    gsl_vector_free(x); gsl_vector_free(y); gsl_vector_free(w);
+}
+
 void test_default_rng(gsl_rng *r) {
     gsl_vector *o = gsl_vector_alloc(2e5);
     apop_model *ncut = apop_model_set_parameters(apop_normal, 1.1, 1.23);
@@ -1213,6 +1866,493 @@ void row_manipulations(){
     assert (!apop_map_sum(test2, .fn_d=is_even, .part='v'));
 }
 
+static double nested_sum(double in, void *d){ return apop_map_sum(d, .fn_d=is_odd, .part='v');}
+
+//Resize the thread pool and chunk size a few times; answers shouldn't change, and
+//a map_sum inside a map_sum shouldn't deadlock.
+void test_thread_pool(){
+    int prior_threads = apop_opts.thread_count;
+    apop_data *d= apop_data_alloc(1001);
+    apop_map(d, .fn_di=set_to_index, .part='v', .inplace='y');
+    int threadcts[] = {1, 4, 2, 7, 1, 3};
+    for (int i=0; i< sizeof(threadcts)/sizeof(int); i++){
+        apop_opts.thread_count = threadcts[i];
+        apop_opts.thread_chunk_size = i%3; //0=auto, 1, 2
+        for (int j=0; j< 100; j++){
+            assert(apop_map_sum(d, .fn_d=is_odd, .part='v')==500);
+            assert(apop_vector_map_sum(d->vector, is_even)==501);
+        }
+        Apop_data_rows(d, 0, 4, first_four);
+        assert(apop_map_sum(first_four, .fn_dp=nested_sum, .param=d, .part='v')==2000);
+    }
+    apop_opts.thread_count = prior_threads;
+    apop_opts.thread_chunk_size = 0;
+    apop_data_free(d);
+}
+
+static double inverse(double in){ return 1/(in+1);}
+
+//With .reproducible='y', the sum shouldn't change in the last bit as the thread count changes.
+void test_reproducible_sum(){
+    int prior_threads = apop_opts.thread_count;
+    apop_data *d= apop_data_alloc(10001);
+    apop_map(d, .fn_di=set_to_index, .part='v', .inplace='y');
+    apop_opts.thread_count = 1;
+    double serial = apop_map_sum(d, inverse, .reproducible='y');
+    for (int i=2; i< 6; i++){
+        apop_opts.thread_count = i;
+        assert(apop_map_sum(d, inverse, .reproducible='y') == serial);
+        Diff(apop_map_sum(d, inverse), serial, 1e-12);
+    }
+    apop_opts.thread_count = prior_threads;
+    apop_data_free(d);
+}
+
+//A row function that looks at every part of the row it is handed.
+static double row_total(apop_data *r, int i){
+    assert(!r->names || r->names->rowct <= 1);
+    return (r->vector ? apop_data_get(r, 0, -1) : 0)
+         + (r->matrix ? apop_data_get(r, 0, 0) : 0)
+         + (r->text ? atof(r->text[0][0]) : 0) + 1000*i;
+}
+
+//Map a text page and a couple of numeric pages in one threaded pass, and check against the serial run.
+void test_multipage_map(){
+    int prior_threads = apop_opts.thread_count;
+    apop_data *d = apop_data_alloc(200, 150, 2);
+    d->more = apop_text_alloc(NULL, 90, 1);
+    d->more->more = apop_data_alloc(0, 3, 700);
+    for (int i=0; i< 200; i++) apop_data_set(d, i, -1, i);
+    for (int i=0; i< 150; i++) apop_data_set(d, i, 0, -i);
+    for (int i=0; i< 90; i++) apop_text_add(d->more, i, 0, "%i", i*2);
+    apop_map(d->more->more, .fn_di=set_to_index, .part='m', .inplace='y');
+
+    apop_opts.thread_count = 1;
+    apop_data *serial = apop_map(d, .fn_ri=row_total, .all_pages='y');
+    apop_data *serial_m = apop_map(d, .fn_di=set_to_index, .part='m', .all_pages='y');
+    double serial_sum = apop_map_sum(d, .fn_ri=row_total, .all_pages='y');
+    for (int i=2; i< 6; i++){
+        apop_opts.thread_count = i;
+        apop_data *rows = apop_map(d, .fn_ri=row_total, .all_pages='y');
+        apop_data *m = apop_map(d, .fn_di=set_to_index, .part='m', .all_pages='y');
+        for (apop_data *p=rows, *s=serial; s; p=p->more, s=s->more){
+            assert(p->vector->size == s->vector->size);
+            assert(apop_vector_distance(p->vector, s->vector) == 0);
+        }
+        assert(m->more->more->matrix->size2 == 700);
+        assert(apop_matrix_sum(m->more->more->matrix) == apop_matrix_sum(serial_m->more->more->matrix));
+        Diff(apop_map_sum(d, .fn_ri=row_total, .all_pages='y'), serial_sum, 1e-12);
+        apop_data_free(rows);
+        apop_data_free(m);
+    }
+    assert(serial->more->vector->size == 90);
+    assert(apop_data_get(serial->more, 89, -1) == 89*1000 + 178);
+    apop_opts.thread_count = prior_threads;
+    apop_data_free(serial);
+    apop_data_free(serial_m);
+    apop_data_free(d);
+}
+
+static double sq_dev(double x, void *mu){ return gsl_pow_2(x - *(double*)mu);}
+
+/* The built-in models sum their log likelihoods with batch kernels, not apop_map_sum;
+   check them against apop_map_sum, using a strided vector and a matrix view that isn't
+   contiguous, at several thread counts. */
+#define close_enough(L, R) Apop_assert(fabs((L)-(R)) <= 1e-9*(1+fabs(R)), "%g is too different from %g.", (double)(L), (double)(R))
+
+/* The gamma, beta, Poisson, and exponential models, against the element-by-element
+   formulas they used before the batch kernels. The data is strided and padded like
+   test_batch_log_likelihoods's, but all in (0, 1) so the beta is finite. */
+static void check_batch_models(){
+    gsl_vector *v = gsl_vector_alloc(2400);
+    gsl_matrix *m = gsl_matrix_alloc(1200, 9);
+    for (int i=0; i< 2400; i++) gsl_vector_set(v, i, 0.005 + (i%97)/100.);
+    for (int i=0; i< 1200; i++) for (int j=0; j< 9; j++) gsl_matrix_set(m, i, j, 0.05 + ((i*7+j)%89)/100.);
+    gsl_vector_view vv = gsl_vector_subvector_with_stride(v, 0, 2, 1200);
+    gsl_matrix_view mv = gsl_matrix_submatrix(m, 0, 1, 1200, 7);
+    apop_data *d = &(apop_data){.vector=&vv.vector, .matrix=&mv.matrix};
+    double sum = 0, matrix_sum = 0, ln_sum = 0, ln1m_sum = 0, gamma_ll = 0, beta_ll = 0, poisson_ll = 0;
+    double ga = 1.5, gb = 0.7, alpha = 2, beta = 3, lambda = 0.6, mu = 0.5;
+    size_t n = d->vector->size + d->matrix->size1*d->matrix->size2,
+           mn = d->matrix->size1*d->matrix->size2;
+    for (size_t i=0; i< n; i++){
+        double x = i < d->vector->size ? gsl_vector_get(d->vector, i)
+                  : gsl_matrix_get(d->matrix, (i-d->vector->size)/d->matrix->size2, (i-d->vector->size)%d->matrix->size2);
+        sum += x;
+        if (i >= d->vector->size) matrix_sum += x;
+        ln_sum += log(x);
+        ln1m_sum += log(1-x);
+        gamma_ll += (ga-1)*log(x) - x/gb - (gsl_sf_lngamma(ga) + ga*log(gb));
+        beta_ll += (alpha-1)*log(x) + (beta-1)*log(1-x);
+        poisson_ll += log(lambda)*x - gsl_sf_lngamma(x+1);
+    }
+    gsl_vector *grad = gsl_vector_alloc(2);
+    apop_model *gamma = apop_model_set_parameters(apop_gamma, ga, gb);
+    close_enough(apop_log_likelihood(d, gamma), gamma_ll);
+    apop_score(d, grad, gamma);
+    close_enough(gsl_vector_get(grad, 0), ln_sum - n*(gsl_sf_psi(ga) + log(gb)));
+    close_enough(gsl_vector_get(grad, 1), sum/gsl_pow_2(gb) - n*ga/gb);
+
+    apop_model *beta_m = apop_model_set_parameters(apop_beta, alpha, beta);
+    close_enough(apop_log_likelihood(d, beta_m), beta_ll + gsl_sf_lnbeta(alpha, beta)*n);
+    apop_score(d, grad, beta_m); //as before the kernels, each sum gets the other parameter's psi.
+    close_enough(gsl_vector_get(grad, 0), ln_sum + (-gsl_sf_psi(beta) + gsl_sf_psi(alpha+beta))*n);
+    close_enough(gsl_vector_get(grad, 1), ln1m_sum + (-gsl_sf_psi(alpha) + gsl_sf_psi(alpha+beta))*n);
+
+    gsl_vector *grad1 = gsl_vector_alloc(1);
+    apop_model *poisson = apop_model_set_parameters(apop_poisson, lambda);
+    close_enough(apop_log_likelihood(d, poisson), poisson_ll - n*lambda);
+    apop_score(d, grad1, poisson);
+    close_enough(gsl_vector_get(grad1, 0), matrix_sum/lambda - n);
+
+    apop_model *exponential = apop_model_set_parameters(apop_exponential, mu);
+    close_enough(apop_log_likelihood(d, exponential), -matrix_sum/mu - mn*log(mu));
+    apop_score(d, grad1, exponential);
+    close_enough(gsl_vector_get(grad1, 0), matrix_sum/gsl_pow_2(mu) - mn/mu);
+
+    apop_model_free(gamma);
+    apop_model_free(beta_m);
+    apop_model_free(poisson);
+    apop_model_free(exponential);
+    gsl_vector_free(grad);
+    gsl_vector_free(grad1);
+    gsl_vector_free(v);
+    gsl_matrix_free(m);
+}
+
+void test_batch_log_likelihoods(){
+    int prior_threads = apop_opts.thread_count;
+    gsl_vector *v = gsl_vector_alloc(2400);
+    gsl_matrix *m = gsl_matrix_alloc(1200, 9);
+    for (int i=0; i< 2400; i++) gsl_vector_set(v, i, 0.1 + (i%97)/100.);
+    for (int i=0; i< 1200; i++) for (int j=0; j< 9; j++) gsl_matrix_set(m, i, j, 0.05 + ((i*7+j)%89)/100.);
+    gsl_vector_view vv = gsl_vector_subvector_with_stride(v, 0, 2, 1200);
+    gsl_matrix_view mv = gsl_matrix_submatrix(m, 0, 1, 1200, 7);
+    apop_data d = {.vector=&vv.vector, .matrix=&mv.matrix};
+    double mu = 0.4, sd = 0.3, n = 1200*8;
+    apop_model *norm = apop_model_set_parameters(apop_normal, mu, sd);
+    gsl_vector *grad = gsl_vector_alloc(2);
+    for (int t=1; t< 5; t++){
+        apop_opts.thread_count = t;
+        double ssq = apop_map_sum(&d, .fn_dp=sq_dev, .param=&mu);
+        Diff(apop_log_likelihood(&d, norm), -ssq/(2*sd*sd) - n*(M_LNPI+M_LN2+log(sd)), 1e-6);
+        apop_score(&d, grad, norm);
+        Diff(gsl_vector_get(grad, 1), ssq/gsl_pow_3(sd) - n/sd, 1e-6);
+        check_batch_models();
+    }
+    apop_opts.thread_count = prior_threads;
+    gsl_vector_free(grad);
+    gsl_vector_free(v);
+    gsl_matrix_free(m);
+    apop_model_free(norm);
+}
+
+static double colsum(gsl_vector *v){ return apop_vector_sum(v); }
+static double row_count(apop_data *d){ return 1; }
+
+//A data set stored by columns should get, set, copy, and summarize just like the row-major original.
+void test_columnar(){
+    apop_data *d = apop_data_alloc(40, 40, 6);
+    apop_name_add(d->names, "third", 'c');
+    for (int i=0; i< 40; i++){
+        apop_data_set(d, i, -1, i);
+        for (int j=0; j< 6; j++) apop_data_set(d, i, j, (i*(j+3))%11 + j);
+    }
+    apop_data *cov = apop_data_covariance(d);
+    apop_data *summary = apop_data_summarize(d);
+    apop_data *c = apop_data_to_columns(apop_data_copy(d));
+    assert(!c->matrix && c->columns->size1 == 6 && c->columns->size2 == 40);
+    for (int i=0; i< 40; i++)
+        for (int j=-1; j< 6; j++)
+            assert(apop_data_get(c, i, j) == apop_data_get(d, i, j));
+    assert(apop_data_get(c, 7, .colname="third") == apop_data_get(d, 7, 0));
+
+    apop_data *ccov = apop_data_covariance(c);
+    apop_data *csummary = apop_data_summarize(c);
+    for (int i=0; i< 6; i++){
+        for (int j=0; j< 6; j++)
+            assert(fabs(apop_data_get(cov, i, j) - apop_data_get(ccov, i, j)) < 1e-10);
+        Apop_row(summary, i, srow);
+        Apop_row(csummary, i, csrow);
+        assert(apop_vector_distance(srow, csrow) < 1e-10);
+    }
+
+    apop_data *cc = apop_data_copy(c);
+    apop_data_set(cc, 3, 4, 100);
+    *apop_data_ptr(cc, 4, 3) = 200;
+    assert(apop_data_get(c, 3, 4) != 100);
+    apop_data_to_rows(cc);
+    assert(cc->matrix && !cc->columns);
+    assert(gsl_matrix_get(cc->matrix, 3, 4) == 100);
+    assert(gsl_matrix_get(cc->matrix, 4, 3) == 200);
+
+    //apop_map_sum reads the columns; functions that need a row-major matrix stop.
+    assert(apop_map_sum(c, square) == apop_map_sum(d, square));
+    assert(apop_map_sum(c, square, .part='m') == apop_map_sum(d, square, .part='m'));
+    assert(apop_map_sum(c, .fn_v=colsum) == apop_map_sum(d, .fn_v=colsum));
+    assert(apop_map_sum(c, .fn_v=colsum, .part='c') == apop_map_sum(d, .fn_v=colsum, .part='c'));
+    int v = apop_opts.verbose;
+    apop_opts.verbose = -1;
+    assert(gsl_isnan(apop_map_sum(c, .fn_r=row_count)));
+    apop_data *mapped = apop_map(c, square);
+    assert(mapped->error == 'p');
+    apop_model *std_normal = apop_model_set_parameters(apop_normal, 0, 1);
+    assert(gsl_isnan(apop_log_likelihood(c, std_normal)));
+    apop_model_free(std_normal);
+    apop_opts.verbose = v;
+
+    //Writing to the db goes via a row-major copy.
+    apop_table_exists("colstab", 'd');
+    apop_data_print(c, "colstab", .output_type='d');
+    assert(apop_query_to_float("select count(*) from colstab") == 40);
+    double third = 0;
+    for (int i=0; i< 40; i++) third += apop_data_get(d, i, 0);
+    assert(apop_query_to_float("select sum(third) from colstab") == third);
+    assert(!c->matrix && c->columns);
+
+    apop_data_free(mapped);
+    apop_data_free(d); apop_data_free(c); apop_data_free(cc);
+    apop_data_free(cov); apop_data_free(ccov);
+    apop_data_free(summary); apop_data_free(csummary);
+}
+
+void test_name_lookup(){
+    apop_name *n = apop_name_alloc();
+    char name[20];
+    for (int i=0; i< 100; i++){
+        sprintf(name, "Col %i", i);
+        apop_name_add(n, name, 'c');
+    }
+    apop_name_add(n, "the vector", 'v');
+    apop_name_add(n, "p value", 'c');
+    apop_name_add(n, "p.val", 'c');
+    for (int i=0; i< 100; i++){
+        sprintf(name, "col %i", i);
+        assert(apop_name_find(n, name, 'c') == i);
+    }
+    assert(apop_name_find(n, "p.val", 'c') == 101);  //the exact match beats the earlier regex match
+    assert(apop_name_find(n, "P V.*", 'c') == 100);
+    assert(apop_name_find(n, "col 1.", 'c') == 10);
+    assert(apop_name_find(n, "the vector", 'c') == -1);
+    assert(apop_name_find(n, "nonesuch", 'c') == -2);
+    assert(apop_name_find(n, "nonesuch", 'r') == -2);
+
+    //the index has to notice when the list changes
+    apop_name_add(n, "late arrival", 'c');
+    assert(apop_name_find(n, "Late Arrival", 'c') == 102);
+    assert(n->colsize == 128); //the list grows by doubling, not one name at a time.
+    apop_name *copy = apop_name_copy(n);
+    assert(apop_name_find(copy, "col 50", 'c') == 50);
+    free(copy->column[50]);
+    copy->column[50] = strdup("renamed");
+    assert(apop_name_find(copy, "renamed", 'c') == 50);
+    assert(apop_name_find(copy, "col 50", 'c') == -2);
+    assert(apop_name_find(n, "col 50", 'c') == 50);
+    apop_name_free(n);
+    apop_name_free(copy);
+
+    //Dropping columns swaps in a shorter list, which has to bring its own size along.
+    apop_data *wide = apop_data_alloc(2, 40);
+    int drop[40] = {0};
+    for (int i=0; i< 40; i++){
+        apop_name_add(wide->names, "c", 'c');
+        drop[i] = (i > 0);
+    }
+    apop_data_rm_columns(wide, drop);
+    for (int i=0; i< 20; i++) apop_name_add(wide->names, "added", 'c');
+    assert(wide->names->colct == 21 && wide->names->colsize >= 21);
+    apop_data_free(wide);
+}
+
+void test_string_arena(){
+    apop_data *d = apop_data_alloc(0, 500, 2);
+    apop_data_use_arena(d);
+    apop_text_alloc(d, 500, 3);
+    for (int i=0; i< 500; i++){
+        apop_name_add(d->names, "", 'r');
+        apop_text_add(d, i, 0, "row %i", i);
+        apop_text_add(d, i, 2, "%i", i*i);
+        apop_data_set(d, i, 0, i);
+    }
+    apop_data_add_names(d, 'c', "first", "second");
+    apop_data_add_names(d, 't', "one", "two", "three");
+    apop_name_add(d->names, "vector", 'v');
+    asprintf(&d->text[7][1], "written by hand"); //users may write to cells directly.
+    d->names->row[5] = strdup("named by hand");
+    apop_text_alloc(d, 500, 4);   //move all the rows
+    apop_text_add(d, 3, 3, "new column");
+
+    apop_data *c = apop_data_copy(d);
+    assert(c->arena && c->arena != d->arena && c->names->arena == c->arena);
+    apop_text_add(d, 0, 0, "changed");
+    apop_data_rm_columns(d, (int[]){1, 0});
+    assert(!strcmp(d->names->column[0], "second"));
+    assert(apop_name_find(d->names, "second", 'c') == 0);
+    apop_data_free(d);
+
+    assert(!strcmp(c->text[0][0], "row 0"));
+    assert(!strcmp(c->text[499][2], "249001"));
+    assert(!strcmp(c->text[7][1], "written by hand"));
+    assert(!strcmp(c->text[3][3], "new column"));
+    assert(!strcmp(c->text[4][3], "") && !strcmp(c->text[4][1], ""));
+    assert(!strcmp(c->names->column[1], "second") && !strcmp(c->names->text[2], "three"));
+    assert(apop_data_get(c, 12, .colname="first") == 12);
+    apop_data **halves = apop_data_split(c, 100, 'r');
+    assert(!strcmp(halves[1]->text[0][0], "row 100"));
+    assert(!strcmp(halves[1]->text[399][2], "249001"));
+    apop_data_free(halves[0]); apop_data_free(halves[1]); free(halves);
+    apop_data_free(c);
+
+    apop_opts.string_arena = 'y';
+    apop_data *e = apop_text_alloc(NULL, 2, 2);
+    apop_opts.string_arena = 'n';
+    assert(e->arena);
+    apop_text_add(e, 1, 1, "%s", "x");
+    asprintf(&e->text[1][0], "by hand");
+    apop_text_alloc(e, 1, 2); //frees the hand-written cell with its row
+    assert(e->textsize[0] == 1 && !strcmp(e->text[0][0], ""));
+    apop_data_free(e);
+}
+
+void test_text_reading(){
+    char infile[] = "text_reading_test.csv";
+    FILE *f = fopen(infile, "w");
+    fprintf(f, "first, second, third  # the header\n"
+               "1, 2.5, 3e2\n"
+               "\n"
+               "   # a comment line\n"
+               "-4,,6\n"
+               "7 , \"8\" ,-.5\n"
+               "0.1, 1234567890123456789012, 5");  //no newline at the end
+    fclose(f);
+    apop_data *d = apop_text_to_data(infile);
+    assert(d->matrix->size1 == 4 && d->matrix->size2 == 3);
+    assert(!strcmp(d->names->column[2], "third"));
+    assert(apop_data_get(d, 0, 2) == 300);
+    assert(apop_data_get(d, 1, 0) == -4);
+    assert(gsl_isnan(apop_data_get(d, 1, 1)));
+    assert(apop_data_get(d, 2, 1) == 8);
+    assert(apop_data_get(d, 2, 2) == -0.5);
+    assert(apop_data_get(d, 3, 0) == 0.1);  //exactly the same double as the compiler's 0.1
+    assert(apop_data_get(d, 3, 1) == 1234567890123456789012.);
+    assert(apop_data_get(d, 3, 2) == 5);
+    apop_data_free(d);
+
+    //Numbers are read with the locale's decimal point, if the system has such a locale.
+    if (setlocale(LC_NUMERIC, "de_DE.UTF-8") || setlocale(LC_NUMERIC, "de_DE")){
+        f = fopen(infile, "w");
+        fprintf(f, "a|b\n2,5|-0,125\n");
+        fclose(f);
+        d = apop_text_to_data(infile, .delimiters="|");
+        setlocale(LC_NUMERIC, "C");
+        assert(apop_data_get(d, 0, 0) == 2.5 && apop_data_get(d, 0, 1) == -0.125);
+        apop_data_free(d);
+    }
+    unlink(infile);
+}
+
+//A failed read rolls back its partial batch, and leaves no transaction open.
+void test_text_to_db_failure(){
+    char infile[] = "text_dup_test.csv";
+    FILE *f = fopen(infile, "w");
+    fprintf(f, "a, b\n1, 2\n1, 3\n2, 4\n");
+    fclose(f);
+    int v = apop_opts.verbose;
+    char stop = apop_opts.stop_on_warning;
+    apop_opts.verbose = -1;
+    apop_opts.stop_on_warning = 'n';
+    assert(apop_text_to_db(infile, "dups", .table_params="unique (a)") == -1);
+    apop_opts.verbose = v;
+    apop_opts.stop_on_warning = stop;
+    assert(!apop_query("begin;")); //fails if the read's transaction is still open.
+    assert(!apop_query("commit;"));
+    assert(apop_query_to_float("select count(*) from dups") == 0);
+    unlink(infile);
+}
+
+//Big enough that the threaded reader will cut it into pieces, with quotes, escaped
+//newlines, and comments all over, so some are sure to straddle a cut.
+void test_threaded_text_reading(){
+    char infile[] = "text_threads_test.csv";
+    FILE *f = fopen(infile, "w");
+    fprintf(f, "a, b, c  # it's the header\n");
+    for (int i=0; i< 60000; i++)
+        if (i%11==0)      fprintf(f, "\"row\n%i\", %i, %g, 1\n", i, i, i/3.);
+        else if (i%11==1) fprintf(f, "# it's a \"comment\n\n");
+        else if (i%11==2) fprintf(f, "'r,%i\\'', %i, , 2\n", i, i);
+        else if (i%11==3) fprintf(f, "r\\\n%i, %i, 1e3\n", i, i);
+        else              fprintf(f, "r%i, %i, %i.25, %i\n", i, i, i, i%11);
+    fclose(f);
+    int prior_threads = apop_opts.thread_count;
+    apop_opts.thread_count = 1;
+    apop_data *serial = apop_text_to_data(infile, .has_row_names='y');
+    int serial_rows = apop_text_to_db(infile, "serial_read", .has_row_names='y');
+    apop_opts.thread_count = 4;
+    apop_data *threaded = apop_text_to_data(infile, .has_row_names='y');
+    int threaded_rows = apop_text_to_db(infile, "threaded_read", .has_row_names='y');
+    apop_opts.thread_count = prior_threads;
+
+    assert(serial->matrix->size1 == 60000 - 60000/11 - 1);
+    assert(threaded->matrix->size1 == serial->matrix->size1);
+    assert(threaded->names->rowct == serial->names->rowct);
+    for (int i=0; i< serial->names->rowct; i++)
+        assert(!strcmp(threaded->names->row[i], serial->names->row[i]));
+    assert(!strcmp(serial->names->row[0], "row\n0"));
+    assert(!strcmp(serial->names->row[1], "r,2'"));
+    assert(!strcmp(serial->names->row[2], "r\n3"));
+    for (size_t i=0; i< serial->matrix->size1; i++)
+        for (size_t j=0; j< 3; j++){
+            double s = apop_data_get(serial, i, j), t = apop_data_get(threaded, i, j);
+            assert(s == t || (gsl_isnan(s) && gsl_isnan(t)));
+        }
+    assert(serial_rows == threaded_rows);
+    assert(apop_query_to_float("select count(*) from serial_read") == serial->matrix->size1);
+    assert(!apop_query_to_float("select count(*) from serial_read s, threaded_read t "
+                      "where s.row_names = t.row_names and s.a = t.a "
+                      "and (s.b != t.b or s.c != t.c or (s.b is null) != (t.b is null) or (s.c is null) != (t.c is null))"));
+    assert(apop_query_to_float("select count(*) from serial_read s, threaded_read t "
+                      "where s.row_names = t.row_names and s.a = t.a") == serial->matrix->size1);
+    apop_data_free(serial);
+    apop_data_free(threaded);
+    unlink(infile);
+}
+
+void test_typed_query_fetching(){
+    apop_query("create table typed(row_names, a, b real, c, d);");
+    apop_query("begin;");
+    for (int i=0; i< 1000; i++)
+        apop_query("insert into typed values('r%i', %i, %i/7.0, %s, 'x%i')", i, i, i,
+                i%4==0 ? "NULL" : i%4==1 ? "'nan'" : i%4==2 ? "'12.5'" : "-999", i);
+    apop_query("commit;");
+    //numbers come back bit-for-bit, not via a 15-digit print-out.
+    assert(apop_query_to_float("select 1.0/3") == 1.0/3);
+    apop_data *d = apop_query_to_data("select * from typed");
+    assert(d->matrix->size1 == 1000 && d->matrix->size2 == 4);
+    assert(d->names->rowct == 1000 && !strcmp(d->names->row[999], "r999"));
+    for (int i=0; i< 1000; i++){
+        assert(apop_data_get(d, i, 0) == i);
+        assert(apop_data_get(d, i, 1) == i/7.0);
+        double c = apop_data_get(d, i, 2);
+        assert(i%4==2 ? c==12.5 : i%4==3 ? c==-999 : gsl_isnan(c));
+        assert(!apop_data_get(d, i, 3)); //'x1' etc. are text; atof gives zero.
+    }
+    apop_data_free(d);
+
+    //A numeric apop_opts.db_nan marks numeric cells equal to it.
+    strcpy(apop_opts.db_nan, "-999");
+    apop_data *dn = apop_query_to_data("select c from typed where row_names in ('r2', 'r3')");
+    assert(apop_data_get(dn, 0, 0) == 12.5 && gsl_isnan(apop_data_get(dn, 1, 0)));
+    apop_data_free(dn);
+    strcpy(apop_opts.db_nan, "NaN");
+
+    apop_data *m = apop_query_to_mixed_data("nvmtw", "select row_names, b, a, d, c from typed");
+    assert(m->vector->size == 1000 && m->matrix->size1 == 1000 && m->weights->size == 1000);
+    assert(m->textsize[0] == 1000 && !strcmp(m->text[999][0], "x999"));
+    assert(apop_data_get(m, 998, -1) == 998/7.0 && apop_data_get(m, 998, 0) == 998);
+    assert(gsl_vector_get(m->weights, 2) == 12.5 && gsl_isnan(gsl_vector_get(m->weights, 4)));
+    apop_data_free(m);
+}
+
 void test_pmf(){
     double x[] = {0, 0.2, 0 , 0.4, 1, .7, 0 , 0, 0};
 	apop_data *d= apop_data_alloc();
@@ -1402,6 +2542,17 @@ int main(int argc, char **argv){
     do_test("test printing", test_printing());
     do_test("test rank expand/compress", rank_round_trip(r));
     do_test("test row set and remove", row_manipulations());
+    do_test("test thread pool resizing and chunking", test_thread_pool());
+    do_test("test reproducible apop_map_sum", test_reproducible_sum());
+    do_test("test multi-page threaded apop_map", test_multipage_map());
+    do_test("test batch log likelihoods", test_batch_log_likelihoods());
+    do_test("test column-major data sets", test_columnar());
+    do_test("test name lookups", test_name_lookup());
+    do_test("test string arenas", test_string_arena());
+    do_test("test text reading", test_text_reading());
+    do_test("test text_to_db rollback on failure", test_text_to_db_failure());
+    do_test("test threaded text reading", test_threaded_text_reading());
+    do_test("test typed query fetching", test_typed_query_fetching());
     do_test("test apop_map on apop_data_rows", test_apop_map_row());
     do_test("test optimization of multi-page parameters", pack_test());
     do_test("Kullback-Leibler divergence test", test_kl_divergence(r));
@@ -1416,6 +2567,17 @@ int main(int argc, char **argv){
     do_test("positive definiteness", test_posdef(r));
     do_test("test binomial estimations", test_binomial(r));
     do_test("test data to db", test_data_to_db());
+    do_test("test bulk data to db", test_bulk_data_to_db());
+    do_test("test query cursors", test_query_cursor());
+    do_test("test SQL quantiles and covariances", test_db_aggregates());
+    do_test("test threaded queries", test_threaded_queries());
+    do_test("test bound queries", test_bound_queries());
+    do_test("binary data files", test_binary_io());
+    do_test("test database merging", test_db_merge());
+    do_test("quantile sketches", test_sketch());
+    do_test("blocked covariance", test_covariance());
+    do_test("running moments", test_running_moments());
+    do_test("multi-start MLE", test_multistart());
     do_test("test db to crosstab", test_crosstabbing());
     do_test("dummies and factors", dummies_and_factors());
     do_test("test vector/matrix realloc", test_resize());
@@ -13,6 +13,8 @@
 extern "C" {
 #endif
 
+struct apop_arena;
+
 /** This structure holds the names of the components of the \ref apop_data set. You may never have to worry about it directly, because most operations on \ref apop_data sets will take care of the names for you.
 \ingroup names
 */
@@ -22,7 +24,9 @@ typedef struct{
 	char ** row;
 	char ** text;
 	int colct, rowct, textct;
+    int colsize, rowsize, textsize; /**< The space allocated for each list, which \ref apop_name_add grows by doubling. Zero if unknown. */
     char title[101];
+    struct apop_arena *arena; /**< Where the names are stored, or \c NULL to use plain \c malloc. See \ref apop_data_use_arena. */
 } apop_name;
 
 /** The \ref apop_data structure represents a data set. It primarily joins together a gsl_vector, a gsl_matrix, and a table of strings, then gives them all row and column names. It tries to be minimally intrusive, so you can use it everywhere you would use a \c gsl_matrix or a \c gsl_vector.
@@ -41,6 +45,8 @@ for (j = 0; j< data->matrix->size1; j++){
 \endcode
 
 We're generally assuming that the data vector and data matrix have the same row count: \c data->vector->size==data->matrix->size1 . This means that the \ref apop_name structure doesn't have separate vector_names and row_names elements: the rownames are assumed to apply for both.
+
+The matrix is normally stored by rows. For wide tables where you'll mostly be going column by column, you can use \ref apop_data_to_columns to move the matrix to the \c columns element, where row \c j of \c columns holds column \c j of the data, contiguously. See that function for which functions understand this form.
 */
 typedef struct apop_data{
     gsl_vector  *vector;
@@ -51,6 +57,8 @@ typedef struct apop_data{
     gsl_vector  *weights;
     struct apop_data   *more;
     char        error;
+    gsl_matrix  *columns; /**< The matrix, stored by columns, or \c NULL. See \ref apop_data_to_columns. */
+    struct apop_arena *arena; /**< Where the names and text are stored, or \c NULL to use plain \c malloc. See \ref apop_data_use_arena. */
 } apop_data;
 
 /** A description of a parametrized statistical model, including the input settings and the output parameters, predicted/expected values, et cetera.  The full declaration is given in the \c apop_model page, see the longer discussion on the \ref models page, or see the \ref apop_ols page for a sample program that uses an \ref apop_model.
@@ -129,7 +137,19 @@ typedef struct{
     char db_pass[101]; /**< Password for database login. Max 100 chars.  */
     FILE *log_file;  /**< The file handle for the log. Defaults to \c stderr, but change it with, e.g.,
                            <tt>apop_opts.log_file = fopen("outlog", "w");</tt> */
-    int  thread_count; /**< Threads to use internally. See \ref apop_map and family.  */
+    int  thread_count; /**< Threads to use internally. See \ref apop_map and family; \ref apop_text_to_data and \ref apop_text_to_db also parse big files on this many threads. The threads are kept running between calls; changing this resizes them on the next threaded call. Threads that query the database each get their own connection; see \ref apop_db_open. */
+    int  thread_chunk_size; /**< When threading, hand out work in chunks of this many rows (or elements), letting
+                              threads that finish early take chunks from threads that are running behind. If zero,
+                              I'll pick a size giving about eight chunks per thread. default = 0. */
+    char string_arena; /**< If 'y', every new \ref apop_data set keeps its names and text in an arena;
+                            see \ref apop_data_use_arena. default = 'n'. */
+    int  db_batch_size; /**< \ref apop_data_to_db and \ref apop_text_to_db commit a transaction
+                              every this many rows. default = 100000. */
+    char db_scratch; /**< If 'y', \ref apop_db_open tells SQLite not to wait for the disk
+                          after each write (<tt>synchronous=off</tt>) and to keep its rollback
+                          journal in memory. Writes are much faster, but if the program or machine
+                          crashes mid-write, the database file may be corrupt, so use this only for
+                          databases you could rebuild. Set it before opening the database. default = 'n'. */
     int  rng_seed;
     float version;
 } apop_opts_type;
@@ -203,6 +223,10 @@ int apop_text_add(apop_data *in, const size_t row, const size_t col, const char
 apop_data * apop_text_alloc(apop_data *in, const size_t row, const size_t col);
 void apop_text_free(char ***freeme, int rows, int cols);
 apop_data *apop_data_transpose(apop_data *in);
+apop_data *apop_data_to_columns(apop_data *d);
+apop_data *apop_data_to_rows(apop_data *d);
+void apop_data_use_arena(apop_data *d);
+apop_data *apop_data_mmap(char const *filename);
 gsl_matrix * apop_matrix_realloc(gsl_matrix *m, size_t newheight, size_t newwidth);
 gsl_vector * apop_vector_realloc(gsl_vector *v, size_t newheight);
 
@@ -333,7 +357,7 @@ apop_model *apop_model_set_parameters_base(apop_model in, double ap[]);
     //The variadic versions, with lots of options to input extra parameters to the
     //function being mapped/applied
 APOP_VAR_DECLARE apop_data * apop_map(apop_data *in, double (*fn_d)(double), double (*fn_v)(gsl_vector*), double (*fn_r)(apop_data *), double (*fn_dp)(double! void *), double (*fn_vp)(gsl_vector*! void *), double (*fn_rp)(apop_data *! void *), double (*fn_dpi)(double! void *! int), double (*fn_vpi)(gsl_vector*! void *! int), double (*fn_rpi)(apop_data*! void *! int), double (*fn_di)(double! int), double (*fn_vi)(gsl_vector*! int), double (*fn_ri)(apop_data*! int), void *param, int inplace, char part, int all_pages);
-APOP_VAR_DECLARE double apop_map_sum(apop_data *in, double (*fn_d)(double), double (*fn_v)(gsl_vector*), double (*fn_r)(apop_data *), double (*fn_dp)(double! void *), double (*fn_vp)(gsl_vector*! void *), double (*fn_rp)(apop_data *! void *), double (*fn_dpi)(double! void *! int), double (*fn_vpi)(gsl_vector*! void *! int), double (*fn_rpi)(apop_data*! void *! int), double (*fn_di)(double! int), double (*fn_vi)(gsl_vector*! int), double (*fn_ri)(apop_data*! int), void *param, char part, int all_pages);
+APOP_VAR_DECLARE double apop_map_sum(apop_data *in, double (*fn_d)(double), double (*fn_v)(gsl_vector*), double (*fn_r)(apop_data *), double (*fn_dp)(double! void *), double (*fn_vp)(gsl_vector*! void *), double (*fn_rp)(apop_data *! void *), double (*fn_dpi)(double! void *! int), double (*fn_vpi)(gsl_vector*! void *! int), double (*fn_rpi)(apop_data*! void *! int), double (*fn_di)(double! int), double (*fn_vi)(gsl_vector*! int), double (*fn_ri)(apop_data*! int), void *param, char part, int all_pages, char reproducible);
 
     //the specific-to-a-type versions, quicker and easier when appropriate.
 gsl_vector *apop_matrix_map(const gsl_matrix *m, double (*fn)(gsl_vector*));